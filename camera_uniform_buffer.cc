@@ -0,0 +1,96 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "camera_uniform_buffer.h"
+
+#include <algorithm>
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <GL/glew.h>
+
+#include "shader_program.h"
+
+namespace wvu {
+
+const char kCameraUniformBlockSource[] =
+    "layout (std140) uniform Camera {\n"
+    "mat4 view;\n"
+    "mat4 projection;\n"
+    "mat4 view_projection;\n"
+    "vec4 camera_position;\n"
+    "float time;\n"
+    "};\n";
+
+CameraUniformBuffer::~CameraUniformBuffer() {
+  if (buffer_id_ != 0) {
+    glDeleteBuffers(1, &buffer_id_);
+  }
+}
+
+bool CameraUniformBuffer::Create() {
+  if (buffer_id_ != 0) return true;
+  glGenBuffers(1, &buffer_id_);
+  if (buffer_id_ == 0) return false;
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  // The buffer stays bound to the binding point for the rest of the program.
+  glBindBufferBase(GL_UNIFORM_BUFFER, kCameraUniformBlockBinding, buffer_id_);
+  return true;
+}
+
+void CameraUniformBuffer::Update(const Eigen::Matrix4f& projection,
+                                 const Eigen::Matrix4f& view,
+                                 const float time) {
+  CameraBlock block;
+  const Eigen::Matrix4f view_projection = projection * view;
+  std::copy(view.data(), view.data() + 16, block.view);
+  std::copy(projection.data(), projection.data() + 16, block.projection);
+  std::copy(view_projection.data(), view_projection.data() + 16,
+            block.view_projection);
+  // The camera center is the translation of the camera -> world transformation.
+  const Eigen::Vector4f camera_position = view.inverse().col(3);
+  std::copy(camera_position.data(), camera_position.data() + 4,
+            block.camera_position);
+  block.time = time;
+  std::fill(block.padding, block.padding + 3, 0.0f);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+}  // namespace wvu
@@ -0,0 +1,106 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef CAMERA_UNIFORM_BUFFER_H_
+#define CAMERA_UNIFORM_BUFFER_H_
+
+#include <Eigen/Core>
+#include <GL/glew.h>
+
+namespace wvu {
+// GLSL declaration of the camera uniform block. Shaders that need the camera
+// data include this declaration in their source. ShaderProgram::Create() binds
+// the block to kCameraUniformBlockBinding.
+extern const char kCameraUniformBlockSource[];
+
+// Uniform buffer object holding the camera data that is constant for a frame:
+// the view, projection and view-projection matrices, the camera position and
+// the time. The buffer is written once per frame and bound to the fixed binding
+// point kCameraUniformBlockBinding, so every shader program reads the same data
+// and no camera uniforms are uploaded per object.
+//
+// Example:
+//
+// wvu::CameraUniformBuffer camera_buffer;
+// camera_buffer.Create();
+// while (...) {  // Rendering loop.
+//   camera_buffer.Update(projection, view, glfwGetTime());
+//   ...  // Draw the models.
+// }
+class CameraUniformBuffer {
+ public:
+  CameraUniformBuffer() : buffer_id_(0) {}
+  ~CameraUniformBuffer();
+
+  // Creates the buffer object and binds it to kCameraUniformBlockBinding.
+  // Returns true if successful.
+  bool Create();
+
+  // Writes the camera data of the frame into the buffer.
+  // Params:
+  //   projection  The camera projection matrix.
+  //   view  The camera pose matrix (world -> camera transformation matrix).
+  //   time  The time in seconds.
+  void Update(const Eigen::Matrix4f& projection,
+              const Eigen::Matrix4f& view,
+              const float time);
+
+  // Returns the id of the buffer object.
+  GLuint buffer_id() const {
+    return buffer_id_;
+  }
+
+ private:
+  // Camera data laid out following the std140 rules. The matrices are stored
+  // in column-major order.
+  struct CameraBlock {
+    GLfloat view[16];
+    GLfloat projection[16];
+    GLfloat view_projection[16];
+    // Position of the camera in the world (w = 1).
+    GLfloat camera_position[4];
+    GLfloat time;
+    // The size of a std140 block is a multiple of 16 bytes.
+    GLfloat padding[3];
+  };
+
+  // Uniform buffer object id.
+  GLuint buffer_id_;
+};
+
+}  // namespace wvu
+
+#endif  // CAMERA_UNIFORM_BUFFER_H_
@@ -39,6 +39,7 @@
 #define _USE_MATH_DEFINES  // For using M_PI.
 #include <cmath>
 #include <Eigen/Core>
+#include <Eigen/LU>
 #include <GL/glew.h>
 
 namespace wvu {
@@ -87,5 +88,37 @@ Eigen::Matrix4f ComputePerspectiveProjectionMatrix(const GLfloat field_of_view,
   return projection_matrix;
 }
 
-}  // namespace wvu
+// Computes the planes of the view frustum from the view-projection matrix.
+// A point is inside the clipping volume when -w <= x, y, z <= w in clip
+// space, and every inequality is a plane made of the rows of the matrix.
+Eigen::Matrix<float, 6, 4> ComputeFrustumPlanes(
+    const Eigen::Matrix4f& view_projection) {
+  Eigen::Matrix<float, 6, 4> planes;
+  for (int axis = 0; axis < 3; ++axis) {
+    planes.row(2 * axis) = view_projection.row(3) + view_projection.row(axis);
+    planes.row(2 * axis + 1) =
+        view_projection.row(3) - view_projection.row(axis);
+  }
+  for (int i = 0; i < 6; ++i) {
+    planes.row(i) /= planes.row(i).head<3>().norm();
+  }
+  return planes;
+}
 
+// Unprojects the point on the near and far planes; the ray goes from one to
+// the other.
+void ComputePickingRay(const Eigen::Matrix4f& view_projection,
+                       const float x,
+                       const float y,
+                       Eigen::Vector3f* origin,
+                       Eigen::Vector3f* direction) {
+  const Eigen::Matrix4f inverse_view_projection = view_projection.inverse();
+  const Eigen::Vector4f near_point =
+      inverse_view_projection * Eigen::Vector4f(x, y, -1.0f, 1.0f);
+  const Eigen::Vector4f far_point =
+      inverse_view_projection * Eigen::Vector4f(x, y, 1.0f, 1.0f);
+  *origin = near_point.head<3>() / near_point.w();
+  *direction = (far_point.head<3>() / far_point.w() - *origin).normalized();
+}
+
+}  // namespace wvu
@@ -51,6 +51,30 @@ Eigen::Matrix4f ComputePerspectiveProjectionMatrix(const GLfloat field_of_view,
                                                    const GLfloat aspect_ratio,
                                                    const GLfloat near,
                                                    const GLfloat far);
+
+// Computes the planes of the view frustum from the view-projection matrix.
+// Each row is a plane (a, b, c, d) in world space, normalized so that
+// a * x + b * y + c * z + d is the signed distance of the point (x, y, z) to
+// the plane, positive inside the frustum. The rows are the left, right,
+// bottom, top, near and far planes.
+// Params:
+//   view_projection  The projection matrix times the view matrix.
+Eigen::Matrix<float, 6, 4> ComputeFrustumPlanes(
+    const Eigen::Matrix4f& view_projection);
+
+// Computes the ray from the camera through a point of the window, e.g., to
+// pick the model under the cursor. The ray starts on the near plane.
+// Params:
+//   view_projection  The projection matrix times the view matrix.
+//   x, y  The point in normalized device coordinates: -1 is the left or
+//     bottom edge of the window, and 1 the right or top edge.
+//   origin  The start of the ray, in world space.
+//   direction  The unit direction of the ray, in world space.
+void ComputePickingRay(const Eigen::Matrix4f& view_projection,
+                       const float x,
+                       const float y,
+                       Eigen::Vector3f* origin,
+                       Eigen::Vector3f* direction);
 }  // namespace wvu
 
 #endif  // CAMERA_UTILS_H_
@@ -0,0 +1,93 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef CPU_FEATURES_H_
+#define CPU_FEATURES_H_
+
+// The SIMD kernels of the project are compiled with function-level target
+// attributes (e.g., __attribute__((target("avx2")))) instead of global
+// compiler flags, and selected at run time with the functions below, so the
+// binary runs on any x86 processor. WVU_X86 is defined where the compiler
+// supports both; elsewhere only the scalar paths are compiled.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define WVU_X86 1
+#include <immintrin.h>
+#endif
+
+namespace wvu {
+
+// Return true if the processor supports the instruction set. The answer is
+// queried once and cached. They return false when WVU_X86 is not defined.
+inline bool CpuHasSse2() {
+#ifdef WVU_X86
+  static const bool has_sse2 = __builtin_cpu_supports("sse2");
+  return has_sse2;
+#else
+  return false;
+#endif
+}
+
+inline bool CpuHasSsse3() {
+#ifdef WVU_X86
+  static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+  return has_ssse3;
+#else
+  return false;
+#endif
+}
+
+inline bool CpuHasAvx() {
+#ifdef WVU_X86
+  static const bool has_avx = __builtin_cpu_supports("avx");
+  return has_avx;
+#else
+  return false;
+#endif
+}
+
+inline bool CpuHasAvx2() {
+#ifdef WVU_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+#else
+  return false;
+#endif
+}
+
+}  // namespace wvu
+
+#endif  // CPU_FEATURES_H_
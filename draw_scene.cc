@@ -41,13 +41,14 @@
 #define GLUTILS_GFLAGS_NAMESPACE gflags
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <memory>
 #include <string>
-
-// Include CImg library to load textures.
-// The macro below disables the capabilities of displaying images in CImg.
-#define cimg_display 0
-#include <CImg.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 // The macro below tells the linker to use the GLEW library in a static way.
 // This is mainly for compatibility with Windows.
@@ -77,6 +78,55 @@
 
 // Camera utils.
 #include "camera_utils.h"
+
+// Camera uniform buffer.
+#include "camera_uniform_buffer.h"
+
+// Cache of shader program binaries.
+#include "program_binary_cache.h"
+
+// Asynchronous texture loading.
+#include "texture_loader.h"
+
+// Texture arrays.
+#include "texture_array.h"
+
+// Block compression of textures.
+#include "texture_compression.h"
+
+// Shared textures.
+#include "texture_cache.h"
+
+// Mipmaps built on the CPU.
+#include "mipmap_generator.h"
+
+// Video memory budgets.
+#include "residency_manager.h"
+
+// Textures streamed page by page.
+#include "virtual_texture.h"
+
+// Shared geometry buffers drawn with multi-draw indirect.
+#include "geometry_allocator.h"
+#include "multi_draw_batch.h"
+
+// Frustum culling on the GPU.
+#include "gpu_frustum_culler.h"
+
+// Frustum culling on the CPU.
+#include "frustum_culler.h"
+
+// Bounding volume hierarchy of the scene.
+#include "scene_bvh.h"
+
+// Occlusion culling on the CPU.
+#include "occlusion_culler.h"
+
+// Occlusion culling with hardware occlusion queries.
+#include "occlusion_query_culler.h"
+
+// Potentially visible sets of the scene, baked offline.
+#include "potentially_visible_set.h"
 #include <iostream>
 
 #define _USE_MATH_DEFINES
@@ -94,6 +144,112 @@ DEFINE_string(texture1_filepath, "",
 DEFINE_string(texture2_filepath, "",
               "Filepath of the texture 2.");
 DEFINE_string(texture3_filepath, "", "Filepath of the texture 3");
+DEFINE_string(shader_cache_directory, "",
+              "Directory of the on-disk cache of shader program binaries. "
+              "The cache is disabled when empty.");
+DEFINE_int32(texture_loader_threads, 0,
+             "Number of threads decoding textures. When zero, one thread per "
+             "hardware thread is used.");
+DEFINE_int32(texture_preview_scale, 8,
+             "JPEG textures are first shown with a preview decoded at "
+             "1/texture_preview_scale of their resolution (2, 4 or 8). 1 "
+             "disables the previews.");
+DEFINE_bool(texture_load_benchmark, false,
+            "Measures the time it takes to load 3, 100 and 1000 textures "
+            "(cycling through the texture flags) with one decoding thread and "
+            "with the thread pool, and exits.");
+DEFINE_bool(stress_test, false,
+            "Renders 1k, 10k and 100k cubes with the per-model loop and with "
+            "instancing, reports draw calls and frame times, and exits.");
+DEFINE_int32(stress_test_frames, 100,
+             "Number of frames rendered per stress test configuration.");
+DEFINE_bool(texture_array, false,
+            "Packs the textures of the models into texture arrays, so that "
+            "the models select a layer instead of binding their own texture.");
+DEFINE_bool(multi_draw_scene, false,
+            "Draws the scene from one vertex and one index buffer shared by "
+            "all the meshes, with a multi-draw indirect call per texture (one "
+            "per texture array with -texture_array) instead of a draw call "
+            "per model. Needs OpenGL 4.3.");
+DEFINE_string(texture_compression, "none",
+              "Block compression of the textures: none, bc1, bc3 or bc7. "
+              "Falls back to none when the driver does not support it.");
+DEFINE_int32(texture_upload_budget_kb, 4096,
+             "Kilobytes of texture levels uploaded per frame. The textures "
+             "are drawn with their smallest levels until the larger ones are "
+             "uploaded. 0 uploads every level at once.");
+DEFINE_string(mipmap_filter, "box",
+              "Filter building the mipmaps of the textures: box or kaiser.");
+DEFINE_int32(texture_budget_mb, 0,
+             "Megabytes of video memory for the textures. Over budget, the "
+             "least recently drawn textures drop their largest mipmap levels. "
+             "0 disables the budget.");
+DEFINE_int32(mesh_budget_mb, 0,
+             "Megabytes of video memory for the meshes. Over budget, the "
+             "least recently drawn meshes release their buffers. 0 disables "
+             "the budget.");
+DEFINE_bool(virtual_texture, false,
+            "Streams the textures as virtual textures: the texture flags are "
+            ".wvvt files (see texture_baker), whose pages are loaded into a "
+            "cache of fixed size as the scene needs them.");
+DEFINE_int32(virtual_texture_cache_pages, 16,
+             "Pages per side of the cache of the virtual textures. Each page "
+             "takes 136x136 texels.");
+DEFINE_int32(virtual_texture_feedback_scale, 8,
+             "The pages needed by the virtual textures are found by drawing "
+             "the scene at 1/virtual_texture_feedback_scale of the window "
+             "size.");
+DEFINE_bool(frustum_culling, true,
+            "Draws only the models whose bounding box intersects the view "
+            "frustum. The visible and culled counts of every frame are logged "
+            "with -v=1.");
+DEFINE_bool(scene_bvh, true,
+            "Culls the models with a bounding volume hierarchy of the scene "
+            "instead of testing each of them, and logs the model under the "
+            "cursor on a left click.");
+DEFINE_bool(bvh_benchmark, false,
+            "Logs the build, refit, culling and picking times of the BVH of "
+            "the scene with 10k, 100k and 1M cubes, and exits.");
+DEFINE_bool(bake_pvs, false,
+            "Bakes the potentially visible sets of the scene into -pvs_file, "
+            "logs the size and time of the bake, and exits.");
+DEFINE_string(pvs_file, "",
+              "File of potentially visible sets (.wvpvs) baked for the scene "
+              "with -bake_pvs. While the camera is in its grid, only the "
+              "models of the set of its cell are drawn.");
+DEFINE_double(pvs_cell_size, 1.0,
+              "Side of the view cells of the potentially visible sets.");
+DEFINE_int32(pvs_rays_per_model, 16,
+             "Rays cast from each view cell towards each model before the "
+             "model is considered hidden from the cell.");
+DEFINE_bool(occlusion_culling, false,
+            "Rasterizes the largest models on screen into a small depth buffer "
+            "on the CPU, and skips the models hidden behind them.");
+DEFINE_int32(occlusion_culling_threads, 0,
+             "Number of threads rasterizing the occluders and testing the "
+             "models. Zero uses one per hardware thread.");
+DEFINE_bool(occlusion_queries, false,
+            "Draws the bounding box of every drawn model inside a hardware "
+            "occlusion query, and draws the model in the next frame under the "
+            "conditional rendering of the query.");
+DEFINE_bool(occlusion_culling_benchmark, false,
+            "Renders the culling grid behind a row of walls with frustum "
+            "culling only, with occlusion culling on the CPU and with "
+            "occlusion queries, logs the frame time and the drawn and "
+            "occluded counts of each, and exits.");
+DEFINE_bool(culling_benchmark, false,
+            "Renders -culling_benchmark_objects cubes spread around the camera "
+            "with the per-model loop, with CPU frustum culling and with GPU "
+            "frustum culling, logs the frame time of each, and exits.");
+DEFINE_int32(culling_benchmark_objects, 1000000,
+             "Number of cubes drawn by the culling benchmarks.");
+DEFINE_int32(culling_benchmark_frames, 10,
+             "Number of frames rendered by each path of the culling "
+             "benchmarks.");
+DEFINE_bool(texture_compression_benchmark, false,
+            "Compresses every texture with BC1, BC3 and BC7, reports the video "
+            "memory and upload time against the uncompressed texture, and "
+            "exits.");
 
 // Annonymous namespace for constants and helper functions.
 namespace {
@@ -102,6 +258,9 @@ namespace {
     // Window dimensions.
     constexpr int kWindowWidth = 1280/*640*/;
     constexpr int kWindowHeight = 800/*480*/;
+    // The depth buffer of the occlusion culling is 1/5 of the window size.
+    constexpr int kOcclusionBufferWidth = kWindowWidth / 5;
+    constexpr int kOcclusionBufferHeight = kWindowHeight / 5;
     
     // GLSL shaders.
     // Every shader should declare its version.
@@ -113,61 +272,165 @@ namespace {
     // Note that the position variable is of type vec3, which is a 3D dimensional
     // vector. The layout keyword determines the way the VAO buffer is arranged in
     // memory. This way the shader can read the vertices correctly.
+    // The view and projection matrices come from the camera uniform block, which
+    // is written once per frame; their product is precomputed on the CPU.
+    // When TEXTURE_ARRAY is defined, the texel is moved to the place of the
+    // texture in its layer (see wvu::TextureRegion).
     const std::string vertex_shader_src =
     "#version 330 core\n"
     "layout (location = 0) in vec3 position;\n"
     "layout (location = 1) in vec2 passed_texel;\n"
     "uniform mat4 model;\n"
-    "uniform mat4 view;\n"
-    "uniform mat4 projection;\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "uniform float texture_layer;\n"
+    "uniform vec4 texture_transform;\n"
+    "flat out float layer;\n"
+    "#endif\n"
+    + std::string(wvu::kCameraUniformBlockSource) +
     "out vec2 texel;\n"
     "\n"
     "void main() {\n"
-    "gl_Position = projection * view * model * vec4(position, 1.0f);\n"
+    "gl_Position = view_projection * model * vec4(position, 1.0f);\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "texel = passed_texel * texture_transform.xy + texture_transform.zw;\n"
+    "layer = texture_layer;\n"
+    "#else\n"
     "texel = passed_texel;\n"
+    "#endif\n"
     "}\n";
     
     // Fragment shader follows standard 3.3.0. The goal of the fragment shader is to
     // calculate the color of the pixel corresponding to a vertex. This is why we
     // declare a variable named color of type vec4 (4D vector) as its output. This
     // shader sets the output color to a (1.0, 0.5, 0.2, 1.0) using an RGBA format.
+    // When VIRTUAL_TEXTURE is defined, the bound texture is the page table of a
+    // virtual texture (see wvu::VirtualTextureManager).
     const std::string fragment_shader_src =
     "#version 330 core\n"
     "in vec2 texel;\n"
     "out vec4 color;\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "flat in float layer;\n"
+    "uniform sampler2DArray texture_sampler;\n"
+    "#else\n"
     "uniform sampler2D texture_sampler;\n"
+    "#endif\n"
+    "#ifdef VIRTUAL_TEXTURE\n"
+    + std::string(wvu::kVirtualTextureShaderSource) +
+    "#endif\n"
     "void main() {\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "color = texture(texture_sampler, vec3(texel, layer));\n"
+    "#elif defined(VIRTUAL_TEXTURE)\n"
+    "color = SampleVirtualTexture(texture_sampler, texel);\n"
+    "#else\n"
     "color = texture(texture_sampler, texel);\n"
+    "#endif\n"
     "}\n";
     
-    // -------------------- Texture helper functions -------------------------------
-    GLuint LoadTexture(const std::string& texture_filepath) {
-        cimg_library::CImg<unsigned char> image;
-        image.load(texture_filepath.c_str());
-        const int width = image.width();
-        const int height = image.height();
-        // OpenGL expects to have the pixel values interleaved (e.g., RGBD, ...). CImg
-        // flatens out the planes. To have them interleaved, CImg has to re-arrange
-        // the values.
-        // Also, OpenGL has the y-axis of the texture flipped.
-        image.permute_axes("cxyz");
-        GLuint texture_id;
-        glGenTextures(1, &texture_id);
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-        // We are configuring texture wrapper, each per dimension,s:x, t:y.
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // Define the interpolation behavior for this texture.
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        /// Sending the texture information to the GPU.
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height,
-                     0, GL_RGB, GL_UNSIGNED_BYTE, image.data());
-        // Generate a mipmap.
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        return texture_id;
-    }
+    // Fragment shader of the feedback pass of the virtual textures. Writes the
+    // page of the virtual texture that the fragment needs.
+    const std::string feedback_fragment_shader_src =
+    "#version 330 core\n"
+    "in vec2 texel;\n"
+    "out vec4 color;\n"
+    "uniform sampler2D texture_sampler;\n"
+    + std::string(wvu::kVirtualTextureShaderSource) +
+    "void main() {\n"
+    "color = ComputeVirtualTextureFeedback(texture_sampler, texel);\n"
+    "}\n";
+    
+    // Fragment shader used while the scene shader program is still being built
+    // by the driver. It is tiny, so it builds quickly, and paints the models with
+    // a flat color.
+    const std::string fallback_fragment_shader_src =
+    "#version 330 core\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "color = vec4(0.5f, 0.5f, 0.5f, 1.0f);\n"
+    "}\n";
+    
+    // Vertex shader used for instanced rendering. The model matrix, the tint and
+    // the texture layer are per-instance attributes (see wvu::ModelInstance)
+    // instead of uniform variables, so a single draw call renders all instances.
+    // A mat4 attribute takes four consecutive locations (2 to 5).
+    const std::string instanced_vertex_shader_src =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "layout (location = 1) in vec2 passed_texel;\n"
+    "layout (location = 2) in mat4 instance_model;\n"
+    "layout (location = 6) in vec4 instance_tint;\n"
+    "layout (location = 7) in float instance_texture_layer;\n"
+    "layout (location = 8) in vec4 instance_texture_transform;\n"
+    + std::string(wvu::kCameraUniformBlockSource) +
+    "out vec2 texel;\n"
+    "out vec4 tint;\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "flat out float layer;\n"
+    "#endif\n"
+    "\n"
+    "void main() {\n"
+    "gl_Position = view_projection * instance_model * vec4(position, 1.0f);\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "texel = passed_texel * instance_texture_transform.xy +\n"
+    "    instance_texture_transform.zw;\n"
+    "layer = instance_texture_layer;\n"
+    "#else\n"
+    "texel = passed_texel;\n"
+    "#endif\n"
+    "tint = instance_tint;\n"
+    "}\n";
+    
+    // Fragment shader used for instanced rendering. Multiplies the texel color by
+    // the tint of the instance.
+    const std::string instanced_fragment_shader_src =
+    "#version 330 core\n"
+    "in vec2 texel;\n"
+    "in vec4 tint;\n"
+    "out vec4 color;\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "flat in float layer;\n"
+    "uniform sampler2DArray texture_sampler;\n"
+    "#else\n"
+    "uniform sampler2D texture_sampler;\n"
+    "#endif\n"
+    "void main() {\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "color = tint * texture(texture_sampler, vec3(texel, layer));\n"
+    "#else\n"
+    "color = tint * texture(texture_sampler, texel);\n"
+    "#endif\n"
+    "}\n";
+    
+    // Vertex shader used for multi-draw indirect rendering. The objects are read
+    // from a shader storage buffer with the index of the draw (see
+    // wvu::MultiDrawBatch), which needs GLSL 4.30. Pairs with the instanced
+    // fragment shader.
+    const std::string multi_draw_vertex_shader_src =
+    "#version 430 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "layout (location = 1) in vec2 passed_texel;\n"
+    + std::string(wvu::kDrawObjectShaderSource)
+    + std::string(wvu::kMultiDrawShaderSource)
+    + std::string(wvu::kCameraUniformBlockSource) +
+    "out vec2 texel;\n"
+    "out vec4 tint;\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "flat out float layer;\n"
+    "#endif\n"
+    "\n"
+    "void main() {\n"
+    "DrawObject object = GetDrawObject();\n"
+    "gl_Position = view_projection * object.model * vec4(position, 1.0f);\n"
+    "#ifdef TEXTURE_ARRAY\n"
+    "texel = passed_texel * object.texture_transform.xy +\n"
+    "    object.texture_transform.zw;\n"
+    "layer = object.texture_layer;\n"
+    "#else\n"
+    "texel = passed_texel;\n"
+    "#endif\n"
+    "tint = object.tint;\n"
+    "}\n";
     
     // Error callback function. This function follows the required signature of
     // GLFW. See http://www.glfw.org/docs/3.0/group__error.html for more
@@ -226,10 +489,16 @@ namespace {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     }
     
-    bool CreateShaderProgram(wvu::ShaderProgram* shader_program) {
+    // Cache of shader program binaries. Null when the cache is disabled.
+    wvu::ProgramBinaryCache* program_binary_cache = nullptr;
+    
+    bool CreateShaderProgram(const std::string& vertex_shader_source,
+                             const std::string& fragment_shader_source,
+                             wvu::ShaderProgram* shader_program) {
         if (shader_program == nullptr) return false;
-        shader_program->LoadVertexShaderFromString(vertex_shader_src);
-        shader_program->LoadFragmentShaderFromString(fragment_shader_src);
+        shader_program->set_binary_cache(program_binary_cache);
+        shader_program->LoadVertexShaderFromString(vertex_shader_source);
+        shader_program->LoadFragmentShaderFromString(fragment_shader_source);
         std::string error_info_log;
         if (!shader_program->Create(&error_info_log)) {
             std::cout << "ERROR: " << error_info_log << "\n";
@@ -241,13 +510,198 @@ namespace {
         return true;
     }
     
+    // Submits the build of the shader program to the driver without waiting for
+    // it. Use wvu::ShaderProgram::PollCreate() to know when it is ready.
+    bool BeginCreateShaderProgram(const std::string& vertex_shader_source,
+                                  const std::string& fragment_shader_source,
+                                  wvu::ShaderProgram* shader_program) {
+        if (shader_program == nullptr) return false;
+        shader_program->set_binary_cache(program_binary_cache);
+        shader_program->LoadVertexShaderFromString(vertex_shader_source);
+        shader_program->LoadFragmentShaderFromString(fragment_shader_source);
+        return shader_program->BeginCreate();
+    }
+    
+    // Polls the build of a shader program started with
+    // BeginCreateShaderProgram() without blocking. Sets ready once the program
+    // can be used. Returns false if the build failed.
+    bool PollShaderProgram(wvu::ShaderProgram* shader_program, bool* ready) {
+        if (shader_program == nullptr || ready == nullptr) return false;
+        if (*ready) return true;
+        std::string error_info_log;
+        const wvu::ShaderProgram::BuildStatus status =
+            shader_program->PollCreate(&error_info_log);
+        if (status == wvu::ShaderProgram::BuildStatus::kFailed) {
+            std::cerr << "ERROR: " << error_info_log << "\n";
+            return false;
+        }
+        *ready = status == wvu::ShaderProgram::BuildStatus::kReady;
+        return true;
+    }
+    
+    // Waits for the build of a shader program started with
+    // BeginCreateShaderProgram(). The benchmarks submit all their programs
+    // first and then wait for each, so that the driver builds them in
+    // parallel. Returns false if the build failed.
+    bool WaitForShaderProgram(wvu::ShaderProgram* shader_program) {
+        bool ready = false;
+        while (!ready) {
+            if (!PollShaderProgram(shader_program, &ready)) return false;
+            if (!ready) std::this_thread::yield();
+        }
+        return true;
+    }
+    
+    // Logs the statistics of the cache of shader program binaries.
+    void LogProgramBinaryCacheStats() {
+        if (program_binary_cache == nullptr) return;
+        const wvu::ProgramBinaryCache::Stats& stats =
+            program_binary_cache->stats();
+        LOG(INFO) << "Shader cache: " << stats.hits << " hits, "
+                  << stats.misses << " misses (" << stats.rejected
+                  << " rejected by the driver), " << stats.time_saved_ms
+                  << " ms saved.";
+    }
+    
+    // Returns the texture array of the model, or zero if it has none.
+    GLuint GetTextureArray(const Model* model) {
+        return model->texture_region().texture_id;
+    }
+    
+    // Returns the texture bound to draw the model: its texture array, or its
+    // own texture when it has no texture region.
+    GLuint GetDrawTexture(const Model* model) {
+        const GLuint texture_array_id = model->texture_region().texture_id;
+        return texture_array_id != 0 ? texture_array_id : model->texture_id();
+    }
+    
+    // Returns true if the models sharing a texture are next to each other in
+    // the order of the ids of the textures.
+    // Params:
+    //   get_texture  Returns the texture of a model.
+    bool IsGroupedByTexture(const std::vector<Model*>& models,
+                            GLuint (*get_texture)(const Model*)) {
+        for(int i = 1; i < models.size(); i++){
+            if(get_texture(models[i]) < get_texture(models[i - 1])){
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Copies the models into grouped_models so that the models sharing a
+    // texture are next to each other, keeping their order otherwise. This is a
+    // counting sort over the few textures of the scene, which is several times
+    // faster than std::stable_sort() on the visible models.
+    // Params:
+    //   get_texture  Returns the texture of a model.
+    void GroupByTexture(const std::vector<Model*>& models,
+                        GLuint (*get_texture)(const Model*),
+                        std::vector<Model*>* grouped_models) {
+        std::vector<GLuint> texture_ids;
+        std::vector<int> group_offsets;
+        for(int i = 0; i < models.size(); i++){
+            const GLuint texture_id = get_texture(models[i]);
+            const int group = std::find(texture_ids.begin(), texture_ids.end(),
+                                        texture_id) - texture_ids.begin();
+            if(group == texture_ids.size()){
+                texture_ids.push_back(texture_id);
+                group_offsets.push_back(0);
+            }
+            group_offsets[group]++;
+        }
+        int offset = 0;
+        for(int group = 0; group < group_offsets.size(); group++){
+            const int group_size = group_offsets[group];
+            group_offsets[group] = offset;
+            offset += group_size;
+        }
+        grouped_models->resize(models.size());
+        for(int i = 0; i < models.size(); i++){
+            const int group = std::find(texture_ids.begin(), texture_ids.end(),
+                                        get_texture(models[i])) - texture_ids.begin();
+            grouped_models->at(group_offsets[group]++) = models[i];
+        }
+    }
+    
+    // Geometry of the scene suballocated from the shared buffers of a geometry
+    // allocator, and the batch submitting the visible models with multi-draw
+    // indirect (see -multi_draw_scene).
+    struct SceneMultiDraw {
+        wvu::GeometryAllocator geometry_allocator;
+        wvu::MultiDrawBatch batch;
+        // Allocation of every mesh drawn so far.
+        std::unordered_map<const wvu::Mesh*, int> mesh_allocations;
+        // The visible models grouped by texture, kept across frames so that
+        // its memory is reused.
+        std::vector<Model*> grouped_models;
+    };
+    
+    // Draws the models with a multi-draw indirect call per texture: the
+    // commands of the models sharing a texture are consecutive in the batch,
+    // and the texture is bound before drawing their range. The meshes are
+    // uploaded into the geometry allocator the first time they are drawn. The
+    // multi-draw shader program must be in use.
+    void DrawModelsWithMultiDraw(const std::vector<Model*>& models,
+                                 SceneMultiDraw* multi_draw) {
+        const std::vector<Model*>* grouped_models = &models;
+        if(!IsGroupedByTexture(models, GetDrawTexture)){
+            GroupByTexture(models, GetDrawTexture, &multi_draw->grouped_models);
+            grouped_models = &multi_draw->grouped_models;
+        }
+        wvu::MultiDrawBatch& batch = multi_draw->batch;
+        batch.Clear();
+        //First draw of each range of models sharing a texture, and the model
+        //whose texture the range binds.
+        std::vector<int> range_first_draws;
+        std::vector<const Model*> range_models;
+        wvu::DrawObject object = {};
+        for(Model* model : *grouped_models){
+            const wvu::Mesh* mesh = model->mesh();
+            auto mesh_allocation = multi_draw->mesh_allocations.find(mesh);
+            if(mesh_allocation == multi_draw->mesh_allocations.end()){
+                const int allocation =
+                    multi_draw->geometry_allocator.Allocate(mesh->vertices(), mesh->indices());
+                mesh_allocation = multi_draw->mesh_allocations.emplace(mesh, allocation).first;
+            }
+            if(mesh_allocation->second < 0) continue;
+            if(range_models.empty() ||
+               GetDrawTexture(model) != GetDrawTexture(range_models.back())){
+                range_first_draws.push_back(batch.num_draws());
+                range_models.push_back(model);
+            }
+            model->SetDrawObject(&object);
+            batch.Add(mesh_allocation->second, object);
+        }
+        range_first_draws.push_back(batch.num_draws());
+        batch.Upload();
+        for(int i = 0; i < range_models.size(); i++){
+            const GLenum texture_target = GetTextureArray(range_models[i]) != 0 ?
+                GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+            glBindTexture(texture_target, GetDrawTexture(range_models[i]));
+            batch.DrawRange(range_first_draws[i],
+                            range_first_draws[i + 1] - range_first_draws[i]);
+            glBindTexture(texture_target, 0);
+        }
+    }
+    
+    // Multi-draw of the scene drawn by RenderScene() instead of a draw call
+    // per model. Null when the scene is drawn model by model.
+    SceneMultiDraw* scene_multi_draw = nullptr;
+    
     // Renders the scene.
     void RenderScene(const wvu::ShaderProgram& shader_program,
                      const Eigen::Matrix4f& projection,
                      const Eigen::Matrix4f& view,
+                     wvu::CameraUniformBuffer* camera_buffer,
                      std::vector<Model*>* models_to_draw,
+                     wvu::PotentiallyVisibleSet* pvs,
+                     wvu::FrustumCuller* frustum_culler,
+                     wvu::SceneBvh* scene_bvh,
+                     wvu::OcclusionCuller* occlusion_culler,
+                     wvu::OcclusionQueryCuller* occlusion_query_culler,
                      GLFWwindow* window) {
-        if(models_to_draw == nullptr || window == nullptr){
+        if(camera_buffer == nullptr || models_to_draw == nullptr || window == nullptr){
             std::cout << "Null pointer passed.  Could not render scene.";
             return;
         }
@@ -257,6 +711,8 @@ namespace {
                 return;
             }
         }
+        // Write the camera data shared by all the models once per frame.
+        camera_buffer->Update(projection, view, static_cast<float>(glfwGetTime()));
         // Clear the buffer.
         ClearTheFrameBuffer();
         // Let OpenGL know that we want to use our shader program.
@@ -264,12 +720,84 @@ namespace {
         // Render the models in a wireframe mode.
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         // Draw the models.
-        // TODO: For every model in models_to_draw, call its Draw() method, passing
-        // the view and projection matrices.
-        //Rotate models within loops
+        // TODO: For every model in models_to_draw, call its Draw() method.
+        //Only the models in the view frustum are drawn when there is a culler
+        //or a BVH of the scene, which holds the models_to_draw. While the
+        //camera is in the grid of the potentially visible sets, only the
+        //models of the set of its cell are tested.
+        const std::vector<Model*>* visible_models = models_to_draw;
+        const std::vector<Model*>* cell_models = nullptr;
+        if(pvs != nullptr){
+            const Eigen::Vector3f camera_position =
+                -view.topLeftCorner<3, 3>().transpose() * view.topRightCorner<3, 1>();
+            cell_models = pvs->Lookup(camera_position);
+        }
+        if(cell_models != nullptr){
+            visible_models = cell_models;
+            if(frustum_culler != nullptr){
+                visible_models = &frustum_culler->Cull(projection * view, *cell_models);
+            }
+        } else if(scene_bvh != nullptr){
+            visible_models = &scene_bvh->Cull(projection * view);
+        } else if(frustum_culler != nullptr){
+            visible_models = &frustum_culler->Cull(projection * view, *models_to_draw);
+        }
+        //Of those, the ones hidden behind the largest ones are skipped.
+        if(occlusion_culler != nullptr){
+            visible_models = &occlusion_culler->Cull(projection * view, *visible_models);
+        }
+        //With a multi-draw of the scene, the visible models are submitted with
+        //a call per texture instead of a draw call each, and shader_program is
+        //the multi-draw program. The occlusion queries need a draw per model,
+        //so they are not used then.
+        if(scene_multi_draw != nullptr){
+            DrawModelsWithMultiDraw(*visible_models, scene_multi_draw);
+        } else {
+            //The BVH and the cullers return the models in their own order, so
+            //the visible ones are grouped by texture array again; otherwise the
+            //arrays would be bound almost once per model. The vector is kept
+            //across frames so that its memory is reused.
+            if(!IsGroupedByTexture(*visible_models, GetTextureArray)){
+                static std::vector<Model*> grouped_models;
+                GroupByTexture(*visible_models, GetTextureArray, &grouped_models);
+                visible_models = &grouped_models;
+            }
+            const std::vector<Model*>& models = *visible_models;
+            if(occlusion_query_culler != nullptr){
+                occlusion_query_culler->BeginFrame();
+            }
+            GLuint bound_texture_array_id = 0;
+            for(int i = 0; i < models.size(); i++){
+                //The models whose bounding box was hidden in the previous frame
+                //are skipped, or left to the GPU when the query is not read yet.
+                if(occlusion_query_culler != nullptr &&
+                   !occlusion_query_culler->BeginDraw(models[i])){
+                    continue;
+                }
+                //Models sharing a texture array are drawn one after the other, so
+                //the array is only bound when it changes.
+                const GLuint texture_array_id = models[i]->texture_region().texture_id;
+                if(texture_array_id != 0 && texture_array_id != bound_texture_array_id){
+                    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array_id);
+                    bound_texture_array_id = texture_array_id;
+                }
+                models[i]->Draw(shader_program);
+                if(occlusion_query_culler != nullptr){
+                    occlusion_query_culler->EndDraw();
+                }
+            }
+            if(bound_texture_array_id != 0){
+                glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            }
+            //Query the bounding boxes of the models against the finished depth
+            //buffer, for the next frame.
+            if(occlusion_query_culler != nullptr){
+                occlusion_query_culler->QueryBoundingBoxes(projection * view, models);
+            }
+        }
+        //Now, rotate the Models, the culled ones too, so that they are tested
+        //with their current pose in the next frame
         for(int i = 0; i < models_to_draw->size(); i++){
-            models_to_draw->at(i)->Draw(shader_program, projection, view);
-            //Now, rotate the Models
             //First, we get the current orientation
             Eigen::Vector3f current_orientation = models_to_draw->at(i)->orientation();
             //Now, change the current angle according to time
@@ -285,8 +813,176 @@ namespace {
         glBindVertexArray(0);
     }
     
-    void ConstructModels(std::vector<Model*>* models_to_draw) {
+    // Draws the models into the feedback framebuffer of the virtual textures.
+    // The models keep the pose of the previous frame.
+    void RenderVirtualTextureFeedback(const wvu::ShaderProgram& feedback_shader_program,
+                                      std::vector<Model*>* models_to_draw) {
         if(models_to_draw == nullptr){
+            std::cout << "Null pointer passed.  Could not render the feedback.";
+            return;
+        }
+        feedback_shader_program.Use();
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        for(int i = 0; i < models_to_draw->size(); i++){
+            models_to_draw->at(i)->Draw(feedback_shader_program);
+        }
+        glBindVertexArray(0);
+    }
+    
+    // Logs the model under the cursor, found by casting a ray from the camera
+    // through the BVH of the scene.
+    void PickModel(const Eigen::Matrix4f& projection,
+                   const Eigen::Matrix4f& view,
+                   const std::vector<Model*>& models_to_draw,
+                   wvu::SceneBvh* scene_bvh,
+                   GLFWwindow* window) {
+        if(scene_bvh == nullptr || window == nullptr){
+            std::cout << "Null pointer passed.  Could not pick a model.";
+            return;
+        }
+        double cursor_x;
+        double cursor_y;
+        int window_width;
+        int window_height;
+        glfwGetCursorPos(window, &cursor_x, &cursor_y);
+        glfwGetWindowSize(window, &window_width, &window_height);
+        if(window_width == 0 || window_height == 0){
+            return;
+        }
+        Eigen::Vector3f origin;
+        Eigen::Vector3f direction;
+        wvu::ComputePickingRay(projection * view,
+                               2.0f * cursor_x / window_width - 1.0f,
+                               1.0f - 2.0f * cursor_y / window_height,
+                               &origin, &direction);
+        float distance;
+        Model* model = scene_bvh->Raycast(origin, direction, &distance);
+        if(model == nullptr){
+            LOG(INFO) << "Picked no model.";
+            return;
+        }
+        const int model_index =
+            std::find(models_to_draw.begin(), models_to_draw.end(), model) - models_to_draw.begin();
+        LOG(INFO) << "Picked model " << model_index << " at distance " << distance << ".";
+    }
+    
+    // Fills the vertices (position and texel per column) and the EBO indices of
+    // a unit cube.
+    void GetCubeGeometry(Eigen::MatrixXf* vertices_cube,
+                         std::vector<GLuint>* indices_cube) {
+        if(vertices_cube == nullptr || indices_cube == nullptr){
+            std::cout << "Null pointer passed.  Could not build the cube.";
+            return;
+        }
+        vertices_cube->resize(5, 8);
+        
+        vertices_cube->block(0, 0, 3, 1) = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
+        vertices_cube->block(3, 0, 2, 1) = Eigen::Vector2f(0.0f, 0.0f);
+        
+        vertices_cube->block(0, 1, 3, 1) = Eigen::Vector3f(0.0f, 0.0f, 0.0f);
+        vertices_cube->block(3, 1, 2, 1) = Eigen::Vector2f(0.0f, 1.0f);
+        
+        vertices_cube->block(0, 2, 3, 1) = Eigen::Vector3f(1.0f, 1.0f, 0.0f);
+        vertices_cube->block(3, 2, 2, 1) = Eigen::Vector2f(1.0f, 0.0f);
+        
+        vertices_cube->block(0, 3, 3, 1) = Eigen::Vector3f(1.0f, 0.0f, 0.0f);
+        vertices_cube->block(3, 3, 2, 1) = Eigen::Vector2f(1.0f, 1.0f);
+        
+        vertices_cube->block(0, 4, 3, 1) = Eigen::Vector3f(1.0f, 1.0f, -1.0f);
+        vertices_cube->block(3, 4, 2, 1) = Eigen::Vector2f(0.0f, 0.0f);
+        
+        vertices_cube->block(0, 5, 3, 1) = Eigen::Vector3f(1.0f, 0.0f, -1.0f);
+        vertices_cube->block(3, 5, 2, 1) = Eigen::Vector2f(0.0f, 1.0f);
+        
+        vertices_cube->block(0, 6, 3, 1) = Eigen::Vector3f(0.0f, 1.0f, -1.0f);
+        vertices_cube->block(3, 6, 2, 1) = Eigen::Vector2f(1.0f, 0.0f);
+        
+        vertices_cube->block(0, 7, 3, 1) = Eigen::Vector3f(0.0f, 0.0f, -1.0f);
+        vertices_cube->block(3, 7, 2, 1) = Eigen::Vector2f(1.0f, 1.0f);
+        
+        
+        *indices_cube = {
+            0, 1, 3,  // First triangle.
+            0, 3, 2,  // Second triangle.
+            2, 3, 5,  // Third triangle.
+            2, 5, 4,  // Fourth triangle.
+            4, 5, 7,  // Fifth triangle.
+            4, 7, 6,  // Sixth triangle.
+            0, 1, 7,  // Seventh triangle.
+            0, 7, 6,  // Eigth triangle.
+            0, 4, 6,  // Ninth triangle.
+            0, 2, 4,  // Tenth triangle.
+            1, 5, 7,  // Eleventh triangle.
+            1, 3, 5   // Twelvth triangle.
+            
+        };
+    }
+    
+    // Side of the checkerboard used for the textures that could not be
+    // decoded when packing texture arrays.
+    constexpr int kPlaceholderTextureSize = 2;
+    
+    // Decodes the textures of the models, packs them into texture arrays and
+    // sets the texture region of each model. The models are sorted by texture
+    // array so that RenderScene() binds each array once per frame; it sorts
+    // them again after culling, which changes their order.
+    // Params:
+    //   texture_filepaths  The texture file of each model.
+    bool PackTexturesIntoArrays(const std::vector<std::string>& texture_filepaths,
+                                wvu::TextureLoader* texture_loader,
+                                wvu::TextureArrayManager* texture_arrays,
+                                std::vector<Model*>* models) {
+        if(texture_loader == nullptr || texture_arrays == nullptr || models == nullptr){
+            std::cout << "Null pointer passed.  Could not pack textures.";
+            return false;
+        }
+        std::vector<wvu::RgbaImage> images(texture_filepaths.size());
+        for(int i = 0; i < texture_filepaths.size(); i++){
+            if(!texture_filepaths[i].empty()){
+                texture_loader->LoadImage(texture_filepaths[i], &images[i]);
+            }
+        }
+        texture_loader->WaitForAll();
+        std::vector<int> region_indices(images.size());
+        for(int i = 0; i < images.size(); i++){
+            //Textures that could not be decoded get a checkerboard.
+            if(images[i].pixels.empty()){
+                images[i].width = kPlaceholderTextureSize;
+                images[i].height = kPlaceholderTextureSize;
+                images[i].pixels = {
+                    255, 255, 255, 255,  128, 128, 128, 255,
+                    128, 128, 128, 255,  255, 255, 255, 255
+                };
+            }
+            region_indices[i] = texture_arrays->Add(&images[i]);
+        }
+        if(!texture_arrays->Build()){
+            return false;
+        }
+        for(int i = 0; i < models->size(); i++){
+            models->at(i)->set_texture_region(texture_arrays->region(region_indices[i]));
+        }
+        std::stable_sort(models->begin(), models->end(), [](const Model* a, const Model* b) {
+            return a->texture_region().texture_id < b->texture_region().texture_id;
+        });
+        LOG(INFO) << "Packed " << images.size() << " textures into "
+                  << texture_arrays->texture_ids().size() << " texture arrays ("
+                  << texture_arrays->num_layers() << " layers).";
+        return true;
+    }
+    
+    // Constructs the models of the scene. Their geometry is registered in
+    // mesh_registry. When texture_arrays is not null, the textures are packed
+    // into texture arrays; when virtual_textures is not null, the textures are
+    // virtual textures; otherwise the models share the textures of the texture
+    // cache.
+    void ConstructModels(wvu::MeshRegistry* mesh_registry,
+                         wvu::TextureLoader* texture_loader,
+                         wvu::TextureCache* texture_cache,
+                         wvu::TextureArrayManager* texture_arrays,
+                         wvu::VirtualTextureManager* virtual_textures,
+                         std::vector<Model*>* models_to_draw) {
+        if(mesh_registry == nullptr || texture_loader == nullptr || texture_cache == nullptr || models_to_draw == nullptr){
             std::cout << "Null pointer passed.  Could not construct models.";
             return;
         }
@@ -395,84 +1091,57 @@ namespace {
         
         
         //Prepare and render the cube
-        Eigen::MatrixXf vertices_cube(5, 8);
-        
-        vertices_cube.block(0, 0, 3, 1) = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
-        vertices_cube.block(3, 0, 2, 1) = Eigen::Vector2f(0.0f, 0.0f);
-        
-        vertices_cube.block(0, 1, 3, 1) = Eigen::Vector3f(0.0f, 0.0f, 0.0f);
-        vertices_cube.block(3, 1, 2, 1) = Eigen::Vector2f(0.0f, 1.0f);
-        
-        vertices_cube.block(0, 2, 3, 1) = Eigen::Vector3f(1.0f, 1.0f, 0.0f);
-        vertices_cube.block(3, 2, 2, 1) = Eigen::Vector2f(1.0f, 0.0f);
+        Eigen::MatrixXf vertices_cube;
+        std::vector<GLuint> indices_cube;
+        GetCubeGeometry(&vertices_cube, &indices_cube);
         
-        vertices_cube.block(0, 3, 3, 1) = Eigen::Vector3f(1.0f, 0.0f, 0.0f);
-        vertices_cube.block(3, 3, 2, 1) = Eigen::Vector2f(1.0f, 1.0f);
-        
-        vertices_cube.block(0, 4, 3, 1) = Eigen::Vector3f(1.0f, 1.0f, -1.0f);
-        vertices_cube.block(3, 4, 2, 1) = Eigen::Vector2f(0.0f, 0.0f);
-        
-        vertices_cube.block(0, 5, 3, 1) = Eigen::Vector3f(1.0f, 0.0f, -1.0f);
-        vertices_cube.block(3, 5, 2, 1) = Eigen::Vector2f(0.0f, 1.0f);
-        
-        vertices_cube.block(0, 6, 3, 1) = Eigen::Vector3f(0.0f, 1.0f, -1.0f);
-        vertices_cube.block(3, 6, 2, 1) = Eigen::Vector2f(1.0f, 0.0f);
-        
-        vertices_cube.block(0, 7, 3, 1) = Eigen::Vector3f(0.0f, 0.0f, -1.0f);
-        vertices_cube.block(3, 7, 2, 1) = Eigen::Vector2f(1.0f, 1.0f);
-        
-        
-        std::vector<GLuint> indices_cube = {
-            0, 1, 3,  // First triangle.
-            0, 3, 2,  // Second triangle.
-            2, 3, 5,  // Third triangle.
-            2, 5, 4,  // Fourth triangle.
-            4, 5, 7,  // Fifth triangle.
-            4, 7, 6,  // Sixth triangle.
-            0, 1, 7,  // Seventh triangle.
-            0, 7, 6,  // Eigth triangle.
-            0, 4, 6,  // Ninth triangle.
-            0, 2, 4,  // Tenth triangle.
-            1, 5, 7,  // Eleventh triangle.
-            1, 3, 5   // Twelvth triangle.
-            
-        };
         
         
         
+        //The geometry is registered once and shared by the models drawing it.
+        wvu::Mesh* cube_mesh = mesh_registry->Register("cube", vertices_cube, indices_cube);
+        wvu::Mesh* pyramid_mesh = mesh_registry->Register("pyramid", vertices_pyramid, indices_pyramid);
+        wvu::Mesh* rectangle_mesh = mesh_registry->Register("rectangle", vertices_rectangle, indices_rectangle);
         
         Model* cube;
         cube = new Model(Eigen::Vector3f(1.0f, 1.0f, -1.0f),  // Orientation of object.
                          Eigen::Vector3f(1.0f, 1.0f, -7.5f),  // Position of object.
-                         vertices_cube,
-                         indices_cube);
-        
-        GLuint texture_id2 = LoadTexture(FLAGS_texture2_filepath);
-        cube->set_texture(texture_id2);
+                         cube_mesh);
         models_to_draw->push_back(cube);
         
         Model* pyramid;
         pyramid = new Model(Eigen::Vector3f(1.0f, 1.0f, -1.0f),  // Orientation of object.
                             Eigen::Vector3f(0.0f, -1.0f, -7.5f),  // Position of object.
-                            vertices_pyramid,
-                            indices_pyramid);
-        
-        GLuint texture_id3 = LoadTexture(FLAGS_texture3_filepath);
-        pyramid->set_texture(texture_id3);
+                            pyramid_mesh);
         models_to_draw->push_back(pyramid);
         
         Model* rectangle;
         rectangle = new Model(Eigen::Vector3f(1.0f, 1.0f, -1.0f), //Orientation of object.
                               Eigen::Vector3f(-2.0f, 1.0f, -7.5f), //Position of object.
-                              vertices_rectangle,
-                              indices_rectangle);
-        
-        GLuint texture_id = LoadTexture(FLAGS_texture1_filepath);
-        rectangle->set_texture(texture_id);
+                              rectangle_mesh);
         models_to_draw->push_back(rectangle);
         
+        //Textures of the cube, the pyramid and the rectangle.
+        const std::vector<std::string> texture_filepaths = {
+            FLAGS_texture2_filepath, FLAGS_texture3_filepath, FLAGS_texture1_filepath
+        };
+        if(texture_arrays != nullptr){
+            PackTexturesIntoArrays(texture_filepaths, texture_loader, texture_arrays, models_to_draw);
+            return;
+        }
+        if(virtual_textures != nullptr){
+            for(int i = 0; i < models_to_draw->size(); i++){
+                const GLuint page_table_id = virtual_textures->Add(texture_filepaths[i]);
+                if(page_table_id == 0){
+                    LOG(WARNING) << "Could not open the virtual texture "
+                                 << texture_filepaths[i] << ".";
+                }
+                models_to_draw->at(i)->set_texture(page_table_id);
+            }
+            return;
+        }
         for(int i = 0; i < models_to_draw->size(); i++){
-            models_to_draw->at(i)->SetVerticesIntoGpu();
+            models_to_draw->at(i)->set_texture(texture_cache->Acquire(texture_filepaths[i]));
         }
     }
     
@@ -494,6 +1163,843 @@ namespace {
         }
     }
     
+    // -------------------- Stress test helper functions ---------------------------
+    // Side of the cube used by the stress test. The cubes are small so that the
+    // cost is dominated by the draw submission and not by the pixel fill.
+    constexpr float kStressCubeScale = 0.05f;
+    
+    // Computes the positions of num_cubes cubes laid out on a 3D grid that fits
+    // in the view frustum.
+    std::vector<Eigen::Vector3f> ComputeStressGridPositions(const int num_cubes) {
+        std::vector<Eigen::Vector3f> positions;
+        positions.reserve(num_cubes);
+        const int cubes_per_side =
+            static_cast<int>(std::ceil(std::cbrt(static_cast<float>(num_cubes))));
+        const float spacing = 3.0f / cubes_per_side;
+        for(int i = 0; i < num_cubes; i++){
+            const int x = i % cubes_per_side;
+            const int y = (i / cubes_per_side) % cubes_per_side;
+            const int z = i / (cubes_per_side * cubes_per_side);
+            positions.emplace_back(-1.5f + x * spacing,
+                                   -1.5f + y * spacing,
+                                   -4.0f - z * spacing);
+        }
+        return positions;
+    }
+    
+    // Renders the cubes with the instanced path: fills the per-instance
+    // attributes and issues a single draw call.
+    void RenderInstancedScene(const wvu::ShaderProgram& shader_program,
+                              const Eigen::Matrix4f& projection,
+                              const Eigen::Matrix4f& view,
+                              const std::vector<Eigen::Vector3f>& positions,
+                              wvu::CameraUniformBuffer* camera_buffer,
+                              Model* model,
+                              std::vector<wvu::ModelInstance>* instances) {
+        if(camera_buffer == nullptr || model == nullptr || instances == nullptr){
+            std::cout << "Null pointer passed.  Could not render scene.";
+            return;
+        }
+        camera_buffer->Update(projection, view, static_cast<float>(glfwGetTime()));
+        ClearTheFrameBuffer();
+        shader_program.Use();
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        //Rotate the instances the same way RenderScene rotates the models.
+        const GLfloat rotation_speed = 50.0f;
+        const GLfloat current_angle = wvu::ConvertDegreesToRadians(rotation_speed * static_cast<GLfloat>(glfwGetTime()));
+        const Eigen::Matrix4f rotation = wvu::ComputeRotationMatrix(Eigen::Vector3f(1.0f, 1.0f, -1.0f).normalized(), current_angle);
+        instances->resize(positions.size());
+        for(int i = 0; i < positions.size(); i++){
+            const Eigen::Matrix4f model_matrix = wvu::ComputeTranslationMatrix(positions[i]) * rotation;
+            wvu::ModelInstance& instance = instances->at(i);
+            std::copy(model_matrix.data(), model_matrix.data() + 16, instance.model_matrix);
+            instance.tint[0] = 1.0f;
+            instance.tint[1] = 1.0f;
+            instance.tint[2] = 1.0f;
+            instance.tint[3] = 1.0f;
+            instance.texture_layer = 0.0f;
+            instance.texture_transform[0] = 1.0f;
+            instance.texture_transform[1] = 1.0f;
+            instance.texture_transform[2] = 0.0f;
+            instance.texture_transform[3] = 0.0f;
+        }
+        model->DrawInstanced(shader_program, instances->data(), instances->size());
+        glBindVertexArray(0);
+    }
+    
+    // Renders the cubes with the multi-draw indirect path: updates the model
+    // matrices of the objects of the batch and submits them with a single call.
+    void RenderMultiDrawScene(const wvu::ShaderProgram& shader_program,
+                              const Eigen::Matrix4f& projection,
+                              const Eigen::Matrix4f& view,
+                              const std::vector<Eigen::Vector3f>& positions,
+                              const GLuint texture_id,
+                              wvu::CameraUniformBuffer* camera_buffer,
+                              wvu::MultiDrawBatch* batch) {
+        if(camera_buffer == nullptr || batch == nullptr){
+            std::cout << "Null pointer passed.  Could not render scene.";
+            return;
+        }
+        camera_buffer->Update(projection, view, static_cast<float>(glfwGetTime()));
+        ClearTheFrameBuffer();
+        shader_program.Use();
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        //Rotate the objects the same way RenderScene rotates the models.
+        const GLfloat rotation_speed = 50.0f;
+        const GLfloat current_angle = wvu::ConvertDegreesToRadians(rotation_speed * static_cast<GLfloat>(glfwGetTime()));
+        const Eigen::Matrix4f rotation = wvu::ComputeRotationMatrix(Eigen::Vector3f(1.0f, 1.0f, -1.0f).normalized(), current_angle);
+        for(int i = 0; i < positions.size(); i++){
+            const Eigen::Matrix4f model_matrix = wvu::ComputeTranslationMatrix(positions[i]) * rotation;
+            std::copy(model_matrix.data(), model_matrix.data() + 16, batch->mutable_object(i)->model_matrix);
+        }
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        batch->Draw();
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+    }
+    
+    // Renders num_cubes cubes with the per-model loop, with instancing and, if
+    // the driver supports it, with multi-draw indirect, and logs the number of
+    // draw calls and the average frame time of each path.
+    void RunStressTest(const Eigen::Matrix4f& projection,
+                       const Eigen::Matrix4f& view,
+                       wvu::CameraUniformBuffer* camera_buffer,
+                       wvu::TextureLoader* texture_loader,
+                       GLFWwindow* window) {
+        if(camera_buffer == nullptr || texture_loader == nullptr || window == nullptr){
+            std::cout << "Null pointer passed.  Could not run stress test.";
+            return;
+        }
+        wvu::ShaderProgram shader_program;
+        wvu::ShaderProgram instanced_shader_program;
+        wvu::ShaderProgram multi_draw_shader_program;
+        const bool multi_draw_supported = wvu::MultiDrawBatch::IsSupported();
+        if (!BeginCreateShaderProgram(vertex_shader_src, fragment_shader_src,
+                                      &shader_program) ||
+            !BeginCreateShaderProgram(instanced_vertex_shader_src,
+                                      instanced_fragment_shader_src,
+                                      &instanced_shader_program) ||
+            (multi_draw_supported &&
+             !BeginCreateShaderProgram(multi_draw_vertex_shader_src,
+                                       instanced_fragment_shader_src,
+                                       &multi_draw_shader_program)) ||
+            !WaitForShaderProgram(&shader_program) ||
+            !WaitForShaderProgram(&instanced_shader_program)) {
+            return;
+        }
+        Eigen::MatrixXf vertices_cube;
+        std::vector<GLuint> indices_cube;
+        GetCubeGeometry(&vertices_cube, &indices_cube);
+        vertices_cube.topRows(3) *= kStressCubeScale;
+        //Every cube draws the same mesh.
+        wvu::MeshRegistry mesh_registry;
+        wvu::Mesh* cube_mesh = mesh_registry.Register("cube", vertices_cube, indices_cube);
+        //The multi-draw path suballocates the cube from the shared buffers.
+        wvu::GeometryAllocator geometry_allocator;
+        wvu::MultiDrawBatch batch;
+        int cube_allocation = -1;
+        const bool multi_draw = multi_draw_supported &&
+            WaitForShaderProgram(&multi_draw_shader_program) &&
+            geometry_allocator.Create(vertices_cube.cols(), indices_cube.size()) &&
+            batch.Create(&geometry_allocator);
+        if (multi_draw) {
+            cube_allocation = geometry_allocator.Allocate(vertices_cube, indices_cube);
+        } else {
+            LOG(INFO) << "Multi-draw indirect needs OpenGL 4.3; skipping it.";
+        }
+        const GLuint texture_id = FLAGS_texture2_filepath.empty() ?
+            0 : texture_loader->Load(FLAGS_texture2_filepath);
+        texture_loader->WaitForAll();
+        // Disable v-sync so that the frame time is not capped.
+        glfwSwapInterval(0);
+        const int kNumCubesPerTest[] = { 1000, 10000, 100000 };
+        for (const int num_cubes : kNumCubesPerTest) {
+            const std::vector<Eigen::Vector3f> positions =
+                ComputeStressGridPositions(num_cubes);
+            // Current path: one Model and one draw call per cube.
+            std::vector<Model*> models;
+            models.reserve(num_cubes);
+            for(int i = 0; i < num_cubes; i++){
+                Model* cube = new Model(Eigen::Vector3f(1.0f, 1.0f, -1.0f),
+                                        positions[i],
+                                        cube_mesh);
+                cube->set_texture(texture_id);
+                models.push_back(cube);
+            }
+            glFinish();
+            double start_time = glfwGetTime();
+            for(int frame = 0; frame < FLAGS_stress_test_frames; frame++){
+                RenderScene(shader_program, projection, view, camera_buffer,
+                            &models, nullptr, nullptr, nullptr, nullptr, nullptr, window);
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            glFinish();
+            const double loop_frame_time_ms =
+                1000.0 * (glfwGetTime() - start_time) / FLAGS_stress_test_frames;
+            DeleteModels(&models);
+            
+            // Instanced path: one Model and a single draw call.
+            Model cube(Eigen::Vector3f(1.0f, 1.0f, -1.0f),
+                       Eigen::Vector3f::Zero(),
+                       cube_mesh);
+            cube.set_texture(texture_id);
+            std::vector<wvu::ModelInstance> instances;
+            glFinish();
+            start_time = glfwGetTime();
+            for(int frame = 0; frame < FLAGS_stress_test_frames; frame++){
+                RenderInstancedScene(instanced_shader_program, projection, view,
+                                     positions, camera_buffer, &cube, &instances);
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            glFinish();
+            const double instanced_frame_time_ms =
+                1000.0 * (glfwGetTime() - start_time) / FLAGS_stress_test_frames;
+            
+            LOG(INFO) << "Stress test with " << num_cubes << " cubes: "
+                      << "per-model loop " << num_cubes << " draw calls, "
+                      << loop_frame_time_ms << " ms/frame; "
+                      << "instanced 1 draw call, "
+                      << instanced_frame_time_ms << " ms/frame.";
+            if (!multi_draw) continue;
+            
+            // Multi-draw indirect path: one command per cube, a single call.
+            batch.Clear();
+            wvu::DrawObject object = {};
+            object.tint[0] = 1.0f;
+            object.tint[1] = 1.0f;
+            object.tint[2] = 1.0f;
+            object.tint[3] = 1.0f;
+            object.texture_transform[0] = 1.0f;
+            object.texture_transform[1] = 1.0f;
+            for(int i = 0; i < num_cubes; i++){
+                batch.Add(cube_allocation, object);
+            }
+            glFinish();
+            start_time = glfwGetTime();
+            for(int frame = 0; frame < FLAGS_stress_test_frames; frame++){
+                RenderMultiDrawScene(multi_draw_shader_program, projection, view,
+                                     positions, texture_id, camera_buffer, &batch);
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            glFinish();
+            const double multi_draw_frame_time_ms =
+                1000.0 * (glfwGetTime() - start_time) / FLAGS_stress_test_frames;
+            LOG(INFO) << "Stress test with " << num_cubes << " cubes: "
+                      << "multi-draw indirect 1 call, "
+                      << multi_draw_frame_time_ms << " ms/frame.";
+        }
+        if (texture_id != 0) {
+            glDeleteTextures(1, &texture_id);
+        }
+    }
+    
+    // -------------------- Culling benchmark ------------------------------------
+    // Side of the cube used by the culling benchmarks.
+    constexpr float kCullingCubeScale = 0.01f;
+    // Half the side of the square covered by the cubes of the culling
+    // benchmarks. Most of the square is outside the view frustum.
+    constexpr float kCullingGridHalfSize = 20.0f;
+    
+    // Computes the positions of num_cubes cubes laid out on a square grid
+    // centered below the camera, on the plane y = -1.
+    std::vector<Eigen::Vector3f> ComputeCullingGridPositions(const int num_cubes) {
+        std::vector<Eigen::Vector3f> positions;
+        positions.reserve(num_cubes);
+        const int cubes_per_side =
+            static_cast<int>(std::ceil(std::sqrt(static_cast<float>(num_cubes))));
+        const float spacing = 2.0f * kCullingGridHalfSize / cubes_per_side;
+        for(int i = 0; i < num_cubes; i++){
+            positions.emplace_back(-kCullingGridHalfSize + (i % cubes_per_side) * spacing,
+                                   -1.0f,
+                                   -kCullingGridHalfSize + (i / cubes_per_side) * spacing);
+        }
+        return positions;
+    }
+    
+    // Renders the objects of the batch that pass the frustum test of the GPU
+    // culler.
+    void RenderCulledScene(const wvu::ShaderProgram& shader_program,
+                           const Eigen::Matrix4f& projection,
+                           const Eigen::Matrix4f& view,
+                           const GLuint texture_id,
+                           wvu::CameraUniformBuffer* camera_buffer,
+                           wvu::GpuFrustumCuller* culler,
+                           wvu::MultiDrawBatch* batch) {
+        if(camera_buffer == nullptr || culler == nullptr || batch == nullptr){
+            std::cout << "Null pointer passed.  Could not render scene.";
+            return;
+        }
+        camera_buffer->Update(projection, view, static_cast<float>(glfwGetTime()));
+        ClearTheFrameBuffer();
+        culler->Cull(projection * view, batch);
+        shader_program.Use();
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        culler->Draw(batch);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+    }
+    
+    // Renders the cubes of the culling grid with the per-model loop, which
+    // draws every model, with the loop drawing the models that pass the CPU
+    // frustum culler or the BVH of the scene, and with GPU frustum culling,
+    // and logs the average frame time of each path.
+    void RunCullingBenchmark(const Eigen::Matrix4f& projection,
+                             const Eigen::Matrix4f& view,
+                             wvu::CameraUniformBuffer* camera_buffer,
+                             wvu::TextureLoader* texture_loader,
+                             GLFWwindow* window) {
+        if(camera_buffer == nullptr || texture_loader == nullptr || window == nullptr){
+            std::cout << "Null pointer passed.  Could not run culling benchmark.";
+            return;
+        }
+        // The GPU culling path is skipped when the driver lacks compute shaders.
+        wvu::ShaderProgram shader_program;
+        wvu::ShaderProgram multi_draw_shader_program;
+        const bool gpu_culling_supported = wvu::GpuFrustumCuller::IsSupported();
+        if (!BeginCreateShaderProgram(vertex_shader_src, fragment_shader_src,
+                                      &shader_program) ||
+            (gpu_culling_supported &&
+             !BeginCreateShaderProgram(multi_draw_vertex_shader_src,
+                                       instanced_fragment_shader_src,
+                                       &multi_draw_shader_program)) ||
+            !WaitForShaderProgram(&shader_program)) {
+            return;
+        }
+        wvu::GpuFrustumCuller culler;
+        const bool gpu_culling = gpu_culling_supported &&
+            WaitForShaderProgram(&multi_draw_shader_program) &&
+            culler.Create(program_binary_cache);
+        Eigen::MatrixXf vertices_cube;
+        std::vector<GLuint> indices_cube;
+        GetCubeGeometry(&vertices_cube, &indices_cube);
+        vertices_cube.topRows(3) *= kCullingCubeScale;
+        const GLuint texture_id = FLAGS_texture2_filepath.empty() ?
+            0 : texture_loader->Load(FLAGS_texture2_filepath);
+        texture_loader->WaitForAll();
+        glfwSwapInterval(0);
+        const int num_cubes = std::max(1, FLAGS_culling_benchmark_objects);
+        const std::vector<Eigen::Vector3f> positions =
+            ComputeCullingGridPositions(num_cubes);
+        
+        // Current path: every model is drawn.
+        wvu::MeshRegistry mesh_registry;
+        wvu::Mesh* cube_mesh = mesh_registry.Register("cube", vertices_cube, indices_cube);
+        std::vector<Model*> models;
+        models.reserve(num_cubes);
+        for(int i = 0; i < num_cubes; i++){
+            Model* cube = new Model(Eigen::Vector3f(1.0f, 1.0f, -1.0f),
+                                    positions[i],
+                                    cube_mesh);
+            cube->set_texture(texture_id);
+            models.push_back(cube);
+        }
+        glFinish();
+        double start_time = glfwGetTime();
+        for(int frame = 0; frame < FLAGS_culling_benchmark_frames; frame++){
+            RenderScene(shader_program, projection, view, camera_buffer,
+                        &models, nullptr, nullptr, nullptr, nullptr, nullptr, window);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        glFinish();
+        const double loop_frame_time_ms =
+            1000.0 * (glfwGetTime() - start_time) / FLAGS_culling_benchmark_frames;
+        
+        // CPU culling path: the loop only draws the visible models.
+        wvu::FrustumCuller frustum_culler;
+        glFinish();
+        start_time = glfwGetTime();
+        for(int frame = 0; frame < FLAGS_culling_benchmark_frames; frame++){
+            RenderScene(shader_program, projection, view, camera_buffer,
+                        &models, nullptr, &frustum_culler, nullptr, nullptr, nullptr, window);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        glFinish();
+        const double cpu_culled_frame_time_ms =
+            1000.0 * (glfwGetTime() - start_time) / FLAGS_culling_benchmark_frames;
+        
+        // BVH culling path: the loop draws the models found by the BVH, which
+        // is refitted every frame since the loop rotates the models.
+        wvu::SceneBvh scene_bvh;
+        scene_bvh.Build(models);
+        glFinish();
+        start_time = glfwGetTime();
+        for(int frame = 0; frame < FLAGS_culling_benchmark_frames; frame++){
+            RenderScene(shader_program, projection, view, camera_buffer,
+                        &models, nullptr, nullptr, &scene_bvh, nullptr, nullptr, window);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        glFinish();
+        const double bvh_culled_frame_time_ms =
+            1000.0 * (glfwGetTime() - start_time) / FLAGS_culling_benchmark_frames;
+        scene_bvh.Clear();
+        DeleteModels(&models);
+        LOG(INFO) << "Culling benchmark with " << num_cubes << " cubes: "
+                  << "per-model loop " << loop_frame_time_ms << " ms/frame; "
+                  << "CPU culling " << cpu_culled_frame_time_ms << " ms/frame, "
+                  << frustum_culler.stats().num_visible << " cubes visible; "
+                  << "BVH culling " << bvh_culled_frame_time_ms << " ms/frame, "
+                  << scene_bvh.stats().culling.num_visible << " cubes visible.";
+        if (!gpu_culling) {
+            LOG(INFO) << "GPU culling needs OpenGL 4.3; skipping it.";
+            if (texture_id != 0) {
+                glDeleteTextures(1, &texture_id);
+            }
+            return;
+        }
+        
+        // GPU culling path: the objects are uploaded once, and the culling and
+        // the draws take the same calls whatever their number.
+        wvu::GeometryAllocator geometry_allocator;
+        wvu::MultiDrawBatch batch;
+        geometry_allocator.Create(vertices_cube.cols(), indices_cube.size());
+        batch.Create(&geometry_allocator);
+        const int cube_allocation = geometry_allocator.Allocate(vertices_cube, indices_cube);
+        wvu::DrawObject object = {};
+        object.tint[0] = 1.0f;
+        object.tint[1] = 1.0f;
+        object.tint[2] = 1.0f;
+        object.tint[3] = 1.0f;
+        object.texture_transform[0] = 1.0f;
+        object.texture_transform[1] = 1.0f;
+        for(int i = 0; i < num_cubes; i++){
+            const Eigen::Matrix4f model_matrix = wvu::ComputeTranslationMatrix(positions[i]);
+            std::copy(model_matrix.data(), model_matrix.data() + 16, object.model_matrix);
+            batch.Add(cube_allocation, object);
+        }
+        glFinish();
+        start_time = glfwGetTime();
+        for(int frame = 0; frame < FLAGS_culling_benchmark_frames; frame++){
+            RenderCulledScene(multi_draw_shader_program, projection, view,
+                              texture_id, camera_buffer, &culler, &batch);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        glFinish();
+        const double gpu_culled_frame_time_ms =
+            1000.0 * (glfwGetTime() - start_time) / FLAGS_culling_benchmark_frames;
+        
+        LOG(INFO) << "Culling benchmark with " << num_cubes << " cubes: "
+                  << "GPU culling " << gpu_culled_frame_time_ms << " ms/frame, "
+                  << culler.ReadNumVisible() << " cubes visible"
+                  << (culler.indirect_count() ? "." : " (fixed-count draws).");
+        if (texture_id != 0) {
+            glDeleteTextures(1, &texture_id);
+        }
+    }
+    
+    // -------------------- Potentially visible sets ----------------------------
+    // Bakes the potentially visible sets of the models into FLAGS_pvs_file.
+    // The grid of view cells covers the models and the camera, with a margin
+    // of one cell.
+    bool BakePotentiallyVisibleSets(const std::vector<Model*>& models,
+                                    const Eigen::Vector3f& camera_position) {
+        if(FLAGS_pvs_file.empty()){
+            LOG(ERROR) << "-bake_pvs needs -pvs_file.";
+            return false;
+        }
+        wvu::PvsBakeOptions options;
+        wvu::ComputeWorldBounds(models, &options.grid_min, &options.grid_max);
+        options.cell_size = static_cast<float>(FLAGS_pvs_cell_size);
+        options.num_rays_per_model = FLAGS_pvs_rays_per_model;
+        options.grid_min = options.grid_min.cwiseMin(camera_position) -
+            Eigen::Vector3f::Constant(options.cell_size);
+        options.grid_max = options.grid_max.cwiseMax(camera_position) +
+            Eigen::Vector3f::Constant(options.cell_size);
+        wvu::PotentiallyVisibleSet pvs;
+        if(!pvs.Bake(models, options)){
+            return false;
+        }
+        if(!pvs.Write(FLAGS_pvs_file)){
+            LOG(ERROR) << "Could not write the potentially visible sets into "
+                       << FLAGS_pvs_file << ".";
+            return false;
+        }
+        const wvu::PotentiallyVisibleSet::Stats& stats = pvs.stats();
+        LOG(INFO) << "Baked the potentially visible sets of " << models.size()
+                  << " models into " << FLAGS_pvs_file << " in "
+                  << stats.bake_time_ms << " ms: " << stats.num_cells << " cells, "
+                  << stats.num_sets << " distinct sets, "
+                  << stats.set_bytes / 1024.0 << " KB, "
+                  << 100.0 * stats.visible_fraction << "% of the models visible "
+                  << "per cell, " << stats.num_rays << " rays.";
+        return true;
+    }
+    
+    // -------------------- Occlusion culling benchmark --------------------------
+    // Renders the cubes of the culling grid behind a row of walls, through the
+    // BVH of the scene, without occlusion culling, with occlusion culling on
+    // the CPU and with occlusion queries, and logs the average frame time and
+    // the drawn and occluded cubes of each path.
+    void RunOcclusionCullingBenchmark(const Eigen::Matrix4f& projection,
+                                      const Eigen::Matrix4f& view,
+                                      wvu::CameraUniformBuffer* camera_buffer,
+                                      wvu::TextureLoader* texture_loader,
+                                      GLFWwindow* window) {
+        if(camera_buffer == nullptr || texture_loader == nullptr || window == nullptr){
+            std::cout << "Null pointer passed.  Could not run occlusion culling benchmark.";
+            return;
+        }
+        wvu::ShaderProgram shader_program;
+        if (!CreateShaderProgram(vertex_shader_src, fragment_shader_src,
+                                 &shader_program)) {
+            return;
+        }
+        Eigen::MatrixXf vertices_cube;
+        std::vector<GLuint> indices_cube;
+        GetCubeGeometry(&vertices_cube, &indices_cube);
+        // The walls are flattened cubes standing on the grid, 3 units ahead.
+        Eigen::MatrixXf vertices_wall = vertices_cube;
+        vertices_wall.row(0) *= 1.8f;
+        vertices_wall.row(1) *= 0.8f;
+        vertices_wall.row(2) *= 0.1f;
+        vertices_cube.topRows(3) *= kCullingCubeScale;
+        const GLuint texture_id = FLAGS_texture2_filepath.empty() ?
+            0 : texture_loader->Load(FLAGS_texture2_filepath);
+        texture_loader->WaitForAll();
+        glfwSwapInterval(0);
+        wvu::MeshRegistry mesh_registry;
+        wvu::Mesh* cube_mesh = mesh_registry.Register("cube", vertices_cube, indices_cube);
+        wvu::Mesh* wall_mesh = mesh_registry.Register("wall", vertices_wall, indices_cube);
+        const int num_cubes = std::max(1, FLAGS_culling_benchmark_objects);
+        const std::vector<Eigen::Vector3f> positions =
+            ComputeCullingGridPositions(num_cubes);
+        std::vector<Model*> models;
+        models.reserve(num_cubes + 5);
+        for(int i = 0; i < num_cubes; i++){
+            models.push_back(new Model(Eigen::Vector3f(1.0f, 1.0f, -1.0f),
+                                       positions[i],
+                                       cube_mesh));
+        }
+        for(int i = -2; i <= 2; i++){
+            models.push_back(new Model(Eigen::Vector3f(0.0f, 1.0f, 0.0f),
+                                       Eigen::Vector3f(2.0f * i, -0.6f, -3.0f),
+                                       wall_mesh));
+        }
+        for(int i = 0; i < models.size(); i++){
+            models[i]->set_texture(texture_id);
+        }
+        wvu::SceneBvh scene_bvh;
+        scene_bvh.Build(models);
+        
+        glFinish();
+        double start_time = glfwGetTime();
+        for(int frame = 0; frame < FLAGS_culling_benchmark_frames; frame++){
+            RenderScene(shader_program, projection, view, camera_buffer,
+                        &models, nullptr, nullptr, &scene_bvh, nullptr, nullptr, window);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        glFinish();
+        const double frustum_frame_time_ms =
+            1000.0 * (glfwGetTime() - start_time) / FLAGS_culling_benchmark_frames;
+        const int num_in_frustum = scene_bvh.stats().culling.num_visible;
+        
+        wvu::OcclusionCuller occlusion_culler(kOcclusionBufferWidth, kOcclusionBufferHeight,
+                                              FLAGS_occlusion_culling_threads);
+        glFinish();
+        start_time = glfwGetTime();
+        for(int frame = 0; frame < FLAGS_culling_benchmark_frames; frame++){
+            RenderScene(shader_program, projection, view, camera_buffer,
+                        &models, nullptr, nullptr, &scene_bvh, &occlusion_culler, nullptr,
+                        window);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        glFinish();
+        const double occlusion_frame_time_ms =
+            1000.0 * (glfwGetTime() - start_time) / FLAGS_culling_benchmark_frames;
+        
+        // Hardware occlusion queries, whose results lag one frame behind.
+        wvu::OcclusionQueryCuller occlusion_query_culler;
+        double query_frame_time_ms = 0.0;
+        if (occlusion_query_culler.Create(program_binary_cache)) {
+            glFinish();
+            start_time = glfwGetTime();
+            for(int frame = 0; frame < FLAGS_culling_benchmark_frames; frame++){
+                RenderScene(shader_program, projection, view, camera_buffer,
+                            &models, nullptr, nullptr, &scene_bvh, nullptr,
+                            &occlusion_query_culler, window);
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            glFinish();
+            query_frame_time_ms =
+                1000.0 * (glfwGetTime() - start_time) / FLAGS_culling_benchmark_frames;
+        }
+        
+        const wvu::OcclusionCuller::Stats& stats = occlusion_culler.stats();
+        LOG(INFO) << "Occlusion culling benchmark with " << num_cubes << " cubes: "
+                  << "frustum culling " << frustum_frame_time_ms << " ms/frame, "
+                  << num_in_frustum << " models drawn; occlusion culling "
+                  << occlusion_frame_time_ms << " ms/frame ("
+                  << stats.raster_time_ms << " ms rasterizing "
+                  << stats.num_occluders << " occluders, " << stats.test_time_ms
+                  << " ms testing), " << stats.num_tested - stats.num_occluded
+                  << " models drawn, " << stats.num_occluded << " occluded.";
+        if (occlusion_query_culler.stats().num_frames > 0) {
+            const wvu::OcclusionQueryCuller::Stats& query_stats =
+                occlusion_query_culler.stats();
+            LOG(INFO) << "Occlusion queries: " << query_frame_time_ms << " ms/frame, "
+                      << query_stats.num_skipped << " of " << query_stats.num_tested
+                      << " draws skipped in the last frame ("
+                      << query_stats.num_conditional << " left to the GPU, "
+                      << query_stats.num_unresolved << " unresolved).";
+        }
+        scene_bvh.Clear();
+        occlusion_query_culler.Clear();
+        DeleteModels(&models);
+        if (texture_id != 0) {
+            glDeleteTextures(1, &texture_id);
+        }
+    }
+    
+    // -------------------- BVH benchmark ----------------------------------------
+    // Logs, for the culling grid with 10k, 100k and 1M cubes, the time to build
+    // the BVH of the scene, to refit it after moving a tenth of the cubes and
+    // after rotating all of them, to cull it against the view frustum (next to
+    // the linear frustum culler), and to cast picking rays through it.
+    void RunBvhBenchmark(const Eigen::Matrix4f& projection,
+                         const Eigen::Matrix4f& view) {
+        Eigen::MatrixXf vertices_cube;
+        std::vector<GLuint> indices_cube;
+        GetCubeGeometry(&vertices_cube, &indices_cube);
+        vertices_cube.topRows(3) *= kCullingCubeScale;
+        wvu::MeshRegistry mesh_registry;
+        wvu::Mesh* cube_mesh = mesh_registry.Register("cube", vertices_cube, indices_cube);
+        const Eigen::Matrix4f view_projection = projection * view;
+        // The picking rays go through a 40x25 grid of points of the window.
+        const int kNumRaysPerRow = 40;
+        const int kNumRays = 1000;
+        std::vector<Eigen::Vector3f> ray_origins(kNumRays);
+        std::vector<Eigen::Vector3f> ray_directions(kNumRays);
+        for(int i = 0; i < kNumRays; i++){
+            const float x = (i % kNumRaysPerRow + 0.5f) / kNumRaysPerRow;
+            const float y = (i / kNumRaysPerRow + 0.5f) / (kNumRays / kNumRaysPerRow);
+            wvu::ComputePickingRay(view_projection, 2.0f * x - 1.0f, 2.0f * y - 1.0f,
+                                   &ray_origins[i], &ray_directions[i]);
+        }
+        const int kNumQueries = 10;
+        const int kNumCubes[] = { 10000, 100000, 1000000 };
+        for(const int num_cubes : kNumCubes){
+            const std::vector<Eigen::Vector3f> positions =
+                ComputeCullingGridPositions(num_cubes);
+            std::vector<Model*> models;
+            models.reserve(num_cubes);
+            for(int i = 0; i < num_cubes; i++){
+                models.push_back(new Model(Eigen::Vector3f(1.0f, 1.0f, -1.0f),
+                                           positions[i],
+                                           cube_mesh));
+            }
+            wvu::SceneBvh scene_bvh;
+            double start_time = glfwGetTime();
+            scene_bvh.Build(models);
+            const double build_time_ms = 1000.0 * (glfwGetTime() - start_time);
+            
+            // Lifts a tenth of the cubes, then rotates all of them.
+            for(int i = 0; i < num_cubes; i += 10){
+                models[i]->set_position(positions[i] + Eigen::Vector3f(0.0f, kCullingCubeScale, 0.0f));
+            }
+            start_time = glfwGetTime();
+            scene_bvh.Update();
+            const double partial_refit_time_ms = 1000.0 * (glfwGetTime() - start_time);
+            for(int i = 0; i < num_cubes; i++){
+                models[i]->set_orientation(Eigen::Vector3f(0.5f, 0.5f, -0.5f));
+            }
+            start_time = glfwGetTime();
+            scene_bvh.Update();
+            const double full_refit_time_ms = 1000.0 * (glfwGetTime() - start_time);
+            
+            wvu::FrustumCuller frustum_culler;
+            start_time = glfwGetTime();
+            for(int i = 0; i < kNumQueries; i++){
+                frustum_culler.Cull(view_projection, models);
+            }
+            const double linear_cull_time_ms =
+                1000.0 * (glfwGetTime() - start_time) / kNumQueries;
+            start_time = glfwGetTime();
+            for(int i = 0; i < kNumQueries; i++){
+                scene_bvh.Cull(view_projection);
+            }
+            const double bvh_cull_time_ms =
+                1000.0 * (glfwGetTime() - start_time) / kNumQueries;
+            
+            int num_hits = 0;
+            start_time = glfwGetTime();
+            for(int i = 0; i < kNumRays; i++){
+                if(scene_bvh.Raycast(ray_origins[i], ray_directions[i], nullptr) != nullptr){
+                    num_hits++;
+                }
+            }
+            const double ray_time_ms = 1000.0 * (glfwGetTime() - start_time);
+            
+            const wvu::SceneBvh::Stats& stats = scene_bvh.stats();
+            LOG(INFO) << "BVH benchmark with " << num_cubes << " cubes: build "
+                      << build_time_ms << " ms (" << stats.num_nodes
+                      << " nodes, SAH cost " << stats.build_sah_cost << "); refit "
+                      << partial_refit_time_ms << " ms after moving a tenth of the cubes, "
+                      << full_refit_time_ms << " ms after rotating all of them; culling "
+                      << bvh_cull_time_ms << " ms (" << stats.culling.num_visible
+                      << " cubes visible), " << linear_cull_time_ms
+                      << " ms with the linear culler; " << kNumRays << " picking rays "
+                      << ray_time_ms << " ms (" << num_hits << " hits).";
+            scene_bvh.Clear();
+            DeleteModels(&models);
+        }
+    }
+    
+    // -------------------- Texture loading benchmark ------------------------------
+    // Loads num_textures textures, cycling through the texture files, and
+    // returns the time in milliseconds until all of them are uploaded.
+    double MeasureTextureLoading(const std::vector<std::string>& filepaths,
+                                 const int num_textures,
+                                 const int num_threads) {
+        const double start_time = glfwGetTime();
+        wvu::TextureLoader texture_loader(num_threads);
+        std::vector<GLuint> texture_ids;
+        texture_ids.reserve(num_textures);
+        for(int i = 0; i < num_textures; i++){
+            texture_ids.push_back(texture_loader.Load(filepaths[i % filepaths.size()]));
+        }
+        texture_loader.WaitForAll();
+        glFinish();
+        const double elapsed_time_ms = 1000.0 * (glfwGetTime() - start_time);
+        glDeleteTextures(texture_ids.size(), texture_ids.data());
+        return elapsed_time_ms;
+    }
+    
+    // Logs the time it takes to load 3, 100 and 1000 textures with a single
+    // decoding thread and with the thread pool.
+    void RunTextureLoadBenchmark() {
+        std::vector<std::string> filepaths;
+        for (const std::string& filepath : { FLAGS_texture1_filepath,
+                                             FLAGS_texture2_filepath,
+                                             FLAGS_texture3_filepath }) {
+            if (!filepath.empty()) filepaths.push_back(filepath);
+        }
+        if (filepaths.empty()) {
+            std::cerr << "ERROR: The texture load benchmark needs at least one "
+                      << "texture file.\n";
+            return;
+        }
+        const int kNumTexturesPerTest[] = { 3, 100, 1000 };
+        for (const int num_textures : kNumTexturesPerTest) {
+            const double serial_time_ms =
+                MeasureTextureLoading(filepaths, num_textures, 1);
+            const double pool_time_ms =
+                MeasureTextureLoading(filepaths, num_textures,
+                                      FLAGS_texture_loader_threads);
+            LOG(INFO) << "Loading " << num_textures << " textures: "
+                      << serial_time_ms << " ms with 1 thread, "
+                      << pool_time_ms << " ms with the thread pool.";
+        }
+    }
+    
+    // -------------------- Texture compression benchmark --------------------------
+    // Uploads an image and its mipmaps into a new texture, compressed when
+    // compressed_image is not null. Returns the upload time in milliseconds and
+    // the video memory of the texture in vram_bytes.
+    double MeasureTextureUpload(const wvu::RgbaImage& image,
+                                const std::vector<wvu::RgbaImage>& mipmaps,
+                                const wvu::CompressedImage* compressed_image,
+                                size_t* vram_bytes) {
+        GLuint texture_id;
+        glGenTextures(1, &texture_id);
+        glFinish();
+        const double start_time = glfwGetTime();
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        if (compressed_image != nullptr) {
+            wvu::UploadCompressedImage(*compressed_image);
+        } else {
+            wvu::UploadMipmappedImage(image, mipmaps, true);
+        }
+        glFinish();
+        const double elapsed_time_ms = 1000.0 * (glfwGetTime() - start_time);
+        // Add up the size of every level as stored by the driver.
+        *vram_bytes = 0;
+        int level_width = image.width;
+        int level_height = image.height;
+        for (int level = 0; ; ++level) {
+            if (compressed_image != nullptr) {
+                GLint level_size = 0;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level,
+                                         GL_TEXTURE_COMPRESSED_IMAGE_SIZE,
+                                         &level_size);
+                *vram_bytes += level_size;
+            } else {
+                *vram_bytes += 4 * static_cast<size_t>(level_width) * level_height;
+            }
+            if (level_width == 1 && level_height == 1) break;
+            level_width = std::max(1, level_width / 2);
+            level_height = std::max(1, level_height / 2);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDeleteTextures(1, &texture_id);
+        return elapsed_time_ms;
+    }
+    
+    // Logs, for every texture file and every supported compression format, the
+    // encoding time, the upload time and the video memory of the texture
+    // against the uncompressed texture.
+    void RunTextureCompressionBenchmark(const wvu::MipmapFilter mipmap_filter) {
+        const wvu::TextureCompressionFormat kFormats[] = {
+            wvu::TextureCompressionFormat::kBc1,
+            wvu::TextureCompressionFormat::kBc3,
+            wvu::TextureCompressionFormat::kBc7
+        };
+        const char* kFormatNames[] = { "BC1", "BC3", "BC7" };
+        for (const std::string& filepath : { FLAGS_texture1_filepath,
+                                             FLAGS_texture2_filepath,
+                                             FLAGS_texture3_filepath }) {
+            if (filepath.empty()) continue;
+            wvu::RgbaImage image;
+            if (!wvu::DecodeImageFile(filepath, &image)) {
+                LOG(WARNING) << "Could not decode " << filepath << ".";
+                continue;
+            }
+            std::vector<wvu::RgbaImage> mipmaps;
+            wvu::GenerateMipmaps(image, mipmap_filter,
+                                 FLAGS_texture_loader_threads, &mipmaps);
+            size_t uncompressed_bytes = 0;
+            const double uncompressed_time_ms =
+                MeasureTextureUpload(image, mipmaps, nullptr,
+                                     &uncompressed_bytes);
+            LOG(INFO) << filepath << " (" << image.width << "x" << image.height
+                      << "): uncompressed " << uncompressed_bytes / 1024
+                      << " KB, upload " << uncompressed_time_ms << " ms.";
+            for (int i = 0; i < 3; i++) {
+                if (!wvu::IsTextureCompressionSupported(kFormats[i])) {
+                    LOG(INFO) << "  " << kFormatNames[i]
+                              << ": not supported by the driver.";
+                    continue;
+                }
+                const double start_time = glfwGetTime();
+                wvu::CompressedImage compressed_image;
+                wvu::CompressImage(image, mipmaps, kFormats[i],
+                                   FLAGS_texture_loader_threads,
+                                   &compressed_image);
+                const double encoding_time_ms =
+                    1000.0 * (glfwGetTime() - start_time);
+                size_t compressed_bytes = 0;
+                const double compressed_time_ms =
+                    MeasureTextureUpload(image, mipmaps, &compressed_image,
+                                         &compressed_bytes);
+                LOG(INFO) << "  " << kFormatNames[i] << ": "
+                          << compressed_bytes / 1024 << " KB ("
+                          << 100.0 * compressed_bytes / uncompressed_bytes
+                          << "% of the video memory), upload "
+                          << compressed_time_ms << " ms, encoding "
+                          << encoding_time_ms << " ms.";
+            }
+        }
+    }
+    
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -540,14 +2046,67 @@ int main(int argc, char** argv) {
     ConfigureViewPort(window);
     
     // Compile shaders and create shader program.
+    std::unique_ptr<wvu::ProgramBinaryCache> binary_cache;
+    if (!FLAGS_shader_cache_directory.empty()) {
+        binary_cache.reset(
+            new wvu::ProgramBinaryCache(FLAGS_shader_cache_directory));
+        program_binary_cache = binary_cache.get();
+        if (!binary_cache->IsSupported()) {
+            LOG(WARNING) << "The OpenGL driver does not support program "
+                         << "binaries. The shader cache is disabled.";
+        }
+    }
+    // The shader programs of the scene are built in the background. Meanwhile,
+    // the models are drawn with the fallback shader program.
     wvu::ShaderProgram shader_program;
-    if (!CreateShaderProgram(&shader_program)) {
+    wvu::ShaderProgram fallback_shader_program;
+    wvu::ShaderProgram feedback_shader_program;
+    wvu::ShaderProgram multi_draw_shader_program;
+    if (FLAGS_texture_array && FLAGS_virtual_texture) {
+        std::cerr << "ERROR: -texture_array and -virtual_texture can not be "
+                  << "used together.\n";
+        return -1;
+    }
+    if (FLAGS_texture_array) {
+        shader_program.AddDefine("TEXTURE_ARRAY", "");
+        fallback_shader_program.AddDefine("TEXTURE_ARRAY", "");
+        multi_draw_shader_program.AddDefine("TEXTURE_ARRAY", "");
+    }
+    if (FLAGS_virtual_texture) {
+        shader_program.AddDefine("VIRTUAL_TEXTURE", "");
+    }
+    // The multi-draw shader reads the pose and texture region of each model
+    // from a shader storage buffer, so the virtual textures are not supported.
+    bool multi_draw_scene = FLAGS_multi_draw_scene;
+    if (multi_draw_scene && FLAGS_virtual_texture) {
+        LOG(WARNING) << "The multi-draw of the scene does not support "
+                     << "virtual textures; drawing the models one by one.";
+        multi_draw_scene = false;
+    } else if (multi_draw_scene && !wvu::MultiDrawBatch::IsSupported()) {
+        LOG(WARNING) << "Multi-draw indirect needs OpenGL 4.3; drawing the "
+                     << "models one by one.";
+        multi_draw_scene = false;
+    }
+    // Every program is submitted before any is waited for, so that drivers
+    // supporting GL_KHR_parallel_shader_compile build them in parallel.
+    if (!BeginCreateShaderProgram(vertex_shader_src, fragment_shader_src,
+                                  &shader_program) ||
+        (FLAGS_virtual_texture &&
+         !BeginCreateShaderProgram(vertex_shader_src, feedback_fragment_shader_src,
+                                   &feedback_shader_program)) ||
+        (multi_draw_scene &&
+         !BeginCreateShaderProgram(multi_draw_vertex_shader_src,
+                                   instanced_fragment_shader_src,
+                                   &multi_draw_shader_program))) {
+        return -1;
+    }
+    // The fallback program is the only one built synchronously: the first
+    // frames are drawn with it while the others build, so it must be ready
+    // before the loop. It only paints a flat color, so it builds quickly.
+    if (!CreateShaderProgram(vertex_shader_src, fallback_fragment_shader_src,
+                             &fallback_shader_program)) {
         return -1;
     }
-    
-    // Construct the models to draw in the scene.
-    std::vector<Model*> models_to_draw;
-    ConstructModels(&models_to_draw);
     
     // Construct the camera projection matrix.
     const float field_of_view = wvu::ConvertDegreesToRadians(45.0f);
@@ -559,20 +2118,380 @@ int main(int argc, char** argv) {
                                             near_plane, far_plane);
     const Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
     
+    // Create the uniform buffer holding the per-frame camera data.
+    wvu::CameraUniformBuffer camera_buffer;
+    if (!camera_buffer.Create()) {
+        std::cerr << "ERROR: Could not create the camera uniform buffer.\n";
+        return -1;
+    }
+    
+    // Textures are decoded by a pool of threads.
+    wvu::TextureLoader texture_loader(FLAGS_texture_loader_threads);
+    wvu::TextureCompressionFormat compression_format;
+    if (!wvu::ParseTextureCompressionFormat(FLAGS_texture_compression,
+                                            &compression_format)) {
+        std::cerr << "ERROR: Unknown texture compression "
+                  << FLAGS_texture_compression << ".\n";
+        return -1;
+    }
+    wvu::MipmapFilter mipmap_filter;
+    if (!wvu::ParseMipmapFilter(FLAGS_mipmap_filter, &mipmap_filter)) {
+        std::cerr << "ERROR: Unknown mipmap filter " << FLAGS_mipmap_filter
+                  << ".\n";
+        return -1;
+    }
+    texture_loader.set_mipmap_filter(mipmap_filter);
+    texture_loader.set_upload_budget(
+        static_cast<size_t>(std::max(0, FLAGS_texture_upload_budget_kb)) * 1024);
+    texture_loader.set_preview_scale_denominator(FLAGS_texture_preview_scale);
+    if (!texture_loader.set_compression_format(compression_format)) {
+        LOG(WARNING) << "The OpenGL driver does not support "
+                     << FLAGS_texture_compression
+                     << " textures. The textures are not compressed.";
+    }
+    
+    if (FLAGS_bvh_benchmark) {
+        RunBvhBenchmark(projection, view);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 0;
+    }
+    
+    if (FLAGS_occlusion_culling_benchmark) {
+        RunOcclusionCullingBenchmark(projection, view, &camera_buffer, &texture_loader, window);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 0;
+    }
+    
+    if (FLAGS_culling_benchmark) {
+        LogProgramBinaryCacheStats();
+        RunCullingBenchmark(projection, view, &camera_buffer, &texture_loader, window);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 0;
+    }
+    
+    if (FLAGS_texture_compression_benchmark) {
+        RunTextureCompressionBenchmark(mipmap_filter);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 0;
+    }
+    
+    if (FLAGS_texture_load_benchmark) {
+        RunTextureLoadBenchmark();
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 0;
+    }
+    
+    if (FLAGS_stress_test) {
+        LogProgramBinaryCacheStats();
+        RunStressTest(projection, view, &camera_buffer, &texture_loader, window);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 0;
+    }
+    
+    // Construct the models to draw in the scene.
+    const double construction_start_time = glfwGetTime();
+    std::vector<Model*> models_to_draw;
+    wvu::ResidencyManager residency_manager;
+    wvu::MeshRegistry mesh_registry;
+    residency_manager.set_budget(
+        wvu::ResourceType::kTexture,
+        static_cast<size_t>(std::max(0, FLAGS_texture_budget_mb)) << 20);
+    residency_manager.set_budget(
+        wvu::ResourceType::kMesh,
+        static_cast<size_t>(std::max(0, FLAGS_mesh_budget_mb)) << 20);
+    wvu::TextureCache texture_cache(&texture_loader);
+    wvu::FrustumCuller frustum_culler;
+    wvu::SceneBvh scene_bvh;
+    wvu::OcclusionCuller occlusion_culler(kOcclusionBufferWidth, kOcclusionBufferHeight,
+                                          FLAGS_occlusion_culling_threads);
+    wvu::OcclusionQueryCuller occlusion_query_culler;
+    const bool occlusion_queries =
+        FLAGS_occlusion_queries && occlusion_query_culler.Create(program_binary_cache);
+    if (occlusion_queries &&
+        occlusion_query_culler.query_target() != GL_ANY_SAMPLES_PASSED_CONSERVATIVE) {
+        LOG(INFO) << "Conservative occlusion queries are not supported; "
+                  << "using exact ones.";
+    }
+    texture_cache.set_residency_manager(&residency_manager);
+    wvu::TextureArrayManager texture_arrays;
+    texture_arrays.set_mipmap_filter(mipmap_filter);
+    // Virtual textures stream their pages into a cache of fixed size.
+    wvu::VirtualTextureManager virtual_textures;
+    if (FLAGS_virtual_texture) {
+        int framebuffer_width;
+        int framebuffer_height;
+        glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+        if (!virtual_textures.Create(FLAGS_virtual_texture_cache_pages,
+                                     framebuffer_width, framebuffer_height,
+                                     FLAGS_virtual_texture_feedback_scale)) {
+            std::cerr << "ERROR: Could not create the cache of the virtual "
+                      << "textures.\n";
+            return -1;
+        }
+    }
+    mesh_registry.set_residency_manager(&residency_manager);
+    ConstructModels(&mesh_registry, &texture_loader, &texture_cache,
+                    FLAGS_texture_array ? &texture_arrays : nullptr,
+                    FLAGS_virtual_texture ? &virtual_textures : nullptr,
+                    &models_to_draw);
+    
+    // The potentially visible sets are baked before the BVH of the scene is
+    // built, since the baker builds its own.
+    const Eigen::Vector3f camera_position =
+        -view.topLeftCorner<3, 3>().transpose() * view.topRightCorner<3, 1>();
+    if (FLAGS_bake_pvs) {
+        const bool baked = BakePotentiallyVisibleSets(models_to_draw, camera_position);
+        DeleteModels(&models_to_draw);
+        mesh_registry.Clear();
+        texture_cache.set_residency_manager(nullptr);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return baked ? 0 : 1;
+    }
+    wvu::PotentiallyVisibleSet pvs;
+    const bool pvs_loaded =
+        !FLAGS_pvs_file.empty() && pvs.Read(FLAGS_pvs_file, models_to_draw);
+    if (!FLAGS_pvs_file.empty() && !pvs_loaded) {
+        LOG(ERROR) << "Could not read the potentially visible sets of the scene "
+                   << "from " << FLAGS_pvs_file << ".";
+    }
+    if (FLAGS_scene_bvh) {
+        scene_bvh.Build(models_to_draw);
+    }
+    
+    // The scene is drawn from the shared buffers of a geometry allocator with
+    // multi-draw indirect when requested and supported, once the multi-draw
+    // program is built. Until then, the models are drawn one by one.
+    SceneMultiDraw multi_draw;
+    if (multi_draw_scene) {
+        multi_draw_scene =
+            multi_draw.geometry_allocator.Create(1 << 16, 1 << 18) &&
+            multi_draw.batch.Create(&multi_draw.geometry_allocator);
+    }
+    if (multi_draw_scene && occlusion_queries) {
+        LOG(WARNING) << "The occlusion queries need a draw call per model; "
+                     << "they are not used with the multi-draw of the scene.";
+    }
+    
     // Loop until the user closes the window.
+    bool shader_program_ready = false;
+    bool feedback_shader_program_ready = false;
+    bool multi_draw_shader_program_ready = false;
+    bool first_frame = true;
+    int previous_mouse_button_state = GLFW_RELEASE;
     while (!glfwWindowShouldClose(window)) {
+        // Check whether the shader programs of the scene finished building.
+        // This does not block the frame loop.
+        if (!shader_program_ready) {
+            if (!PollShaderProgram(&shader_program, &shader_program_ready)) break;
+            if (shader_program_ready) {
+                LogProgramBinaryCacheStats();
+                if (FLAGS_virtual_texture) {
+                    virtual_textures.SetUniforms(shader_program, false);
+                }
+            }
+        }
+        if (FLAGS_virtual_texture && !feedback_shader_program_ready) {
+            if (!PollShaderProgram(&feedback_shader_program,
+                                   &feedback_shader_program_ready)) {
+                break;
+            }
+            if (feedback_shader_program_ready) {
+                virtual_textures.SetUniforms(feedback_shader_program, true);
+            }
+        }
+        if (multi_draw_scene && !multi_draw_shader_program_ready) {
+            if (!PollShaderProgram(&multi_draw_shader_program,
+                                   &multi_draw_shader_program_ready)) {
+                break;
+            }
+            if (multi_draw_shader_program_ready) {
+                scene_multi_draw = &multi_draw;
+            }
+        }
+        
+        // Upload the textures decoded since the previous frame.
+        texture_loader.Update();
+        texture_cache.Update();
+        
+        // Upload the pages of the virtual textures read since the previous
+        // frame, and find the pages needed by this one.
+        if (FLAGS_virtual_texture) {
+            virtual_textures.Update();
+            if (shader_program_ready && feedback_shader_program_ready &&
+                virtual_textures.BeginFeedback()) {
+                RenderVirtualTextureFeedback(feedback_shader_program, &models_to_draw);
+                virtual_textures.EndFeedback();
+            }
+            virtual_textures.BindPhysicalPages();
+        }
+        
+        // Pick the model under the cursor on a left click.
+        const int mouse_button_state = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
+        if (FLAGS_scene_bvh && mouse_button_state == GLFW_PRESS &&
+            previous_mouse_button_state == GLFW_RELEASE) {
+            PickModel(projection, view, models_to_draw, &scene_bvh, window);
+        }
+        previous_mouse_button_state = mouse_button_state;
+        
         // Render the scene!
-        RenderScene(shader_program, projection, view, &models_to_draw, window);
+        RenderScene(scene_multi_draw != nullptr ? multi_draw_shader_program :
+                        shader_program_ready ? shader_program : fallback_shader_program,
+                    projection, view, &camera_buffer, &models_to_draw,
+                    pvs_loaded ? &pvs : nullptr,
+                    FLAGS_frustum_culling && (!FLAGS_scene_bvh || pvs_loaded) ?
+                        &frustum_culler : nullptr,
+                    FLAGS_frustum_culling && FLAGS_scene_bvh ? &scene_bvh : nullptr,
+                    FLAGS_occlusion_culling ? &occlusion_culler : nullptr,
+                    occlusion_queries && scene_multi_draw == nullptr ?
+                        &occlusion_query_culler : nullptr,
+                    window);
+        const wvu::FrustumCuller::Stats& culling_stats =
+            FLAGS_scene_bvh && !pvs.stats().camera_in_grid ?
+                scene_bvh.stats().culling : frustum_culler.stats();
+        if (pvs.stats().camera_in_grid) {
+            VLOG(1) << "Potentially visible set: " << pvs.stats().num_visible
+                    << " of " << models_to_draw.size() << " models.";
+        }
+        if (FLAGS_frustum_culling) {
+            VLOG(1) << "Frustum culling: "
+                    << culling_stats.num_visible << " visible, "
+                    << culling_stats.num_culled << " culled.";
+        }
+        if (FLAGS_occlusion_culling) {
+            const wvu::OcclusionCuller::Stats& occlusion_stats = occlusion_culler.stats();
+            VLOG(1) << "Occlusion culling: "
+                    << occlusion_stats.num_tested - occlusion_stats.num_occluded
+                    << " drawn, " << occlusion_stats.num_occluded << " occluded by "
+                    << occlusion_stats.num_occluders << " occluders.";
+        }
+        if (occlusion_queries) {
+            const wvu::OcclusionQueryCuller::Stats& query_stats = occlusion_query_culler.stats();
+            VLOG(1) << "Occlusion queries: " << query_stats.num_skipped << " of "
+                    << query_stats.num_tested << " draws skipped, "
+                    << query_stats.num_conditional << " left to the GPU.";
+        }
+        
+        // Evict the least recently drawn resources over the budgets.
+        residency_manager.EndFrame();
         
         // Swap front and back buffers.
         glfwSwapBuffers(window);
+        if (first_frame) {
+            LOG(INFO) << "First frame shown "
+                      << 1000.0 * (glfwGetTime() - construction_start_time)
+                      << " ms after constructing the models.";
+            first_frame = false;
+        }
         
         // Poll for and process events.
         glfwPollEvents();
     }
     
-    // Cleaning up tasks.
+    LOG(INFO) << "Uniform uploads: " << shader_program.num_uniform_uploads()
+              << ", skipped because the value did not change: "
+              << shader_program.num_skipped_uniform_uploads() << ".";
+    const wvu::TextureLoader::Stats& texture_stats = texture_loader.stats();
+    LOG(INFO) << "Textures: " << texture_stats.num_loaded << " loaded, "
+              << texture_stats.uploaded_bytes / 1024 << " KB of video memory ("
+              << texture_stats.uncompressed_bytes / 1024
+              << " KB uncompressed), " << texture_stats.upload_time_ms
+              << " ms uploading, " << texture_stats.num_streamed_levels
+              << " levels streamed.";
+    const wvu::TextureCache::Stats texture_cache_stats = texture_cache.stats();
+    LOG(INFO) << "Texture cache: " << texture_cache_stats.hits << " hits, "
+              << texture_cache_stats.misses << " misses, "
+              << texture_cache_stats.num_textures << " textures, "
+              << texture_cache_stats.resident_bytes / 1024 << " KB resident.";
+    const wvu::ResidencyManager::Stats residency_stats = residency_manager.stats();
+    const char* kResourceTypeNames[] = { "Textures", "Meshes" };
+    for (int i = 0; i < wvu::kNumResourceTypes; ++i) {
+        LOG(INFO) << kResourceTypeNames[i] << " residency: "
+                  << residency_stats.used_bytes[i] / 1024 << " KB of "
+                  << residency_stats.budget_bytes[i] / 1024 << " KB budget, "
+                  << residency_stats.num_evictions[i] << " evictions, "
+                  << residency_stats.num_restores[i] << " restores.";
+    }
+    
+    const wvu::FrustumCuller::Stats& culling_stats =
+        FLAGS_scene_bvh ? scene_bvh.stats().culling : frustum_culler.stats();
+    if (FLAGS_frustum_culling && culling_stats.num_frames > 0) {
+        LOG(INFO) << "Frustum culling: "
+                  << static_cast<double>(culling_stats.total_visible) / culling_stats.num_frames
+                  << " models visible and "
+                  << static_cast<double>(culling_stats.total_culled) / culling_stats.num_frames
+                  << " culled per frame.";
+    }
+    if (FLAGS_occlusion_culling && occlusion_culler.stats().num_frames > 0) {
+        const wvu::OcclusionCuller::Stats& occlusion_stats = occlusion_culler.stats();
+        LOG(INFO) << "Occlusion culling: "
+                  << static_cast<double>(occlusion_stats.total_tested - occlusion_stats.total_occluded) /
+                     occlusion_stats.num_frames
+                  << " models drawn and "
+                  << static_cast<double>(occlusion_stats.total_occluded) / occlusion_stats.num_frames
+                  << " occluded per frame.";
+    }
+    if (pvs_loaded) {
+        LOG(INFO) << "Potentially visible sets: " << pvs.stats().num_decodes
+                  << " sets decoded in " << pvs.stats().num_lookups << " frames.";
+    }
+    if (occlusion_queries && occlusion_query_culler.stats().num_frames > 0) {
+        const wvu::OcclusionQueryCuller::Stats& query_stats = occlusion_query_culler.stats();
+        LOG(INFO) << "Occlusion queries: "
+                  << static_cast<double>(query_stats.total_skipped) / query_stats.num_frames
+                  << " of "
+                  << static_cast<double>(query_stats.total_tested) / query_stats.num_frames
+                  << " draws skipped per frame.";
+    }
+    if (FLAGS_scene_bvh) {
+        const wvu::SceneBvh::Stats& bvh_stats = scene_bvh.stats();
+        LOG(INFO) << "Scene BVH: " << bvh_stats.num_nodes << " nodes, "
+                  << bvh_stats.num_refits << " refits, "
+                  << bvh_stats.num_rebuilds << " rebuilds, SAH cost "
+                  << bvh_stats.sah_cost << " (" << bvh_stats.build_sah_cost
+                  << " after the last build).";
+    }
+    LOG(INFO) << "Meshes: " << mesh_registry.num_meshes() << " meshes, "
+              << mesh_registry.geometry_bytes() / 1024.0
+              << " KB of geometry for " << models_to_draw.size() << " models.";
+    if (multi_draw_scene) {
+        const wvu::GeometryAllocator::Stats geometry_stats =
+            multi_draw.geometry_allocator.stats();
+        LOG(INFO) << "Multi-draw: " << geometry_stats.num_allocations
+                  << " meshes in the shared buffers, "
+                  << geometry_stats.used_vertices << " vertices and "
+                  << geometry_stats.used_indices << " indices.";
+    }
+    if (FLAGS_virtual_texture) {
+        const wvu::VirtualTextureManager::Stats virtual_texture_stats =
+            virtual_textures.stats();
+        LOG(INFO) << "Virtual textures: " << virtual_texture_stats.num_textures
+                  << " textures, " << virtual_texture_stats.num_resident_pages
+                  << " of " << virtual_texture_stats.num_cache_pages
+                  << " cache pages used ("
+                  << virtual_texture_stats.cache_bytes / 1024 << " KB), "
+                  << virtual_texture_stats.num_feedback_readbacks
+                  << " feedback readbacks, "
+                  << virtual_texture_stats.num_requested_pages
+                  << " pages requested, "
+                  << virtual_texture_stats.num_uploaded_pages << " uploaded, "
+                  << virtual_texture_stats.num_evicted_pages << " evicted.";
+    }
+    
+    // Cleaning up tasks. The models release their textures before the
+    // residency manager goes away.
+    scene_bvh.Clear();
+    occlusion_query_culler.Clear();
+    scene_multi_draw = nullptr;
     DeleteModels(&models_to_draw);
+    mesh_registry.Clear();
+    texture_cache.set_residency_manager(nullptr);
     // Destroy window.
     glfwDestroyWindow(window);
     // Tear down GLFW library.
@@ -0,0 +1,305 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "frustum_culler.h"
+
+#include <cmath>
+#include <vector>
+#include <Eigen/Core>
+
+#include "camera_utils.h"
+#include "cpu_features.h"
+#include "mesh.h"
+#include "model.h"
+
+namespace wvu {
+namespace {
+
+// Boxes to test, in structure-of-arrays layout.
+struct BoxBatch {
+  // Rows 0-2 of the model matrices, entry by entry: matrix[4 * row + col].
+  const float* matrix[12];
+  // Centers and half extents of the boxes in model space.
+  const float* center[3];
+  const float* extent[3];
+};
+
+// Tests the boxes [begin, end). The center of a box is moved to world space
+// with the model matrix, and its half extents with the absolute value of the
+// rotation and scale, which gives the world-space box enclosing it. The box is
+// outside a plane when the center is farther behind the plane than the
+// projection of the half extents onto the normal of the plane.
+void CullBoxesScalar(const BoxBatch& boxes,
+                     const float planes[6][4],
+                     const int begin,
+                     const int end,
+                     unsigned char* visible) {
+  for (int i = begin; i < end; ++i) {
+    float world_center[3];
+    float world_extent[3];
+    for (int row = 0; row < 3; ++row) {
+      const float* const* m = boxes.matrix + 4 * row;
+      world_center[row] = m[0][i] * boxes.center[0][i] +
+          m[1][i] * boxes.center[1][i] + m[2][i] * boxes.center[2][i] +
+          m[3][i];
+      world_extent[row] = std::fabs(m[0][i]) * boxes.extent[0][i] +
+          std::fabs(m[1][i]) * boxes.extent[1][i] +
+          std::fabs(m[2][i]) * boxes.extent[2][i];
+    }
+    bool inside = true;
+    for (int p = 0; p < 6; ++p) {
+      const float distance = planes[p][0] * world_center[0] +
+          planes[p][1] * world_center[1] + planes[p][2] * world_center[2] +
+          planes[p][3];
+      const float radius = std::fabs(planes[p][0]) * world_extent[0] +
+          std::fabs(planes[p][1]) * world_extent[1] +
+          std::fabs(planes[p][2]) * world_extent[2];
+      inside = inside && distance + radius >= 0.0f;
+    }
+    visible[i] = inside ? 1 : 0;
+  }
+}
+
+#ifdef WVU_X86
+// Tests 4 boxes per iteration, one per lane. Returns the number of boxes
+// tested; the remaining ones are left to the scalar code.
+__attribute__((target("sse2")))
+int CullBoxesSse(const BoxBatch& boxes,
+                 const float planes[6][4],
+                 const int num_boxes,
+                 unsigned char* visible) {
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  const __m128 zero = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= num_boxes; i += 4) {
+    __m128 center[3];
+    __m128 extent[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      center[axis] = _mm_loadu_ps(boxes.center[axis] + i);
+      extent[axis] = _mm_loadu_ps(boxes.extent[axis] + i);
+    }
+    __m128 world_center[3];
+    __m128 world_extent[3];
+    for (int row = 0; row < 3; ++row) {
+      const float* const* m = boxes.matrix + 4 * row;
+      const __m128 m0 = _mm_loadu_ps(m[0] + i);
+      const __m128 m1 = _mm_loadu_ps(m[1] + i);
+      const __m128 m2 = _mm_loadu_ps(m[2] + i);
+      world_center[row] = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(m0, center[0]), _mm_mul_ps(m1, center[1])),
+          _mm_add_ps(_mm_mul_ps(m2, center[2]), _mm_loadu_ps(m[3] + i)));
+      world_extent[row] = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, m0), extent[0]),
+                     _mm_mul_ps(_mm_andnot_ps(sign_mask, m1), extent[1])),
+          _mm_mul_ps(_mm_andnot_ps(sign_mask, m2), extent[2]));
+    }
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; ++p) {
+      const __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][0]), world_center[0]),
+                     _mm_mul_ps(_mm_set1_ps(planes[p][1]), world_center[1])),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][2]), world_center[2]),
+                     _mm_set1_ps(planes[p][3])));
+      const __m128 radius = _mm_add_ps(
+          _mm_add_ps(
+              _mm_mul_ps(_mm_set1_ps(std::fabs(planes[p][0])),
+                         world_extent[0]),
+              _mm_mul_ps(_mm_set1_ps(std::fabs(planes[p][1])),
+                         world_extent[1])),
+          _mm_mul_ps(_mm_set1_ps(std::fabs(planes[p][2])), world_extent[2]));
+      inside = _mm_and_ps(inside,
+                          _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+    }
+    const int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; lane < 4; ++lane) {
+      visible[i + lane] = (mask >> lane) & 1;
+    }
+  }
+  return i;
+}
+
+// Same as CullBoxesSse() with 8 boxes per iteration.
+__attribute__((target("avx")))
+int CullBoxesAvx(const BoxBatch& boxes,
+                 const float planes[6][4],
+                 const int num_boxes,
+                 unsigned char* visible) {
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= num_boxes; i += 8) {
+    __m256 center[3];
+    __m256 extent[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      center[axis] = _mm256_loadu_ps(boxes.center[axis] + i);
+      extent[axis] = _mm256_loadu_ps(boxes.extent[axis] + i);
+    }
+    __m256 world_center[3];
+    __m256 world_extent[3];
+    for (int row = 0; row < 3; ++row) {
+      const float* const* m = boxes.matrix + 4 * row;
+      const __m256 m0 = _mm256_loadu_ps(m[0] + i);
+      const __m256 m1 = _mm256_loadu_ps(m[1] + i);
+      const __m256 m2 = _mm256_loadu_ps(m[2] + i);
+      world_center[row] = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(m0, center[0]),
+                        _mm256_mul_ps(m1, center[1])),
+          _mm256_add_ps(_mm256_mul_ps(m2, center[2]),
+                        _mm256_loadu_ps(m[3] + i)));
+      world_extent[row] = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_andnot_ps(sign_mask, m0), extent[0]),
+              _mm256_mul_ps(_mm256_andnot_ps(sign_mask, m1), extent[1])),
+          _mm256_mul_ps(_mm256_andnot_ps(sign_mask, m2), extent[2]));
+    }
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+    for (int p = 0; p < 6; ++p) {
+      const __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_set1_ps(planes[p][0]), world_center[0]),
+              _mm256_mul_ps(_mm256_set1_ps(planes[p][1]), world_center[1])),
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_set1_ps(planes[p][2]), world_center[2]),
+              _mm256_set1_ps(planes[p][3])));
+      const __m256 radius = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_set1_ps(std::fabs(planes[p][0])),
+                            world_extent[0]),
+              _mm256_mul_ps(_mm256_set1_ps(std::fabs(planes[p][1])),
+                            world_extent[1])),
+          _mm256_mul_ps(_mm256_set1_ps(std::fabs(planes[p][2])),
+                        world_extent[2]));
+      inside = _mm256_and_ps(
+          inside,
+          _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+    }
+    const int mask = _mm256_movemask_ps(inside);
+    for (int lane = 0; lane < 8; ++lane) {
+      visible[i + lane] = (mask >> lane) & 1;
+    }
+  }
+  return i;
+}
+#endif
+
+// Tests the boxes with the widest SIMD instructions the processor supports.
+void CullBoxes(const BoxBatch& boxes,
+               const float planes[6][4],
+               const int num_boxes,
+               unsigned char* visible) {
+  int num_tested = 0;
+#ifdef WVU_X86
+  if (CpuHasAvx()) {
+    num_tested = CullBoxesAvx(boxes, planes, num_boxes, visible);
+  } else if (CpuHasSse2()) {
+    num_tested = CullBoxesSse(boxes, planes, num_boxes, visible);
+  }
+#endif
+  CullBoxesScalar(boxes, planes, num_tested, num_boxes, visible);
+}
+
+}  // namespace
+
+FrustumCuller::FrustumCuller() {
+  stats_.num_visible = 0;
+  stats_.num_culled = 0;
+  stats_.num_frames = 0;
+  stats_.total_visible = 0;
+  stats_.total_culled = 0;
+}
+
+const std::vector<Model*>& FrustumCuller::Cull(
+    const Eigen::Matrix4f& view_projection,
+    const std::vector<Model*>& models) {
+  const int num_models = models.size();
+  for (int i = 0; i < 12; ++i) {
+    matrices_[i].resize(num_models);
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    box_centers_[axis].resize(num_models);
+    box_extents_[axis].resize(num_models);
+  }
+  visible_.resize(num_models);
+  // Gathers the model matrices and the boxes into the arrays.
+  for (int i = 0; i < num_models; ++i) {
+    const Eigen::Matrix4f model_matrix = models[i]->ComputeModelMatrix();
+    for (int row = 0; row < 3; ++row) {
+      for (int col = 0; col < 4; ++col) {
+        matrices_[4 * row + col][i] = model_matrix(row, col);
+      }
+    }
+    const MeshBounds& bounds = models[i]->mesh()->bounds();
+    for (int axis = 0; axis < 3; ++axis) {
+      box_centers_[axis][i] =
+          0.5f * (bounds.box_min[axis] + bounds.box_max[axis]);
+      box_extents_[axis][i] =
+          0.5f * (bounds.box_max[axis] - bounds.box_min[axis]);
+    }
+  }
+
+  BoxBatch boxes;
+  for (int i = 0; i < 12; ++i) {
+    boxes.matrix[i] = matrices_[i].data();
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    boxes.center[axis] = box_centers_[axis].data();
+    boxes.extent[axis] = box_extents_[axis].data();
+  }
+  const Eigen::Matrix<float, 6, 4> frustum_planes =
+      ComputeFrustumPlanes(view_projection);
+  float planes[6][4];
+  for (int p = 0; p < 6; ++p) {
+    for (int i = 0; i < 4; ++i) {
+      planes[p][i] = frustum_planes(p, i);
+    }
+  }
+  CullBoxes(boxes, planes, num_models, visible_.data());
+
+  visible_models_.clear();
+  for (int i = 0; i < num_models; ++i) {
+    if (visible_[i]) {
+      visible_models_.push_back(models[i]);
+    }
+  }
+  stats_.num_visible = visible_models_.size();
+  stats_.num_culled = num_models - stats_.num_visible;
+  ++stats_.num_frames;
+  stats_.total_visible += stats_.num_visible;
+  stats_.total_culled += stats_.num_culled;
+  return visible_models_;
+}
+
+}  // namespace wvu
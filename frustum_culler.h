@@ -0,0 +1,103 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef FRUSTUM_CULLER_H_
+#define FRUSTUM_CULLER_H_
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "model.h"
+
+namespace wvu {
+// Culls models against the view frustum on the CPU, so that only the visible
+// ones are drawn. The bounding box of the mesh of every model (see
+// wvu::MeshBounds) is moved to world space with the model matrix and tested
+// against the six frustum planes. The boxes are processed in
+// structure-of-arrays batches, eight at a time with AVX or four at a time
+// with SSE when the processor supports them.
+//
+// Example:
+//
+// wvu::FrustumCuller frustum_culler;
+// while (...) {  // Rendering loop.
+//   for (Model* model : frustum_culler.Cull(projection * view, models)) {
+//     model->Draw(shader_program);
+//   }
+// }
+class FrustumCuller {
+ public:
+  // Statistics of the culler.
+  struct Stats {
+    // Number of models visible and culled by the last call to Cull().
+    int num_visible;
+    int num_culled;
+    // Number of calls to Cull(), and sums of the counts over them.
+    int num_frames;
+    long long total_visible;
+    long long total_culled;
+  };
+
+  FrustumCuller();
+
+  // Returns the models whose bounding box intersects the view frustum, in
+  // their original order. The returned vector is valid until the next call.
+  // Params:
+  //   view_projection  The projection matrix times the view matrix.
+  //   models  The models to cull. They must have a mesh.
+  const std::vector<Model*>& Cull(const Eigen::Matrix4f& view_projection,
+                                  const std::vector<Model*>& models);
+
+  // Returns the statistics of the culler.
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  // Model matrices (the first 3 rows, row by row), and centers and half
+  // extents of the model-space bounding boxes, in structure-of-arrays layout.
+  std::vector<float> matrices_[12];
+  std::vector<float> box_centers_[3];
+  std::vector<float> box_extents_[3];
+  // Result of the test of each model: 1 if visible.
+  std::vector<unsigned char> visible_;
+  std::vector<Model*> visible_models_;
+  Stats stats_;
+};
+
+}  // namespace wvu
+
+#endif  // FRUSTUM_CULLER_H_
@@ -0,0 +1,317 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "geometry_allocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <vector>
+#include <Eigen/Core>
+#include <GL/glew.h>
+
+#include "mesh.h"
+
+namespace wvu {
+namespace {
+// A vertex holds the position (x, y, z) and the texel (u, v).
+constexpr int kFloatsPerVertex = 5;
+constexpr GLsizeiptr kVertexSize = kFloatsPerVertex * sizeof(GLfloat);
+constexpr GLsizeiptr kIndexSize = sizeof(GLuint);
+
+}  // namespace
+
+void GeometryAllocator::FreeList::Reset(const int capacity) {
+  ranges_.clear();
+  if (capacity > 0) {
+    ranges_[0] = capacity;
+  }
+}
+
+int GeometryAllocator::FreeList::Allocate(const int size) {
+  for (std::map<int, int>::iterator it = ranges_.begin(); it != ranges_.end();
+       ++it) {
+    if (it->second < size) continue;
+    const int offset = it->first;
+    const int remaining_size = it->second - size;
+    ranges_.erase(it);
+    if (remaining_size > 0) {
+      ranges_[offset + size] = remaining_size;
+    }
+    return offset;
+  }
+  return -1;
+}
+
+void GeometryAllocator::FreeList::Free(const int offset, const int size) {
+  if (size <= 0) return;
+  int start = offset;
+  int end = offset + size;
+  // Merges the range with the free range that ends where it starts.
+  std::map<int, int>::iterator next = ranges_.lower_bound(offset);
+  if (next != ranges_.begin()) {
+    std::map<int, int>::iterator previous = std::prev(next);
+    if (previous->first + previous->second == start) {
+      start = previous->first;
+      ranges_.erase(previous);
+    }
+  }
+  // Merges the range with the free range that starts where it ends.
+  if (next != ranges_.end() && next->first == end) {
+    end += next->second;
+    ranges_.erase(next);
+  }
+  ranges_[start] = end - start;
+}
+
+GeometryAllocator::GeometryAllocator() :
+    vertex_array_object_id_(0), vertex_buffer_object_id_(0),
+    element_buffer_object_id_(0), vertex_capacity_(0), index_capacity_(0),
+    num_grows_(0), num_defragmentations_(0) {}
+
+GeometryAllocator::~GeometryAllocator() {
+  if (vertex_array_object_id_ != 0) {
+    glDeleteVertexArrays(1, &vertex_array_object_id_);
+  }
+  if (vertex_buffer_object_id_ != 0) {
+    glDeleteBuffers(1, &vertex_buffer_object_id_);
+  }
+  if (element_buffer_object_id_ != 0) {
+    glDeleteBuffers(1, &element_buffer_object_id_);
+  }
+}
+
+bool GeometryAllocator::Create(const int vertex_capacity,
+                               const int index_capacity) {
+  if (vertex_array_object_id_ != 0) {
+    std::cerr << "ERROR: The geometry allocator was already created.\n";
+    return false;
+  }
+  if (vertex_capacity <= 0 || index_capacity <= 0) {
+    std::cerr << "ERROR: Invalid capacity of the geometry allocator.\n";
+    return false;
+  }
+  glGenVertexArrays(1, &vertex_array_object_id_);
+  Reallocate(vertex_capacity, index_capacity);
+  return vertex_array_object_id_ != 0 && vertex_buffer_object_id_ != 0 &&
+      element_buffer_object_id_ != 0;
+}
+
+int GeometryAllocator::Allocate(const Eigen::MatrixXf& vertices,
+                                const std::vector<GLuint>& indices) {
+  if (vertex_array_object_id_ == 0) {
+    std::cerr << "ERROR: The geometry allocator was not created.\n";
+    return -1;
+  }
+  if (vertices.rows() != kFloatsPerVertex) {
+    std::cerr << "ERROR: The vertices must have " << kFloatsPerVertex
+              << " rows.\n";
+    return -1;
+  }
+  const int num_vertices = vertices.cols();
+  const int num_indices = indices.size();
+  if (num_vertices == 0 || num_indices == 0) return -1;
+  int base_vertex = free_vertices_.Allocate(num_vertices);
+  int first_index = free_indices_.Allocate(num_indices);
+  if (base_vertex < 0 || first_index < 0) {
+    free_vertices_.Free(base_vertex, base_vertex < 0 ? 0 : num_vertices);
+    free_indices_.Free(first_index, first_index < 0 ? 0 : num_indices);
+    // Grows the buffers to at least twice their size, packing the
+    // allocations, which leaves the free space at their end.
+    const Stats current_stats = stats();
+    const int vertex_capacity =
+        std::max(2 * vertex_capacity_,
+                 current_stats.used_vertices + num_vertices);
+    const int index_capacity =
+        std::max(2 * index_capacity_, current_stats.used_indices + num_indices);
+    Reallocate(vertex_capacity, index_capacity);
+    ++num_grows_;
+    base_vertex = free_vertices_.Allocate(num_vertices);
+    first_index = free_indices_.Allocate(num_indices);
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_object_id_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, base_vertex * kVertexSize,
+                  num_vertices * kVertexSize, vertices.data());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, element_buffer_object_id_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, first_index * kIndexSize,
+                  num_indices * kIndexSize, indices.data());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  GeometryAllocation allocation;
+  allocation.base_vertex = base_vertex;
+  allocation.num_vertices = num_vertices;
+  allocation.first_index = first_index;
+  allocation.num_indices = num_indices;
+  const MeshBounds bounds = ComputeMeshBounds(vertices);
+  allocation.bounding_sphere[0] = bounds.sphere_center.x();
+  allocation.bounding_sphere[1] = bounds.sphere_center.y();
+  allocation.bounding_sphere[2] = bounds.sphere_center.z();
+  allocation.bounding_sphere[3] = bounds.sphere_radius;
+  int handle;
+  if (free_handles_.empty()) {
+    handle = allocations_.size();
+    allocations_.push_back(allocation);
+    live_.push_back(true);
+  } else {
+    handle = free_handles_.back();
+    free_handles_.pop_back();
+    allocations_[handle] = allocation;
+    live_[handle] = true;
+  }
+  return handle;
+}
+
+void GeometryAllocator::Free(const int handle) {
+  if (handle < 0 || handle >= allocations_.size() || !live_[handle]) {
+    std::cerr << "ERROR: Invalid geometry allocation " << handle << ".\n";
+    return;
+  }
+  const GeometryAllocation& allocation = allocations_[handle];
+  free_vertices_.Free(allocation.base_vertex, allocation.num_vertices);
+  free_indices_.Free(allocation.first_index, allocation.num_indices);
+  live_[handle] = false;
+  free_handles_.push_back(handle);
+}
+
+void GeometryAllocator::Defragment() {
+  if (free_vertices_.num_ranges() <= 1 && free_indices_.num_ranges() <= 1) {
+    return;
+  }
+  Reallocate(vertex_capacity_, index_capacity_);
+  ++num_defragmentations_;
+}
+
+void GeometryAllocator::Bind() const {
+  glBindVertexArray(vertex_array_object_id_);
+}
+
+GeometryAllocator::Stats GeometryAllocator::stats() const {
+  Stats stats;
+  stats.num_allocations = 0;
+  stats.used_vertices = 0;
+  stats.used_indices = 0;
+  for (int handle = 0; handle < allocations_.size(); ++handle) {
+    if (!live_[handle]) continue;
+    ++stats.num_allocations;
+    stats.used_vertices += allocations_[handle].num_vertices;
+    stats.used_indices += allocations_[handle].num_indices;
+  }
+  stats.vertex_capacity = vertex_capacity_;
+  stats.index_capacity = index_capacity_;
+  stats.num_free_vertex_ranges = free_vertices_.num_ranges();
+  stats.num_free_index_ranges = free_indices_.num_ranges();
+  stats.num_grows = num_grows_;
+  stats.num_defragmentations = num_defragmentations_;
+  return stats;
+}
+
+void GeometryAllocator::Reallocate(const int vertex_capacity,
+                                   const int index_capacity) {
+  // The copies go through the copy targets, so that the element buffer
+  // binding of the bound VAO is left alone.
+  GLuint vertex_buffer_object_id;
+  GLuint element_buffer_object_id;
+  glGenBuffers(1, &vertex_buffer_object_id);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_object_id);
+  glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity * kVertexSize, nullptr,
+               GL_STATIC_DRAW);
+  glGenBuffers(1, &element_buffer_object_id);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, element_buffer_object_id);
+  glBufferData(GL_COPY_WRITE_BUFFER, index_capacity * kIndexSize, nullptr,
+               GL_STATIC_DRAW);
+
+  // Copies the live allocations one after another. The indices are relative
+  // to the base vertex, so they are copied unchanged.
+  int num_vertices = 0;
+  int num_indices = 0;
+  for (int handle = 0; handle < allocations_.size(); ++handle) {
+    if (!live_[handle]) continue;
+    GeometryAllocation& allocation = allocations_[handle];
+    glBindBuffer(GL_COPY_READ_BUFFER, vertex_buffer_object_id_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_object_id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        allocation.base_vertex * kVertexSize,
+                        num_vertices * kVertexSize,
+                        allocation.num_vertices * kVertexSize);
+    glBindBuffer(GL_COPY_READ_BUFFER, element_buffer_object_id_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, element_buffer_object_id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        allocation.first_index * kIndexSize,
+                        num_indices * kIndexSize,
+                        allocation.num_indices * kIndexSize);
+    allocation.base_vertex = num_vertices;
+    allocation.first_index = num_indices;
+    num_vertices += allocation.num_vertices;
+    num_indices += allocation.num_indices;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  if (vertex_buffer_object_id_ != 0) {
+    glDeleteBuffers(1, &vertex_buffer_object_id_);
+  }
+  if (element_buffer_object_id_ != 0) {
+    glDeleteBuffers(1, &element_buffer_object_id_);
+  }
+  vertex_buffer_object_id_ = vertex_buffer_object_id;
+  element_buffer_object_id_ = element_buffer_object_id;
+  vertex_capacity_ = vertex_capacity;
+  index_capacity_ = index_capacity;
+  free_vertices_.Reset(vertex_capacity_);
+  free_vertices_.Allocate(num_vertices);
+  free_indices_.Reset(index_capacity_);
+  free_indices_.Allocate(num_indices);
+  SetBuffersIntoVertexArray();
+}
+
+void GeometryAllocator::SetBuffersIntoVertexArray() {
+  glBindVertexArray(vertex_array_object_id_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id_);
+  // The position takes the first 3 floats of a vertex, and the texel the
+  // next 2.
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, kVertexSize, nullptr);
+  glEnableVertexAttribArray(0);
+  const GLvoid* offset_texel = reinterpret_cast<GLvoid*>(3 * sizeof(GLfloat));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, kVertexSize, offset_texel);
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object_id_);
+  glBindVertexArray(0);
+}
+
+}  // namespace wvu
@@ -0,0 +1,210 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef GEOMETRY_ALLOCATOR_H_
+#define GEOMETRY_ALLOCATOR_H_
+
+#include <map>
+#include <vector>
+#include <Eigen/Core>
+#include <GL/glew.h>
+
+namespace wvu {
+// Place of a mesh in the buffers of a geometry allocator. The indices are
+// relative to the first vertex of the mesh, so they are drawn with
+// base_vertex (e.g., glDrawElementsBaseVertex() or the base vertex of a
+// DrawElementsIndirectCommand).
+struct GeometryAllocation {
+  GLint base_vertex;
+  GLsizei num_vertices;
+  GLuint first_index;
+  GLsizei num_indices;
+  // Sphere enclosing the vertices in model space: the center (x, y, z) and
+  // the radius.
+  GLfloat bounding_sphere[4];
+};
+
+// Suballocates the geometry of many meshes from one vertex buffer and one
+// element buffer, described by a single vertex array object. Since every mesh
+// shares the same VAO, a scene is drawn without binding a VAO per object, and
+// it can be submitted at once with glMultiDrawElementsIndirect() (see
+// wvu::MultiDrawBatch). The vertices have the layout of wvu::Mesh: the
+// position at the attribute location 0 and the texel at 1.
+//
+// The free ranges of each buffer are kept in a free list, and adjacent ranges
+// are merged when freed. When no free range fits a mesh, the buffers grow and
+// the meshes are packed at their beginning. Defragment() packs them in place.
+// The allocations keep their handles when moved.
+//
+// Example:
+//
+// wvu::GeometryAllocator geometry_allocator;
+// geometry_allocator.Create(1 << 16, 1 << 18);
+// const int cube = geometry_allocator.Allocate(vertices, indices);
+// geometry_allocator.Bind();
+// const wvu::GeometryAllocation& allocation =
+//     geometry_allocator.allocation(cube);
+// glDrawElementsBaseVertex(GL_TRIANGLES, allocation.num_indices,
+//                          GL_UNSIGNED_INT,
+//                          ...,  // allocation.first_index in bytes.
+//                          allocation.base_vertex);
+class GeometryAllocator {
+ public:
+  // Statistics of the allocator.
+  struct Stats {
+    // Number of live allocations.
+    int num_allocations;
+    // Vertices and indices taken by the live allocations.
+    int used_vertices;
+    int used_indices;
+    // Vertices and indices the buffers can hold.
+    int vertex_capacity;
+    int index_capacity;
+    // Number of free ranges of each buffer. More than one means the buffer is
+    // fragmented.
+    int num_free_vertex_ranges;
+    int num_free_index_ranges;
+    // Number of times the buffers grew, and were defragmented.
+    int num_grows;
+    int num_defragmentations;
+  };
+
+  GeometryAllocator();
+  ~GeometryAllocator();
+
+  // Creates the buffers and the VAO. Returns true if successful.
+  // Params:
+  //   vertex_capacity  Number of vertices the vertex buffer holds initially.
+  //   index_capacity  Number of indices the element buffer holds initially.
+  bool Create(const int vertex_capacity, const int index_capacity);
+
+  // Uploads the geometry of a mesh into the buffers, growing them if needed.
+  // Returns the handle of the allocation, or -1 if the geometry is empty.
+  // Params:
+  //   vertices  The vertices, one per column: the position (x, y, z) and the
+  //     texel (u, v).
+  //   indices  The indices of the triangles.
+  int Allocate(const Eigen::MatrixXf& vertices,
+               const std::vector<GLuint>& indices);
+
+  // Frees an allocation. Its handle may be returned by a later Allocate().
+  void Free(const int handle);
+
+  // Packs the allocations at the beginning of the buffers, so that the free
+  // space is a single range at their end.
+  void Defragment();
+
+  // Binds the VAO shared by every allocation.
+  void Bind() const;
+
+  // Returns the place of an allocation in the buffers.
+  const GeometryAllocation& allocation(const int handle) const {
+    return allocations_[handle];
+  }
+
+  GLuint vertex_array_object_id() const {
+    return vertex_array_object_id_;
+  }
+
+  GLuint vertex_buffer_object_id() const {
+    return vertex_buffer_object_id_;
+  }
+
+  GLuint element_buffer_object_id() const {
+    return element_buffer_object_id_;
+  }
+
+  // Returns a number that changes whenever the allocations move, so that the
+  // draw commands built from them can be refreshed.
+  int generation() const {
+    return num_grows_ + num_defragmentations_;
+  }
+
+  // Returns the statistics of the allocator.
+  Stats stats() const;
+
+ private:
+  // First-fit free list of the ranges of a buffer, in elements. The ranges
+  // are keyed by their offset, so that a freed range is merged with its
+  // neighbors.
+  class FreeList {
+   public:
+    // Makes the whole [0, capacity) range free.
+    void Reset(const int capacity);
+    // Takes size elements from the first free range that fits them. Returns
+    // their offset, or -1 if no range fits.
+    int Allocate(const int size);
+    // Gives back the range [offset, offset + size).
+    void Free(const int offset, const int size);
+    // Returns the number of free ranges.
+    int num_ranges() const {
+      return ranges_.size();
+    }
+
+   private:
+    // Size of the free ranges, keyed by their offset.
+    std::map<int, int> ranges_;
+  };
+
+  // Creates buffers of the given capacities, copies the live allocations into
+  // them packed at their beginning, and replaces the current buffers.
+  void Reallocate(const int vertex_capacity, const int index_capacity);
+
+  // Attaches the vertex and element buffers to the VAO.
+  void SetBuffersIntoVertexArray();
+
+  GLuint vertex_array_object_id_;
+  GLuint vertex_buffer_object_id_;
+  GLuint element_buffer_object_id_;
+  int vertex_capacity_;
+  int index_capacity_;
+  FreeList free_vertices_;
+  FreeList free_indices_;
+  // Allocations indexed by their handle, and whether each one is live.
+  std::vector<GeometryAllocation> allocations_;
+  std::vector<bool> live_;
+  // Handles of the freed allocations, reused by Allocate().
+  std::vector<int> free_handles_;
+  int num_grows_;
+  int num_defragmentations_;
+
+  GeometryAllocator(const GeometryAllocator&) = delete;
+  GeometryAllocator& operator=(const GeometryAllocator&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GEOMETRY_ALLOCATOR_H_
@@ -0,0 +1,225 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "gpu_frustum_culler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <Eigen/Core>
+#include <GL/glew.h>
+
+#include "camera_utils.h"
+#include "multi_draw_batch.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Number of draws culled by a work group.
+constexpr int kWorkGroupSize = 64;
+
+// Shader storage buffer bindings of the commands of the batch, the culled
+// commands and their number. The objects are at kDrawObjectBinding.
+constexpr GLuint kCommandBinding = 1;
+constexpr GLuint kCulledCommandBinding = 2;
+constexpr GLuint kCountBinding = 3;
+
+// Compute shader testing the bounding sphere of each object against the
+// frustum planes. The sphere is moved to world space with the model matrix,
+// and its radius scaled by the largest scale of the matrix. When
+// COMPACT_COMMANDS is defined, the visible commands are appended; otherwise
+// every command keeps its place and the culled ones draw zero instances.
+// Follows the #version directive and kDrawObjectShaderSource.
+const char kCullingShaderSource[] =
+    "layout (local_size_x = 64) in;\n"
+    "struct Command {\n"
+    "uint count;\n"
+    "uint instance_count;\n"
+    "uint first_index;\n"
+    "int base_vertex;\n"
+    "uint base_instance;\n"
+    "};\n"
+    "layout (std430, binding = 1) readonly buffer Commands {\n"
+    "Command commands[];\n"
+    "};\n"
+    "layout (std430, binding = 2) writeonly buffer CulledCommands {\n"
+    "Command culled_commands[];\n"
+    "};\n"
+    "layout (std430, binding = 3) buffer DrawCount {\n"
+    "uint draw_count;\n"
+    "};\n"
+    "uniform vec4 frustum_planes[6];\n"
+    "uniform uint num_draws;\n"
+    "void main() {\n"
+    "uint i = gl_GlobalInvocationID.x;\n"
+    "if (i >= num_draws) return;\n"
+    "mat4 model = draw_objects[i].model;\n"
+    "vec4 sphere = draw_objects[i].bounding_sphere;\n"
+    "vec3 center = (model * vec4(sphere.xyz, 1.0f)).xyz;\n"
+    "float scale = max(max(length(model[0].xyz), length(model[1].xyz)),\n"
+    "                  length(model[2].xyz));\n"
+    "float radius = sphere.w * scale;\n"
+    "bool visible = true;\n"
+    "for (int p = 0; p < 6; ++p) {\n"
+    "visible = visible &&\n"
+    "    dot(frustum_planes[p].xyz, center) + frustum_planes[p].w >= -radius;\n"
+    "}\n"
+    "Command command = commands[i];\n"
+    "#ifdef COMPACT_COMMANDS\n"
+    "if (visible) {\n"
+    "culled_commands[atomicAdd(draw_count, 1u)] = command;\n"
+    "}\n"
+    "#else\n"
+    "if (visible) {\n"
+    "atomicAdd(draw_count, 1u);\n"
+    "}\n"
+    "command.instance_count = visible ? 1u : 0u;\n"
+    "culled_commands[i] = command;\n"
+    "#endif\n"
+    "}\n";
+
+}  // namespace
+
+GpuFrustumCuller::GpuFrustumCuller() :
+    frustum_planes_location_(-1), num_draws_location_(-1),
+    culled_command_buffer_id_(0), count_buffer_id_(0), buffer_capacity_(0),
+    indirect_count_(false) {}
+
+GpuFrustumCuller::~GpuFrustumCuller() {
+  if (culled_command_buffer_id_ != 0) {
+    glDeleteBuffers(1, &culled_command_buffer_id_);
+  }
+  if (count_buffer_id_ != 0) {
+    glDeleteBuffers(1, &count_buffer_id_);
+  }
+}
+
+bool GpuFrustumCuller::IsSupported() {
+  return MultiDrawBatch::IsSupported();
+}
+
+bool GpuFrustumCuller::Create(ProgramBinaryCache* binary_cache) {
+  if (!IsSupported()) {
+    std::cerr << "ERROR: GPU culling needs OpenGL 4.3.\n";
+    return false;
+  }
+  indirect_count_ = MultiDrawBatch::IsIndirectCountSupported();
+  program_.set_binary_cache(binary_cache);
+  program_.LoadComputeShaderFromString(std::string("#version 430 core\n") +
+                                       kDrawObjectShaderSource +
+                                       kCullingShaderSource);
+  if (indirect_count_) {
+    program_.AddDefine("COMPACT_COMMANDS", "");
+  }
+  std::string error_info_log;
+  if (!program_.Create(&error_info_log)) {
+    std::cerr << "ERROR: " << error_info_log << "\n";
+    return false;
+  }
+  frustum_planes_location_ =
+      glGetUniformLocation(program_.shader_program_id(), "frustum_planes");
+  num_draws_location_ =
+      glGetUniformLocation(program_.shader_program_id(), "num_draws");
+  glGenBuffers(1, &culled_command_buffer_id_);
+  glGenBuffers(1, &count_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer_id_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return true;
+}
+
+void GpuFrustumCuller::Cull(const Eigen::Matrix4f& view_projection,
+                            MultiDrawBatch* batch) {
+  if (batch == nullptr) {
+    std::cout << "Null pointer passed.  Could not cull the batch.";
+    return;
+  }
+  if (culled_command_buffer_id_ == 0 || batch->num_draws() == 0) return;
+  batch->Upload();
+  ReserveBuffers(batch->num_draws());
+  const GLuint zero = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer_id_);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  program_.Use();
+  const Eigen::Matrix<float, 6, 4, Eigen::RowMajor> frustum_planes =
+      ComputeFrustumPlanes(view_projection);
+  glUniform4fv(frustum_planes_location_, 6, frustum_planes.data());
+  glUniform1ui(num_draws_location_, batch->num_draws());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCommandBinding,
+                   batch->indirect_buffer_id());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCulledCommandBinding,
+                   culled_command_buffer_id_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCountBinding, count_buffer_id_);
+  glDispatchCompute((batch->num_draws() + kWorkGroupSize - 1) / kWorkGroupSize,
+                    1, 1);
+  // The draws read the commands and their number written by the shader.
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuFrustumCuller::Draw(MultiDrawBatch* batch) {
+  if (batch == nullptr) {
+    std::cout << "Null pointer passed.  Could not draw the batch.";
+    return;
+  }
+  if (culled_command_buffer_id_ == 0) return;
+  batch->DrawCommands(culled_command_buffer_id_,
+                      indirect_count_ ? count_buffer_id_ : 0);
+}
+
+int GpuFrustumCuller::ReadNumVisible() const {
+  if (count_buffer_id_ == 0) return 0;
+  GLuint num_visible = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer_id_);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(num_visible),
+                     &num_visible);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return num_visible;
+}
+
+void GpuFrustumCuller::ReserveBuffers(const int num_draws) {
+  if (num_draws <= buffer_capacity_) return;
+  buffer_capacity_ = std::max(num_draws, 2 * buffer_capacity_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, culled_command_buffer_id_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               buffer_capacity_ * sizeof(DrawElementsIndirectCommand),
+               nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+}  // namespace wvu
@@ -0,0 +1,123 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef GPU_FRUSTUM_CULLER_H_
+#define GPU_FRUSTUM_CULLER_H_
+
+#include <Eigen/Core>
+#include <GL/glew.h>
+
+#include "multi_draw_batch.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Culls the draws of a multi-draw batch against the view frustum on the GPU.
+// A compute shader reads the model matrix and the bounding sphere of every
+// object from the object buffer of the batch, tests the sphere against the
+// frustum planes, and copies the commands of the visible objects into an
+// indirect buffer, counting them with an atomic counter. Draw() then issues
+// them with glMultiDrawElementsIndirectCount(), which reads the count from the
+// GPU, so no CPU work per frame depends on the number of objects. Without
+// indirect count support, the commands keep their place and the culled ones
+// draw zero instances, and all of them are submitted.
+//
+// Example:
+//
+// wvu::GpuFrustumCuller culler;
+// culler.Create();
+// while (...) {  // Rendering loop.
+//   culler.Cull(projection * view, &batch);
+//   shader_program.Use();
+//   culler.Draw(&batch);
+// }
+class GpuFrustumCuller {
+ public:
+  GpuFrustumCuller();
+  ~GpuFrustumCuller();
+
+  // Returns true if the driver supports compute shaders and multi-draw
+  // indirect (OpenGL 4.3).
+  static bool IsSupported();
+
+  // Builds the compute shader and creates the buffers. Returns false if the
+  // culler is not supported or the shader fails to build.
+  // Params:
+  //   binary_cache  Cache of program binaries for the compute shader, or null.
+  bool Create(ProgramBinaryCache* binary_cache);
+
+  // Uploads the batch (see MultiDrawBatch::Upload()) and culls its draws.
+  // Changes the program in use.
+  // Params:
+  //   view_projection  The projection matrix times the view matrix.
+  //   batch  The batch to cull.
+  void Cull(const Eigen::Matrix4f& view_projection, MultiDrawBatch* batch);
+
+  // Draws the draws of the batch that passed the last Cull(). The shader
+  // program must be in use.
+  void Draw(MultiDrawBatch* batch);
+
+  // Returns the number of draws that passed the last Cull(). Waits for the
+  // GPU to finish culling, so it is meant for statistics.
+  int ReadNumVisible() const;
+
+  // Returns true if the number of visible draws is read by the GPU.
+  bool indirect_count() const {
+    return indirect_count_;
+  }
+
+ private:
+  // Grows the buffer of culled commands to hold the draws.
+  void ReserveBuffers(const int num_draws);
+
+  // Compute shader culling the draws.
+  ShaderProgram program_;
+  GLint frustum_planes_location_;
+  GLint num_draws_location_;
+  // Commands of the visible draws, and their number.
+  GLuint culled_command_buffer_id_;
+  GLuint count_buffer_id_;
+  // Number of commands the culled command buffer can hold.
+  int buffer_capacity_;
+  // True if the draws are compacted and their number read by the GPU.
+  bool indirect_count_;
+
+  GpuFrustumCuller(const GpuFrustumCuller&) = delete;
+  GpuFrustumCuller& operator=(const GpuFrustumCuller&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GPU_FRUSTUM_CULLER_H_
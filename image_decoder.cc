@@ -0,0 +1,337 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "image_decoder.h"
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <jpeglib.h>
+#include <jerror.h>
+#include <png.h>
+
+// Include CImg library to load the formats without a native decoder.
+// The macro below disables the capabilities of displaying images in CImg.
+#define cimg_display 0
+#include <CImg.h>
+
+#include "mapped_file.h"
+#include "pixel_conversion.h"
+
+namespace wvu {
+namespace {
+// Number of bytes of the PNG signature.
+constexpr int kPngSignatureSize = 8;
+
+// Returns true if the data starts with the JPEG start of image marker.
+bool IsJpeg(const unsigned char* data, const size_t size) {
+  return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+// Returns true if the data starts with the PNG signature.
+bool IsPng(const unsigned char* data, const size_t size) {
+  return size >= kPngSignatureSize &&
+         png_sig_cmp(data, 0, kPngSignatureSize) == 0;
+}
+
+// -------------------- JPEG ---------------------------------------------------
+// libjpeg source manager reading the stream from memory, like the source
+// manager of CImg's jpeg_buffer.h plugin. The whole file is the buffer, so the
+// source only needs to handle truncated files.
+void InitJpegSource(j_decompress_ptr decompressor) {}
+
+boolean FillJpegInputBuffer(j_decompress_ptr decompressor) {
+  // The file is truncated. Insert an end of image marker, as the stdio source
+  // manager of libjpeg does, so the decoder finishes with what it has.
+  static const JOCTET kEndOfImage[2] = { 0xFF, JPEG_EOI };
+  WARNMS(decompressor, JWRN_JPEG_EOF);
+  decompressor->src->next_input_byte = kEndOfImage;
+  decompressor->src->bytes_in_buffer = 2;
+  return TRUE;
+}
+
+void SkipJpegInputData(j_decompress_ptr decompressor, long num_bytes) {
+  if (num_bytes <= 0) return;
+  jpeg_source_mgr* source = decompressor->src;
+  if (static_cast<size_t>(num_bytes) > source->bytes_in_buffer) {
+    source->next_input_byte += source->bytes_in_buffer;
+    source->bytes_in_buffer = 0;
+    FillJpegInputBuffer(decompressor);
+    return;
+  }
+  source->next_input_byte += num_bytes;
+  source->bytes_in_buffer -= num_bytes;
+}
+
+void TerminateJpegSource(j_decompress_ptr decompressor) {}
+
+// libjpeg error manager that returns to the decoder instead of exiting.
+struct JpegErrorManager {
+  jpeg_error_mgr manager;
+  jmp_buf jump_buffer;
+};
+
+void ExitOnJpegError(j_common_ptr decompressor) {
+  longjmp(reinterpret_cast<JpegErrorManager*>(decompressor->err)->jump_buffer,
+          1);
+}
+
+// Warnings (e.g., corrupt data) are not printed.
+void OutputJpegMessage(j_common_ptr decompressor) {}
+
+// Decodes a JPEG stream at 1/scale_denominator of its resolution.
+bool DecodeJpeg(const unsigned char* data,
+                const size_t size,
+                const int scale_denominator,
+                RgbaImage* image) {
+  jpeg_decompress_struct decompressor;
+  JpegErrorManager error_manager;
+  // Declared before setjmp so that a decoding error does not skip them.
+  std::vector<JSAMPLE> row;
+  decompressor.err = jpeg_std_error(&error_manager.manager);
+  error_manager.manager.error_exit = ExitOnJpegError;
+  error_manager.manager.output_message = OutputJpegMessage;
+  if (setjmp(error_manager.jump_buffer)) {
+    jpeg_destroy_decompress(&decompressor);
+    return false;
+  }
+  jpeg_create_decompress(&decompressor);
+  jpeg_source_mgr source;
+  source.init_source = InitJpegSource;
+  source.fill_input_buffer = FillJpegInputBuffer;
+  source.skip_input_data = SkipJpegInputData;
+  source.resync_to_restart = jpeg_resync_to_restart;
+  source.term_source = TerminateJpegSource;
+  source.next_input_byte = data;
+  source.bytes_in_buffer = size;
+  decompressor.src = &source;
+  jpeg_read_header(&decompressor, TRUE);
+  if (decompressor.jpeg_color_space == JCS_CMYK ||
+      decompressor.jpeg_color_space == JCS_YCCK) {
+    // Leave the uncommon color spaces to CImg.
+    jpeg_destroy_decompress(&decompressor);
+    return false;
+  }
+  // libjpeg scales the image in the DCT domain: it only computes the low
+  // frequency coefficients of each block, which is much faster than decoding
+  // the full image and downsampling it.
+  decompressor.scale_num = 1;
+  decompressor.scale_denom = scale_denominator;
+#ifdef JCS_ALPHA_EXTENSIONS
+  // libjpeg-turbo writes RGBA pixels with an opaque alpha, so the rows are
+  // decoded straight into the image.
+  decompressor.out_color_space = JCS_EXT_RGBA;
+#else
+  if (decompressor.jpeg_color_space != JCS_GRAYSCALE) {
+    decompressor.out_color_space = JCS_RGB;
+  }
+#endif
+  jpeg_start_decompress(&decompressor);
+  image->width = decompressor.output_width;
+  image->height = decompressor.output_height;
+  image->pixels.resize(4 * image->width * image->height);
+  const int num_components = decompressor.output_components;
+  if (num_components != 4) {
+    row.resize(num_components * image->width);
+  }
+  while (decompressor.output_scanline < decompressor.output_height) {
+    unsigned char* destination =
+        image->pixels.data() + 4 * image->width * decompressor.output_scanline;
+    JSAMPROW row_pointer = num_components == 4 ? destination : row.data();
+    jpeg_read_scanlines(&decompressor, &row_pointer, 1);
+    if (num_components == 4) continue;
+    // Expand the grey or RGB row and add an opaque alpha.
+    for (int x = 0; x < image->width; ++x) {
+      const JSAMPLE* pixel = row.data() + num_components * x;
+      destination[4 * x] = pixel[0];
+      destination[4 * x + 1] = pixel[num_components == 3 ? 1 : 0];
+      destination[4 * x + 2] = pixel[num_components == 3 ? 2 : 0];
+      destination[4 * x + 3] = 255;
+    }
+  }
+  jpeg_finish_decompress(&decompressor);
+  jpeg_destroy_decompress(&decompressor);
+  return true;
+}
+
+// -------------------- PNG ----------------------------------------------------
+// Position of libpng in the file.
+struct PngReader {
+  const unsigned char* data;
+  size_t size;
+  size_t offset;
+};
+
+void ReadPngData(png_structp decoder, png_bytep output, png_size_t length) {
+  PngReader* reader = static_cast<PngReader*>(png_get_io_ptr(decoder));
+  if (reader->offset + length > reader->size) {
+    png_error(decoder, "Truncated PNG file");
+  }
+  std::memcpy(output, reader->data + reader->offset, length);
+  reader->offset += length;
+}
+
+// Warnings (e.g., incorrect color profiles) are not printed.
+void IgnorePngWarning(png_structp decoder, png_const_charp message) {}
+
+bool DecodePng(const unsigned char* data, const size_t size, RgbaImage* image) {
+  png_structp decoder = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr,
+                                               nullptr, IgnorePngWarning);
+  if (decoder == nullptr) return false;
+  png_infop info = png_create_info_struct(decoder);
+  // Declared before setjmp so that a decoding error does not skip them.
+  std::vector<png_bytep> rows;
+  PngReader reader = { data, size, 0 };
+  if (info == nullptr || setjmp(png_jmpbuf(decoder))) {
+    png_destroy_read_struct(&decoder, &info, nullptr);
+    return false;
+  }
+  png_set_read_fn(decoder, &reader, ReadPngData);
+  png_read_info(decoder, info);
+  // Convert every pixel format to 8-bit RGBA.
+  const int color_type = png_get_color_type(decoder, info);
+  const int bit_depth = png_get_bit_depth(decoder, info);
+  const bool has_transparency = png_get_valid(decoder, info, PNG_INFO_tRNS);
+  if (color_type == PNG_COLOR_TYPE_PALETTE) {
+    png_set_palette_to_rgb(decoder);
+  }
+  if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+    png_set_expand_gray_1_2_4_to_8(decoder);
+  }
+  if (has_transparency) {
+    png_set_tRNS_to_alpha(decoder);
+  }
+  if (bit_depth == 16) {
+    png_set_strip_16(decoder);
+  }
+  if (color_type == PNG_COLOR_TYPE_GRAY ||
+      color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+    png_set_gray_to_rgb(decoder);
+  }
+  if ((color_type & PNG_COLOR_MASK_ALPHA) == 0 && !has_transparency) {
+    png_set_filler(decoder, 0xFF, PNG_FILLER_AFTER);
+  }
+  png_set_interlace_handling(decoder);
+  png_read_update_info(decoder, info);
+  image->width = png_get_image_width(decoder, info);
+  image->height = png_get_image_height(decoder, info);
+  image->pixels.resize(4 * image->width * image->height);
+  rows.resize(image->height);
+  for (int y = 0; y < image->height; ++y) {
+    rows[y] = image->pixels.data() + 4 * image->width * y;
+  }
+  png_read_image(decoder, rows.data());
+  png_read_end(decoder, nullptr);
+  png_destroy_read_struct(&decoder, &info, nullptr);
+  return true;
+}
+
+// -------------------- Other formats ------------------------------------------
+bool DecodeWithCImg(const std::string& filepath, RgbaImage* image) {
+  cimg_library::CImg<unsigned char> planar_image;
+  try {
+    planar_image.load(filepath.c_str());
+  } catch (const cimg_library::CImgException&) {
+    return false;
+  }
+  if (planar_image.is_empty()) return false;
+  // OpenGL expects to have the pixel values interleaved (e.g., RGBA, ...). CImg
+  // flatens out the planes. Interleave them straight into the decoded image,
+  // expanding grey images and adding an opaque alpha when missing.
+  const unsigned char* red = planar_image.data(0, 0, 0, 0);
+  const unsigned char* green = red;
+  const unsigned char* blue = red;
+  const unsigned char* alpha = nullptr;
+  if (planar_image.spectrum() == 2) {
+    alpha = planar_image.data(0, 0, 0, 1);
+  } else if (planar_image.spectrum() >= 3) {
+    green = planar_image.data(0, 0, 0, 1);
+    blue = planar_image.data(0, 0, 0, 2);
+    if (planar_image.spectrum() >= 4) alpha = planar_image.data(0, 0, 0, 3);
+  }
+  const int num_pixels = planar_image.width() * planar_image.height();
+  image->width = planar_image.width();
+  image->height = planar_image.height();
+  image->pixels.resize(4 * num_pixels);
+  InterleavePlanarToRgba(red, green, blue, alpha, num_pixels,
+                         image->pixels.data());
+  return true;
+}
+
+}  // namespace
+
+bool DecodeImageFile(const std::string& filepath, RgbaImage* image) {
+  if (image == nullptr) {
+    std::cout << "Null pointer passed.  Could not decode image.";
+    return false;
+  }
+  // JPEG and PNG files are decoded in-process from the mapped file. The format
+  // is detected from the content, not from the extension.
+  MappedFile file;
+  if (file.Open(filepath)) {
+    if (IsJpeg(file.data(), file.size()) &&
+        DecodeJpeg(file.data(), file.size(), 1, image)) {
+      return true;
+    }
+    if (IsPng(file.data(), file.size()) &&
+        DecodePng(file.data(), file.size(), image)) {
+      return true;
+    }
+  }
+  return DecodeWithCImg(filepath, image);
+}
+
+bool DecodeReducedImageFile(const std::string& filepath,
+                            const int scale_denominator,
+                            RgbaImage* image) {
+  if (image == nullptr) {
+    std::cout << "Null pointer passed.  Could not decode image.";
+    return false;
+  }
+  if (scale_denominator != 1 && scale_denominator != 2 &&
+      scale_denominator != 4 && scale_denominator != 8) {
+    return false;
+  }
+  MappedFile file;
+  return file.Open(filepath) && IsJpeg(file.data(), file.size()) &&
+         DecodeJpeg(file.data(), file.size(), scale_denominator, image);
+}
+
+}  // namespace wvu
@@ -0,0 +1,77 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef IMAGE_DECODER_H_
+#define IMAGE_DECODER_H_
+
+#include <string>
+#include <vector>
+
+namespace wvu {
+// Decoded image with 8-bit RGBA pixels stored row by row.
+struct RgbaImage {
+  RgbaImage() : width(0), height(0) {}
+  int width;
+  int height;
+  // 4 * width * height interleaved values.
+  std::vector<unsigned char> pixels;
+};
+
+// Decodes an image file into RGBA pixels. Grey images are expanded and an
+// opaque alpha is added to images without alpha. JPEG and PNG files are memory
+// mapped and decoded in-process with libjpeg and libpng; other formats are
+// loaded with CImg. Returns true if successful. This function is thread-safe.
+// Params:
+//   filepath  The path of the image file.
+//   image  The decoded image.
+bool DecodeImageFile(const std::string& filepath, RgbaImage* image);
+
+// Decodes a JPEG file at 1/2, 1/4 or 1/8 of its resolution (rounded up) for
+// low mipmap levels and previews. libjpeg scales the image while decoding it,
+// which takes a fraction of the time and memory of a full decode. Returns
+// false for other formats, since they would need a full decode anyway. This
+// function is thread-safe.
+// Params:
+//   filepath  The path of the image file.
+//   scale_denominator  1, 2, 4 or 8.
+//   image  The decoded image.
+bool DecodeReducedImageFile(const std::string& filepath,
+                            const int scale_denominator,
+                            RgbaImage* image);
+
+}  // namespace wvu
+
+#endif  // IMAGE_DECODER_H_
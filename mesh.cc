@@ -0,0 +1,354 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "mesh.h"
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <GL/glew.h>
+
+namespace wvu {
+namespace {
+// Direction of the rays testing whether a point is inside a mesh. It is not
+// aligned with the axes, so that it rarely grazes the edges of the
+// triangles of axis-aligned faces.
+const Eigen::Vector3f kInsideRayDirection(0.5773f, 0.6211f, 0.5302f);
+
+// Returns the distance along the ray to the triangle, in units of the length
+// of the direction, or a negative value if the ray misses it
+// (Moller-Trumbore).
+float IntersectTriangle(const Eigen::Vector3f& origin,
+                        const Eigen::Vector3f& direction,
+                        const Eigen::Vector3f& vertex0,
+                        const Eigen::Vector3f& vertex1,
+                        const Eigen::Vector3f& vertex2) {
+  const Eigen::Vector3f edge1 = vertex1 - vertex0;
+  const Eigen::Vector3f edge2 = vertex2 - vertex0;
+  const Eigen::Vector3f p = direction.cross(edge2);
+  const float determinant = edge1.dot(p);
+  if (std::abs(determinant) < 1e-12f) {
+    return -1.0f;
+  }
+  const float inverse_determinant = 1.0f / determinant;
+  const Eigen::Vector3f t = origin - vertex0;
+  const float u = t.dot(p) * inverse_determinant;
+  if (u < 0.0f || u > 1.0f) {
+    return -1.0f;
+  }
+  const Eigen::Vector3f q = t.cross(edge1);
+  const float v = direction.dot(q) * inverse_determinant;
+  if (v < 0.0f || u + v > 1.0f) {
+    return -1.0f;
+  }
+  return edge2.dot(q) * inverse_determinant;
+}
+
+// Returns the number of triangles of the mesh crossed by the ray.
+int CountMeshCrossings(const Mesh& mesh,
+                       const Eigen::Vector3f& origin,
+                       const Eigen::Vector3f& direction) {
+  const Eigen::MatrixXf& vertices = mesh.vertices();
+  const std::vector<GLuint>& indices = mesh.indices();
+  int num_crossings = 0;
+  for (int i = 0; i + 2 < indices.size(); i += 3) {
+    if (IntersectTriangle(origin, direction,
+                          vertices.block<3, 1>(0, indices[i]),
+                          vertices.block<3, 1>(0, indices[i + 1]),
+                          vertices.block<3, 1>(0, indices[i + 2])) >= 0.0f) {
+      ++num_crossings;
+    }
+  }
+  return num_crossings;
+}
+
+}  // namespace
+
+MeshBounds ComputeMeshBounds(const Eigen::MatrixXf& vertices) {
+  MeshBounds bounds;
+  if (vertices.cols() == 0) {
+    bounds.box_min.setZero();
+    bounds.box_max.setZero();
+    bounds.sphere_center.setZero();
+    bounds.sphere_radius = 0.0f;
+    return bounds;
+  }
+  bounds.box_min = vertices.topRows(3).rowwise().minCoeff();
+  bounds.box_max = vertices.topRows(3).rowwise().maxCoeff();
+  bounds.sphere_center = 0.5f * (bounds.box_min + bounds.box_max);
+  bounds.sphere_radius = (vertices.topRows(3).colwise() - bounds.sphere_center)
+      .colwise().norm().maxCoeff();
+  return bounds;
+}
+
+float IntersectMeshTriangles(const Mesh& mesh,
+                             const Eigen::Vector3f& origin,
+                             const Eigen::Vector3f& direction,
+                             const float max_distance) {
+  const Eigen::MatrixXf& vertices = mesh.vertices();
+  const std::vector<GLuint>& indices = mesh.indices();
+  float closest_distance = std::numeric_limits<float>::infinity();
+  for (int i = 0; i + 2 < indices.size(); i += 3) {
+    const float distance =
+        IntersectTriangle(origin, direction,
+                          vertices.block<3, 1>(0, indices[i]),
+                          vertices.block<3, 1>(0, indices[i + 1]),
+                          vertices.block<3, 1>(0, indices[i + 2]));
+    if (distance >= 0.0f && distance < max_distance &&
+        distance < closest_distance) {
+      closest_distance = distance;
+    }
+  }
+  return closest_distance;
+}
+
+bool IsInsideMesh(const Mesh& mesh, const Eigen::Vector3f& point) {
+  const MeshBounds& bounds = mesh.bounds();
+  if ((point.array() < bounds.box_min.array()).any() ||
+      (point.array() > bounds.box_max.array()).any()) {
+    return false;
+  }
+  return CountMeshCrossings(mesh, point, kInsideRayDirection) % 2 == 1 &&
+      CountMeshCrossings(mesh, point, -kInsideRayDirection) % 2 == 1;
+}
+
+Mesh::Mesh(const Eigen::MatrixXf& vertices,
+           const std::vector<GLuint>& indices) :
+    vertices_(vertices), indices_(indices),
+    bounds_(ComputeMeshBounds(vertices)), vertex_array_object_id_(0),
+    vertex_buffer_object_id_(0), element_buffer_object_id_(0),
+    instance_buffer_object_id_(0), instance_buffer_capacity_(0),
+    residency_manager_(nullptr) {}
+
+Mesh::~Mesh() {
+  set_residency_manager(nullptr);
+  Evict();
+}
+
+void Mesh::SetVerticesIntoGpu() {
+  glGenVertexArrays(1, &vertex_array_object_id_);
+  glBindVertexArray(vertex_array_object_id_);
+  glGenBuffers(1, &vertex_buffer_object_id_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id_);
+  const int vertices_size_in_bytes =
+      vertices_.rows() * vertices_.cols() * sizeof(vertices_(0, 0));
+  glBufferData(GL_ARRAY_BUFFER, vertices_size_in_bytes, vertices_.data(),
+               GL_STATIC_DRAW);
+  // The position takes the first 3 floats of a vertex, and the texel the
+  // next 2.
+  constexpr GLsizei kStride = 5 * sizeof(GLfloat);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, kStride, nullptr);
+  glEnableVertexAttribArray(0);
+  const GLvoid* offset_texel = reinterpret_cast<GLvoid*>(3 * sizeof(GLfloat));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, kStride, offset_texel);
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glGenBuffers(1, &element_buffer_object_id_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object_id_);
+  const int indices_size_in_bytes = indices_.size() * sizeof(indices_[0]);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size_in_bytes,
+               indices_.data(), GL_STATIC_DRAW);
+}
+
+void Mesh::set_residency_manager(ResidencyManager* residency_manager) {
+  if (residency_manager_ != nullptr) {
+    residency_manager_->Unregister(this);
+  }
+  residency_manager_ = residency_manager;
+  if (residency_manager_ != nullptr) {
+    residency_manager_->Register(this, ResourceType::kMesh);
+  }
+}
+
+size_t Mesh::resident_bytes() const {
+  if (vertex_array_object_id_ == 0) return 0;
+  return full_bytes() + instance_buffer_capacity_ * sizeof(ModelInstance);
+}
+
+size_t Mesh::full_bytes() const {
+  return vertices_.size() * sizeof(vertices_(0, 0)) +
+      indices_.size() * sizeof(indices_[0]);
+}
+
+bool Mesh::Evict() {
+  if (vertex_array_object_id_ == 0) return false;
+  // The vertices and indices stay in memory to upload them again.
+  glDeleteVertexArrays(1, &vertex_array_object_id_);
+  glDeleteBuffers(1, &vertex_buffer_object_id_);
+  glDeleteBuffers(1, &element_buffer_object_id_);
+  if (instance_buffer_object_id_ != 0) {
+    glDeleteBuffers(1, &instance_buffer_object_id_);
+  }
+  vertex_array_object_id_ = 0;
+  vertex_buffer_object_id_ = 0;
+  element_buffer_object_id_ = 0;
+  instance_buffer_object_id_ = 0;
+  instance_buffer_capacity_ = 0;
+  return true;
+}
+
+bool Mesh::Restore() {
+  if (vertex_array_object_id_ != 0) return false;
+  SetVerticesIntoGpu();
+  return true;
+}
+
+void Mesh::Bind() {
+  // Uploads the buffers again if they were evicted.
+  if (residency_manager_ != nullptr) {
+    residency_manager_->MarkUsed(this);
+  }
+  glBindVertexArray(vertex_array_object_id_);
+}
+
+void Mesh::Draw() const {
+  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, 0);
+}
+
+void Mesh::DrawInstanced(const ModelInstance* instances,
+                         const int num_instances) {
+  if (instances == nullptr || num_instances <= 0) return;
+  Bind();
+  if (instance_buffer_object_id_ == 0) {
+    SetInstanceBufferIntoGpu();
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_object_id_);
+  const GLsizeiptr instances_size_in_bytes =
+      num_instances * sizeof(ModelInstance);
+  if (num_instances > instance_buffer_capacity_) {
+    // Grow the buffer.
+    glBufferData(GL_ARRAY_BUFFER, instances_size_in_bytes, instances,
+                 GL_STREAM_DRAW);
+    instance_buffer_capacity_ = num_instances;
+  } else {
+    // Orphan the previous storage so that the driver does not have to wait
+    // until the previous frame stops reading from it.
+    glBufferData(GL_ARRAY_BUFFER,
+                 instance_buffer_capacity_ * sizeof(ModelInstance), nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances_size_in_bytes, instances);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glDrawElementsInstanced(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, 0,
+                          num_instances);
+}
+
+void Mesh::SetInstanceBufferIntoGpu() {
+  glBindVertexArray(vertex_array_object_id_);
+  glGenBuffers(1, &instance_buffer_object_id_);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_object_id_);
+  constexpr GLsizei kStride = sizeof(ModelInstance);
+  // The model matrix takes four attribute locations, one per column.
+  constexpr GLuint kModelMatrixIndex = 2;
+  for (GLuint column = 0; column < 4; ++column) {
+    const GLvoid* offset_column = reinterpret_cast<GLvoid*>(
+        offsetof(ModelInstance, model_matrix) + 4 * column * sizeof(GLfloat));
+    glVertexAttribPointer(kModelMatrixIndex + column, 4, GL_FLOAT, GL_FALSE,
+                          kStride, offset_column);
+    glEnableVertexAttribArray(kModelMatrixIndex + column);
+    glVertexAttribDivisor(kModelMatrixIndex + column, 1);
+  }
+  constexpr GLuint kTintIndex = 6;
+  const GLvoid* offset_tint =
+      reinterpret_cast<GLvoid*>(offsetof(ModelInstance, tint));
+  glVertexAttribPointer(kTintIndex, 4, GL_FLOAT, GL_FALSE, kStride,
+                        offset_tint);
+  glEnableVertexAttribArray(kTintIndex);
+  glVertexAttribDivisor(kTintIndex, 1);
+  constexpr GLuint kTextureLayerIndex = 7;
+  const GLvoid* offset_layer =
+      reinterpret_cast<GLvoid*>(offsetof(ModelInstance, texture_layer));
+  glVertexAttribPointer(kTextureLayerIndex, 1, GL_FLOAT, GL_FALSE, kStride,
+                        offset_layer);
+  glEnableVertexAttribArray(kTextureLayerIndex);
+  glVertexAttribDivisor(kTextureLayerIndex, 1);
+  constexpr GLuint kTextureTransformIndex = 8;
+  const GLvoid* offset_transform =
+      reinterpret_cast<GLvoid*>(offsetof(ModelInstance, texture_transform));
+  glVertexAttribPointer(kTextureTransformIndex, 4, GL_FLOAT, GL_FALSE,
+                        kStride, offset_transform);
+  glEnableVertexAttribArray(kTextureTransformIndex);
+  glVertexAttribDivisor(kTextureTransformIndex, 1);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+MeshRegistry::MeshRegistry() : residency_manager_(nullptr) {}
+
+MeshRegistry::~MeshRegistry() {}
+
+Mesh* MeshRegistry::Register(const std::string& name,
+                             const Eigen::MatrixXf& vertices,
+                             const std::vector<GLuint>& indices) {
+  std::unique_ptr<Mesh>& mesh = meshes_[name];
+  if (mesh == nullptr) {
+    mesh.reset(new Mesh(vertices, indices));
+    mesh->SetVerticesIntoGpu();
+    mesh->set_residency_manager(residency_manager_);
+  }
+  return mesh.get();
+}
+
+void MeshRegistry::Clear() {
+  meshes_.clear();
+}
+
+Mesh* MeshRegistry::Find(const std::string& name) const {
+  const auto mesh = meshes_.find(name);
+  return mesh == meshes_.end() ? nullptr : mesh->second.get();
+}
+
+void MeshRegistry::set_residency_manager(
+    ResidencyManager* residency_manager) {
+  residency_manager_ = residency_manager;
+  for (const auto& name_and_mesh : meshes_) {
+    name_and_mesh.second->set_residency_manager(residency_manager);
+  }
+}
+
+size_t MeshRegistry::geometry_bytes() const {
+  size_t bytes = 0;
+  for (const auto& name_and_mesh : meshes_) {
+    bytes += name_and_mesh.second->full_bytes();
+  }
+  return bytes;
+}
+
+}  // namespace wvu
@@ -0,0 +1,245 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef MESH_H_
+#define MESH_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+#include <GL/glew.h>
+
+#include "residency_manager.h"
+
+namespace wvu {
+// Per-instance attributes consumed by Mesh::DrawInstanced(). The struct is
+// tightly packed so that a contiguous array of instances is copied into the
+// instance buffer object with a single call.
+struct ModelInstance {
+  // Model matrix in column-major order (the storage order of Eigen and
+  // OpenGL).
+  GLfloat model_matrix[16];
+  // RGBA color that multiplies the sampled texel.
+  GLfloat tint[4];
+  // Layer of the texture to sample from.
+  GLfloat texture_layer;
+  // Scale (x, y) and offset (z, w) of the texture coordinates within the
+  // layer (see wvu::TextureRegion).
+  GLfloat texture_transform[4];
+};
+
+// Box and sphere enclosing the vertices of a mesh, in model space.
+struct MeshBounds {
+  // Corners of the axis-aligned bounding box.
+  Eigen::Vector3f box_min;
+  Eigen::Vector3f box_max;
+  // Bounding sphere, centered in the box.
+  Eigen::Vector3f sphere_center;
+  float sphere_radius;
+};
+
+// Computes the bounds of the positions of the vertices.
+// Params:
+//   vertices  The vertices, one per column, whose first 3 rows are the
+//     position (x, y, z).
+MeshBounds ComputeMeshBounds(const Eigen::MatrixXf& vertices);
+
+// Geometry shared by the models drawing it: the vertices and indices, and
+// their vertex array, vertex buffer and element buffer objects. The buffers
+// are a mesh resource of a residency manager, when one is set: they may be
+// freed while no model draws the mesh, and are uploaded again from the
+// vertices and indices when one does.
+class Mesh : public ResidentResource {
+ public:
+  // Params:
+  //   vertices  The vertices, one per column: the position (x, y, z) and the
+  //     texel (u, v).
+  //   indices  The indices of the triangles.
+  Mesh(const Eigen::MatrixXf& vertices, const std::vector<GLuint>& indices);
+  ~Mesh();
+
+  // Creates the VAO, VBO and EBO and uploads the geometry.
+  void SetVerticesIntoGpu();
+
+  // Registers the buffers in a residency manager, which must outlive the
+  // mesh. Bind() marks them used. Null unregisters.
+  void set_residency_manager(ResidencyManager* residency_manager);
+
+  // ResidentResource interface. Evict() frees the buffers and Restore()
+  // uploads them again.
+  size_t resident_bytes() const override;
+  size_t full_bytes() const override;
+  bool Evict() override;
+  bool Restore() override;
+
+  // Binds the VAO of the mesh, uploading the buffers again if they were
+  // evicted.
+  void Bind();
+
+  // Draws the triangles of the mesh, which must be bound.
+  void Draw() const;
+
+  // Draws num_instances copies of the mesh with a single
+  // glDrawElementsInstanced call. The per-instance attributes are uploaded
+  // into an instance buffer object bound to the VAO of the mesh: the model
+  // matrix at the attribute locations 2-5, the tint at 6, the texture layer
+  // at 7 and the texture transform at 8. Binds the mesh.
+  // Params:
+  //   instances  Contiguous array of per-instance attributes.
+  //   num_instances  Number of instances in the array.
+  void DrawInstanced(const ModelInstance* instances, const int num_instances);
+
+  // Returns a const reference of the vertices.
+  const Eigen::MatrixXf& vertices() const {
+    return vertices_;
+  }
+
+  // Returns a const reference of the indices for an EBO.
+  const std::vector<GLuint>& indices() const {
+    return indices_;
+  }
+
+  // Returns the bounds of the vertices, computed at construction.
+  const MeshBounds& bounds() const {
+    return bounds_;
+  }
+
+  GLuint vertex_array_object_id() const {
+    return vertex_array_object_id_;
+  }
+
+  GLuint vertex_buffer_object_id() const {
+    return vertex_buffer_object_id_;
+  }
+
+  GLuint element_buffer_object_id() const {
+    return element_buffer_object_id_;
+  }
+
+ private:
+  // Creates the instance buffer object and configures the per-instance
+  // attributes of the VAO.
+  void SetInstanceBufferIntoGpu();
+
+  Eigen::MatrixXf vertices_;
+  std::vector<GLuint> indices_;
+  MeshBounds bounds_;
+  GLuint vertex_array_object_id_;
+  GLuint vertex_buffer_object_id_;
+  GLuint element_buffer_object_id_;
+  // Instance buffer object id. Created the first time the mesh is drawn
+  // instanced.
+  GLuint instance_buffer_object_id_;
+  // Number of instances the instance buffer object can hold.
+  int instance_buffer_capacity_;
+  // Residency manager tracking the buffers, or null.
+  ResidencyManager* residency_manager_;
+
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+};
+
+// Returns the distance from the origin to the closest triangle of the mesh
+// hit by the ray, in units of the length of the direction, or infinity if no
+// triangle closer than max_distance is hit. The ray is in model space.
+// Params:
+//   mesh  The mesh, whose vertices and indices are read on the CPU.
+//   origin  The start of the ray.
+//   direction  The direction of the ray.
+//   max_distance  Hits at this distance or farther are ignored.
+float IntersectMeshTriangles(const Mesh& mesh,
+                             const Eigen::Vector3f& origin,
+                             const Eigen::Vector3f& direction,
+                             const float max_distance);
+
+// Returns true if the point, in model space, is inside the mesh. The mesh
+// must be closed: the point is inside when rays in two opposite directions
+// both cross its triangles an odd number of times, so a point in front of an
+// open surface is not inside it.
+bool IsInsideMesh(const Mesh& mesh, const Eigen::Vector3f& point);
+
+// Owns the meshes of a scene, one per name, so that the models drawing the
+// same geometry share a single copy of it on the CPU and in video memory.
+//
+// Example:
+//
+// wvu::MeshRegistry mesh_registry;
+// wvu::Mesh* cube = mesh_registry.Register("cube", vertices, indices);
+// models.push_back(new wvu::Model(orientation, position, cube));
+//
+// The registry must outlive the models using its meshes.
+class MeshRegistry {
+ public:
+  MeshRegistry();
+  // Deletes the meshes.
+  ~MeshRegistry();
+
+  // Registers the geometry under a name and uploads it. If the name is
+  // already registered, returns its mesh and ignores the geometry. Must be
+  // called from the OpenGL thread.
+  Mesh* Register(const std::string& name,
+                 const Eigen::MatrixXf& vertices,
+                 const std::vector<GLuint>& indices);
+
+  // Deletes the meshes. Must be called from the OpenGL thread, while the
+  // context is current.
+  void Clear();
+
+  // Returns the mesh registered under the name, or null.
+  Mesh* Find(const std::string& name) const;
+
+  // Registers the meshes, and the ones registered afterwards, in a residency
+  // manager, which must outlive the registry. Null unregisters them.
+  void set_residency_manager(ResidencyManager* residency_manager);
+
+  // Returns the number of meshes.
+  int num_meshes() const {
+    return meshes_.size();
+  }
+
+  // Returns the bytes of the vertices and indices of all the meshes.
+  size_t geometry_bytes() const;
+
+ private:
+  std::unordered_map<std::string, std::unique_ptr<Mesh>> meshes_;
+  ResidencyManager* residency_manager_;
+};
+
+}  // namespace wvu
+
+#endif  // MESH_H_
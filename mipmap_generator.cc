@@ -0,0 +1,522 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "mipmap_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+#include "cpu_features.h"
+
+namespace wvu {
+namespace {
+// Maximum number of taps of a filter along each dimension.
+constexpr int kMaxTaps = 6;
+// Number of entries of each half of the table encoding linear values.
+constexpr int kEncodeTableSize = 4096;
+// Shape parameter and width, in destination pixels, of the Kaiser window.
+constexpr double kKaiserAlpha = 4.0;
+constexpr double kKaiserWidth = 3.0;
+// Threads are only worth starting for levels with enough rows each.
+constexpr int kMinRowsPerThread = 16;
+
+// Lookup tables converting between 8-bit values and linear floats.
+struct ConversionTables {
+  // Linear value of each 8-bit sRGB value, followed by the value of each 8-bit
+  // alpha, so that the alpha of a pixel is decoded by adding 256 to its index.
+  float decode[512];
+  // 8-bit sRGB value of the linear values from 0 to 1, indexed by
+  // sqrt(value) * (kEncodeTableSize - 1) to keep the dark values precise,
+  // followed by the 8-bit alpha indexed by alpha * (kEncodeTableSize - 1).
+  int encode[2 * kEncodeTableSize];
+};
+
+double SrgbToLinear(const double value) {
+  return value <= 0.04045 ? value / 12.92 :
+      std::pow((value + 0.055) / 1.055, 2.4);
+}
+
+double LinearToSrgb(const double value) {
+  return value <= 0.0031308 ? value * 12.92 :
+      1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+}
+
+const ConversionTables& GetConversionTables() {
+  static const ConversionTables* const tables = []() {
+    ConversionTables* new_tables = new ConversionTables;
+    for (int i = 0; i < 256; ++i) {
+      new_tables->decode[i] = SrgbToLinear(i / 255.0);
+      new_tables->decode[256 + i] = i / 255.0f;
+    }
+    for (int i = 0; i < kEncodeTableSize; ++i) {
+      const double value = i / static_cast<double>(kEncodeTableSize - 1);
+      new_tables->encode[i] =
+          static_cast<int>(255.0 * LinearToSrgb(value * value) + 0.5);
+      new_tables->encode[kEncodeTableSize + i] =
+          static_cast<int>(255.0 * value + 0.5);
+    }
+    return new_tables;
+  }();
+  return *tables;
+}
+
+// Separable filter halving the resolution. Destination pixel x is the
+// weighted sum of the source pixels 2x + first_tap to
+// 2x + first_tap + num_taps - 1, clamped to the edges of the image.
+struct FilterKernel {
+  int first_tap;
+  int num_taps;
+  float weights[kMaxTaps];
+};
+
+// Modified Bessel function of the first kind of order zero.
+double BesselI0(const double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+FilterKernel MakeFilterKernel(const MipmapFilter filter) {
+  FilterKernel kernel;
+  if (filter == MipmapFilter::kBox) {
+    kernel.first_tap = 0;
+    kernel.num_taps = 2;
+    kernel.weights[0] = 0.5f;
+    kernel.weights[1] = 0.5f;
+    return kernel;
+  }
+  kernel.first_tap = -2;
+  kernel.num_taps = 6;
+  double weights[kMaxTaps];
+  double sum = 0.0;
+  for (int k = 0; k < kernel.num_taps; ++k) {
+    // Distance between the source pixel and the center of the destination
+    // pixel, in destination pixels.
+    const double distance = 0.5 * (kernel.first_tap + k - 0.5);
+    const double sinc = std::sin(M_PI * distance) / (M_PI * distance);
+    const double ratio = distance / (0.5 * kKaiserWidth);
+    const double window =
+        BesselI0(kKaiserAlpha * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) /
+        BesselI0(kKaiserAlpha);
+    weights[k] = sinc * window;
+    sum += weights[k];
+  }
+  for (int k = 0; k < kernel.num_taps; ++k) {
+    kernel.weights[k] = weights[k] / sum;
+  }
+  return kernel;
+}
+
+// Converts num_pixels RGBA pixels to linear floats.
+void DecodeRowScalar(const unsigned char* source,
+                     const int num_pixels,
+                     float* destination) {
+  const float* decode = GetConversionTables().decode;
+  for (int i = 0; i < 4 * num_pixels; i += 4) {
+    destination[i] = decode[source[i]];
+    destination[i + 1] = decode[source[i + 1]];
+    destination[i + 2] = decode[source[i + 2]];
+    destination[i + 3] = decode[256 + source[i + 3]];
+  }
+}
+
+// Converts num_pixels linear RGBA pixels back to 8 bits.
+void EncodeRowScalar(const float* source,
+                     const int num_pixels,
+                     unsigned char* destination) {
+  const int* encode = GetConversionTables().encode;
+  for (int i = 0; i < 4 * num_pixels; ++i) {
+    float value = std::min(std::max(source[i], 0.0f), 1.0f);
+    int offset = kEncodeTableSize;
+    if ((i & 3) != 3) {
+      value = std::sqrt(value);
+      offset = 0;
+    }
+    destination[i] = encode[offset + static_cast<int>(
+        value * (kEncodeTableSize - 1) + 0.5f)];
+  }
+}
+
+// Filters destination pixel x of a row.
+void FilterPixelHorizontal(const float* source,
+                           const int source_width,
+                           const FilterKernel& kernel,
+                           const int x,
+                           float* destination) {
+  float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  for (int k = 0; k < kernel.num_taps; ++k) {
+    const int source_x =
+        std::min(std::max(2 * x + kernel.first_tap + k, 0), source_width - 1);
+    for (int channel = 0; channel < 4; ++channel) {
+      sum[channel] += kernel.weights[k] * source[4 * source_x + channel];
+    }
+  }
+  std::copy(sum, sum + 4, destination + 4 * x);
+}
+
+void FilterRowHorizontalScalar(const float* source,
+                               const int source_width,
+                               const FilterKernel& kernel,
+                               const int destination_width,
+                               float* destination) {
+  for (int x = 0; x < destination_width; ++x) {
+    FilterPixelHorizontal(source, source_width, kernel, x, destination);
+  }
+}
+
+// Adds up the rows weighted by the kernel, num_values floats each.
+void FilterRowsVerticalScalar(const float* const* rows,
+                              const FilterKernel& kernel,
+                              const int num_values,
+                              float* destination) {
+  for (int i = 0; i < num_values; ++i) {
+    float sum = 0.0f;
+    for (int k = 0; k < kernel.num_taps; ++k) {
+      sum += kernel.weights[k] * rows[k][i];
+    }
+    destination[i] = sum;
+  }
+}
+
+#ifdef WVU_X86
+// Decodes 2 pixels per iteration: the 8 bytes are widened to 32-bit indices
+// and the floats are gathered from the table. The alpha lanes read the second
+// half of the table.
+__attribute__((target("avx2")))
+void DecodeRowAvx2(const unsigned char* source,
+                   const int num_pixels,
+                   float* destination) {
+  const float* decode = GetConversionTables().decode;
+  const __m256i alpha_offset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+  int i = 0;
+  for (; i + 2 <= num_pixels; i += 2) {
+    const __m128i bytes =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + 4 * i));
+    const __m256i indices =
+        _mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), alpha_offset);
+    _mm256_storeu_ps(destination + 4 * i,
+                     _mm256_i32gather_ps(decode, indices, 4));
+  }
+  DecodeRowScalar(source + 4 * i, num_pixels - i, destination + 4 * i);
+}
+
+// Encodes 2 pixels per iteration with the same table lookups as the scalar
+// version, so both produce the same bytes.
+__attribute__((target("avx2")))
+void EncodeRowAvx2(const float* source,
+                   const int num_pixels,
+                   unsigned char* destination) {
+  const int* encode = GetConversionTables().encode;
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 scale = _mm256_set1_ps(kEncodeTableSize - 1);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256i alpha_offset = _mm256_setr_epi32(
+      0, 0, 0, kEncodeTableSize, 0, 0, 0, kEncodeTableSize);
+  int i = 0;
+  for (; i + 2 <= num_pixels; i += 2) {
+    __m256 values = _mm256_min_ps(
+        _mm256_max_ps(_mm256_loadu_ps(source + 4 * i), zero), one);
+    // The color channels are indexed by their square root.
+    values = _mm256_blend_ps(_mm256_sqrt_ps(values), values, 0x88);
+    const __m256i indices = _mm256_add_epi32(
+        _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(values, scale), half)),
+        alpha_offset);
+    const __m256i bytes = _mm256_i32gather_epi32(encode, indices, 4);
+    const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(bytes),
+                                           _mm256_extracti128_si256(bytes, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + 4 * i),
+                     _mm_packus_epi16(words, words));
+  }
+  EncodeRowScalar(source + 4 * i, num_pixels - i, destination + 4 * i);
+}
+
+// Filters 2 destination pixels per iteration: each tap loads the source
+// pixels of both into the two halves of a register. The pixels whose taps
+// cross the edges of the row are filtered by the scalar code.
+__attribute__((target("avx2")))
+void FilterRowHorizontalAvx2(const float* source,
+                             const int source_width,
+                             const FilterKernel& kernel,
+                             const int destination_width,
+                             float* destination) {
+  __m256 weights[kMaxTaps];
+  for (int k = 0; k < kernel.num_taps; ++k) {
+    weights[k] = _mm256_set1_ps(kernel.weights[k]);
+  }
+  int x = 0;
+  while (x < destination_width) {
+    const int first_x = 2 * x + kernel.first_tap;
+    const int last_x = 2 * (x + 1) + kernel.first_tap + kernel.num_taps - 1;
+    if (x + 1 >= destination_width || first_x < 0 || last_x >= source_width) {
+      FilterPixelHorizontal(source, source_width, kernel, x, destination);
+      ++x;
+      continue;
+    }
+    __m256 sum = _mm256_setzero_ps();
+    const float* pixel = source + 4 * first_x;
+    for (int k = 0; k < kernel.num_taps; ++k, pixel += 4) {
+      const __m256 values = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(_mm_loadu_ps(pixel)),
+          _mm_loadu_ps(pixel + 8), 1);
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(weights[k], values));
+    }
+    _mm256_storeu_ps(destination + 4 * x, sum);
+    x += 2;
+  }
+}
+
+__attribute__((target("avx2")))
+void FilterRowsVerticalAvx2(const float* const* rows,
+                            const FilterKernel& kernel,
+                            const int num_values,
+                            float* destination) {
+  __m256 weights[kMaxTaps];
+  for (int k = 0; k < kernel.num_taps; ++k) {
+    weights[k] = _mm256_set1_ps(kernel.weights[k]);
+  }
+  int i = 0;
+  for (; i + 8 <= num_values; i += 8) {
+    __m256 sum = _mm256_setzero_ps();
+    for (int k = 0; k < kernel.num_taps; ++k) {
+      const __m256 values = _mm256_loadu_ps(rows[k] + i);
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(weights[k], values));
+    }
+    _mm256_storeu_ps(destination + i, sum);
+  }
+  const float* remaining_rows[kMaxTaps];
+  for (int k = 0; k < kernel.num_taps; ++k) {
+    remaining_rows[k] = rows[k] + i;
+  }
+  FilterRowsVerticalScalar(remaining_rows, kernel, num_values - i,
+                           destination + i);
+}
+#endif
+
+void DecodeRow(const unsigned char* source,
+               const int num_pixels,
+               float* destination) {
+#ifdef WVU_X86
+  if (CpuHasAvx2()) {
+    DecodeRowAvx2(source, num_pixels, destination);
+    return;
+  }
+#endif
+  DecodeRowScalar(source, num_pixels, destination);
+}
+
+void EncodeRow(const float* source,
+               const int num_pixels,
+               unsigned char* destination) {
+#ifdef WVU_X86
+  if (CpuHasAvx2()) {
+    EncodeRowAvx2(source, num_pixels, destination);
+    return;
+  }
+#endif
+  EncodeRowScalar(source, num_pixels, destination);
+}
+
+void FilterRowHorizontal(const float* source,
+                         const int source_width,
+                         const FilterKernel& kernel,
+                         const int destination_width,
+                         float* destination) {
+#ifdef WVU_X86
+  if (CpuHasAvx2()) {
+    FilterRowHorizontalAvx2(source, source_width, kernel, destination_width,
+                            destination);
+    return;
+  }
+#endif
+  FilterRowHorizontalScalar(source, source_width, kernel, destination_width,
+                            destination);
+}
+
+void FilterRowsVertical(const float* const* rows,
+                        const FilterKernel& kernel,
+                        const int num_values,
+                        float* destination) {
+#ifdef WVU_X86
+  if (CpuHasAvx2()) {
+    FilterRowsVerticalAvx2(rows, kernel, num_values, destination);
+    return;
+  }
+#endif
+  FilterRowsVerticalScalar(rows, kernel, num_values, destination);
+}
+
+// Computes rows first_row to end_row - 1 of the destination level. The source
+// rows are decoded and filtered horizontally once, into a ring of num_taps
+// rows: the taps of a destination row span consecutive source rows, so they
+// never share a slot of the ring.
+void DownsampleRows(const RgbaImage& source,
+                    const FilterKernel& kernel,
+                    const int first_row,
+                    const int end_row,
+                    RgbaImage* destination) {
+  const int row_size = 4 * destination->width;
+  std::vector<float> decoded_row(4 * source.width);
+  std::vector<float> filtered_rows(kernel.num_taps * row_size);
+  std::vector<float> destination_row(row_size);
+  int ring_rows[kMaxTaps];
+  std::fill(ring_rows, ring_rows + kMaxTaps, -1);
+  for (int y = first_row; y < end_row; ++y) {
+    const float* rows[kMaxTaps];
+    for (int k = 0; k < kernel.num_taps; ++k) {
+      const int source_y = std::min(
+          std::max(2 * y + kernel.first_tap + k, 0), source.height - 1);
+      const int slot = source_y % kernel.num_taps;
+      float* filtered_row = filtered_rows.data() + slot * row_size;
+      if (ring_rows[slot] != source_y) {
+        DecodeRow(source.pixels.data() + 4 * source_y * source.width,
+                  source.width, decoded_row.data());
+        FilterRowHorizontal(decoded_row.data(), source.width, kernel,
+                            destination->width, filtered_row);
+        ring_rows[slot] = source_y;
+      }
+      rows[k] = filtered_row;
+    }
+    FilterRowsVertical(rows, kernel, row_size, destination_row.data());
+    EncodeRow(destination_row.data(), destination->width,
+              destination->pixels.data() + y * row_size);
+  }
+}
+
+}  // namespace
+
+bool ParseMipmapFilter(const std::string& name, MipmapFilter* filter) {
+  if (name == "box") {
+    *filter = MipmapFilter::kBox;
+  } else if (name == "kaiser") {
+    *filter = MipmapFilter::kKaiser;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int ComputeNumMipmapLevels(const int width, const int height) {
+  int num_levels = 1;
+  for (int side = std::max(width, height); side > 1; side /= 2) {
+    ++num_levels;
+  }
+  return num_levels;
+}
+
+bool GenerateMipmaps(const RgbaImage& image,
+                     const MipmapFilter filter,
+                     const int num_threads,
+                     std::vector<RgbaImage>* mipmaps) {
+  if (mipmaps == nullptr) {
+    std::cout << "Null pointer passed.  Could not generate the mipmaps.";
+    return false;
+  }
+  mipmaps->clear();
+  if (image.pixels.empty()) return false;
+  int num_workers = num_threads;
+  if (num_workers <= 0) {
+    num_workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const FilterKernel kernel = MakeFilterKernel(filter);
+  mipmaps->resize(ComputeNumMipmapLevels(image.width, image.height) - 1);
+  const RgbaImage* source = &image;
+  for (RgbaImage& mipmap : *mipmaps) {
+    mipmap.width = std::max(1, source->width / 2);
+    mipmap.height = std::max(1, source->height / 2);
+    mipmap.pixels.resize(4 * mipmap.width * mipmap.height);
+    // Split the rows of the level into bands, one per thread.
+    const int num_bands = std::max(
+        1, std::min(num_workers, mipmap.height / kMinRowsPerThread));
+    std::vector<std::thread> workers;
+    for (int band = 1; band < num_bands; ++band) {
+      workers.push_back(std::thread(
+          DownsampleRows, std::cref(*source), std::cref(kernel),
+          band * mipmap.height / num_bands,
+          (band + 1) * mipmap.height / num_bands, &mipmap));
+    }
+    DownsampleRows(*source, kernel, 0, mipmap.height / num_bands, &mipmap);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+    source = &mipmap;
+  }
+  return true;
+}
+
+void UploadMipmappedImage(const RgbaImage& image,
+                          const std::vector<RgbaImage>& mipmaps,
+                          const bool immutable_storage) {
+  const int num_levels = mipmaps.size() + 1;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+  // Blend the two closest levels; the mipmaps are wasted otherwise.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // The rows of the images are tightly packed.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  const bool use_texture_storage = immutable_storage &&
+      (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage);
+  if (use_texture_storage) {
+    glTexStorage2D(GL_TEXTURE_2D, num_levels, GL_RGBA8, image.width,
+                   image.height);
+  }
+  for (int level = 0; level < num_levels; ++level) {
+    const RgbaImage& level_image = level == 0 ? image : mipmaps[level - 1];
+    if (use_texture_storage) {
+      glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, level_image.width,
+                      level_image.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                      level_image.pixels.data());
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, level_image.width,
+                   level_image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                   level_image.pixels.data());
+    }
+  }
+}
+
+}  // namespace wvu
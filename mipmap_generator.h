@@ -0,0 +1,99 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef MIPMAP_GENERATOR_H_
+#define MIPMAP_GENERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "image_decoder.h"
+
+namespace wvu {
+// Builds mipmap chains on the CPU so that the OpenGL thread only uploads them,
+// instead of calling glGenerateMipmap(). The color channels of the images are
+// sRGB encoded, so they are converted to linear light before filtering and
+// back to sRGB afterwards; otherwise the small levels get darker than the
+// texture. The alpha channel is filtered as it is. The filters use AVX2 when
+// the processor supports it, and fall back to scalar code otherwise.
+
+// Filters that halve the resolution of a level.
+enum class MipmapFilter {
+  // Averages 2x2 pixels. Fast, but blurs and aliases a little.
+  kBox,
+  // Kaiser-windowed sinc over 6x6 pixels. Keeps the small levels sharper.
+  kKaiser
+};
+
+// Parses the name of a filter: "box" or "kaiser". Returns true if successful.
+bool ParseMipmapFilter(const std::string& name, MipmapFilter* filter);
+
+// Returns the number of levels of the complete mipmap chain of an image, down
+// to 1x1, including the image itself.
+int ComputeNumMipmapLevels(const int width, const int height);
+
+// Builds the mipmap chain of the image. Every level is computed from the
+// previous one, and its rows are split among several threads.
+// Params:
+//   image  The full resolution image (level 0).
+//   filter  The filter used to downsample the levels.
+//   num_threads  Number of threads filtering each level. When zero, one thread
+//     per hardware thread is used.
+//   mipmaps  Levels 1 to ComputeNumMipmapLevels() - 1 of the image. Empty if
+//     the image is 1x1.
+// Returns true if successful.
+bool GenerateMipmaps(const RgbaImage& image,
+                     const MipmapFilter filter,
+                     const int num_threads,
+                     std::vector<RgbaImage>* mipmaps);
+
+// Uploads the image and its mipmaps into the texture bound to GL_TEXTURE_2D
+// and sets a trilinear filter. With immutable_storage, the levels are
+// allocated at once with glTexStorage2D (when the driver supports it) and
+// filled with glTexSubImage2D; the texture can not be resized afterwards.
+// Otherwise every level is uploaded with glTexImage2D. Must be called from
+// the OpenGL thread.
+// Params:
+//   image  Level 0 of the texture.
+//   mipmaps  The remaining levels, as returned by GenerateMipmaps().
+//   immutable_storage  Whether to allocate immutable storage.
+void UploadMipmappedImage(const RgbaImage& image,
+                          const std::vector<RgbaImage>& mipmaps,
+                          const bool immutable_storage);
+
+}  // namespace wvu
+
+#endif  // MIPMAP_GENERATOR_H_
@@ -35,57 +35,31 @@
 // Author: Brandon Horn (bhorn1@mix.wvu.edu)
 
 #include "model.h"
+#include <algorithm>
 #include <iostream>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <GL/glew.h>
 
+#include "scene_bvh.h"
 #include "shader_program.h"
 #include "transformations.h"
 
 namespace wvu {
     Model::Model(const Eigen::Vector3f& orientation,
                  const Eigen::Vector3f& position,
-                 const Eigen::MatrixXf& vertices) {
+                 Mesh* mesh) {
         orientation_ = orientation;
         position_ = position;
-        vertices_ = vertices;
-        vertex_buffer_object_id_ = 0;
-        vertex_array_object_id_ = 0;
-        element_buffer_object_id_ = 0;
+        mesh_ = mesh;
         texture_object_id_ = 0;
-    }
-    
-    Model::Model(const Eigen::Vector3f& orientation,
-                 const Eigen::Vector3f& position,
-                 const Eigen::MatrixXf& vertices,
-                 const std::vector<GLuint>& indices) {
-        orientation_ = orientation;
-        position_ = position;
-        vertices_ = vertices;
-        indices_ = indices;
-        vertex_buffer_object_id_ = 0;
-        vertex_array_object_id_ = 0;
-        element_buffer_object_id_ = 0;
-        texture_object_id_ = 0;
-    }
-    
-    Model::~Model() {
-        //Delete vertex_array_obect
-        if(vertex_array_object_id_ != 0){
-            glDeleteVertexArrays(1, &vertex_array_object_id_);
-        }
-        //Delete vertex_buffer_object
-        if(vertex_buffer_object_id_ != 0){
-            glDeleteBuffers(1, &vertex_buffer_object_id_);
-        }
-        //Delete element_buffer_object
-        if(element_buffer_object_id_ != 0){
-            glDeleteBuffers(1, &element_buffer_object_id_);
-        }
-        
-        
+        uniform_handles_program_id_ = 0;
+        model_uniform_handle_ = kInvalidUniformHandle;
+        texture_layer_uniform_handle_ = kInvalidUniformHandle;
+        texture_transform_uniform_handle_ = kInvalidUniformHandle;
+        scene_bvh_ = nullptr;
+        scene_bvh_object_ = 0;
     }
     
     // Builds the model matrix from the orientation and position members.
@@ -101,22 +75,46 @@ namespace wvu {
     // Setters set members by *copying* input parameters.
     void Model::set_orientation(const Eigen::Vector3f& orientation) {
         orientation_ = orientation;
+        MarkMoved();
     }
     
     // Setters set members by *copying* input parameters.
     void Model::set_position(const Eigen::Vector3f& position) {
         position_ = position;
+        MarkMoved();
     }
     
     void Model::set_texture(const GLuint texture_id){
         texture_object_id_ = texture_id;
+        texture_handle_ = TextureHandle();
+    }
+    
+    void Model::set_texture(const TextureHandle& texture){
+        texture_handle_ = texture;
+        texture_object_id_ = texture.texture_id();
+    }
+    
+    GLuint Model::texture_id() const {
+        return texture_handle_.valid() ? texture_handle_.texture_id() : texture_object_id_;
     }
     
+    void Model::set_texture_region(const TextureRegion& texture_region){
+        texture_region_ = texture_region;
+    }
+    
+    const TextureRegion& Model::texture_region() const {
+        return texture_region_;
+    }
+    
+    //The BVH only refits the model later, so it can be told before the caller
+    //writes through the pointer.
     Eigen::Vector3f* Model::mutable_orientation() {
+        MarkMoved();
         return &orientation_;
     }
     
     Eigen::Vector3f* Model::mutable_position() {
+        MarkMoved();
         return &position_;
     }
     
@@ -128,86 +126,90 @@ namespace wvu {
         return position_;
     }
     
-    const Eigen::MatrixXf& Model::vertices() const {
-        return vertices_;
-    }
-    
-    const std::vector<GLuint>& Model::indices() const {
-        return indices_;
-    }
-    
-    const GLuint Model::vertex_buffer_object_id() const {
-        return vertex_buffer_object_id_;
+    void Model::set_mesh(Mesh* mesh) {
+        mesh_ = mesh;
+        MarkMoved();
     }
     
-    const GLuint Model::vertex_buffer_object_id() {
-        return vertex_buffer_object_id_;
+    Mesh* Model::mesh() const {
+        return mesh_;
     }
     
-    const GLuint Model::vertex_array_object_id() const {
-        return vertex_array_object_id_;
+    void Model::set_scene_bvh(SceneBvh* scene_bvh, const int scene_bvh_object) {
+        scene_bvh_ = scene_bvh;
+        scene_bvh_object_ = scene_bvh_object;
     }
     
-    const GLuint Model::vertex_array_object_id() {
-        return vertex_array_object_id_;
-    }
-    
-    const GLuint Model::element_buffer_object_id() const {
-        return element_buffer_object_id_;
+    void Model::MarkMoved() {
+        if(scene_bvh_ != nullptr){
+            scene_bvh_->MarkMoved(scene_bvh_object_);
+        }
     }
     
-    const GLuint Model::element_buffer_object_id() {
-        return element_buffer_object_id_;
+    void Model::Draw(const ShaderProgram& shader_program) {
+        texture_handle_.MarkUsed();
+        // The model transformation must be computed using ComputeModelMatrix().
+        const Eigen::Matrix4f model = ComputeModelMatrix();
+        mesh_->Bind();
+        UpdateUniformHandles(shader_program);
+        shader_program.SetUniformMatrix4(model_uniform_handle_, model.data());
+        if(texture_region_.texture_id != 0){
+            //The texture array is already bound; select the layer and the
+            //place of the texture in it.
+            shader_program.SetUniformFloat(texture_layer_uniform_handle_, texture_region_.layer);
+            shader_program.SetUniformVector4(texture_transform_uniform_handle_, texture_region_.uv_transform);
+            mesh_->Draw();
+            return;
+        }
+        //Bind texture
+        glBindTexture(GL_TEXTURE_2D, texture_id());
+        mesh_->Draw();
+        //Unbind texture
+        glBindTexture(GL_TEXTURE_2D, 0);
     }
     
-    void Model::SetVerticesIntoGpu() {
-        //First, we set up the VAO
-        constexpr GLuint kNumVertexArrays = 1;
-        GLuint* ptr_VAO_id = &vertex_array_object_id_;
-        glGenVertexArrays(kNumVertexArrays, ptr_VAO_id);
-        glBindVertexArray(*ptr_VAO_id);
-        //Now, we create the VBO
-        glGenBuffers(1, &vertex_buffer_object_id_);
-        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id_);
-        const int vertices_size_in_bytes = vertices_.rows() * vertices_.cols() * sizeof(vertices_(0, 0));
-        glBufferData(GL_ARRAY_BUFFER, vertices_size_in_bytes, vertices_.data(), GL_STATIC_DRAW);
-        constexpr GLuint kIndex = 0;
-        constexpr GLuint kNumElementsPerVertex = 3;
-        constexpr GLuint kStride = 5 * sizeof(vertices_(0,0));
-        const GLvoid* offset_ptr = nullptr;
-        glVertexAttribPointer(kIndex, kNumElementsPerVertex, GL_FLOAT, GL_FALSE, kStride, offset_ptr);
-        glEnableVertexAttribArray(kIndex);
-        //Configure the texels.
-        const GLvoid* offset_texel =
-        reinterpret_cast<GLvoid*>(3 * sizeof(vertices_(0, 0)));
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, kStride, offset_texel);
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        //Finally, we setup the EBO
-        glGenBuffers(1, &element_buffer_object_id_);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object_id_);
-        const int indices_size_in_bytes = indices_.size() * sizeof(indices_[0]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size_in_bytes, indices_.data(), GL_STATIC_DRAW);
+    void Model::UpdateUniformHandles(const ShaderProgram& shader_program) {
+        if(uniform_handles_program_id_ == shader_program.shader_program_id()){
+            return;
+        }
+        uniform_handles_program_id_ = shader_program.shader_program_id();
+        model_uniform_handle_ = shader_program.uniform_handle("model");
+        texture_layer_uniform_handle_ = shader_program.uniform_handle("texture_layer");
+        texture_transform_uniform_handle_ = shader_program.uniform_handle("texture_transform");
     }
     
-    void Model::Draw(const ShaderProgram& shader_program,
-                     const Eigen::Matrix4f& projection,
-                     const Eigen::Matrix4f& view) {
-        // The model transformation must be computed using ComputeModelMatrix().
-        const Eigen::Matrix4f model = ComputeModelMatrix();
-        glBindVertexArray(vertex_array_object_id_);
-        const GLint model_location = glGetUniformLocation(shader_program.shader_program_id(), "model");
-        const GLint view_location = glGetUniformLocation(shader_program.shader_program_id(), "view");
-        const GLint projection_location = glGetUniformLocation(shader_program.shader_program_id(), "projection");
+    void Model::DrawInstanced(const ShaderProgram& shader_program,
+                              const ModelInstance* instances,
+                              const int num_instances) {
+        if(instances == nullptr || num_instances <= 0){
+            return;
+        }
+        texture_handle_.MarkUsed();
+        if(texture_region_.texture_id != 0){
+            //The texture array is already bound; the instances select the layer.
+            mesh_->DrawInstanced(instances, num_instances);
+            return;
+        }
         //Bind texture
-        glBindTexture(GL_TEXTURE_2D, texture_object_id_);
-        glUniformMatrix4fv(model_location, 1, GL_FALSE, model.data());
-        glUniformMatrix4fv(view_location, 1, GL_FALSE, view.data());
-        glUniformMatrix4fv(projection_location, 1, GL_FALSE, projection.data());
-        glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, 0);
+        glBindTexture(GL_TEXTURE_2D, texture_id());
+        mesh_->DrawInstanced(instances, num_instances);
         //Unbind texture
         glBindTexture(GL_TEXTURE_2D, 0);
     }
     
+    void Model::SetDrawObject(DrawObject* object) {
+        if(object == nullptr){
+            std::cout << "Null pointer passed.  Could not set the draw object.";
+            return;
+        }
+        texture_handle_.MarkUsed();
+        const Eigen::Matrix4f model = ComputeModelMatrix();
+        std::copy(model.data(), model.data() + 16, object->model_matrix);
+        std::fill(object->tint, object->tint + 4, 1.0f);
+        object->texture_layer = texture_region_.layer;
+        std::copy(texture_region_.uv_transform, texture_region_.uv_transform + 4,
+                  object->texture_transform);
+    }
+    
 }  // namespace wvu
 
@@ -41,10 +41,19 @@
 #include <Eigen/Core>
 #include <GL/glew.h>
 
+#include "mesh.h"
+#include "multi_draw_batch.h"
 #include "shader_program.h"
+#include "texture_array.h"
+#include "texture_cache.h"
 
 namespace wvu {
-    // Class that holds the necessary information of a 3D model in OpenGL.
+    class SceneBvh;
+    
+    // Class that holds an object of the scene: its pose, its texture and the
+    // mesh it draws. The geometry lives in the mesh, which is shared by all
+    // the models drawing it (see wvu::MeshRegistry); the memory of a scene
+    // grows with its unique geometry, not with its number of models.
     class Model {
     public:
         // Constructor.
@@ -52,42 +61,47 @@ namespace wvu {
         //  orientation  Axis of rotation whose norm is the angle
         //     (aka Rodrigues vector).
         //  position  The position of the object in the world.
-        //  vertices  The vertices forming the object.
-        Model(const Eigen::Vector3f& orientation,
-              const Eigen::Vector3f& position,
-              const Eigen::MatrixXf& vertices);
-        
-        // Constructor.
-        // Params
-        //  orientation  Axis of rotation whose norm is the angle
-        //     (aka Rodrigues vector).
-        //  position  The position of the object in the world.
-        //  vertices  The vertices forming the object.
-        //  indices  Indices for EBO.
+        //  mesh  The geometry of the object. It must outlive the model.
         Model(const Eigen::Vector3f& orientation,
               const Eigen::Vector3f& position,
-              const Eigen::MatrixXf& vertices,
-              const std::vector<GLuint>& indices);
-        
-        // Destructor.
-        // NOTE: Destructors need to be called when instances of this class are
-        // created in the heap by using new operator.
-        ~Model();
+              Mesh* mesh);
         
         // Builds the model matrix from the orientation and position members.
         Eigen::Matrix4f ComputeModelMatrix();
         
-        // Sets the VAO, VBO and EBO.
-        void SetVerticesIntoGpu();
-        
-        // Draws the model. Executes OpenGL calls to render the set VAO.
+        // Draws the model. Executes OpenGL calls to render its mesh. The
+        // camera matrices are read from the camera uniform buffer (see
+        // camera_uniform_buffer.h), so only the model matrix is uploaded.
+        // When the model has a texture region, its layer and texture transform
+        // are uploaded to the "texture_layer" and "texture_transform" uniforms
+        // instead of binding a texture; the caller binds the texture array of
+        // the region to GL_TEXTURE_2D_ARRAY, once for all the models sharing it.
         // Params:
         //   shader_program  The shader program that is currently in use.
-        //   projection  The camera projection matrix.
-        //   view  The camera pose matrix (world -> camera transformation matrix).
-        void Draw(const ShaderProgram& shader_program,
-                  const Eigen::Matrix4f& projection,
-                  const Eigen::Matrix4f& view);
+        void Draw(const ShaderProgram& shader_program);
+        
+        // Draws num_instances copies of the model with a single
+        // glDrawElementsInstanced call (see Mesh::DrawInstanced()); the pose
+        // of this model is ignored.
+        // Params:
+        //   shader_program  The instanced shader program that is currently in
+        //     use. It reads the model matrix from the attribute locations 2-5,
+        //     the tint from location 6, the texture layer from location 7 and
+        //     the texture transform from location 8, and the camera matrices
+        //     from the camera uniform buffer. No uniforms are uploaded. The
+        //     texture of this model is bound unless the model has a texture
+        //     region; then the caller binds the texture array.
+        //   instances  Contiguous array of per-instance attributes.
+        //   num_instances  Number of instances in the array.
+        void DrawInstanced(const ShaderProgram& shader_program,
+                           const ModelInstance* instances,
+                           const int num_instances);
+        
+        // Fills the object drawing the model in a multi-draw batch (see
+        // wvu::MultiDrawBatch) with its model matrix and texture region, and
+        // records the use of its texture. The caller binds the texture of the
+        // model, or its texture array, before drawing the batch.
+        void SetDrawObject(DrawObject* object);
         
         // Sets the orientation or pose of the object using the Rodrigues
         // vector: angle-axis vector where the angle is the norm of the vector.
@@ -98,6 +112,18 @@ namespace wvu {
         
         //Sets the id for the model's texture
         void set_texture(const GLuint texture_id);
+        
+        //Sets the model's texture from a texture cache. The model keeps a
+        //reference to the texture until it is destroyed or its texture changes.
+        void set_texture(const TextureHandle& texture);
+        
+        //Sets the layer of a texture array holding the model's texture. It
+        //takes precedence over the texture set with set_texture().
+        void set_texture_region(const TextureRegion& texture_region);
+        
+        //Returns the texture region of the model. Its texture_id is zero when
+        //the model does not use a texture array.
+        const TextureRegion& texture_region() const;
         // If we want to avoid copying, we can return a pointer to
         // the member. Note that making public the attributes work
         // if we want to modify directly the members. However, this
@@ -116,25 +142,31 @@ namespace wvu {
         // Gets the position of the object in the world.
         const Eigen::Vector3f& position();
         
-        // Returns a const reference of the vertices.
-        const Eigen::MatrixXf& vertices() const;
-        
-        // Returns a const reference of the indices for an EBO.
-        const std::vector<GLuint>& indices() const;
+        // Sets the mesh drawn by the model. It must outlive the model.
+        void set_mesh(Mesh* mesh);
         
-        // Returns the VBO id associated to this model.
-        const GLuint vertex_buffer_object_id();
-        const GLuint vertex_buffer_object_id() const;
+        // Returns the mesh drawn by the model.
+        Mesh* mesh() const;
         
-        // Returns the VAO id associated to this model.
-        const GLuint vertex_array_object_id();
-        const GLuint vertex_array_object_id() const;
+        // Sets the BVH indexing the model (see wvu::SceneBvh) and the index
+        // of the model in it. The model tells the BVH when its pose changes,
+        // including through the mutable getters. Called by the BVH; null
+        // detaches the model.
+        void set_scene_bvh(SceneBvh* scene_bvh, const int scene_bvh_object);
         
-        // Returns the EBO id assotiated to this model.
-        const GLuint element_buffer_object_id();
-        const GLuint element_buffer_object_id() const;
+        // Returns the id of the model's texture. It is read from the texture
+        // handle when there is one, since the residency manager may replace
+        // the texture of a cache.
+        GLuint texture_id() const;
         
     private:
+        // Tells the BVH indexing the model, if any, that the model moved.
+        void MarkMoved();
+        
+        // Looks up the handle of the model uniform used by Draw() when the
+        // shader program differs from the one used in the previous call.
+        void UpdateUniformHandles(const ShaderProgram& shader_program);
+        
         // Attributes.
         // The convention we will use is to define a '_' after the name
         // of the attribute.
@@ -142,17 +174,23 @@ namespace wvu {
         Eigen::Vector3f orientation_;
         // Position of the object in the world.
         Eigen::Vector3f position_;
-        // Vertex matrix.
-        Eigen::MatrixXf vertices_;
-        // Indices for EBO.
-        std::vector<GLuint> indices_;
-        // Vertex buffer object id.
-        GLuint vertex_buffer_object_id_;
-        // Vertex array object id.
-        GLuint vertex_array_object_id_;
-        // Element buffer object id.
-        GLuint element_buffer_object_id_;
+        // Geometry drawn by the model, owned by a mesh registry.
+        Mesh* mesh_;
         GLuint texture_object_id_;
+        // Reference to the texture when it comes from a texture cache.
+        TextureHandle texture_handle_;
+        // Layer of a texture array holding the texture of the model.
+        TextureRegion texture_region_;
+        // Shader program whose uniform handles are cached below.
+        GLuint uniform_handles_program_id_;
+        // Handle of the "model" uniform.
+        UniformHandle model_uniform_handle_;
+        // Handles of the "texture_layer" and "texture_transform" uniforms.
+        UniformHandle texture_layer_uniform_handle_;
+        UniformHandle texture_transform_uniform_handle_;
+        // BVH indexing the model, and the index of the model in it.
+        SceneBvh* scene_bvh_;
+        int scene_bvh_object_;
     };
     
 }  // namespace wvu
@@ -0,0 +1,259 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "multi_draw_batch.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <vector>
+#include <GL/glew.h>
+
+#include "geometry_allocator.h"
+
+namespace wvu {
+
+// The binding matches kDrawObjectBinding.
+const char kDrawObjectShaderSource[] =
+    "struct DrawObject {\n"
+    "mat4 model;\n"
+    "vec4 tint;\n"
+    "vec4 texture_transform;\n"
+    "vec4 bounding_sphere;\n"
+    "float texture_layer;\n"
+    "};\n"
+    "layout (std430, binding = 0) readonly buffer DrawObjects {\n"
+    "DrawObject draw_objects[];\n"
+    "};\n";
+
+// The location matches kDrawIdAttributeLocation.
+const char kMultiDrawShaderSource[] =
+    "layout (location = 9) in uint draw_id;\n"
+    "DrawObject GetDrawObject() {\n"
+    "return draw_objects[draw_id];\n"
+    "}\n";
+
+MultiDrawBatch::MultiDrawBatch() :
+    geometry_allocator_(nullptr), indirect_buffer_id_(0), object_buffer_id_(0),
+    draw_id_buffer_id_(0), buffer_capacity_(0), commands_changed_(false),
+    objects_changed_(false), allocator_generation_(0) {}
+
+MultiDrawBatch::~MultiDrawBatch() {
+  if (indirect_buffer_id_ != 0) {
+    glDeleteBuffers(1, &indirect_buffer_id_);
+  }
+  if (object_buffer_id_ != 0) {
+    glDeleteBuffers(1, &object_buffer_id_);
+  }
+  if (draw_id_buffer_id_ != 0) {
+    glDeleteBuffers(1, &draw_id_buffer_id_);
+  }
+}
+
+bool MultiDrawBatch::IsSupported() {
+  return GLEW_VERSION_4_3;
+}
+
+bool MultiDrawBatch::IsIndirectCountSupported() {
+  return GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters;
+}
+
+bool MultiDrawBatch::Create(GeometryAllocator* geometry_allocator) {
+  if (geometry_allocator == nullptr) {
+    std::cout << "Null pointer passed.  Could not create the batch.";
+    return false;
+  }
+  if (!IsSupported()) {
+    std::cerr << "ERROR: Multi-draw indirect needs OpenGL 4.3.\n";
+    return false;
+  }
+  geometry_allocator_ = geometry_allocator;
+  allocator_generation_ = geometry_allocator_->generation();
+  glGenBuffers(1, &indirect_buffer_id_);
+  glGenBuffers(1, &object_buffer_id_);
+  glGenBuffers(1, &draw_id_buffer_id_);
+  // The draw index advances once per instance, and every command draws one
+  // instance starting at its own index, so the attribute of the i-th command
+  // is i.
+  geometry_allocator_->Bind();
+  glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer_id_);
+  glVertexAttribIPointer(kDrawIdAttributeLocation, 1, GL_UNSIGNED_INT, 0,
+                         nullptr);
+  glEnableVertexAttribArray(kDrawIdAttributeLocation);
+  glVertexAttribDivisor(kDrawIdAttributeLocation, 1);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+  return true;
+}
+
+int MultiDrawBatch::Add(const int allocation_handle,
+                        const DrawObject& object) {
+  if (geometry_allocator_ == nullptr) {
+    std::cerr << "ERROR: The batch was not created.\n";
+    return -1;
+  }
+  const int index = commands_.size();
+  DrawElementsIndirectCommand command;
+  command.instance_count = 1;
+  command.base_instance = index;
+  allocation_handles_.push_back(allocation_handle);
+  commands_.push_back(command);
+  objects_.push_back(object);
+  SetCommandRanges(index);
+  commands_changed_ = true;
+  objects_changed_ = true;
+  return index;
+}
+
+void MultiDrawBatch::Clear() {
+  allocation_handles_.clear();
+  commands_.clear();
+  objects_.clear();
+  commands_changed_ = true;
+  objects_changed_ = true;
+}
+
+void MultiDrawBatch::Draw() {
+  if (geometry_allocator_ == nullptr || commands_.empty()) return;
+  Upload();
+  DrawCommands(indirect_buffer_id_, 0);
+}
+
+void MultiDrawBatch::Upload() {
+  if (geometry_allocator_ == nullptr || commands_.empty()) return;
+  if (allocator_generation_ != geometry_allocator_->generation()) {
+    for (int i = 0; i < commands_.size(); ++i) {
+      SetCommandRanges(i);
+    }
+    allocator_generation_ = geometry_allocator_->generation();
+    commands_changed_ = true;
+    objects_changed_ = true;
+  }
+  ReserveBuffers(commands_.size());
+  if (commands_changed_) {
+    // Orphans the storage of the commands too, since batches rebuilt every
+    // frame would otherwise wait for the draws of the previous one.
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_id_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 buffer_capacity_ * sizeof(commands_[0]), nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                    commands_.size() * sizeof(commands_[0]), commands_.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    commands_changed_ = false;
+  }
+  if (objects_changed_) {
+    // Orphans the storage of the objects, so that the upload does not wait
+    // for the draws of the previous frame.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, object_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 buffer_capacity_ * sizeof(objects_[0]), nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                    objects_.size() * sizeof(objects_[0]), objects_.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    objects_changed_ = false;
+  }
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kDrawObjectBinding,
+                   object_buffer_id_);
+}
+
+void MultiDrawBatch::DrawCommands(const GLuint indirect_buffer_id,
+                                  const GLuint parameter_buffer_id) {
+  if (geometry_allocator_ == nullptr || commands_.empty()) return;
+  geometry_allocator_->Bind();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_id);
+  if (parameter_buffer_id != 0) {
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, parameter_buffer_id);
+    if (GLEW_VERSION_4_6) {
+      glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                       0, commands_.size(), 0);
+    } else {
+      glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                          nullptr, 0, commands_.size(), 0);
+    }
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+  } else {
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                commands_.size(), 0);
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void MultiDrawBatch::DrawRange(const int first_draw, const int num_draws) {
+  if (geometry_allocator_ == nullptr || num_draws <= 0 ||
+      first_draw + num_draws > commands_.size()) {
+    return;
+  }
+  geometry_allocator_->Bind();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_id_);
+  glMultiDrawElementsIndirect(
+      GL_TRIANGLES, GL_UNSIGNED_INT,
+      reinterpret_cast<const GLvoid*>(first_draw * sizeof(commands_[0])),
+      num_draws, 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void MultiDrawBatch::ReserveBuffers(const int num_draws) {
+  if (num_draws <= buffer_capacity_) return;
+  buffer_capacity_ = std::max(num_draws, 2 * buffer_capacity_);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_id_);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER,
+               buffer_capacity_ * sizeof(DrawElementsIndirectCommand), nullptr,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  std::vector<GLuint> draw_ids(buffer_capacity_);
+  std::iota(draw_ids.begin(), draw_ids.end(), 0);
+  glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer_id_);
+  glBufferData(GL_ARRAY_BUFFER, draw_ids.size() * sizeof(draw_ids[0]),
+               draw_ids.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  commands_changed_ = true;
+  objects_changed_ = true;
+}
+
+void MultiDrawBatch::SetCommandRanges(const int index) {
+  const GeometryAllocation& allocation =
+      geometry_allocator_->allocation(allocation_handles_[index]);
+  DrawElementsIndirectCommand& command = commands_[index];
+  command.count = allocation.num_indices;
+  command.first_index = allocation.first_index;
+  command.base_vertex = allocation.base_vertex;
+  std::copy(allocation.bounding_sphere, allocation.bounding_sphere + 4,
+            objects_[index].bounding_sphere);
+}
+
+}  // namespace wvu
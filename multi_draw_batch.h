@@ -0,0 +1,205 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef MULTI_DRAW_BATCH_H_
+#define MULTI_DRAW_BATCH_H_
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "geometry_allocator.h"
+
+namespace wvu {
+// GLSL declaration of the shader storage buffer holding the objects of a
+// multi-draw batch (see wvu::DrawObject), for shaders of version 430.
+extern const char kDrawObjectShaderSource[];
+// GLSL declaration of the index of the draw, for vertex shaders of version 430.
+// GetDrawObject() returns the object of the draw being processed. Must follow
+// kDrawObjectShaderSource.
+extern const char kMultiDrawShaderSource[];
+
+// Shader storage buffer binding of the objects of a multi-draw batch.
+constexpr GLuint kDrawObjectBinding = 0;
+// Attribute location of the index of the draw.
+constexpr GLuint kDrawIdAttributeLocation = 9;
+
+// Per-object data read by the shaders from a shader storage buffer, laid out
+// following the std430 rules.
+struct DrawObject {
+  // Model matrix in column-major order.
+  GLfloat model_matrix[16];
+  // RGBA color that multiplies the sampled texel.
+  GLfloat tint[4];
+  // Scale (x, y) and offset (z, w) of the texture coordinates within the
+  // layer (see wvu::TextureRegion).
+  GLfloat texture_transform[4];
+  // Bounding sphere of the mesh in model space. Set by the batch from the
+  // allocation of the draw.
+  GLfloat bounding_sphere[4];
+  // Layer of the texture to sample from.
+  GLfloat texture_layer;
+  // The size of a std430 struct is a multiple of its largest alignment, 16
+  // bytes.
+  GLfloat padding[3];
+};
+
+// Draw command read by glMultiDrawElementsIndirect(), as defined by OpenGL.
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+};
+
+// Draws many objects whose meshes live in a geometry allocator with a single
+// glMultiDrawElementsIndirect() call. Each object is a draw command in an
+// indirect buffer and a wvu::DrawObject in a shader storage buffer. The base
+// instance of the i-th command is i, and the VAO of the allocator feeds a
+// per-instance attribute holding 0, 1, 2, ... at kDrawIdAttributeLocation, so
+// the vertex shader reads the index of its draw there (gl_DrawID needs GLSL
+// 4.60) and fetches its object with it. Requires OpenGL 4.3, see
+// IsSupported().
+//
+// Example:
+//
+// wvu::MultiDrawBatch batch;
+// batch.Create(&geometry_allocator);
+// for (...) {
+//   batch.Add(cube, draw_object);
+// }
+// while (...) {  // Rendering loop.
+//   ...  // Update the objects through batch.mutable_object(i).
+//   shader_program.Use();
+//   batch.Draw();
+// }
+class MultiDrawBatch {
+ public:
+  MultiDrawBatch();
+  ~MultiDrawBatch();
+
+  // Returns true if the driver supports multi-draw indirect, shader storage
+  // buffers and base instances.
+  static bool IsSupported();
+
+  // Creates the buffers and attaches the draw indices to the VAO of the
+  // allocator, which must outlive the batch. Returns false if multi-draw is
+  // not supported.
+  bool Create(GeometryAllocator* geometry_allocator);
+
+  // Adds a draw of an allocation of the allocator. Returns the index of the
+  // draw.
+  int Add(const int allocation_handle, const DrawObject& object);
+
+  // Removes every draw.
+  void Clear();
+
+  // Returns the object of a draw, to update it. The objects are uploaded by
+  // the next Draw().
+  DrawObject* mutable_object(const int index) {
+    objects_changed_ = true;
+    return &objects_[index];
+  }
+
+  // Uploads the objects and the commands if they changed, and draws every
+  // object with one call. The shader program must be in use.
+  void Draw();
+
+  // Uploads the objects and the commands if they changed, and binds the
+  // objects to kDrawObjectBinding. Draw() calls it; call it directly to
+  // process the commands on the GPU before drawing them (see
+  // wvu::GpuFrustumCuller).
+  void Upload();
+
+  // Draws the commands [first_draw, first_draw + num_draws) of the batch with
+  // one call, with the objects bound by Upload(). Lets the caller bind a
+  // different texture for each range of draws. The shader program must be in
+  // use.
+  void DrawRange(const int first_draw, const int num_draws);
+
+  // Draws the commands of an indirect buffer laid out like the one of the
+  // batch, with the objects bound by Upload(). If parameter_buffer_id is not
+  // 0, the number of commands is read from the first GLuint of that buffer
+  // (glMultiDrawElementsIndirectCount(), see IsIndirectCountSupported());
+  // otherwise num_draws() commands are drawn. The shader program must be in
+  // use.
+  void DrawCommands(const GLuint indirect_buffer_id,
+                    const GLuint parameter_buffer_id);
+
+  // Returns true if the driver can read the number of commands from a buffer.
+  static bool IsIndirectCountSupported();
+
+  // Returns the indirect buffer holding the commands of the batch.
+  GLuint indirect_buffer_id() const {
+    return indirect_buffer_id_;
+  }
+
+  // Returns the number of draws.
+  int num_draws() const {
+    return commands_.size();
+  }
+
+ private:
+  // Grows the buffers to hold the draws, and fills the draw indices.
+  void ReserveBuffers(const int num_draws);
+  // Sets the ranges of a command to the ones of its allocation.
+  void SetCommandRanges(const int index);
+
+  GeometryAllocator* geometry_allocator_;
+  // Allocation drawn by each command.
+  std::vector<int> allocation_handles_;
+  std::vector<DrawElementsIndirectCommand> commands_;
+  std::vector<DrawObject> objects_;
+  // Indirect buffer of the commands, shader storage buffer of the objects, and
+  // vertex buffer of the draw indices.
+  GLuint indirect_buffer_id_;
+  GLuint object_buffer_id_;
+  GLuint draw_id_buffer_id_;
+  // Number of draws the buffers can hold.
+  int buffer_capacity_;
+  // True if the commands or the objects changed since they were uploaded.
+  bool commands_changed_;
+  bool objects_changed_;
+  // Generation of the allocator when the commands were built.
+  int allocator_generation_;
+
+  MultiDrawBatch(const MultiDrawBatch&) = delete;
+  MultiDrawBatch& operator=(const MultiDrawBatch&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // MULTI_DRAW_BATCH_H_
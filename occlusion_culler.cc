@@ -0,0 +1,556 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+
+#include "cpu_features.h"
+#include "mesh.h"
+#include "model.h"
+
+namespace wvu {
+namespace {
+
+// Clip-space w below which a vertex is treated as on the camera plane.
+constexpr float kMinClipW = 1e-5f;
+// Minimum work per thread, below which fewer threads are used.
+constexpr int kMinRowsPerThread = 8;
+constexpr int kMinCandidatesPerThread = 1024;
+
+// Triangle in screen space: the pixel coordinates of its vertices, from the
+// bottom left corner of the screen, and their depth in [0, 1].
+struct ScreenTriangle {
+  float x[3];
+  float y[3];
+  float z[3];
+};
+
+// Edge functions and depth plane of a triangle, and the pixels it may cover.
+// The center (x, y) of a pixel is inside the triangle when
+// edge_a[i] * x + edge_b[i] * y + edge_c[i] >= 0 for the three edges, and its
+// depth is then depth_x * x + depth_y * y + depth_c.
+struct TriangleSetup {
+  float edge_a[3];
+  float edge_b[3];
+  float edge_c[3];
+  float depth_x;
+  float depth_y;
+  float depth_c;
+  int min_x;
+  int max_x;
+  int min_y;
+  int max_y;
+};
+
+// Returns the milliseconds elapsed since start.
+double ComputeElapsedMs(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Returns the number of threads to use for num_items items, given the
+// minimum number of items per thread.
+int ComputeNumWorkers(const int num_threads,
+                      const int num_items,
+                      const int min_items_per_thread) {
+  return std::max(1, std::min(num_threads, num_items / min_items_per_thread));
+}
+
+// Clips the triangle against the near plane (z >= -w in clip space), and
+// appends the triangles of the clipped polygon, in screen space, to the
+// list. Triangles outside one of the side planes are dropped.
+void ClipAndProjectTriangle(const Eigen::Vector4f clip[3],
+                            const int width,
+                            const int height,
+                            std::vector<ScreenTriangle>* triangles) {
+  for (int axis = 0; axis < 2; ++axis) {
+    if ((clip[0][axis] > clip[0].w() && clip[1][axis] > clip[1].w() &&
+         clip[2][axis] > clip[2].w()) ||
+        (clip[0][axis] < -clip[0].w() && clip[1][axis] < -clip[1].w() &&
+         clip[2][axis] < -clip[2].w())) {
+      return;
+    }
+  }
+  // Clipping a triangle against a plane leaves at most four vertices.
+  Eigen::Vector4f polygon[4];
+  int num_vertices = 0;
+  for (int i = 0; i < 3; ++i) {
+    const Eigen::Vector4f& a = clip[i];
+    const Eigen::Vector4f& b = clip[(i + 1) % 3];
+    const float distance_a = a.z() + a.w();
+    const float distance_b = b.z() + b.w();
+    if (distance_a >= 0.0f) {
+      polygon[num_vertices++] = a;
+    }
+    if ((distance_a >= 0.0f) != (distance_b >= 0.0f)) {
+      polygon[num_vertices++] =
+          a + (b - a) * (distance_a / (distance_a - distance_b));
+    }
+  }
+  if (num_vertices < 3) {
+    return;
+  }
+  float x[4];
+  float y[4];
+  float z[4];
+  for (int i = 0; i < num_vertices; ++i) {
+    const float inverse_w = 1.0f / std::max(polygon[i].w(), kMinClipW);
+    x[i] = (0.5f * polygon[i].x() * inverse_w + 0.5f) * width;
+    y[i] = (0.5f * polygon[i].y() * inverse_w + 0.5f) * height;
+    z[i] = 0.5f * polygon[i].z() * inverse_w + 0.5f;
+  }
+  for (int i = 1; i + 1 < num_vertices; ++i) {
+    const int vertices[3] = { 0, i, i + 1 };
+    ScreenTriangle triangle;
+    for (int k = 0; k < 3; ++k) {
+      triangle.x[k] = x[vertices[k]];
+      triangle.y[k] = y[vertices[k]];
+      triangle.z[k] = z[vertices[k]];
+    }
+    triangles->push_back(triangle);
+  }
+}
+
+// Computes the edge functions and the depth plane of the triangle, oriented
+// so that the inside is positive whatever the winding. Returns false if the
+// triangle is degenerate or covers no pixel.
+bool SetupTriangle(const ScreenTriangle& triangle,
+                   const int width,
+                   const int height,
+                   TriangleSetup* setup) {
+  const float* x = triangle.x;
+  const float* y = triangle.y;
+  const float signed_area =
+      (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  if (std::fabs(signed_area) < 1e-6f) {
+    return false;
+  }
+  const float sign = signed_area > 0.0f ? 1.0f : -1.0f;
+  for (int i = 0; i < 3; ++i) {
+    const int j = (i + 1) % 3;
+    setup->edge_a[i] = sign * (y[i] - y[j]);
+    setup->edge_b[i] = sign * (x[j] - x[i]);
+    setup->edge_c[i] = sign * (x[i] * y[j] - x[j] * y[i]);
+  }
+  // The edge i is opposite to the vertex (i + 2) % 3, and divided by the area
+  // it gives the barycentric coordinate of that vertex.
+  const float inverse_area = 1.0f / std::fabs(signed_area);
+  const float* z = triangle.z;
+  setup->depth_x = (setup->edge_a[0] * z[2] + setup->edge_a[1] * z[0] +
+                    setup->edge_a[2] * z[1]) * inverse_area;
+  setup->depth_y = (setup->edge_b[0] * z[2] + setup->edge_b[1] * z[0] +
+                    setup->edge_b[2] * z[1]) * inverse_area;
+  // The depth is biased to the farthest point of the pixel, since the pixel
+  // center may be nearer than the rest of the pixel.
+  setup->depth_c = (setup->edge_c[0] * z[2] + setup->edge_c[1] * z[0] +
+                    setup->edge_c[2] * z[1]) * inverse_area +
+      0.5f * (std::fabs(setup->depth_x) + std::fabs(setup->depth_y));
+  setup->min_x = std::max(
+      0, static_cast<int>(std::floor(std::min(x[0], std::min(x[1], x[2])))));
+  setup->max_x = std::min(
+      width - 1,
+      static_cast<int>(std::ceil(std::max(x[0], std::max(x[1], x[2])))));
+  setup->min_y = std::max(
+      0, static_cast<int>(std::floor(std::min(y[0], std::min(y[1], y[2])))));
+  setup->max_y = std::min(
+      height - 1,
+      static_cast<int>(std::ceil(std::max(y[0], std::max(y[1], y[2])))));
+  return setup->min_x <= setup->max_x && setup->min_y <= setup->max_y;
+}
+
+// Rasterizes the rows [row_begin, row_end) of the triangles, keeping the
+// nearest depth of every pixel.
+void RasterizeRowsScalar(const std::vector<TriangleSetup>& setups,
+                         const int width,
+                         const int row_begin,
+                         const int row_end,
+                         float* depth_buffer) {
+  for (const TriangleSetup& setup : setups) {
+    const int first_row = std::max(setup.min_y, row_begin);
+    const int last_row = std::min(setup.max_y, row_end - 1);
+    for (int row = first_row; row <= last_row; ++row) {
+      const float center_y = row + 0.5f;
+      float* depth_row = depth_buffer + row * width;
+      for (int column = setup.min_x; column <= setup.max_x; ++column) {
+        const float center_x = column + 0.5f;
+        bool inside = true;
+        for (int i = 0; i < 3; ++i) {
+          inside = inside && setup.edge_a[i] * center_x +
+              setup.edge_b[i] * center_y + setup.edge_c[i] >= 0.0f;
+        }
+        if (inside) {
+          const float depth = setup.depth_x * center_x +
+              setup.depth_y * center_y + setup.depth_c;
+          depth_row[column] = std::min(depth_row[column], depth);
+        }
+      }
+    }
+  }
+}
+
+#ifdef WVU_X86
+// Same as RasterizeRowsScalar() with 4 pixels per iteration. The width must
+// be a multiple of 4; the pixels of a group outside the triangle are masked
+// by the edge functions.
+__attribute__((target("sse2")))
+void RasterizeRowsSse(const std::vector<TriangleSetup>& setups,
+                      const int width,
+                      const int row_begin,
+                      const int row_end,
+                      float* depth_buffer) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  for (const TriangleSetup& setup : setups) {
+    const int first_row = std::max(setup.min_y, row_begin);
+    const int last_row = std::min(setup.max_y, row_end - 1);
+    const int first_column = setup.min_x & ~3;
+    __m128 edge_a[3];
+    for (int i = 0; i < 3; ++i) {
+      edge_a[i] = _mm_set1_ps(setup.edge_a[i]);
+    }
+    const __m128 depth_x = _mm_set1_ps(setup.depth_x);
+    for (int row = first_row; row <= last_row; ++row) {
+      const float center_y = row + 0.5f;
+      // Edge functions and depth at x = 0 on the row.
+      __m128 edge_row[3];
+      for (int i = 0; i < 3; ++i) {
+        edge_row[i] =
+            _mm_set1_ps(setup.edge_b[i] * center_y + setup.edge_c[i]);
+      }
+      const __m128 depth_row =
+          _mm_set1_ps(setup.depth_y * center_y + setup.depth_c);
+      float* depth_pixels = depth_buffer + row * width;
+      for (int column = first_column; column <= setup.max_x; column += 4) {
+        const __m128 center_x =
+            _mm_add_ps(_mm_set1_ps(static_cast<float>(column)), lane_offsets);
+        __m128 inside = _mm_cmpge_ps(
+            _mm_add_ps(_mm_mul_ps(edge_a[0], center_x), edge_row[0]), zero);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(
+            _mm_mul_ps(edge_a[1], center_x), edge_row[1]), zero));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(
+            _mm_mul_ps(edge_a[2], center_x), edge_row[2]), zero));
+        if (_mm_movemask_ps(inside) == 0) {
+          continue;
+        }
+        const __m128 depth =
+            _mm_add_ps(_mm_mul_ps(depth_x, center_x), depth_row);
+        const __m128 old_depth = _mm_loadu_ps(depth_pixels + column);
+        const __m128 new_depth = _mm_min_ps(old_depth, depth);
+        _mm_storeu_ps(depth_pixels + column,
+                      _mm_or_ps(_mm_and_ps(inside, new_depth),
+                                _mm_andnot_ps(inside, old_depth)));
+      }
+    }
+  }
+}
+#endif
+
+// Rasterizes the rows with the widest SIMD instructions the processor
+// supports.
+void RasterizeRows(const std::vector<TriangleSetup>& setups,
+                   const int width,
+                   const int row_begin,
+                   const int row_end,
+                   float* depth_buffer) {
+#ifdef WVU_X86
+  if (CpuHasSse2()) {
+    RasterizeRowsSse(setups, width, row_begin, row_end, depth_buffer);
+    return;
+  }
+#endif
+  RasterizeRowsScalar(setups, width, row_begin, row_end, depth_buffer);
+}
+
+}  // namespace
+
+OcclusionCuller::OcclusionCuller(const int width,
+                                 const int height,
+                                 const int num_threads)
+    : width_((std::max(4, width) + 3) & ~3),
+      height_(std::max(1, height)),
+      num_threads_(num_threads),
+      max_occluders_(16),
+      min_occluder_size_(0.05f),
+      view_projection_(Eigen::Matrix4f::Identity()) {
+  if (num_threads_ <= 0) {
+    num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+  int level_width = width_;
+  int level_height = height_;
+  while (true) {
+    level_widths_.push_back(level_width);
+    level_heights_.push_back(level_height);
+    if (level_width == 1 && level_height == 1) {
+      break;
+    }
+    level_width = (level_width + 1) / 2;
+    level_height = (level_height + 1) / 2;
+  }
+  pyramid_.resize(level_widths_.size());
+  for (int level = 0; level < pyramid_.size(); ++level) {
+    pyramid_[level].assign(level_widths_[level] * level_heights_[level],
+                           1.0f);
+  }
+  stats_.num_occluders = 0;
+  stats_.num_occluder_triangles = 0;
+  stats_.num_tested = 0;
+  stats_.num_occluded = 0;
+  stats_.num_frames = 0;
+  stats_.total_tested = 0;
+  stats_.total_occluded = 0;
+  stats_.raster_time_ms = 0.0;
+  stats_.test_time_ms = 0.0;
+}
+
+const std::vector<Model*>& OcclusionCuller::Cull(
+    const Eigen::Matrix4f& view_projection,
+    const std::vector<Model*>& candidates) {
+  SelectOccluders(view_projection, candidates);
+  RenderOccluders(view_projection, occluders_);
+
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  const int num_candidates = candidates.size();
+  visible_.resize(num_candidates);
+  const std::function<void(int, int)> test_candidates =
+      [&](const int begin, const int end) {
+        for (int i = begin; i < end; ++i) {
+          visible_[i] = IsOccluded(candidates[i]) ? 0 : 1;
+        }
+      };
+  const int num_workers = ComputeNumWorkers(num_threads_, num_candidates,
+                                            kMinCandidatesPerThread);
+  std::vector<std::thread> workers;
+  for (int worker = 1; worker < num_workers; ++worker) {
+    workers.push_back(std::thread(
+        test_candidates, worker * num_candidates / num_workers,
+        (worker + 1) * num_candidates / num_workers));
+  }
+  test_candidates(0, num_candidates / num_workers);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  visible_models_.clear();
+  for (int i = 0; i < num_candidates; ++i) {
+    if (visible_[i]) {
+      visible_models_.push_back(candidates[i]);
+    }
+  }
+  stats_.test_time_ms = ComputeElapsedMs(start);
+  stats_.num_tested = num_candidates;
+  stats_.num_occluded = num_candidates - visible_models_.size();
+  ++stats_.num_frames;
+  stats_.total_tested += stats_.num_tested;
+  stats_.total_occluded += stats_.num_occluded;
+  return visible_models_;
+}
+
+// The triangles are transformed, clipped and set up once, and every thread
+// rasterizes all of them into its band of rows.
+void OcclusionCuller::RenderOccluders(const Eigen::Matrix4f& view_projection,
+                                      const std::vector<Model*>& occluders) {
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  view_projection_ = view_projection;
+  stats_.num_occluder_triangles = 0;
+  std::vector<ScreenTriangle> triangles;
+  std::vector<Eigen::Vector4f> clip_vertices;
+  for (Model* occluder : occluders) {
+    const Eigen::Matrix4f matrix =
+        view_projection * occluder->ComputeModelMatrix();
+    const Eigen::MatrixXf& vertices = occluder->mesh()->vertices();
+    const std::vector<GLuint>& indices = occluder->mesh()->indices();
+    clip_vertices.resize(vertices.cols());
+    for (int i = 0; i < vertices.cols(); ++i) {
+      clip_vertices[i] = matrix.leftCols<3>() * vertices.col(i).head<3>() +
+          matrix.col(3);
+    }
+    for (int i = 0; i + 2 < indices.size(); i += 3) {
+      const Eigen::Vector4f clip[3] = { clip_vertices[indices[i]],
+                                        clip_vertices[indices[i + 1]],
+                                        clip_vertices[indices[i + 2]] };
+      ClipAndProjectTriangle(clip, width_, height_, &triangles);
+    }
+    stats_.num_occluder_triangles += indices.size() / 3;
+  }
+  std::vector<TriangleSetup> setups;
+  setups.reserve(triangles.size());
+  for (const ScreenTriangle& triangle : triangles) {
+    TriangleSetup setup;
+    if (SetupTriangle(triangle, width_, height_, &setup)) {
+      setups.push_back(setup);
+    }
+  }
+
+  float* depth_buffer = pyramid_[0].data();
+  std::fill(pyramid_[0].begin(), pyramid_[0].end(), 1.0f);
+  const int num_bands =
+      ComputeNumWorkers(num_threads_, height_, kMinRowsPerThread);
+  std::vector<std::thread> workers;
+  for (int band = 1; band < num_bands; ++band) {
+    workers.push_back(std::thread(
+        RasterizeRows, std::cref(setups), width_, band * height_ / num_bands,
+        (band + 1) * height_ / num_bands, depth_buffer));
+  }
+  RasterizeRows(setups, width_, 0, height_ / num_bands, depth_buffer);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  // Every texel of a level keeps the farthest depth of the 2x2 texels below
+  // it; the last row or column of an odd level is repeated.
+  for (int level = 1; level < pyramid_.size(); ++level) {
+    const std::vector<float>& source = pyramid_[level - 1];
+    const int source_width = level_widths_[level - 1];
+    const int source_height = level_heights_[level - 1];
+    std::vector<float>& destination = pyramid_[level];
+    for (int y = 0; y < level_heights_[level]; ++y) {
+      const int y0 = 2 * y;
+      const int y1 = std::min(2 * y + 1, source_height - 1);
+      for (int x = 0; x < level_widths_[level]; ++x) {
+        const int x0 = 2 * x;
+        const int x1 = std::min(2 * x + 1, source_width - 1);
+        destination[y * level_widths_[level] + x] = std::max(
+            std::max(source[y0 * source_width + x0],
+                     source[y0 * source_width + x1]),
+            std::max(source[y1 * source_width + x0],
+                     source[y1 * source_width + x1]));
+      }
+    }
+  }
+  stats_.num_occluders = occluders.size();
+  stats_.raster_time_ms = ComputeElapsedMs(start);
+}
+
+bool OcclusionCuller::IsOccluded(Model* model) const {
+  const Eigen::Matrix4f matrix =
+      view_projection_ * model->ComputeModelMatrix();
+  const MeshBounds& bounds = model->mesh()->bounds();
+  float min_x = std::numeric_limits<float>::max();
+  float max_x = -std::numeric_limits<float>::max();
+  float min_y = std::numeric_limits<float>::max();
+  float max_y = -std::numeric_limits<float>::max();
+  float min_depth = std::numeric_limits<float>::max();
+  for (int corner = 0; corner < 8; ++corner) {
+    const Eigen::Vector4f point(
+        (corner & 1) ? bounds.box_max.x() : bounds.box_min.x(),
+        (corner & 2) ? bounds.box_max.y() : bounds.box_min.y(),
+        (corner & 4) ? bounds.box_max.z() : bounds.box_min.z(), 1.0f);
+    const Eigen::Vector4f clip = matrix * point;
+    // A box crossing the near plane is not tested.
+    if (clip.w() <= kMinClipW || clip.z() < -clip.w()) {
+      return false;
+    }
+    const float inverse_w = 1.0f / clip.w();
+    const float x = (0.5f * clip.x() * inverse_w + 0.5f) * width_;
+    const float y = (0.5f * clip.y() * inverse_w + 0.5f) * height_;
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+    min_depth = std::min(min_depth, 0.5f * clip.z() * inverse_w + 0.5f);
+  }
+  // Boxes off the screen are left to the frustum culling.
+  if (max_x < 0.0f || max_y < 0.0f || min_x >= width_ || min_y >= height_) {
+    return false;
+  }
+  // The occluders cover the pixels whose center they cover, which may be
+  // partly uncovered along their silhouette; the rectangle grows by a pixel
+  // so that it reaches past the silhouette into an uncovered pixel.
+  const int x0 = std::max(0, static_cast<int>(std::floor(min_x)) - 1);
+  const int y0 = std::max(0, static_cast<int>(std::floor(min_y)) - 1);
+  const int x1 = std::min(width_ - 1, static_cast<int>(max_x) + 1);
+  const int y1 = std::min(height_ - 1, static_cast<int>(max_y) + 1);
+  // Finds the finest level where the rectangle covers at most 3x3 texels.
+  int level = 0;
+  while (level + 1 < pyramid_.size() &&
+         ((x1 >> level) - (x0 >> level) > 2 ||
+          (y1 >> level) - (y0 >> level) > 2)) {
+    ++level;
+  }
+  const std::vector<float>& depths = pyramid_[level];
+  const int level_width = level_widths_[level];
+  float max_depth = 0.0f;
+  for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+    for (int x = x0 >> level; x <= (x1 >> level); ++x) {
+      max_depth = std::max(max_depth, depths[y * level_width + x]);
+    }
+  }
+  return min_depth > max_depth;
+}
+
+// The occluders are the models whose bounding sphere looks the largest from
+// the camera: the ratio of its radius to its distance along the view
+// direction, which is the clip-space w of its center.
+void OcclusionCuller::SelectOccluders(const Eigen::Matrix4f& view_projection,
+                                      const std::vector<Model*>& candidates) {
+  std::vector<std::pair<float, Model*> > sizes;
+  for (Model* candidate : candidates) {
+    const MeshBounds& bounds = candidate->mesh()->bounds();
+    const Eigen::Matrix4f model_matrix = candidate->ComputeModelMatrix();
+    const Eigen::Vector3f center =
+        model_matrix.topLeftCorner<3, 3>() * bounds.sphere_center +
+        model_matrix.topRightCorner<3, 1>();
+    const float distance = view_projection.row(3).head<3>().dot(center) +
+        view_projection(3, 3);
+    const float size = bounds.sphere_radius / std::max(distance, kMinClipW);
+    if (size >= min_occluder_size_) {
+      sizes.push_back(std::make_pair(size, candidate));
+    }
+  }
+  const int num_occluders =
+      std::min<int>(std::max(0, max_occluders_), sizes.size());
+  std::partial_sort(sizes.begin(), sizes.begin() + num_occluders, sizes.end(),
+                    [](const std::pair<float, Model*>& a,
+                       const std::pair<float, Model*>& b) {
+                      return a.first > b.first;
+                    });
+  occluders_.clear();
+  for (int i = 0; i < num_occluders; ++i) {
+    occluders_.push_back(sizes[i].second);
+  }
+}
+
+}  // namespace wvu
@@ -0,0 +1,180 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef OCCLUSION_CULLER_H_
+#define OCCLUSION_CULLER_H_
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "model.h"
+
+namespace wvu {
+// Culls the models hidden behind nearer geometry on the CPU. A few large
+// models near the camera, the occluders, are rasterized into a small depth
+// buffer, and a pyramid of the farthest depth of each 2x2 block is built over
+// it (a hierarchical Z buffer). The world-space bounding box of every
+// candidate is projected to the screen, and the candidate is occluded when
+// its nearest depth is farther than the farthest depth of the pyramid texels
+// under its screen rectangle. The texel level is chosen so that at most 3x3
+// texels are read per candidate.
+//
+// The depth buffer is split into bands of rows rasterized by separate
+// threads, four pixels at a time with SSE2 where available, and the
+// candidates are tested by the same number of threads. Occluders must be
+// closed meshes, since the whole of their triangles is drawn as solid depth.
+//
+// Example:
+//
+// wvu::OcclusionCuller occlusion_culler(256, 128, 0);
+// while (...) {  // Rendering loop.
+//   const std::vector<Model*>& in_frustum = ...;  // E.g., a FrustumCuller.
+//   for (Model* model :
+//        occlusion_culler.Cull(projection * view, in_frustum)) {
+//     model->Draw(shader_program);
+//   }
+// }
+class OcclusionCuller {
+ public:
+  // Statistics of the culler.
+  struct Stats {
+    // Number of occluders and of their triangles drawn by the last call to
+    // Cull() or RenderOccluders().
+    int num_occluders;
+    int num_occluder_triangles;
+    // Number of candidates tested and found occluded by the last call to
+    // Cull().
+    int num_tested;
+    int num_occluded;
+    // Number of calls to Cull(), and sums of the counts over them.
+    int num_frames;
+    long long total_tested;
+    long long total_occluded;
+    // Time spent by the last call rasterizing the occluders and building the
+    // pyramid, and testing the candidates.
+    double raster_time_ms;
+    double test_time_ms;
+  };
+
+  // Params:
+  //   width, height  Size of the depth buffer. The width is rounded up to a
+  //     multiple of 4.
+  //   num_threads  Number of threads rasterizing and testing. When zero, one
+  //     per hardware thread is used.
+  OcclusionCuller(const int width, const int height, const int num_threads);
+
+  // Selects the occluders among the candidates, rasterizes them, and returns
+  // the candidates that are not occluded, in their original order. The
+  // returned vector is valid until the next call.
+  // Params:
+  //   view_projection  The projection matrix times the view matrix.
+  //   candidates  The models to test, usually the ones in the view frustum.
+  //     They must have a mesh.
+  const std::vector<Model*>& Cull(const Eigen::Matrix4f& view_projection,
+                                  const std::vector<Model*>& candidates);
+
+  // Clears the depth buffer, rasterizes the meshes of the occluders into it,
+  // and builds the depth pyramid.
+  // Params:
+  //   view_projection  The projection matrix times the view matrix.
+  //   occluders  The models to rasterize.
+  void RenderOccluders(const Eigen::Matrix4f& view_projection,
+                       const std::vector<Model*>& occluders);
+
+  // Returns true if the bounding box of the model is behind the occluders
+  // drawn by the last call to RenderOccluders().
+  bool IsOccluded(Model* model) const;
+
+  // Sets the maximum number of occluders selected by Cull(), the largest on
+  // screen first. The default is 16.
+  void set_max_occluders(const int max_occluders) {
+    max_occluders_ = max_occluders;
+  }
+
+  // Sets the ratio of the bounding sphere radius of a model to its distance
+  // from the camera above which Cull() selects it as an occluder. The default
+  // is 0.05.
+  void set_min_occluder_size(const float min_occluder_size) {
+    min_occluder_size_ = min_occluder_size;
+  }
+
+  // Returns the depth buffer, row by row from the bottom of the screen. The
+  // depth goes from 0 on the near plane to 1 on the far plane.
+  const std::vector<float>& depth_buffer() const {
+    return pyramid_[0];
+  }
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  // Returns the statistics of the culler.
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  // Picks the occluders among the candidates.
+  void SelectOccluders(const Eigen::Matrix4f& view_projection,
+                       const std::vector<Model*>& candidates);
+
+  int width_;
+  int height_;
+  int num_threads_;
+  int max_occluders_;
+  float min_occluder_size_;
+  // View-projection matrix of the last RenderOccluders().
+  Eigen::Matrix4f view_projection_;
+  // Levels of the depth pyramid; level 0 is the depth buffer. Each level
+  // halves the size of the previous one, rounding up.
+  std::vector<std::vector<float> > pyramid_;
+  std::vector<int> level_widths_;
+  std::vector<int> level_heights_;
+  // Occluders selected by the last call to Cull().
+  std::vector<Model*> occluders_;
+  // Result of the test of each candidate: 1 if not occluded.
+  std::vector<unsigned char> visible_;
+  std::vector<Model*> visible_models_;
+  Stats stats_;
+};
+
+}  // namespace wvu
+
+#endif  // OCCLUSION_CULLER_H_
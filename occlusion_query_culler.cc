@@ -0,0 +1,312 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "occlusion_query_culler.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <GL/glew.h>
+
+#include "model.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Relative and absolute growth of the bounding boxes, so that the faces of
+// meshes lying on their box (e.g., cubes) do not hide the box from the query.
+constexpr float kBoxRelativeMargin = 0.01f;
+constexpr float kBoxMargin = 1e-4f;
+
+// Corners of the unit cube drawn as the bounding boxes, and its triangles.
+const GLfloat kBoxVertices[] = {
+  -1.0f, -1.0f, -1.0f,
+   1.0f, -1.0f, -1.0f,
+   1.0f,  1.0f, -1.0f,
+  -1.0f,  1.0f, -1.0f,
+  -1.0f, -1.0f,  1.0f,
+   1.0f, -1.0f,  1.0f,
+   1.0f,  1.0f,  1.0f,
+  -1.0f,  1.0f,  1.0f
+};
+const GLuint kBoxIndices[] = {
+  0, 2, 1, 0, 3, 2,
+  4, 5, 6, 4, 6, 7,
+  0, 1, 5, 0, 5, 4,
+  3, 6, 2, 3, 7, 6,
+  0, 4, 7, 0, 7, 3,
+  1, 2, 6, 1, 6, 5
+};
+constexpr int kNumBoxIndices = sizeof(kBoxIndices) / sizeof(kBoxIndices[0]);
+
+// Shaders drawing the bounding boxes. The unit cube is moved to clip space by
+// a single matrix; no color is written.
+const char kBoxVertexShaderSource[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "uniform mat4 box_transform;\n"
+    "void main() {\n"
+    "gl_Position = box_transform * vec4(position, 1.0f);\n"
+    "}\n";
+const char kBoxFragmentShaderSource[] =
+    "#version 330 core\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "color = vec4(1.0f);\n"
+    "}\n";
+
+// Returns the query target closest to GL_ANY_SAMPLES_PASSED_CONSERVATIVE that
+// the driver supports.
+GLenum SelectQueryTarget() {
+  if (GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility) {
+    return GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+  }
+  if (GLEW_VERSION_3_3 || GLEW_ARB_occlusion_query2) {
+    return GL_ANY_SAMPLES_PASSED;
+  }
+  return GL_SAMPLES_PASSED;
+}
+
+// Returns the matrix moving the unit cube onto the bounding box of the mesh,
+// grown by the margins, in model space.
+Eigen::Matrix4f ComputeBoxMatrix(const MeshBounds& bounds) {
+  const Eigen::Vector3f center = 0.5f * (bounds.box_min + bounds.box_max);
+  const Eigen::Vector3f half_size =
+      (0.5f * (1.0f + kBoxRelativeMargin)) * (bounds.box_max - bounds.box_min) +
+      Eigen::Vector3f::Constant(kBoxMargin);
+  Eigen::Matrix4f box_matrix = Eigen::Matrix4f::Identity();
+  box_matrix.diagonal().head<3>() = half_size;
+  box_matrix.col(3).head<3>() = center;
+  return box_matrix;
+}
+
+// Returns true if a corner of the unit cube moved by the matrix is behind the
+// near plane. Such boxes are not queried, since their front faces are
+// clipped.
+bool CrossesNearPlane(const Eigen::Matrix4f& box_transform) {
+  for (int corner = 0; corner < 8; ++corner) {
+    const Eigen::Vector4f clip_position =
+        box_transform * Eigen::Vector4f(kBoxVertices[3 * corner],
+                                        kBoxVertices[3 * corner + 1],
+                                        kBoxVertices[3 * corner + 2], 1.0f);
+    if (clip_position.z() < -clip_position.w()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+OcclusionQueryCuller::OcclusionQueryCuller() :
+    box_transform_location_(-1), vertex_array_object_id_(0),
+    vertex_buffer_object_id_(0), element_buffer_object_id_(0),
+    query_target_(GL_SAMPLES_PASSED), conditional_query_id_(0), frame_(0) {
+  stats_ = {0, 0, 0, 0, 0, 0, 0, 0};
+}
+
+OcclusionQueryCuller::~OcclusionQueryCuller() {
+  Clear();
+  if (vertex_array_object_id_ != 0) {
+    glDeleteVertexArrays(1, &vertex_array_object_id_);
+  }
+  if (vertex_buffer_object_id_ != 0) {
+    glDeleteBuffers(1, &vertex_buffer_object_id_);
+  }
+  if (element_buffer_object_id_ != 0) {
+    glDeleteBuffers(1, &element_buffer_object_id_);
+  }
+}
+
+bool OcclusionQueryCuller::Create(ProgramBinaryCache* binary_cache) {
+  if (vertex_array_object_id_ != 0) {
+    std::cerr << "ERROR: The occlusion query culler was already created.\n";
+    return false;
+  }
+  query_target_ = SelectQueryTarget();
+  program_.set_binary_cache(binary_cache);
+  program_.LoadVertexShaderFromString(kBoxVertexShaderSource);
+  program_.LoadFragmentShaderFromString(kBoxFragmentShaderSource);
+  std::string error_info_log;
+  if (!program_.Create(&error_info_log)) {
+    std::cerr << "ERROR: " << error_info_log << "\n";
+    return false;
+  }
+  box_transform_location_ =
+      glGetUniformLocation(program_.shader_program_id(), "box_transform");
+  glGenVertexArrays(1, &vertex_array_object_id_);
+  glGenBuffers(1, &vertex_buffer_object_id_);
+  glGenBuffers(1, &element_buffer_object_id_);
+  glBindVertexArray(vertex_array_object_id_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kBoxVertices), kBoxVertices,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object_id_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(kBoxIndices), kBoxIndices,
+               GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat),
+                        nullptr);
+  glEnableVertexAttribArray(0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return true;
+}
+
+void OcclusionQueryCuller::BeginFrame() {
+  ++frame_;
+  ++stats_.num_frames;
+  stats_.num_tested = 0;
+  stats_.num_skipped = 0;
+  stats_.num_conditional = 0;
+  stats_.num_unresolved = 0;
+  stats_.num_queries = 0;
+}
+
+bool OcclusionQueryCuller::ReadResult(const GLuint query_id,
+                                      bool* passed) const {
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(query_id, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available == GL_FALSE) {
+    return false;
+  }
+  GLuint result = 0;
+  glGetQueryObjectuiv(query_id, GL_QUERY_RESULT, &result);
+  *passed = result != 0;
+  return true;
+}
+
+bool OcclusionQueryCuller::BeginDraw(Model* model) {
+  conditional_query_id_ = 0;
+  if (model == nullptr) {
+    return false;
+  }
+  std::unordered_map<const Model*, ModelQuery>::iterator query =
+      queries_.find(model);
+  // Models without a box queried in the previous frame are drawn.
+  if (query == queries_.end() || query->second.frame != frame_ - 1) {
+    return true;
+  }
+  ++stats_.num_tested;
+  ++stats_.total_tested;
+  query->second.conditional = false;
+  bool passed = true;
+  if (ReadResult(query->second.query_id, &passed)) {
+    if (!passed) {
+      ++stats_.num_skipped;
+      ++stats_.total_skipped;
+    }
+    return passed;
+  }
+  // The GPU waits for the result, which comes from the previous frame, so it
+  // is ready long before the draw executes.
+  query->second.conditional = true;
+  ++stats_.num_conditional;
+  conditional_query_id_ = query->second.query_id;
+  glBeginConditionalRender(conditional_query_id_, GL_QUERY_WAIT);
+  return true;
+}
+
+void OcclusionQueryCuller::EndDraw() {
+  if (conditional_query_id_ != 0) {
+    glEndConditionalRender();
+    conditional_query_id_ = 0;
+  }
+}
+
+void OcclusionQueryCuller::QueryBoundingBoxes(
+    const Eigen::Matrix4f& view_projection, const std::vector<Model*>& models) {
+  if (vertex_array_object_id_ == 0) {
+    std::cerr << "ERROR: The occlusion query culler was not created.\n";
+    return;
+  }
+  program_.Use();
+  glBindVertexArray(vertex_array_object_id_);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glDepthMask(GL_FALSE);
+  glDepthFunc(GL_LEQUAL);
+  for (int i = 0; i < models.size(); ++i) {
+    Model* model = models[i];
+    ModelQuery& query = queries_[model];
+    if (query.query_id == 0) {
+      glGenQueries(1, &query.query_id);
+      query.frame = -1;
+      query.conditional = false;
+    }
+    // The results of the draws left to conditional rendering are read before
+    // the query is reused, for the statistics.
+    if (query.frame == frame_ - 1 && query.conditional) {
+      bool passed = true;
+      if (!ReadResult(query.query_id, &passed)) {
+        ++stats_.num_unresolved;
+      } else if (!passed) {
+        ++stats_.num_skipped;
+        ++stats_.total_skipped;
+      }
+    }
+    query.conditional = false;
+    const Eigen::Matrix4f box_transform =
+        view_projection * model->ComputeModelMatrix() *
+        ComputeBoxMatrix(model->mesh()->bounds());
+    if (CrossesNearPlane(box_transform)) {
+      query.frame = -1;
+      continue;
+    }
+    glUniformMatrix4fv(box_transform_location_, 1, GL_FALSE,
+                       box_transform.data());
+    glBeginQuery(query_target_, query.query_id);
+    glDrawElements(GL_TRIANGLES, kNumBoxIndices, GL_UNSIGNED_INT, nullptr);
+    glEndQuery(query_target_);
+    query.frame = frame_;
+    ++stats_.num_queries;
+  }
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glBindVertexArray(0);
+}
+
+void OcclusionQueryCuller::Clear() {
+  for (std::unordered_map<const Model*, ModelQuery>::iterator query =
+           queries_.begin(); query != queries_.end(); ++query) {
+    if (query->second.query_id != 0) {
+      glDeleteQueries(1, &query->second.query_id);
+    }
+  }
+  queries_.clear();
+}
+
+}  // namespace wvu
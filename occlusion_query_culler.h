@@ -0,0 +1,181 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef OCCLUSION_QUERY_CULLER_H_
+#define OCCLUSION_QUERY_CULLER_H_
+
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+#include <GL/glew.h>
+
+#include "model.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Skips the draws of the models hidden behind nearer geometry with hardware
+// occlusion queries. After the models of a frame are drawn, the bounding box
+// of each of them is drawn, without writing color or depth, inside an
+// occlusion query (GL_ANY_SAMPLES_PASSED_CONSERVATIVE, or the closest target
+// the driver supports). In the next frame, each model is drawn under the
+// conditional rendering of its query, so the GPU discards the draw when no
+// sample of the box passed the depth test. The results are never waited for
+// on the CPU: when a result is already available, the draw is skipped or
+// issued right away; otherwise the GPU decides.
+//
+// Since the results come from the previous frame, a model that comes into
+// view is drawn one frame late. Models without a query of the previous frame
+// (e.g., just back in the view frustum) and models whose box crosses the near
+// plane are always drawn.
+//
+// Example:
+//
+// wvu::OcclusionQueryCuller occlusion_query_culler;
+// occlusion_query_culler.Create(nullptr);
+// while (...) {  // Rendering loop.
+//   occlusion_query_culler.BeginFrame();
+//   for (Model* model : models) {
+//     if (occlusion_query_culler.BeginDraw(model)) {
+//       model->Draw(shader_program);
+//       occlusion_query_culler.EndDraw();
+//     }
+//   }
+//   occlusion_query_culler.QueryBoundingBoxes(projection * view, models);
+// }
+class OcclusionQueryCuller {
+ public:
+  // Statistics of the culler.
+  struct Stats {
+    // Number of models drawn under the query of the previous frame, and the
+    // number of them whose draw was skipped, either on the CPU or by the GPU,
+    // in the last frame.
+    int num_tested;
+    int num_skipped;
+    // Number of the tested models whose query result was not available when
+    // they were drawn, so conditional rendering decided, and the number of
+    // them whose result was still not available at the end of the frame.
+    // Whether the GPU skipped the latter is unknown.
+    int num_conditional;
+    int num_unresolved;
+    // Number of bounding boxes queried in the last frame.
+    int num_queries;
+    // Number of frames, and sums of the counts over them.
+    int num_frames;
+    long long total_tested;
+    long long total_skipped;
+  };
+
+  OcclusionQueryCuller();
+  // Deletes the queries and the bounding box geometry.
+  ~OcclusionQueryCuller();
+
+  // Builds the shader drawing the bounding boxes and creates their geometry.
+  // Returns false if the shader fails to build.
+  // Params:
+  //   binary_cache  Cache of program binaries for the shader, or null.
+  bool Create(ProgramBinaryCache* binary_cache);
+
+  // Starts a frame: the queries issued by the previous call to
+  // QueryBoundingBoxes() are used by the draws until the next call.
+  void BeginFrame();
+
+  // Returns false if the model is known to be hidden, and its draw must be
+  // skipped. Otherwise the model must be drawn and EndDraw() called; the draw
+  // may still be discarded by the GPU.
+  bool BeginDraw(Model* model);
+
+  // Ends the conditional rendering started by BeginDraw(), if any.
+  void EndDraw();
+
+  // Draws the bounding box of every model inside its query for the next
+  // frame. Must be called after drawing the models, so that the depth buffer
+  // is complete. Changes the program in use and the vertex array bound.
+  // Params:
+  //   view_projection  The projection matrix times the view matrix.
+  //   models  The models drawn in the frame. They must have a mesh.
+  void QueryBoundingBoxes(const Eigen::Matrix4f& view_projection,
+                          const std::vector<Model*>& models);
+
+  // Deletes the queries of all the models. Must be called before deleting
+  // models that were queried, since the queries are kept per model.
+  void Clear();
+
+  // Returns the target of the queries.
+  GLenum query_target() const {
+    return query_target_;
+  }
+
+  // Returns the statistics of the culler.
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  // Query of a model.
+  struct ModelQuery {
+    GLuint query_id;
+    // Frame whose bounding box the query holds, or -1 if none.
+    int frame;
+    // True if the model was drawn under conditional rendering with an
+    // unavailable result.
+    bool conditional;
+  };
+
+  // Reads the result of a query if available, without waiting. Returns true
+  // and sets passed if it is.
+  bool ReadResult(const GLuint query_id, bool* passed) const;
+
+  // Shader drawing the bounding boxes.
+  ShaderProgram program_;
+  GLint box_transform_location_;
+  // Unit cube drawn as the bounding boxes.
+  GLuint vertex_array_object_id_;
+  GLuint vertex_buffer_object_id_;
+  GLuint element_buffer_object_id_;
+  GLenum query_target_;
+  std::unordered_map<const Model*, ModelQuery> queries_;
+  // Query used by the conditional rendering in progress, or zero.
+  GLuint conditional_query_id_;
+  int frame_;
+  Stats stats_;
+
+  OcclusionQueryCuller(const OcclusionQueryCuller&) = delete;
+  OcclusionQueryCuller& operator=(const OcclusionQueryCuller&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // OCCLUSION_QUERY_CULLER_H_
@@ -0,0 +1,247 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "pixel_conversion.h"
+
+#include "cpu_features.h"
+
+namespace wvu {
+namespace {
+
+void InterleavePlanarToRgbScalar(const unsigned char* red,
+                                 const unsigned char* green,
+                                 const unsigned char* blue,
+                                 const int num_pixels,
+                                 unsigned char* rgb) {
+  for (int i = 0; i < num_pixels; ++i) {
+    rgb[3 * i] = red[i];
+    rgb[3 * i + 1] = green[i];
+    rgb[3 * i + 2] = blue[i];
+  }
+}
+
+void InterleavePlanarToRgbaScalar(const unsigned char* red,
+                                  const unsigned char* green,
+                                  const unsigned char* blue,
+                                  const unsigned char* alpha,
+                                  const int num_pixels,
+                                  unsigned char* rgba) {
+  for (int i = 0; i < num_pixels; ++i) {
+    rgba[4 * i] = red[i];
+    rgba[4 * i + 1] = green[i];
+    rgba[4 * i + 2] = blue[i];
+    rgba[4 * i + 3] = alpha == nullptr ? 255 : alpha[i];
+  }
+}
+
+#ifdef WVU_X86
+// Interleaves 16 pixels per iteration. Each 16-byte output block gathers bytes
+// from the three planes with one shuffle per plane; the shuffle masks pick the
+// byte of the plane that goes into each output byte (-1 writes a zero).
+__attribute__((target("ssse3")))
+void InterleavePlanarToRgbSsse3(const unsigned char* red,
+                                const unsigned char* green,
+                                const unsigned char* blue,
+                                const int num_pixels,
+                                unsigned char* rgb) {
+  const __m128i red_mask0 = _mm_setr_epi8(
+      0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+  const __m128i green_mask0 = _mm_setr_epi8(
+      -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+  const __m128i blue_mask0 = _mm_setr_epi8(
+      -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+  const __m128i red_mask1 = _mm_setr_epi8(
+      -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+  const __m128i green_mask1 = _mm_setr_epi8(
+      5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+  const __m128i blue_mask1 = _mm_setr_epi8(
+      -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+  const __m128i red_mask2 = _mm_setr_epi8(
+      -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+  const __m128i green_mask2 = _mm_setr_epi8(
+      -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+  const __m128i blue_mask2 = _mm_setr_epi8(
+      10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+  int i = 0;
+  for (; i + 16 <= num_pixels; i += 16) {
+    const __m128i r =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(red + i));
+    const __m128i g =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(green + i));
+    const __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(blue + i));
+    const __m128i out0 = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(r, red_mask0),
+                     _mm_shuffle_epi8(g, green_mask0)),
+        _mm_shuffle_epi8(b, blue_mask0));
+    const __m128i out1 = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(r, red_mask1),
+                     _mm_shuffle_epi8(g, green_mask1)),
+        _mm_shuffle_epi8(b, blue_mask1));
+    const __m128i out2 = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(r, red_mask2),
+                     _mm_shuffle_epi8(g, green_mask2)),
+        _mm_shuffle_epi8(b, blue_mask2));
+    __m128i* destination = reinterpret_cast<__m128i*>(rgb + 3 * i);
+    _mm_storeu_si128(destination, out0);
+    _mm_storeu_si128(destination + 1, out1);
+    _mm_storeu_si128(destination + 2, out2);
+  }
+  InterleavePlanarToRgbScalar(red + i, green + i, blue + i, num_pixels - i,
+                              rgb + 3 * i);
+}
+
+// Interleaves 16 pixels per iteration by unpacking bytes into (red, green) and
+// (blue, alpha) pairs and then pairs into pixels.
+__attribute__((target("sse2")))
+void InterleavePlanarToRgbaSse2(const unsigned char* red,
+                                const unsigned char* green,
+                                const unsigned char* blue,
+                                const unsigned char* alpha,
+                                const int num_pixels,
+                                unsigned char* rgba) {
+  const __m128i opaque = _mm_set1_epi8(-1);
+  int i = 0;
+  for (; i + 16 <= num_pixels; i += 16) {
+    const __m128i r =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(red + i));
+    const __m128i g =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(green + i));
+    const __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(blue + i));
+    const __m128i a = alpha == nullptr ? opaque :
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(alpha + i));
+    const __m128i rg_low = _mm_unpacklo_epi8(r, g);
+    const __m128i rg_high = _mm_unpackhi_epi8(r, g);
+    const __m128i ba_low = _mm_unpacklo_epi8(b, a);
+    const __m128i ba_high = _mm_unpackhi_epi8(b, a);
+    __m128i* destination = reinterpret_cast<__m128i*>(rgba + 4 * i);
+    _mm_storeu_si128(destination, _mm_unpacklo_epi16(rg_low, ba_low));
+    _mm_storeu_si128(destination + 1, _mm_unpackhi_epi16(rg_low, ba_low));
+    _mm_storeu_si128(destination + 2, _mm_unpacklo_epi16(rg_high, ba_high));
+    _mm_storeu_si128(destination + 3, _mm_unpackhi_epi16(rg_high, ba_high));
+  }
+  InterleavePlanarToRgbaScalar(red + i, green + i, blue + i,
+                               alpha == nullptr ? nullptr : alpha + i,
+                               num_pixels - i, rgba + 4 * i);
+}
+
+// AVX2 version of the function above with 32 pixels per iteration. The unpack
+// instructions work within 128-bit lanes, so the pixels come out as
+// [0-3 | 16-19], [4-7 | 20-23], ... and a final lane permutation puts them
+// back in order.
+__attribute__((target("avx2")))
+void InterleavePlanarToRgbaAvx2(const unsigned char* red,
+                                const unsigned char* green,
+                                const unsigned char* blue,
+                                const unsigned char* alpha,
+                                const int num_pixels,
+                                unsigned char* rgba) {
+  const __m256i opaque = _mm256_set1_epi8(-1);
+  int i = 0;
+  for (; i + 32 <= num_pixels; i += 32) {
+    const __m256i r =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(red + i));
+    const __m256i g =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(green + i));
+    const __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blue + i));
+    const __m256i a = alpha == nullptr ? opaque :
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(alpha + i));
+    const __m256i rg_low = _mm256_unpacklo_epi8(r, g);
+    const __m256i rg_high = _mm256_unpackhi_epi8(r, g);
+    const __m256i ba_low = _mm256_unpacklo_epi8(b, a);
+    const __m256i ba_high = _mm256_unpackhi_epi8(b, a);
+    const __m256i pixels_0_16 = _mm256_unpacklo_epi16(rg_low, ba_low);
+    const __m256i pixels_4_20 = _mm256_unpackhi_epi16(rg_low, ba_low);
+    const __m256i pixels_8_24 = _mm256_unpacklo_epi16(rg_high, ba_high);
+    const __m256i pixels_12_28 = _mm256_unpackhi_epi16(rg_high, ba_high);
+    __m256i* destination = reinterpret_cast<__m256i*>(rgba + 4 * i);
+    _mm256_storeu_si256(destination,
+                        _mm256_permute2x128_si256(pixels_0_16, pixels_4_20,
+                                                  0x20));
+    _mm256_storeu_si256(destination + 1,
+                        _mm256_permute2x128_si256(pixels_8_24, pixels_12_28,
+                                                  0x20));
+    _mm256_storeu_si256(destination + 2,
+                        _mm256_permute2x128_si256(pixels_0_16, pixels_4_20,
+                                                  0x31));
+    _mm256_storeu_si256(destination + 3,
+                        _mm256_permute2x128_si256(pixels_8_24, pixels_12_28,
+                                                  0x31));
+  }
+  InterleavePlanarToRgbaSse2(red + i, green + i, blue + i,
+                             alpha == nullptr ? nullptr : alpha + i,
+                             num_pixels - i, rgba + 4 * i);
+}
+#endif  // WVU_X86
+
+}  // namespace
+
+void InterleavePlanarToRgb(const unsigned char* red,
+                           const unsigned char* green,
+                           const unsigned char* blue,
+                           const int num_pixels,
+                           unsigned char* rgb) {
+#ifdef WVU_X86
+  if (CpuHasSsse3()) {
+    InterleavePlanarToRgbSsse3(red, green, blue, num_pixels, rgb);
+    return;
+  }
+#endif
+  InterleavePlanarToRgbScalar(red, green, blue, num_pixels, rgb);
+}
+
+void InterleavePlanarToRgba(const unsigned char* red,
+                            const unsigned char* green,
+                            const unsigned char* blue,
+                            const unsigned char* alpha,
+                            const int num_pixels,
+                            unsigned char* rgba) {
+#ifdef WVU_X86
+  if (CpuHasAvx2()) {
+    InterleavePlanarToRgbaAvx2(red, green, blue, alpha, num_pixels, rgba);
+    return;
+  }
+  if (CpuHasSse2()) {
+    InterleavePlanarToRgbaSse2(red, green, blue, alpha, num_pixels, rgba);
+    return;
+  }
+#endif
+  InterleavePlanarToRgbaScalar(red, green, blue, alpha, num_pixels, rgba);
+}
+
+}  // namespace wvu
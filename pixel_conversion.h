@@ -0,0 +1,74 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef PIXEL_CONVERSION_H_
+#define PIXEL_CONVERSION_H_
+
+namespace wvu {
+// Image loaders such as CImg store the channels of an image in separate planes
+// (all the red values, then all the green values, ...), whereas OpenGL expects
+// the channels of each pixel next to each other. The functions below interleave
+// planar channels straight into the destination buffer. They use SSSE3 or AVX2
+// when the processor supports them, and fall back to scalar code otherwise.
+// The buffers do not need any particular alignment.
+
+// Interleaves three planes into RGB pixels.
+// Params:
+//   red, green, blue  The planes, each holding num_pixels values.
+//   num_pixels  Number of pixels.
+//   rgb  Destination of 3 * num_pixels values.
+void InterleavePlanarToRgb(const unsigned char* red,
+                           const unsigned char* green,
+                           const unsigned char* blue,
+                           const int num_pixels,
+                           unsigned char* rgb);
+
+// Interleaves four planes into RGBA pixels.
+// Params:
+//   red, green, blue  The color planes, each holding num_pixels values.
+//   alpha  The alpha plane. When null, the alpha of every pixel is 255.
+//   num_pixels  Number of pixels.
+//   rgba  Destination of 4 * num_pixels values.
+void InterleavePlanarToRgba(const unsigned char* red,
+                            const unsigned char* green,
+                            const unsigned char* blue,
+                            const unsigned char* alpha,
+                            const int num_pixels,
+                            unsigned char* rgba);
+
+}  // namespace wvu
+
+#endif  // PIXEL_CONVERSION_H_
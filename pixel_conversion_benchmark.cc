@@ -0,0 +1,150 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+// Compares the interleaving of planar images done by CImg::permute_axes()
+// against the SIMD kernels of pixel_conversion.h on 4K and 8K textures.
+//
+// Usage: ./bin/pixel_conversion_benchmark
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Include CImg library.
+// The macro below disables the capabilities of displaying images in CImg.
+#define cimg_display 0
+#include <CImg.h>
+
+#include "pixel_conversion.h"
+
+namespace {
+// Number of times each conversion runs. The fastest run is reported.
+constexpr int kNumRepetitions = 5;
+
+// Returns the milliseconds elapsed since start.
+double ElapsedMilliseconds(
+    const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Prints the time and the throughput (in output gigabytes per second) of a
+// conversion.
+void PrintResult(const char* name,
+                 const double time_ms,
+                 const size_t output_size_in_bytes) {
+  std::cout << "  " << name << ": " << time_ms << " ms ("
+            << output_size_in_bytes / (time_ms * 1e6) << " GB/s)\n";
+}
+
+// Benchmarks the conversions on a random planar image of side x side pixels.
+// Returns false if the results of the conversions differ.
+bool RunBenchmark(const int side) {
+  cimg_library::CImg<unsigned char> planar_image(side, side, 1, 3);
+  planar_image.rand(0, 255);
+  const int num_pixels = side * side;
+  const unsigned char* red = planar_image.data(0, 0, 0, 0);
+  const unsigned char* green = planar_image.data(0, 0, 0, 1);
+  const unsigned char* blue = planar_image.data(0, 0, 0, 2);
+  std::cout << side << "x" << side << " RGB texture:\n";
+
+  // CImg::permute_axes() allocates the interleaved image and copies the
+  // values with a strided walk. The copy of the planar image is not timed.
+  double permute_time_ms = 1e30;
+  cimg_library::CImg<unsigned char> permuted_image;
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    permuted_image = planar_image;
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    permuted_image.permute_axes("cxyz");
+    permute_time_ms = std::min(permute_time_ms, ElapsedMilliseconds(start));
+  }
+  PrintResult("permute_axes(\"cxyz\")", permute_time_ms, 3 * num_pixels);
+
+  // The kernels write into an existing upload buffer.
+  std::vector<unsigned char> rgb(3 * num_pixels);
+  double rgb_time_ms = 1e30;
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    wvu::InterleavePlanarToRgb(red, green, blue, num_pixels, rgb.data());
+    rgb_time_ms = std::min(rgb_time_ms, ElapsedMilliseconds(start));
+  }
+  PrintResult("InterleavePlanarToRgb", rgb_time_ms, rgb.size());
+
+  std::vector<unsigned char> rgba(4 * num_pixels);
+  double rgba_time_ms = 1e30;
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    wvu::InterleavePlanarToRgba(red, green, blue, nullptr, num_pixels,
+                                rgba.data());
+    rgba_time_ms = std::min(rgba_time_ms, ElapsedMilliseconds(start));
+  }
+  PrintResult("InterleavePlanarToRgba", rgba_time_ms, rgba.size());
+  std::cout << "  Speed-up over permute_axes: "
+            << permute_time_ms / rgb_time_ms << "x (RGB), "
+            << permute_time_ms / rgba_time_ms << "x (RGBA)\n";
+
+  // Verify that all the conversions agree.
+  if (std::memcmp(permuted_image.data(), rgb.data(), rgb.size()) != 0) {
+    std::cerr << "ERROR: InterleavePlanarToRgb differs from permute_axes.\n";
+    return false;
+  }
+  for (int i = 0; i < num_pixels; ++i) {
+    if (rgba[4 * i] != rgb[3 * i] || rgba[4 * i + 1] != rgb[3 * i + 1] ||
+        rgba[4 * i + 2] != rgb[3 * i + 2] || rgba[4 * i + 3] != 255) {
+      std::cerr << "ERROR: InterleavePlanarToRgba differs from "
+                << "permute_axes.\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int kSides[] = { 4096, 8192 };
+  for (const int side : kSides) {
+    if (!RunBenchmark(side)) {
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,616 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "potentially_visible_set.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <GL/glew.h>
+
+#include "mesh.h"
+#include "model.h"
+#include "scene_bvh.h"
+
+namespace wvu {
+namespace {
+constexpr char kMagic[4] = { 'W', 'V', 'P', 'V' };
+constexpr size_t kHeaderSize = 48;
+// Bytes of an entry of the set table.
+constexpr size_t kSetEntrySize = 8;
+
+// Encodings of the sets, given by their first byte.
+enum SetEncoding : unsigned char {
+  kBitsetEncoding = 0,
+  kRunLengthEncoding = 1
+};
+
+// Model of the scene during the bake: its model matrix, its mesh, the
+// running sum of the areas of the triangles of the mesh, and its world-space
+// box.
+struct BakeModel {
+  Eigen::Matrix4f model_matrix;
+  const Mesh* mesh;
+  std::vector<float> triangle_areas;
+  Eigen::Vector3f world_min;
+  Eigen::Vector3f world_max;
+};
+
+double ComputeElapsedMs(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Computes the world-space box enclosing the bounding box of the mesh of the
+// model.
+void ComputeWorldBox(Model* model,
+                     Eigen::Vector3f* box_min,
+                     Eigen::Vector3f* box_max) {
+  const Eigen::Matrix4f model_matrix = model->ComputeModelMatrix();
+  const MeshBounds& bounds = model->mesh()->bounds();
+  const Eigen::Vector3f center = model_matrix.topLeftCorner<3, 3>() *
+      (0.5f * (bounds.box_min + bounds.box_max)) +
+      model_matrix.topRightCorner<3, 1>();
+  const Eigen::Vector3f extent = model_matrix.topLeftCorner<3, 3>().cwiseAbs() *
+      (0.5f * (bounds.box_max - bounds.box_min));
+  *box_min = center - extent;
+  *box_max = center + extent;
+}
+
+// Returns a point drawn uniformly in the box.
+Eigen::Vector3f SamplePoint(const Eigen::Vector3f& box_min,
+                            const Eigen::Vector3f& box_max,
+                            std::mt19937* generator) {
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+  const Eigen::Vector3f t(distribution(*generator), distribution(*generator),
+                          distribution(*generator));
+  return box_min + (box_max - box_min).cwiseProduct(t);
+}
+
+// Fills the running sum of the areas of the triangles of the mesh, used to
+// draw points uniformly on its surface.
+void ComputeTriangleAreas(const Mesh& mesh, std::vector<float>* areas) {
+  const Eigen::MatrixXf& vertices = mesh.vertices();
+  const std::vector<GLuint>& indices = mesh.indices();
+  areas->clear();
+  float total_area = 0.0f;
+  for (int i = 0; i + 2 < indices.size(); i += 3) {
+    const Eigen::Vector3f vertex0 = vertices.block<3, 1>(0, indices[i]);
+    const Eigen::Vector3f edge1 =
+        vertices.block<3, 1>(0, indices[i + 1]) - vertex0;
+    const Eigen::Vector3f edge2 =
+        vertices.block<3, 1>(0, indices[i + 2]) - vertex0;
+    total_area += 0.5f * edge1.cross(edge2).norm();
+    areas->push_back(total_area);
+  }
+}
+
+// Returns a point drawn uniformly on the triangles of the model, in world
+// space. The model must have a triangle of nonzero area.
+Eigen::Vector3f SampleSurfacePoint(const BakeModel& bake_model,
+                                   std::mt19937* generator) {
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+  const std::vector<float>& areas = bake_model.triangle_areas;
+  const int triangle = std::min<int>(
+      std::upper_bound(areas.begin(), areas.end(),
+                       distribution(*generator) * areas.back()) -
+          areas.begin(),
+      areas.size() - 1);
+  // Folds the unit square onto the triangle.
+  float u = distribution(*generator);
+  float v = distribution(*generator);
+  if (u + v > 1.0f) {
+    u = 1.0f - u;
+    v = 1.0f - v;
+  }
+  const Eigen::MatrixXf& vertices = bake_model.mesh->vertices();
+  const std::vector<GLuint>& indices = bake_model.mesh->indices();
+  const Eigen::Vector3f vertex0 = vertices.block<3, 1>(0, indices[3 * triangle]);
+  const Eigen::Vector3f point = vertex0 +
+      u * (vertices.block<3, 1>(0, indices[3 * triangle + 1]) - vertex0) +
+      v * (vertices.block<3, 1>(0, indices[3 * triangle + 2]) - vertex0);
+  return bake_model.model_matrix.topLeftCorner<3, 3>() * point +
+      bake_model.model_matrix.topRightCorner<3, 1>();
+}
+
+// Returns true if the point is inside the mesh of one of the models.
+bool IsInsideModels(const std::vector<BakeModel>& bake_models,
+                    const Eigen::Vector3f& point) {
+  for (const BakeModel& bake_model : bake_models) {
+    if ((point.array() < bake_model.world_min.array()).any() ||
+        (point.array() > bake_model.world_max.array()).any()) {
+      continue;
+    }
+    const Eigen::Vector3f model_point =
+        bake_model.model_matrix.topLeftCorner<3, 3>().transpose() *
+        (point - bake_model.model_matrix.topRightCorner<3, 1>());
+    if (IsInsideMesh(*bake_model.mesh, model_point)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void AppendUint32(const uint32_t value, std::vector<unsigned char>* bytes) {
+  for (int i = 0; i < 4; ++i) {
+    bytes->push_back((value >> (8 * i)) & 0xFF);
+  }
+}
+
+void AppendFloat(const float value, std::vector<unsigned char>* bytes) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  AppendUint32(bits, bytes);
+}
+
+uint32_t ReadUint32(const unsigned char* bytes) {
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+float ReadFloat(const unsigned char* bytes) {
+  const uint32_t bits = ReadUint32(bytes);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void AppendVarint(uint32_t value, std::vector<unsigned char>* bytes) {
+  while (value >= 0x80) {
+    bytes->push_back((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  bytes->push_back(value);
+}
+
+// Encodes the visibility of the models into the smaller of a bitset and the
+// lengths of the alternating runs of hidden and visible models, starting with
+// the hidden ones, after a byte with its SetEncoding.
+void EncodeSet(const std::vector<char>& visible,
+               std::vector<unsigned char>* encoded_set) {
+  encoded_set->assign(1, kRunLengthEncoding);
+  char run_value = 0;
+  uint32_t run_length = 0;
+  for (int i = 0; i < visible.size(); ++i) {
+    if (visible[i] != run_value) {
+      AppendVarint(run_length, encoded_set);
+      run_value = visible[i];
+      run_length = 0;
+    }
+    ++run_length;
+  }
+  AppendVarint(run_length, encoded_set);
+  const size_t bitset_size = 1 + (visible.size() + 7) / 8;
+  if (encoded_set->size() > bitset_size) {
+    encoded_set->assign(bitset_size, 0);
+    (*encoded_set)[0] = kBitsetEncoding;
+    for (int i = 0; i < visible.size(); ++i) {
+      if (visible[i]) {
+        (*encoded_set)[1 + i / 8] |= 1 << (i % 8);
+      }
+    }
+  }
+}
+
+// Decodes a set. Returns the number of visible models, or -1 if the set is
+// malformed or does not cover exactly the models. The visible models are
+// appended to visible_models when it is not null.
+int DecodeSet(const unsigned char* data,
+              const size_t size,
+              const std::vector<Model*>& models,
+              std::vector<Model*>* visible_models) {
+  if (size == 0) return -1;
+  int num_visible = 0;
+  if (data[0] == kBitsetEncoding) {
+    if (size != 1 + (models.size() + 7) / 8) return -1;
+    for (int i = 0; i < models.size(); ++i) {
+      if (data[1 + i / 8] & (1 << (i % 8))) {
+        if (visible_models != nullptr) {
+          visible_models->push_back(models[i]);
+        }
+        ++num_visible;
+      }
+    }
+    return num_visible;
+  }
+  if (data[0] != kRunLengthEncoding) return -1;
+  size_t position = 1;
+  size_t num_decoded = 0;
+  bool visible = false;
+  while (position < size) {
+    uint32_t run_length = 0;
+    int shift = 0;
+    unsigned char byte;
+    do {
+      if (position == size || shift > 28) return -1;
+      byte = data[position++];
+      run_length |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    if (run_length > models.size() - num_decoded) return -1;
+    if (visible) {
+      if (visible_models != nullptr) {
+        visible_models->insert(visible_models->end(),
+                               models.begin() + num_decoded,
+                               models.begin() + num_decoded + run_length);
+      }
+      num_visible += run_length;
+    }
+    num_decoded += run_length;
+    visible = !visible;
+  }
+  return num_decoded == models.size() ? num_visible : -1;
+}
+
+}  // namespace
+
+PvsBakeOptions::PvsBakeOptions() :
+    grid_min(Eigen::Vector3f::Zero()), grid_max(Eigen::Vector3f::Zero()),
+    cell_size(1.0f), max_num_cells(1 << 16), num_samples_per_cell(32),
+    num_rays_per_model(16) {}
+
+void ComputeWorldBounds(const std::vector<Model*>& models,
+                        Eigen::Vector3f* box_min,
+                        Eigen::Vector3f* box_max) {
+  if (box_min == nullptr || box_max == nullptr) {
+    std::cout << "Null pointer passed.  Could not compute the bounds.";
+    return;
+  }
+  if (models.empty()) {
+    box_min->setZero();
+    box_max->setZero();
+    return;
+  }
+  box_min->setConstant(std::numeric_limits<float>::max());
+  box_max->setConstant(std::numeric_limits<float>::lowest());
+  for (Model* model : models) {
+    Eigen::Vector3f world_min;
+    Eigen::Vector3f world_max;
+    ComputeWorldBox(model, &world_min, &world_max);
+    *box_min = box_min->cwiseMin(world_min);
+    *box_max = box_max->cwiseMax(world_max);
+  }
+}
+
+PotentiallyVisibleSet::PotentiallyVisibleSet() :
+    grid_min_(Eigen::Vector3f::Zero()), cell_size_(1.0f), last_cell_(-1) {
+  num_cells_[0] = num_cells_[1] = num_cells_[2] = 0;
+  stats_.num_cells = 0;
+  stats_.num_sets = 0;
+  stats_.set_bytes = 0;
+  stats_.visible_fraction = 0.0;
+  stats_.num_rays = 0;
+  stats_.bake_time_ms = 0.0;
+  stats_.num_lookups = 0;
+  stats_.num_decodes = 0;
+  stats_.camera_in_grid = false;
+  stats_.num_visible = 0;
+}
+
+bool PotentiallyVisibleSet::Bake(const std::vector<Model*>& models,
+                                 const PvsBakeOptions& options) {
+  if (models.empty()) {
+    std::cerr << "ERROR: No models to bake the visible sets of.\n";
+    return false;
+  }
+  if (!(options.cell_size > 0.0f) || options.max_num_cells <= 0 ||
+      options.num_samples_per_cell <= 0 || options.num_rays_per_model <= 0 ||
+      (options.grid_max.array() < options.grid_min.array()).any()) {
+    std::cerr << "ERROR: Invalid options to bake the visible sets.\n";
+    return false;
+  }
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  // The cells grow until the grid fits in max_num_cells.
+  const Eigen::Vector3f grid_size = options.grid_max - options.grid_min;
+  cell_size_ = options.cell_size;
+  while (true) {
+    double num_cells = 1.0;
+    for (int axis = 0; axis < 3; ++axis) {
+      num_cells_[axis] =
+          std::max(1, static_cast<int>(std::ceil(grid_size[axis] / cell_size_)));
+      num_cells *= num_cells_[axis];
+    }
+    if (num_cells <= options.max_num_cells) break;
+    cell_size_ *= std::max(1.01, std::cbrt(num_cells / options.max_num_cells));
+  }
+  grid_min_ = options.grid_min;
+  models_ = models;
+  cell_sets_.clear();
+  set_data_.clear();
+  set_offsets_.clear();
+  set_sizes_.clear();
+  last_cell_ = -1;
+  stats_.num_rays = 0;
+
+  std::vector<BakeModel> bake_models(models.size());
+  for (int i = 0; i < models.size(); ++i) {
+    BakeModel& bake_model = bake_models[i];
+    bake_model.model_matrix = models[i]->ComputeModelMatrix();
+    bake_model.mesh = models[i]->mesh();
+    ComputeTriangleAreas(*bake_model.mesh, &bake_model.triangle_areas);
+    ComputeWorldBox(models[i], &bake_model.world_min, &bake_model.world_max);
+  }
+  SceneBvh scene_bvh;
+  scene_bvh.Build(models);
+
+  // Cells with the same set share its entry.
+  std::unordered_map<std::string, int> set_indices;
+  std::vector<char> visible(models.size());
+  std::vector<unsigned char> encoded_set;
+  std::vector<Eigen::Vector3f> samples;
+  for (int z = 0; z < num_cells_[2]; ++z) {
+    for (int y = 0; y < num_cells_[1]; ++y) {
+      for (int x = 0; x < num_cells_[0]; ++x) {
+        const int cell = x + num_cells_[0] * (y + num_cells_[1] * z);
+        std::mt19937 generator(cell);
+        const Eigen::Vector3f cell_min =
+            grid_min_ + cell_size_ * Eigen::Vector3f(x, y, z);
+        const Eigen::Vector3f cell_max =
+            cell_min + Eigen::Vector3f::Constant(cell_size_);
+        // The models overlapping the cell can be seen from it.
+        for (int i = 0; i < models.size(); ++i) {
+          visible[i] =
+              (bake_models[i].world_min.array() <= cell_max.array()).all() &&
+              (bake_models[i].world_max.array() >= cell_min.array()).all();
+        }
+        // The rays start from points that are not inside a model.
+        samples.clear();
+        for (int attempt = 0;
+             attempt < 4 * options.num_samples_per_cell &&
+                 samples.size() < options.num_samples_per_cell;
+             ++attempt) {
+          const Eigen::Vector3f sample =
+              SamplePoint(cell_min, cell_max, &generator);
+          if (!IsInsideModels(bake_models, sample)) {
+            samples.push_back(sample);
+          }
+        }
+        std::uniform_int_distribution<int> sample_distribution(
+            0, std::max<int>(1, samples.size()) - 1);
+        for (int i = 0; i < models.size(); ++i) {
+          // A cell filled by models sees everything, since the camera can not
+          // be placed anywhere in it.
+          if (samples.empty()) {
+            visible[i] = 1;
+            continue;
+          }
+          // A mesh without area can not be hit.
+          const BakeModel& bake_model = bake_models[i];
+          if (bake_model.triangle_areas.empty() ||
+              bake_model.triangle_areas.back() <= 0.0f) {
+            continue;
+          }
+          for (int ray = 0; ray < options.num_rays_per_model && !visible[i];
+               ++ray) {
+            const Eigen::Vector3f& origin =
+                samples[sample_distribution(generator)];
+            const Eigen::Vector3f target =
+                SampleSurfacePoint(bake_model, &generator);
+            ++stats_.num_rays;
+            visible[i] = scene_bvh.RaycastTriangles(
+                origin, target - origin, nullptr) == models[i];
+          }
+        }
+        EncodeSet(visible, &encoded_set);
+        const std::string key(encoded_set.begin(), encoded_set.end());
+        std::unordered_map<std::string, int>::const_iterator set_index =
+            set_indices.find(key);
+        if (set_index == set_indices.end()) {
+          set_index = set_indices.emplace(key, set_offsets_.size()).first;
+          set_offsets_.push_back(set_data_.size());
+          set_sizes_.push_back(encoded_set.size());
+          set_data_.insert(set_data_.end(), encoded_set.begin(),
+                           encoded_set.end());
+        }
+        cell_sets_.push_back(set_index->second);
+      }
+    }
+  }
+  scene_bvh.Clear();
+  UpdateStats();
+  stats_.bake_time_ms = ComputeElapsedMs(start);
+  return true;
+}
+
+bool PotentiallyVisibleSet::Write(const std::string& filepath) const {
+  if (cell_sets_.empty()) {
+    std::cerr << "ERROR: The visible sets were not baked.\n";
+    return false;
+  }
+  std::vector<unsigned char> bytes(kMagic, kMagic + 4);
+  AppendUint32(kPotentiallyVisibleSetVersion, &bytes);
+  AppendUint32(models_.size(), &bytes);
+  for (int axis = 0; axis < 3; ++axis) {
+    AppendUint32(num_cells_[axis], &bytes);
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    AppendFloat(grid_min_[axis], &bytes);
+  }
+  AppendFloat(cell_size_, &bytes);
+  AppendUint32(set_offsets_.size(), &bytes);
+  AppendUint32(0, &bytes);
+  for (const uint32_t cell_set : cell_sets_) {
+    AppendUint32(cell_set, &bytes);
+  }
+  for (int i = 0; i < set_offsets_.size(); ++i) {
+    AppendUint32(set_offsets_[i], &bytes);
+    AppendUint32(set_sizes_[i], &bytes);
+  }
+  bytes.insert(bytes.end(), set_data_.begin(), set_data_.end());
+  std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+  file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  return file.good();
+}
+
+bool PotentiallyVisibleSet::Read(const std::string& filepath,
+                                 const std::vector<Model*>& models) {
+  std::ifstream file(filepath, std::ios::binary);
+  if (!file) return false;
+  const std::vector<unsigned char> bytes(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (bytes.size() < kHeaderSize ||
+      std::memcmp(bytes.data(), kMagic, 4) != 0 ||
+      ReadUint32(&bytes[4]) != kPotentiallyVisibleSetVersion ||
+      ReadUint32(&bytes[8]) != models.size()) {
+    return false;
+  }
+  int num_cells[3];
+  size_t total_cells = 1;
+  for (int axis = 0; axis < 3; ++axis) {
+    const uint32_t axis_cells = ReadUint32(&bytes[12 + 4 * axis]);
+    if (axis_cells == 0 || axis_cells > (1 << 16)) return false;
+    num_cells[axis] = axis_cells;
+    total_cells *= axis_cells;
+  }
+  const Eigen::Vector3f grid_min(ReadFloat(&bytes[24]), ReadFloat(&bytes[28]),
+                                 ReadFloat(&bytes[32]));
+  const float cell_size = ReadFloat(&bytes[36]);
+  const uint32_t num_sets = ReadUint32(&bytes[40]);
+  if (!std::isfinite(grid_min.sum()) || !std::isfinite(cell_size) ||
+      !(cell_size > 0.0f) || num_sets == 0 ||
+      total_cells > (bytes.size() - kHeaderSize) / 4 ||
+      num_sets > (bytes.size() - kHeaderSize - 4 * total_cells) /
+          kSetEntrySize) {
+    return false;
+  }
+  const unsigned char* cell_table = &bytes[kHeaderSize];
+  const unsigned char* set_table = cell_table + 4 * total_cells;
+  const size_t data_offset =
+      kHeaderSize + 4 * total_cells + kSetEntrySize * num_sets;
+  const size_t data_size = bytes.size() - data_offset;
+  std::vector<uint32_t> cell_sets(total_cells);
+  for (size_t cell = 0; cell < total_cells; ++cell) {
+    cell_sets[cell] = ReadUint32(cell_table + 4 * cell);
+    if (cell_sets[cell] >= num_sets) return false;
+  }
+  std::vector<uint32_t> set_offsets(num_sets);
+  std::vector<uint32_t> set_sizes(num_sets);
+  for (int set = 0; set < num_sets; ++set) {
+    set_offsets[set] = ReadUint32(set_table + kSetEntrySize * set);
+    set_sizes[set] = ReadUint32(set_table + kSetEntrySize * set + 4);
+    // The set must lie within the file and cover exactly the models.
+    if (set_offsets[set] > data_size ||
+        set_sizes[set] > data_size - set_offsets[set] ||
+        DecodeSet(&bytes[data_offset] + set_offsets[set], set_sizes[set],
+                  models, nullptr) < 0) {
+      return false;
+    }
+  }
+  grid_min_ = grid_min;
+  cell_size_ = cell_size;
+  std::copy(num_cells, num_cells + 3, num_cells_);
+  models_ = models;
+  cell_sets_.swap(cell_sets);
+  set_offsets_.swap(set_offsets);
+  set_sizes_.swap(set_sizes);
+  set_data_.assign(bytes.begin() + data_offset, bytes.end());
+  last_cell_ = -1;
+  stats_.num_rays = 0;
+  stats_.bake_time_ms = 0.0;
+  UpdateStats();
+  return true;
+}
+
+const std::vector<Model*>* PotentiallyVisibleSet::Lookup(
+    const Eigen::Vector3f& position) {
+  ++stats_.num_lookups;
+  const int cell = FindCell(position);
+  stats_.camera_in_grid = cell >= 0;
+  if (cell < 0) {
+    stats_.num_visible = 0;
+    return nullptr;
+  }
+  if (cell != last_cell_) {
+    const uint32_t set = cell_sets_[cell];
+    visible_models_.clear();
+    DecodeSet(set_data_.data() + set_offsets_[set], set_sizes_[set], models_,
+              &visible_models_);
+    last_cell_ = cell;
+    ++stats_.num_decodes;
+  }
+  stats_.num_visible = visible_models_.size();
+  return &visible_models_;
+}
+
+int PotentiallyVisibleSet::FindCell(const Eigen::Vector3f& position) const {
+  if (cell_sets_.empty()) {
+    return -1;
+  }
+  int cell[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    const float coordinate =
+        std::floor((position[axis] - grid_min_[axis]) / cell_size_);
+    // Also rejects NaN positions.
+    if (!(coordinate >= 0.0f && coordinate < num_cells_[axis])) {
+      return -1;
+    }
+    cell[axis] = static_cast<int>(coordinate);
+  }
+  return cell[0] + num_cells_[0] * (cell[1] + num_cells_[1] * cell[2]);
+}
+
+void PotentiallyVisibleSet::UpdateStats() {
+  stats_.num_cells = cell_sets_.size();
+  stats_.num_sets = set_offsets_.size();
+  stats_.set_bytes = set_data_.size();
+  std::vector<int> set_num_visible(set_offsets_.size());
+  for (int set = 0; set < set_offsets_.size(); ++set) {
+    set_num_visible[set] = DecodeSet(set_data_.data() + set_offsets_[set],
+                                     set_sizes_[set], models_, nullptr);
+  }
+  double num_visible = 0.0;
+  for (const uint32_t cell_set : cell_sets_) {
+    num_visible += set_num_visible[cell_set];
+  }
+  stats_.visible_fraction = cell_sets_.empty() || models_.empty() ?
+      0.0 : num_visible / (static_cast<double>(cell_sets_.size()) *
+                           models_.size());
+}
+
+}  // namespace wvu
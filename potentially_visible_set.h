@@ -0,0 +1,215 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef POTENTIALLY_VISIBLE_SET_H_
+#define POTENTIALLY_VISIBLE_SET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+
+#include "model.h"
+
+namespace wvu {
+// Potentially visible sets (PVS) of a static scene. The space around the
+// scene is split into a grid of view cells, and the models that can be seen
+// from anywhere in each cell are found offline by casting rays through a
+// scene BVH (see wvu::SceneBvh): for every model, rays go from random points
+// in the cell to random points on the triangles of its mesh until one of
+// them hits the model first. The boxes of the BVH only select the meshes
+// whose triangles a ray is tested against, so models are seen through the
+// empty parts of each other's boxes. The set of each cell is stored as a
+// bitset over the models, compressed into runs when that is smaller, and
+// cells with the same set share it. At runtime, Lookup() finds the cell of the
+// camera and returns its models, decoding the set only when the camera
+// changes cells.
+//
+// Models that move after the bake keep the visibility of their baked pose.
+// Since the visibility is sampled, a model seen only through a gap narrower
+// than the rays can resolve may be missing from a set; more rays per model
+// make it less likely. The rays start from points of the cell that are not
+// inside a mesh, found by counting the triangles crossed by rays from the
+// point, so the meshes must be closed.
+//
+// File layout (.wvpvs), little endian:
+//   Header (48 bytes):
+//     char magic[4]  "WVPV".
+//     uint32 version  kPotentiallyVisibleSetVersion.
+//     uint32 num_models  Number of models the sets index.
+//     uint32 num_cells[3]  Cells along x, y and z.
+//     float grid_min[3]  Corner of the grid with the lowest coordinates.
+//     float cell_size  Side of the cubic cells.
+//     uint32 num_sets  Number of distinct sets.
+//     uint32 reserved  Zero.
+//   Cell table: one uint32 per cell, x fastest, with the index of its set.
+//   Set table: num_sets entries of
+//     uint32 offset  Offset of the set from the end of the set table.
+//     uint32 size  Bytes of the set.
+//   Sets, each starting with a byte giving its encoding:
+//     0  A bitset over the models, the first model in the lowest bit.
+//     1  The lengths of the alternating runs of hidden and visible models,
+//        starting with a run of hidden ones, as LEB128 varints.
+//   The baker writes the smaller of the two.
+//
+// Example:
+//
+// wvu::PotentiallyVisibleSet pvs;
+// wvu::PvsBakeOptions options;
+// ComputeWorldBounds(models, &options.grid_min, &options.grid_max);
+// pvs.Bake(models, options);  // Offline.
+// pvs.Write("scene.wvpvs");
+// ...
+// pvs.Read("scene.wvpvs", models);
+// while (...) {  // Rendering loop.
+//   const std::vector<Model*>* cell_models = pvs.Lookup(camera_position);
+//   ...  // Draw the cell_models, or all the models if null.
+// }
+
+// Version of the layout written by PotentiallyVisibleSet::Write().
+constexpr uint32_t kPotentiallyVisibleSetVersion = 1;
+
+// Options of PotentiallyVisibleSet::Bake().
+struct PvsBakeOptions {
+  PvsBakeOptions();
+
+  // Box covered by the view cells. It is rounded up to whole cells.
+  Eigen::Vector3f grid_min;
+  Eigen::Vector3f grid_max;
+  // Side of the cubic cells. It grows when the grid would have more than
+  // max_num_cells cells.
+  float cell_size;
+  int max_num_cells;
+  // Number of points in each cell the rays start from. Each ray starts from
+  // one of them at random.
+  int num_samples_per_cell;
+  // Number of rays cast towards each model before it is considered hidden
+  // from the cell.
+  int num_rays_per_model;
+};
+
+// Computes the world-space box enclosing the meshes of the models.
+void ComputeWorldBounds(const std::vector<Model*>& models,
+                        Eigen::Vector3f* box_min,
+                        Eigen::Vector3f* box_max);
+
+class PotentiallyVisibleSet {
+ public:
+  // Statistics of the sets.
+  struct Stats {
+    // Number of cells, and of distinct sets among them.
+    int num_cells;
+    int num_sets;
+    // Bytes of the compressed sets.
+    size_t set_bytes;
+    // Average fraction of the models visible from a cell.
+    double visible_fraction;
+    // Number of rays cast by the last call to Bake(), and its time.
+    long long num_rays;
+    double bake_time_ms;
+    // Number of calls to Lookup(), and the number of them that decoded a set
+    // because the camera changed cells.
+    int num_lookups;
+    int num_decodes;
+    // True if the camera was in the grid in the last call to Lookup(), and
+    // the number of models in the set of its cell.
+    bool camera_in_grid;
+    int num_visible;
+  };
+
+  PotentiallyVisibleSet();
+
+  // Bakes the sets of the models. Builds a BVH over them for the duration of
+  // the bake, so the models must not be in another BVH. Returns false if
+  // there are no models or the options are invalid.
+  // Params:
+  //   models  The models of the scene, in their baked pose. They must have a
+  //     mesh and outlive the sets.
+  //   options  The grid and the sampling of the bake.
+  bool Bake(const std::vector<Model*>& models, const PvsBakeOptions& options);
+
+  // Writes the sets into a file. Returns true if successful.
+  bool Write(const std::string& filepath) const;
+
+  // Reads the sets from a file and attaches them to the models. Returns false
+  // if the file is not valid or was baked for a different number of models.
+  // Params:
+  //   filepath  The path of the file.
+  //   models  The models the sets were baked for, in the same order. They
+  //     must outlive the sets.
+  bool Read(const std::string& filepath, const std::vector<Model*>& models);
+
+  // Returns the models potentially visible from the position, in their
+  // original order, or null if the position is outside the grid. The
+  // returned vector is valid until the next call.
+  // Params:
+  //   position  The position of the camera in the world.
+  const std::vector<Model*>* Lookup(const Eigen::Vector3f& position);
+
+  // Returns the statistics of the sets.
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  // Returns the index of the cell holding the position, or -1 if outside.
+  int FindCell(const Eigen::Vector3f& position) const;
+
+  // Computes the statistics of the sets.
+  void UpdateStats();
+
+  // Grid of cells.
+  Eigen::Vector3f grid_min_;
+  float cell_size_;
+  int num_cells_[3];
+  // Models indexed by the sets.
+  std::vector<Model*> models_;
+  // Set of each cell.
+  std::vector<uint32_t> cell_sets_;
+  // Compressed sets, one after the other, and their offsets and sizes.
+  std::vector<unsigned char> set_data_;
+  std::vector<uint32_t> set_offsets_;
+  std::vector<uint32_t> set_sizes_;
+  // Models of the set of last_cell_.
+  std::vector<Model*> visible_models_;
+  int last_cell_;
+  Stats stats_;
+};
+
+}  // namespace wvu
+
+#endif  // POTENTIALLY_VISIBLE_SET_H_
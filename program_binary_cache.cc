@@ -0,0 +1,240 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "program_binary_cache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include <GL/glew.h>
+
+namespace wvu {
+namespace {
+// Identifies the files written by this cache.
+constexpr uint32_t kFileMagic = 0x42505657;  // "WVPB".
+// Bump when the layout of the file changes.
+constexpr uint32_t kFileVersion = 1;
+// Largest binary accepted from the cache. Linked programs are a few hundred
+// kilobytes at most, so a larger size means the header is corrupted.
+constexpr uint32_t kMaxBinarySize = 64 << 20;
+
+// Header of a cached binary. The binary follows the header.
+struct BinaryFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Format returned by glGetProgramBinary().
+  uint32_t binary_format;
+  // Size of the binary in bytes.
+  uint32_t binary_size;
+  // Time it took to compile and link the program.
+  double build_time_ms;
+};
+
+// 64-bit FNV-1a hash.
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+uint64_t HashString(const std::string& data, uint64_t hash) {
+  for (const char c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= kFnvPrime;
+  }
+  // Hash a separator so that moving characters between consecutive strings
+  // changes the hash.
+  hash ^= 0xff;
+  hash *= kFnvPrime;
+  return hash;
+}
+
+// Returns the string of glGetString(name), or an empty string if unavailable.
+std::string GetGlString(const GLenum name) {
+  const GLubyte* value = glGetString(name);
+  return value == nullptr ? "" : reinterpret_cast<const char*>(value);
+}
+
+// Creates the directory if it does not exist.
+void MakeDirectory(const std::string& directory) {
+#ifdef _WIN32
+  _mkdir(directory.c_str());
+#else
+  mkdir(directory.c_str(), 0755);
+#endif
+}
+
+// Milliseconds elapsed since start.
+double ElapsedMilliseconds(
+    const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& cache_directory) :
+    cache_directory_(cache_directory), supported_(-1) {
+  stats_.hits = 0;
+  stats_.misses = 0;
+  stats_.rejected = 0;
+  stats_.time_saved_ms = 0.0;
+  MakeDirectory(cache_directory_);
+}
+
+bool ProgramBinaryCache::IsSupported() {
+  if (supported_ < 0) {
+    GLint num_formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    }
+    supported_ = num_formats > 0 ? 1 : 0;
+    driver_signature_ = GetGlString(GL_VENDOR) + "\n" +
+        GetGlString(GL_RENDERER) + "\n" + GetGlString(GL_VERSION);
+  }
+  return supported_ == 1;
+}
+
+std::string ProgramBinaryCache::ComputeKey(
+    const std::string& vertex_shader_source,
+    const std::string& fragment_shader_source,
+    const std::string& defines) {
+  IsSupported();
+  uint64_t hash = kFnvOffsetBasis;
+  hash = HashString(driver_signature_, hash);
+  hash = HashString(defines, hash);
+  hash = HashString(vertex_shader_source, hash);
+  hash = HashString(fragment_shader_source, hash);
+  std::ostringstream key;
+  key << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return key.str();
+}
+
+std::string ProgramBinaryCache::GetFilepath(const std::string& key) const {
+  return cache_directory_ + "/" + key + ".bin";
+}
+
+bool ProgramBinaryCache::Load(const std::string& key, const GLuint program) {
+  if (!IsSupported()) return false;
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  const std::string filepath = GetFilepath(key);
+  std::ifstream in(filepath, std::ios::binary);
+  BinaryFileHeader header;
+  if (!in.is_open() ||
+      !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != kFileMagic || header.version != kFileVersion) {
+    ++stats_.misses;
+    return false;
+  }
+  // Validate the size in the header before allocating the binary, so that a
+  // corrupted or truncated entry never triggers a huge allocation. The entry
+  // is deleted, and the caller compiles the program and stores it again.
+  const std::streamoff header_end = in.tellg();
+  in.seekg(0, std::ios::end);
+  const std::streamoff remaining_size = in.tellg() - header_end;
+  in.seekg(header_end);
+  if (!in || header.binary_size == 0 || header.binary_size > kMaxBinarySize ||
+      static_cast<std::streamoff>(header.binary_size) > remaining_size) {
+    in.close();
+    std::remove(filepath.c_str());
+    ++stats_.rejected;
+    ++stats_.misses;
+    return false;
+  }
+  std::vector<char> binary(header.binary_size);
+  if (!in.read(binary.data(), binary.size())) {
+    ++stats_.misses;
+    return false;
+  }
+  glProgramBinary(program, header.binary_format, binary.data(), binary.size());
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    // The driver changed in a way the key does not capture or the file is
+    // corrupted. The caller compiles the program and overwrites the entry.
+    ++stats_.rejected;
+    ++stats_.misses;
+    return false;
+  }
+  ++stats_.hits;
+  stats_.time_saved_ms += header.build_time_ms - ElapsedMilliseconds(start);
+  return true;
+}
+
+bool ProgramBinaryCache::Store(const std::string& key,
+                               const GLuint program,
+                               const double build_time_ms) {
+  if (!IsSupported()) return false;
+  GLint binary_size = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+  if (binary_size <= 0) return false;
+  std::vector<char> binary(binary_size);
+  GLenum binary_format = 0;
+  GLsizei written_size = 0;
+  glGetProgramBinary(program, binary_size, &written_size, &binary_format,
+                     binary.data());
+  if (written_size <= 0) return false;
+  BinaryFileHeader header;
+  header.magic = kFileMagic;
+  header.version = kFileVersion;
+  header.binary_format = binary_format;
+  header.binary_size = written_size;
+  header.build_time_ms = build_time_ms;
+  // Write to a temporary file and rename it so that a crash never leaves a
+  // truncated entry behind.
+  const std::string filepath = GetFilepath(key);
+  const std::string temporary_filepath = filepath + ".tmp";
+  {
+    std::ofstream out(temporary_filepath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open() ||
+        !out.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+        !out.write(binary.data(), written_size)) {
+      return false;
+    }
+  }
+  std::remove(filepath.c_str());
+  return std::rename(temporary_filepath.c_str(), filepath.c_str()) == 0;
+}
+
+}  // namespace wvu
@@ -0,0 +1,128 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef PROGRAM_BINARY_CACHE_H_
+#define PROGRAM_BINARY_CACHE_H_
+
+#include <string>
+#include <GL/glew.h>
+
+namespace wvu {
+// On-disk cache of linked shader program binaries. A program binary is stored
+// under a key that hashes the shader sources, the defines and the GL vendor,
+// renderer and version strings, so a driver update or a change in any shader
+// invalidates the entry. Binaries are retrieved with glGetProgramBinary() and
+// loaded back with glProgramBinary(). When the driver rejects a binary, the
+// caller falls back to compiling and linking the program from source.
+//
+// The cache is used through ShaderProgram::set_binary_cache():
+//
+// wvu::ProgramBinaryCache binary_cache("/path/to/cache/directory");
+// wvu::ShaderProgram shader_program;
+// shader_program.set_binary_cache(&binary_cache);
+// ...  // Load the shaders.
+// shader_program.Create(&error_info_log);
+class ProgramBinaryCache {
+ public:
+  // Statistics of the cache.
+  struct Stats {
+    // Number of programs loaded from the cache.
+    int hits;
+    // Number of programs that had to be compiled and linked from source.
+    int misses;
+    // Number of cached binaries that were corrupted or that the driver
+    // rejected (counted as misses).
+    int rejected;
+    // Compile and link time of the cached programs minus the time it took to
+    // load their binaries, in milliseconds.
+    double time_saved_ms;
+  };
+
+  // Params:
+  //   cache_directory  Directory where the binaries are stored. It is created
+  //     if it does not exist.
+  explicit ProgramBinaryCache(const std::string& cache_directory);
+
+  // Returns true if the driver can save and load program binaries. Requires a
+  // current OpenGL context.
+  bool IsSupported();
+
+  // Computes the key of a program.
+  // Params:
+  //   vertex_shader_source  Source of the vertex shader.
+  //   fragment_shader_source  Source of the fragment shader.
+  //   defines  The defines used to build the program.
+  std::string ComputeKey(const std::string& vertex_shader_source,
+                         const std::string& fragment_shader_source,
+                         const std::string& defines);
+
+  // Loads the binary stored under key into program. Returns true if the driver
+  // accepted the binary and the program is linked, and false otherwise.
+  bool Load(const std::string& key, const GLuint program);
+
+  // Stores the binary of the linked program under key. The program must have
+  // been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set. Returns true if
+  // successful.
+  // Params:
+  //   key  Key of the program.
+  //   program  Id of the linked program.
+  //   build_time_ms  Time spent compiling and linking the program.
+  bool Store(const std::string& key,
+             const GLuint program,
+             const double build_time_ms);
+
+  // Returns the statistics of the cache.
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  // Returns the path of the file that holds the binary of key.
+  std::string GetFilepath(const std::string& key) const;
+
+  // Directory holding the cached binaries.
+  std::string cache_directory_;
+  // Vendor, renderer and version strings of the OpenGL implementation.
+  std::string driver_signature_;
+  // -1 until IsSupported() queries the driver, then 1 if program binaries are
+  // supported and 0 otherwise.
+  int supported_;
+  Stats stats_;
+};
+
+}  // namespace wvu
+
+#endif  // PROGRAM_BINARY_CACHE_H_
@@ -0,0 +1,168 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "residency_manager.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace wvu {
+
+ResidencyManager::ResidencyManager() : frame_(0) {
+  for (int type = 0; type < kNumResourceTypes; ++type) {
+    budgets_[type] = 0;
+    num_evictions_[type] = 0;
+    num_restores_[type] = 0;
+  }
+}
+
+ResidencyManager::~ResidencyManager() {
+  if (!entries_.empty()) {
+    std::cerr << "ERROR: " << entries_.size()
+              << " resources are still registered.\n";
+  }
+}
+
+void ResidencyManager::set_budget(const ResourceType type,
+                                  const size_t budget_bytes) {
+  budgets_[static_cast<int>(type)] = budget_bytes;
+}
+
+void ResidencyManager::Register(ResidentResource* resource,
+                                const ResourceType type) {
+  if (resource == nullptr) {
+    std::cout << "Null pointer passed.  Could not register the resource.";
+    return;
+  }
+  Entry& entry = entries_[resource];
+  entry.type = type;
+  entry.last_used_frame = frame_;
+}
+
+void ResidencyManager::Unregister(ResidentResource* resource) {
+  entries_.erase(resource);
+}
+
+void ResidencyManager::MarkUsed(ResidentResource* resource) {
+  const auto entry = entries_.find(resource);
+  if (entry == entries_.end()) return;
+  entry->second.last_used_frame = frame_;
+  // The resource is about to be drawn; it can not wait for the end of the
+  // frame.
+  if (resource->resident_bytes() == 0 && resource->full_bytes() > 0 &&
+      resource->Restore()) {
+    ++num_restores_[static_cast<int>(entry->second.type)];
+  }
+}
+
+void ResidencyManager::EndFrame() {
+  for (int type = 0; type < kNumResourceTypes; ++type) {
+    const size_t budget = budgets_[type];
+    size_t used_bytes = ComputeUsedBytes(static_cast<ResourceType>(type));
+    // Restore the resources used in this frame that fit the budget, and
+    // gather the others as candidates for eviction.
+    std::vector<std::pair<int, ResidentResource*>> candidates;
+    for (const auto& resource_and_entry : entries_) {
+      ResidentResource* resource = resource_and_entry.first;
+      const Entry& entry = resource_and_entry.second;
+      if (static_cast<int>(entry.type) != type) continue;
+      if (entry.last_used_frame != frame_) {
+        candidates.emplace_back(entry.last_used_frame, resource);
+        continue;
+      }
+      const size_t resident_bytes = resource->resident_bytes();
+      const size_t full_bytes = resource->full_bytes();
+      if (resident_bytes >= full_bytes) continue;
+      if (budget > 0 && used_bytes - resident_bytes + full_bytes > budget) {
+        continue;
+      }
+      if (resource->Restore()) {
+        ++num_restores_[type];
+        used_bytes += full_bytes - resident_bytes;
+      }
+    }
+    if (budget == 0 || used_bytes <= budget) continue;
+    // Evict the least recently used resources first. The resources used in
+    // this frame are kept.
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<int, ResidentResource*>& a,
+                 const std::pair<int, ResidentResource*>& b) {
+                return a.first < b.first;
+              });
+    for (const auto& candidate : candidates) {
+      ResidentResource* resource = candidate.second;
+      while (used_bytes > budget) {
+        const size_t resident_bytes = resource->resident_bytes();
+        if (!resource->Evict()) break;
+        ++num_evictions_[type];
+        used_bytes -= resident_bytes - resource->resident_bytes();
+      }
+      if (used_bytes <= budget) break;
+    }
+  }
+  ++frame_;
+}
+
+ResidencyManager::Stats ResidencyManager::stats() const {
+  Stats stats;
+  for (int type = 0; type < kNumResourceTypes; ++type) {
+    stats.used_bytes[type] =
+        ComputeUsedBytes(static_cast<ResourceType>(type));
+    stats.budget_bytes[type] = budgets_[type];
+    stats.num_resources[type] = 0;
+    stats.num_evictions[type] = num_evictions_[type];
+    stats.num_restores[type] = num_restores_[type];
+  }
+  for (const auto& resource_and_entry : entries_) {
+    ++stats.num_resources[static_cast<int>(resource_and_entry.second.type)];
+  }
+  return stats;
+}
+
+size_t ResidencyManager::ComputeUsedBytes(const ResourceType type) const {
+  size_t used_bytes = 0;
+  for (const auto& resource_and_entry : entries_) {
+    if (resource_and_entry.second.type == type) {
+      used_bytes += resource_and_entry.first->resident_bytes();
+    }
+  }
+  return used_bytes;
+}
+
+}  // namespace wvu
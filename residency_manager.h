@@ -0,0 +1,160 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef RESIDENCY_MANAGER_H_
+#define RESIDENCY_MANAGER_H_
+
+#include <cstddef>
+#include <unordered_map>
+
+namespace wvu {
+// Types of resources with separate video memory budgets.
+enum class ResourceType {
+  kTexture = 0,
+  kMesh = 1
+};
+constexpr int kNumResourceTypes = 2;
+
+// Resource whose video memory can be reclaimed by a ResidencyManager and
+// brought back when it is used again.
+class ResidentResource {
+ public:
+  virtual ~ResidentResource() {}
+
+  // Returns the bytes of video memory the resource takes now.
+  virtual size_t resident_bytes() const = 0;
+
+  // Returns the bytes of video memory the resource takes when it is fully
+  // resident.
+  virtual size_t full_bytes() const = 0;
+
+  // Frees part or all of the video memory of the resource, e.g., the largest
+  // level of a texture. Returns false if nothing can be freed.
+  virtual bool Evict() = 0;
+
+  // Makes the resource fully resident again. The restoration may complete
+  // later (e.g., while a texture is reloaded). Returns false if there is
+  // nothing to restore or a restoration is in progress.
+  virtual bool Restore() = 0;
+};
+
+// Keeps the video memory of each type of resource within a budget. The
+// renderer marks the resources it uses every frame; at the end of the frame,
+// the least recently used resources of the types over budget are evicted
+// (textures drop their largest levels first, meshes free their buffers), and
+// the used resources that were evicted are restored if they fit the budget. A
+// resource without video memory is restored as soon as it is used, since it
+// is about to be drawn.
+//
+// Example:
+//
+// wvu::ResidencyManager residency_manager;
+// residency_manager.set_budget(wvu::ResourceType::kTexture, 256 << 20);
+// mesh_registry.set_residency_manager(&residency_manager);
+// while (...) {  // Rendering loop.
+//   ...  // Draw the models.
+//   residency_manager.EndFrame();
+// }
+//
+// The resources must unregister themselves before they are destroyed. Must be
+// used from the OpenGL thread.
+class ResidencyManager {
+ public:
+  // Statistics of the manager, per type of resource.
+  struct Stats {
+    // Bytes of video memory taken by the resources.
+    size_t used_bytes[kNumResourceTypes];
+    // Budget of the type, or zero if unlimited.
+    size_t budget_bytes[kNumResourceTypes];
+    // Number of registered resources.
+    int num_resources[kNumResourceTypes];
+    // Number of successful Evict() and Restore() calls.
+    int num_evictions[kNumResourceTypes];
+    int num_restores[kNumResourceTypes];
+  };
+
+  ResidencyManager();
+  ~ResidencyManager();
+
+  // Sets the budget of a type of resource in bytes. Zero means unlimited,
+  // which is the default.
+  void set_budget(const ResourceType type, const size_t budget_bytes);
+
+  // Starts tracking a resource. The resource is considered used in the current
+  // frame.
+  void Register(ResidentResource* resource, const ResourceType type);
+
+  // Stops tracking a resource.
+  void Unregister(ResidentResource* resource);
+
+  // Records that the resource is used in the current frame. If the resource
+  // has no video memory, it is restored right away.
+  void MarkUsed(ResidentResource* resource);
+
+  // Restores the resources used in this frame that fit their budget, evicts
+  // the least recently used resources of the types over budget, and starts a
+  // new frame.
+  void EndFrame();
+
+  // Returns the number of the current frame.
+  int frame() const {
+    return frame_;
+  }
+
+  // Returns the statistics of the manager.
+  Stats stats() const;
+
+ private:
+  // Tracked resource.
+  struct Entry {
+    ResourceType type;
+    // Frame of the last call to MarkUsed() for the resource.
+    int last_used_frame;
+  };
+
+  // Returns the bytes taken by the resources of a type.
+  size_t ComputeUsedBytes(const ResourceType type) const;
+
+  std::unordered_map<ResidentResource*, Entry> entries_;
+  size_t budgets_[kNumResourceTypes];
+  int num_evictions_[kNumResourceTypes];
+  int num_restores_[kNumResourceTypes];
+  int frame_;
+};
+
+}  // namespace wvu
+
+#endif  // RESIDENCY_MANAGER_H_
@@ -0,0 +1,618 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "scene_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+
+#include "camera_utils.h"
+#include "frustum_culler.h"
+#include "mesh.h"
+#include "model.h"
+
+namespace wvu {
+namespace {
+
+// Number of bins per axis of the SAH.
+constexpr int kNumBins = 16;
+// Nodes with more models are always split, even if the SAH prefers a leaf.
+constexpr int kMaxLeafSize = 8;
+// Costs of visiting a node and of testing the box of a model, in the SAH.
+constexpr float kTraversalCost = 1.0f;
+constexpr float kIntersectionCost = 1.0f;
+
+// Returns half the surface area of the box; the SAH only uses area ratios.
+float ComputeHalfArea(const Eigen::Vector3f& box_min,
+                      const Eigen::Vector3f& box_max) {
+  const Eigen::Vector3f size = (box_max - box_min).cwiseMax(0.0f);
+  return size.x() * size.y() + size.y() * size.z() + size.z() * size.x();
+}
+
+// Computes the center and half extents of the world-space box enclosing the
+// bounding box of the mesh of the model.
+void ComputeWorldBox(Model* model,
+                     Eigen::Vector3f* center,
+                     Eigen::Vector3f* extent) {
+  const Eigen::Matrix4f model_matrix = model->ComputeModelMatrix();
+  const MeshBounds& bounds = model->mesh()->bounds();
+  *center = model_matrix.topLeftCorner<3, 3>() *
+      (0.5f * (bounds.box_min + bounds.box_max)) +
+      model_matrix.topRightCorner<3, 1>();
+  *extent = model_matrix.topLeftCorner<3, 3>().cwiseAbs() *
+      (0.5f * (bounds.box_max - bounds.box_min));
+}
+
+// Returns the bin of a centroid along the axis.
+inline int ComputeBin(const float centroid,
+                      const float centroid_min,
+                      const float bin_scale) {
+  return std::min(kNumBins - 1,
+                  static_cast<int>((centroid - centroid_min) * bin_scale));
+}
+
+// Tests the box against the frustum planes whose bit is set in plane_mask.
+// Returns -1 if the box is outside one of them; otherwise returns the mask of
+// the planes the box crosses, which its children still have to be tested
+// against.
+int ClassifyBox(const Eigen::Vector3f& box_min,
+                const Eigen::Vector3f& box_max,
+                const float planes[6][4],
+                int plane_mask) {
+  const Eigen::Vector3f center = 0.5f * (box_min + box_max);
+  const Eigen::Vector3f extent = 0.5f * (box_max - box_min);
+  for (int p = 0; p < 6; ++p) {
+    if ((plane_mask & (1 << p)) == 0) {
+      continue;
+    }
+    const float distance = planes[p][0] * center.x() +
+        planes[p][1] * center.y() + planes[p][2] * center.z() + planes[p][3];
+    const float radius = std::fabs(planes[p][0]) * extent.x() +
+        std::fabs(planes[p][1]) * extent.y() +
+        std::fabs(planes[p][2]) * extent.z();
+    if (distance + radius < 0.0f) {
+      return -1;
+    }
+    if (distance - radius >= 0.0f) {
+      plane_mask &= ~(1 << p);
+    }
+  }
+  return plane_mask;
+}
+
+// Intersects the ray with the box (slab test). Returns true if the ray enters
+// the box before max_distance, and the entry distance, zero if the origin is
+// inside.
+bool IntersectBox(const Eigen::Vector3f& box_min,
+                  const Eigen::Vector3f& box_max,
+                  const Eigen::Vector3f& origin,
+                  const Eigen::Vector3f& inverse_direction,
+                  const float max_distance,
+                  float* distance) {
+  const Eigen::Vector3f t0 =
+      (box_min - origin).cwiseProduct(inverse_direction);
+  const Eigen::Vector3f t1 =
+      (box_max - origin).cwiseProduct(inverse_direction);
+  const float t_enter = std::max(0.0f, t0.cwiseMin(t1).maxCoeff());
+  const float t_exit = t0.cwiseMax(t1).minCoeff();
+  if (t_enter > t_exit || t_enter >= max_distance) {
+    return false;
+  }
+  *distance = t_enter;
+  return true;
+}
+
+}  // namespace
+
+SceneBvh::SceneBvh() : node_cost_sum_(0.0), rebuild_threshold_(1.5f) {
+  stats_.num_nodes = 0;
+  stats_.num_leaves = 0;
+  stats_.num_builds = 0;
+  stats_.num_rebuilds = 0;
+  stats_.num_refits = 0;
+  stats_.num_refitted_nodes = 0;
+  stats_.build_sah_cost = 0.0f;
+  stats_.sah_cost = 0.0f;
+  stats_.culling.num_visible = 0;
+  stats_.culling.num_culled = 0;
+  stats_.culling.num_frames = 0;
+  stats_.culling.total_visible = 0;
+  stats_.culling.total_culled = 0;
+  stats_.num_visited_nodes = 0;
+}
+
+SceneBvh::~SceneBvh() {}
+
+void SceneBvh::Build(const std::vector<Model*>& models) {
+  // The models may be models_ itself, when rebuilding.
+  const std::vector<Model*> input_models = models;
+  Clear();
+  const int num_models = input_models.size();
+  build_references_.resize(num_models);
+  for (int i = 0; i < num_models; ++i) {
+    BuildReference& reference = build_references_[i];
+    Eigen::Vector3f extent;
+    ComputeWorldBox(input_models[i], &reference.centroid, &extent);
+    reference.box.min = reference.centroid - extent;
+    reference.box.max = reference.centroid + extent;
+    reference.object = i;
+  }
+  nodes_.reserve(2 * num_models);
+  parents_.reserve(2 * num_models);
+  if (num_models > 0) {
+    BuildNode(0, num_models);
+  }
+
+  // The build sorted the references in the order of the leaves.
+  models_.resize(num_models);
+  boxes_.resize(num_models);
+  for (int i = 0; i < num_models; ++i) {
+    models_[i] = input_models[build_references_[i].object];
+    boxes_[i] = build_references_[i].box;
+    models_[i]->set_scene_bvh(this, i);
+  }
+  leaves_.resize(num_models);
+  stats_.num_leaves = 0;
+  node_cost_sum_ = 0.0;
+  for (int node = 0; node < nodes_.size(); ++node) {
+    if (nodes_[node].right_child == 0) {
+      for (int i = 0; i < nodes_[node].num_objects; ++i) {
+        leaves_[nodes_[node].first_object + i] = node;
+      }
+      ++stats_.num_leaves;
+    }
+    node_cost_sum_ += ComputeNodeCost(nodes_[node]);
+  }
+  moved_.assign(num_models, 0);
+  refit_flags_.assign(nodes_.size(), 0);
+  stats_.num_nodes = nodes_.size();
+  ++stats_.num_builds;
+  stats_.build_sah_cost = ComputeSahCost();
+  stats_.sah_cost = stats_.build_sah_cost;
+}
+
+void SceneBvh::Clear() {
+  for (int i = 0; i < models_.size(); ++i) {
+    models_[i]->set_scene_bvh(nullptr, 0);
+  }
+  nodes_.clear();
+  parents_.clear();
+  models_.clear();
+  boxes_.clear();
+  leaves_.clear();
+  moved_objects_.clear();
+  moved_.clear();
+  refit_nodes_.clear();
+  refit_flags_.clear();
+  node_cost_sum_ = 0.0;
+  stats_.num_nodes = 0;
+  stats_.num_leaves = 0;
+}
+
+void SceneBvh::MarkMoved(const int object) {
+  if (!moved_[object]) {
+    moved_[object] = 1;
+    moved_objects_.push_back(object);
+  }
+}
+
+// The boxes of the moved models are recomputed, and then the nodes above
+// them from the bottom up. Children come after their parents in nodes_, so
+// refitting the nodes by decreasing index refits the children first.
+bool SceneBvh::Update() {
+  if (moved_objects_.empty()) {
+    return false;
+  }
+  // When most of the models moved, they are refitted in the order of the
+  // leaves and so are all the nodes, which beats walking up from every leaf.
+  if (moved_objects_.size() > models_.size() / 4) {
+    for (int object = 0; object < models_.size(); ++object) {
+      if (moved_[object]) {
+        moved_[object] = 0;
+        UpdateObjectBox(object);
+      }
+    }
+    for (int node = nodes_.size() - 1; node >= 0; --node) {
+      RefitNode(node);
+    }
+    stats_.num_refitted_nodes = nodes_.size();
+  } else {
+    for (const int object : moved_objects_) {
+      moved_[object] = 0;
+      UpdateObjectBox(object);
+      for (int node = leaves_[object]; node >= 0 && !refit_flags_[node];
+           node = parents_[node]) {
+        refit_flags_[node] = 1;
+        refit_nodes_.push_back(node);
+      }
+    }
+    std::sort(refit_nodes_.begin(), refit_nodes_.end(), std::greater<int>());
+    for (const int node : refit_nodes_) {
+      RefitNode(node);
+      refit_flags_[node] = 0;
+    }
+    stats_.num_refitted_nodes = refit_nodes_.size();
+    refit_nodes_.clear();
+  }
+  moved_objects_.clear();
+  ++stats_.num_refits;
+  stats_.sah_cost = ComputeSahCost();
+  if (stats_.sah_cost > rebuild_threshold_ * stats_.build_sah_cost) {
+    Build(models_);
+    ++stats_.num_rebuilds;
+    return true;
+  }
+  return false;
+}
+
+const std::vector<Model*>& SceneBvh::Cull(
+    const Eigen::Matrix4f& view_projection) {
+  Update();
+  visible_models_.clear();
+  stats_.num_visited_nodes = 0;
+  const Eigen::Matrix<float, 6, 4> frustum_planes =
+      ComputeFrustumPlanes(view_projection);
+  float planes[6][4];
+  for (int p = 0; p < 6; ++p) {
+    for (int i = 0; i < 4; ++i) {
+      planes[p][i] = frustum_planes(p, i);
+    }
+  }
+  // Nodes to visit, with the planes their parent crosses. A node inside all
+  // the planes adds its models without testing them.
+  std::vector<std::pair<int, int> > stack;
+  if (!nodes_.empty()) {
+    stack.push_back(std::make_pair(0, (1 << 6) - 1));
+  }
+  while (!stack.empty()) {
+    const int node_index = stack.back().first;
+    const int plane_mask = ClassifyBox(nodes_[node_index].box.min,
+                                       nodes_[node_index].box.max,
+                                       planes, stack.back().second);
+    stack.pop_back();
+    ++stats_.num_visited_nodes;
+    if (plane_mask < 0) {
+      continue;
+    }
+    const Node& node = nodes_[node_index];
+    if (plane_mask == 0) {
+      visible_models_.insert(
+          visible_models_.end(), models_.begin() + node.first_object,
+          models_.begin() + node.first_object + node.num_objects);
+    } else if (node.right_child == 0) {
+      for (int i = node.first_object;
+           i < node.first_object + node.num_objects; ++i) {
+        if (ClassifyBox(boxes_[i].min, boxes_[i].max, planes, plane_mask) >=
+            0) {
+          visible_models_.push_back(models_[i]);
+        }
+      }
+    } else {
+      stack.push_back(std::make_pair(node.right_child, plane_mask));
+      stack.push_back(std::make_pair(node_index + 1, plane_mask));
+    }
+  }
+  FrustumCuller::Stats& culling = stats_.culling;
+  culling.num_visible = visible_models_.size();
+  culling.num_culled = models_.size() - culling.num_visible;
+  ++culling.num_frames;
+  culling.total_visible += culling.num_visible;
+  culling.total_culled += culling.num_culled;
+  return visible_models_;
+}
+
+Model* SceneBvh::Raycast(const Eigen::Vector3f& origin,
+                         const Eigen::Vector3f& direction,
+                         float* distance) {
+  return TraceRay(origin, direction, false, distance);
+}
+
+Model* SceneBvh::RaycastTriangles(const Eigen::Vector3f& origin,
+                                  const Eigen::Vector3f& direction,
+                                  float* distance) {
+  return TraceRay(origin, direction, true, distance);
+}
+
+// The children are visited nearest first, and the boxes farther than the
+// closest hit so far are skipped. The models are rigid (rotation and
+// translation), so distances are the same in model space.
+Model* SceneBvh::TraceRay(const Eigen::Vector3f& origin,
+                          const Eigen::Vector3f& direction,
+                          const bool test_triangles,
+                          float* distance) {
+  Update();
+  stats_.num_visited_nodes = 0;
+  if (nodes_.empty() || direction.squaredNorm() == 0.0f) {
+    return nullptr;
+  }
+  const Eigen::Vector3f unit_direction = direction.normalized();
+  const Eigen::Vector3f inverse_direction = unit_direction.cwiseInverse();
+  float closest_distance = std::numeric_limits<float>::infinity();
+  Model* closest_model = nullptr;
+  float entry_distance;
+  std::vector<int> stack;
+  stack.push_back(0);
+  while (!stack.empty()) {
+    const Node& node = nodes_[stack.back()];
+    const int node_index = stack.back();
+    stack.pop_back();
+    ++stats_.num_visited_nodes;
+    if (!IntersectBox(node.box.min, node.box.max, origin, inverse_direction,
+                      closest_distance, &entry_distance)) {
+      continue;
+    }
+    if (node.right_child == 0) {
+      for (int i = node.first_object;
+           i < node.first_object + node.num_objects; ++i) {
+        if (!IntersectBox(boxes_[i].min, boxes_[i].max, origin,
+                          inverse_direction, closest_distance,
+                          &entry_distance)) {
+          continue;
+        }
+        // Tests the box of the mesh in model space.
+        const Eigen::Matrix4f model_matrix = models_[i]->ComputeModelMatrix();
+        const Eigen::Matrix3f inverse_rotation =
+            model_matrix.topLeftCorner<3, 3>().transpose();
+        const Eigen::Vector3f model_origin =
+            inverse_rotation * (origin - model_matrix.topRightCorner<3, 1>());
+        const Eigen::Vector3f model_direction =
+            inverse_rotation * unit_direction;
+        const Mesh& mesh = *models_[i]->mesh();
+        if (!IntersectBox(mesh.bounds().box_min, mesh.bounds().box_max,
+                          model_origin, model_direction.cwiseInverse(),
+                          closest_distance, &entry_distance)) {
+          continue;
+        }
+        if (test_triangles) {
+          entry_distance = IntersectMeshTriangles(mesh, model_origin,
+                                                  model_direction,
+                                                  closest_distance);
+          if (entry_distance == std::numeric_limits<float>::infinity()) {
+            continue;
+          }
+        }
+        closest_distance = entry_distance;
+        closest_model = models_[i];
+      }
+      continue;
+    }
+    const int left_child = node_index + 1;
+    float left_distance;
+    float right_distance;
+    const bool left_hit = IntersectBox(
+        nodes_[left_child].box.min, nodes_[left_child].box.max, origin,
+        inverse_direction, closest_distance, &left_distance);
+    const bool right_hit = IntersectBox(
+        nodes_[node.right_child].box.min, nodes_[node.right_child].box.max,
+        origin, inverse_direction, closest_distance, &right_distance);
+    if (left_hit && right_hit) {
+      // The nearest child is popped first.
+      if (left_distance <= right_distance) {
+        stack.push_back(node.right_child);
+        stack.push_back(left_child);
+      } else {
+        stack.push_back(left_child);
+        stack.push_back(node.right_child);
+      }
+    } else if (left_hit) {
+      stack.push_back(left_child);
+    } else if (right_hit) {
+      stack.push_back(node.right_child);
+    }
+  }
+  if (closest_model != nullptr && distance != nullptr) {
+    *distance = closest_distance;
+  }
+  return closest_model;
+}
+
+// The node is a leaf when the SAH finds no split cheaper than testing all its
+// models and it holds at most kMaxLeafSize of them. When all the centroids
+// coincide, or the best split leaves a side empty, the objects are split at
+// the median of the widest axis instead.
+int SceneBvh::BuildNode(const int begin, const int end) {
+  const int node_index = nodes_.size();
+  nodes_.push_back(Node());
+  parents_.push_back(-1);
+  const int num_objects = end - begin;
+  Box box;
+  box.min.setConstant(std::numeric_limits<float>::max());
+  box.max.setConstant(-std::numeric_limits<float>::max());
+  Eigen::Vector3f centroid_min = box.min;
+  Eigen::Vector3f centroid_max = box.max;
+  for (int i = begin; i < end; ++i) {
+    const BuildReference& reference = build_references_[i];
+    box.min = box.min.cwiseMin(reference.box.min);
+    box.max = box.max.cwiseMax(reference.box.max);
+    centroid_min = centroid_min.cwiseMin(reference.centroid);
+    centroid_max = centroid_max.cwiseMax(reference.centroid);
+  }
+  nodes_[node_index].box = box;
+  nodes_[node_index].first_object = begin;
+  nodes_[node_index].num_objects = num_objects;
+  nodes_[node_index].right_child = 0;
+  if (num_objects == 1) {
+    return node_index;
+  }
+
+  // Finds the cheapest split between the bins of each axis. The objects are
+  // binned along the three axes in a single pass.
+  const float leaf_cost = kIntersectionCost * num_objects;
+  const float inverse_area = 1.0f / std::max(
+      ComputeHalfArea(box.min, box.max), std::numeric_limits<float>::min());
+  const Eigen::Vector3f centroid_extent = centroid_max - centroid_min;
+  Eigen::Vector3f bin_scale;
+  for (int axis = 0; axis < 3; ++axis) {
+    bin_scale[axis] =
+        centroid_extent[axis] > 0.0f ? kNumBins / centroid_extent[axis] : 0.0f;
+  }
+  Box bin_boxes[3][kNumBins];
+  int bin_counts[3][kNumBins] = {};
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int bin = 0; bin < kNumBins; ++bin) {
+      bin_boxes[axis][bin].min.setConstant(std::numeric_limits<float>::max());
+      bin_boxes[axis][bin].max.setConstant(-std::numeric_limits<float>::max());
+    }
+  }
+  for (int i = begin; i < end; ++i) {
+    const BuildReference& reference = build_references_[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      const int bin = ComputeBin(reference.centroid[axis], centroid_min[axis],
+                                 bin_scale[axis]);
+      Box& bin_box = bin_boxes[axis][bin];
+      bin_box.min = bin_box.min.cwiseMin(reference.box.min);
+      bin_box.max = bin_box.max.cwiseMax(reference.box.max);
+      ++bin_counts[axis][bin];
+    }
+  }
+  float best_cost = leaf_cost;
+  int best_axis = -1;
+  int best_split = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (centroid_extent[axis] <= 0.0f) {
+      continue;
+    }
+    // Area times count of the bins right of each split, swept from the right.
+    float right_costs[kNumBins];
+    Box right_box = bin_boxes[axis][kNumBins - 1];
+    int right_count = 0;
+    for (int split = kNumBins - 1; split > 0; --split) {
+      right_box.min = right_box.min.cwiseMin(bin_boxes[axis][split].min);
+      right_box.max = right_box.max.cwiseMax(bin_boxes[axis][split].max);
+      right_count += bin_counts[axis][split];
+      right_costs[split] =
+          ComputeHalfArea(right_box.min, right_box.max) * right_count;
+    }
+    Box left_box = bin_boxes[axis][0];
+    int left_count = 0;
+    for (int split = 1; split < kNumBins; ++split) {
+      left_box.min = left_box.min.cwiseMin(bin_boxes[axis][split - 1].min);
+      left_box.max = left_box.max.cwiseMax(bin_boxes[axis][split - 1].max);
+      left_count += bin_counts[axis][split - 1];
+      if (left_count == 0 || left_count == num_objects) {
+        continue;
+      }
+      const float cost = kTraversalCost + kIntersectionCost * inverse_area *
+          (ComputeHalfArea(left_box.min, left_box.max) * left_count +
+           right_costs[split]);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = split;
+      }
+    }
+  }
+  if (best_axis < 0 && num_objects <= kMaxLeafSize) {
+    return node_index;
+  }
+
+  int middle;
+  if (best_axis >= 0) {
+    const float axis_min = centroid_min[best_axis];
+    const float axis_bin_scale = bin_scale[best_axis];
+    middle = std::partition(
+        build_references_.begin() + begin, build_references_.begin() + end,
+        [&](const BuildReference& reference) {
+          return ComputeBin(reference.centroid[best_axis], axis_min,
+                            axis_bin_scale) < best_split;
+        }) - build_references_.begin();
+  } else {
+    int axis;
+    (centroid_max - centroid_min).maxCoeff(&axis);
+    middle = begin + num_objects / 2;
+    std::nth_element(
+        build_references_.begin() + begin,
+        build_references_.begin() + middle, build_references_.begin() + end,
+        [&](const BuildReference& a, const BuildReference& b) {
+          return a.centroid[axis] < b.centroid[axis];
+        });
+  }
+  const int left_child = BuildNode(begin, middle);
+  parents_[left_child] = node_index;
+  const int right_child = BuildNode(middle, end);
+  parents_[right_child] = node_index;
+  nodes_[node_index].right_child = right_child;
+  return node_index;
+}
+
+void SceneBvh::UpdateObjectBox(const int object) {
+  Eigen::Vector3f center;
+  Eigen::Vector3f extent;
+  ComputeWorldBox(models_[object], &center, &extent);
+  boxes_[object].min = center - extent;
+  boxes_[object].max = center + extent;
+}
+
+void SceneBvh::RefitNode(const int node_index) {
+  Node& node = nodes_[node_index];
+  node_cost_sum_ -= ComputeNodeCost(node);
+  if (node.right_child == 0) {
+    node.box = boxes_[node.first_object];
+    for (int i = node.first_object + 1;
+         i < node.first_object + node.num_objects; ++i) {
+      node.box.min = node.box.min.cwiseMin(boxes_[i].min);
+      node.box.max = node.box.max.cwiseMax(boxes_[i].max);
+    }
+  } else {
+    const Box& left_box = nodes_[node_index + 1].box;
+    const Box& right_box = nodes_[node.right_child].box;
+    node.box.min = left_box.min.cwiseMin(right_box.min);
+    node.box.max = left_box.max.cwiseMax(right_box.max);
+  }
+  node_cost_sum_ += ComputeNodeCost(node);
+}
+
+double SceneBvh::ComputeNodeCost(const Node& node) const {
+  const double area = ComputeHalfArea(node.box.min, node.box.max);
+  return node.right_child == 0 ?
+      area * kIntersectionCost * node.num_objects : area * kTraversalCost;
+}
+
+float SceneBvh::ComputeSahCost() const {
+  if (nodes_.empty()) {
+    return 0.0f;
+  }
+  const double root_area =
+      ComputeHalfArea(nodes_[0].box.min, nodes_[0].box.max);
+  return root_area > 0.0 ? node_cost_sum_ / root_area : 0.0f;
+}
+
+}  // namespace wvu
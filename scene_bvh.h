@@ -0,0 +1,236 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef SCENE_BVH_H_
+#define SCENE_BVH_H_
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "frustum_culler.h"
+#include "model.h"
+
+namespace wvu {
+// Bounding volume hierarchy over the models of a scene, for culling and ray
+// queries that do not visit every model. The leaves hold the world-space
+// bounding boxes of the models (the box of their mesh moved with the model
+// matrix, as in wvu::FrustumCuller). The tree is built top-down with a binned
+// surface area heuristic (SAH).
+//
+// The models tell the BVH when set_position() or set_orientation() moves them,
+// and Update() refits only the leaves of the moved models and their ancestors.
+// Refitting keeps the tree valid but its boxes grow apart as the models move,
+// so the SAH cost of the tree is kept up to date while refitting, and the tree
+// is rebuilt when it exceeds the cost after the last build by the rebuild
+// threshold.
+//
+// Example:
+//
+// wvu::SceneBvh scene_bvh;
+// scene_bvh.Build(models);
+// while (...) {  // Rendering loop.
+//   for (Model* model : scene_bvh.Cull(projection * view)) {
+//     model->Draw(shader_program);
+//   }
+// }
+// Model* model = scene_bvh.Raycast(origin, direction, &distance);
+// ...
+// scene_bvh.Clear();  // Before deleting the models.
+class SceneBvh {
+ public:
+  // Statistics of the BVH.
+  struct Stats {
+    // Number of nodes and leaves of the tree.
+    int num_nodes;
+    int num_leaves;
+    // Number of builds, including the rebuilds by Update(), and of refits.
+    int num_builds;
+    int num_rebuilds;
+    int num_refits;
+    // Number of nodes updated by the last refit.
+    int num_refitted_nodes;
+    // SAH cost of the tree after the last build and now: the expected number
+    // of node visits and box tests of a random ray hitting the root.
+    float build_sah_cost;
+    float sah_cost;
+    // Visible and culled models, counted as by wvu::FrustumCuller.
+    FrustumCuller::Stats culling;
+    // Number of nodes visited by the last call to Cull() or Raycast().
+    int num_visited_nodes;
+  };
+
+  SceneBvh();
+  // Does not touch the models, which may be deleted already; call Clear()
+  // first if they outlive the BVH.
+  ~SceneBvh();
+
+  // Builds the tree over the models, replacing the previous one. The models
+  // must have a mesh and outlive the BVH, or Clear().
+  void Build(const std::vector<Model*>& models);
+
+  // Removes the models from the BVH, so that they stop notifying it.
+  void Clear();
+
+  // Records that a model moved. Called by the models.
+  // Params:
+  //   object  Index of the model in the BVH.
+  void MarkMoved(const int object);
+
+  // Refits the boxes of the models that moved since the last update, and
+  // rebuilds the tree if its SAH cost grew past the rebuild threshold. Returns
+  // true if the tree was rebuilt.
+  bool Update();
+
+  // Returns the models whose bounding box intersects the view frustum, in
+  // the order of the leaves of the tree. Calls Update() first. The returned
+  // vector is valid until the next call. The order follows space, not the
+  // order of Build(), so callers drawing the models by material must group
+  // them again.
+  // Params:
+  //   view_projection  The projection matrix times the view matrix.
+  const std::vector<Model*>& Cull(const Eigen::Matrix4f& view_projection);
+
+  // Returns the closest model hit by the ray, or null. The ray is tested
+  // against the bounding box of the mesh of each candidate in model space,
+  // which fits better than the world-space box. Calls Update() first.
+  // Params:
+  //   origin  The start of the ray.
+  //   direction  The direction of the ray. It does not need to be unit.
+  //   distance  If not null, receives the distance from the origin to the hit.
+  Model* Raycast(const Eigen::Vector3f& origin,
+                 const Eigen::Vector3f& direction,
+                 float* distance);
+
+  // Same as Raycast(), but the ray is then tested against the triangles of
+  // the meshes whose box it hits, so it passes through the empty parts of the
+  // boxes. The vertices and indices of the meshes are read on the CPU.
+  Model* RaycastTriangles(const Eigen::Vector3f& origin,
+                          const Eigen::Vector3f& direction,
+                          float* distance);
+
+  // Sets the growth of the SAH cost over the cost after the last build that
+  // makes Update() rebuild the tree. The default is 1.5.
+  void set_rebuild_threshold(const float rebuild_threshold) {
+    rebuild_threshold_ = rebuild_threshold;
+  }
+
+  // Returns the number of models in the BVH.
+  int num_models() const {
+    return models_.size();
+  }
+
+  // Returns the statistics of the BVH.
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  // Axis-aligned box.
+  struct Box {
+    Eigen::Vector3f min;
+    Eigen::Vector3f max;
+  };
+
+  // Model being built into the tree: its world-space box, the center of the
+  // box, and its index in the input of Build().
+  struct BuildReference {
+    Box box;
+    Eigen::Vector3f centroid;
+    int object;
+  };
+
+  // Node of the tree. The nodes are stored in depth-first order: the left
+  // child of an inner node follows it. The models of a node are the range
+  // [first_object, first_object + num_objects) of models_.
+  struct Node {
+    Box box;
+    int first_object;
+    int num_objects;
+    // Index of the right child, or zero for the leaves.
+    int right_child;
+  };
+
+  // Implements Raycast() and RaycastTriangles(): after the box of a mesh is
+  // hit, tests its triangles if test_triangles is true.
+  Model* TraceRay(const Eigen::Vector3f& origin,
+                  const Eigen::Vector3f& direction,
+                  const bool test_triangles,
+                  float* distance);
+  // Builds the subtree over the references [begin, end), and
+  // returns the index of its root.
+  int BuildNode(const int begin, const int end);
+  // Recomputes the world-space box of a model from its pose.
+  void UpdateObjectBox(const int object);
+  // Moves the box of a node to the union of its objects' or children's boxes,
+  // and updates the SAH cost.
+  void RefitNode(const int node);
+  // Returns the contribution of a node to the unnormalized SAH cost.
+  double ComputeNodeCost(const Node& node) const;
+  // Returns the SAH cost of the tree.
+  float ComputeSahCost() const;
+
+  std::vector<Node> nodes_;
+  // Parent of every node; -1 for the root.
+  std::vector<int> parents_;
+  // Models in the order of the leaves, their world-space boxes, and the leaf
+  // holding each.
+  std::vector<Model*> models_;
+  std::vector<Box> boxes_;
+  std::vector<int> leaves_;
+  // Moved models waiting for Update(), and a flag per model telling whether
+  // it is in the list.
+  std::vector<int> moved_objects_;
+  std::vector<unsigned char> moved_;
+  // Nodes to refit, and a flag per node telling whether it is in the list.
+  std::vector<int> refit_nodes_;
+  std::vector<unsigned char> refit_flags_;
+  // Models being built, in the order of the leaves once the build is done.
+  std::vector<BuildReference> build_references_;
+  // Sum of the costs of the nodes; divided by the area of the root it gives
+  // the SAH cost.
+  double node_cost_sum_;
+  float rebuild_threshold_;
+  // Visible models returned by Cull().
+  std::vector<Model*> visible_models_;
+  Stats stats_;
+
+  SceneBvh(const SceneBvh&) = delete;
+  SceneBvh& operator=(const SceneBvh&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // SCENE_BVH_H_
@@ -36,12 +36,17 @@
 
 #include "shader_program.h"
 
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <initializer_list>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <GL/glew.h>
 
+#include "program_binary_cache.h"
+
 namespace wvu {
 namespace {
 // Buffer size for the error log info.
@@ -50,20 +55,17 @@ constexpr int kNumCharsInfoLog = 512;
 // Enumeration to select the shader types.
 enum ShaderType {
   VERTEX = 0,
-  FRAGMENT = 1
+  FRAGMENT = 1,
+  COMPUTE = 2
 };
 
-// Compiles a shader that is contained in shader_src C++ string. The shader type
-// determines what shader we should compile. This function retrieves the errors
-// in case of compilation errors and stores it into info_log. This function
-// returns the shader id if successful, otherwise it returns zero.
+// Submits the compilation of a shader that is contained in shader_src C++
+// string. The shader type determines what shader we should compile. This
+// function does not wait for the compilation to finish; use
+// CheckShaderCompileStatus() to retrieve the result. This function returns the
+// shader id.
 GLuint CompileShader(const std::string& shader_src,
-                     const ShaderType shader_type,
-                     std::string* info_log) {
-    if(info_log == nullptr){
-        std::cout << "Null pointer passed. Could not compile shader";
-        return -1;
-    }
+                     const ShaderType shader_type) {
   // Create an id for shader using OpenGL glCreateShader().
   GLuint shader_id = 0;
   switch (shader_type) {
@@ -73,6 +75,9 @@ GLuint CompileShader(const std::string& shader_src,
     case FRAGMENT:
       shader_id = glCreateShader(GL_FRAGMENT_SHADER);
       break;
+    case COMPUTE:
+      shader_id = glCreateShader(GL_COMPUTE_SHADER);
+      break;
   }
   // Retrieving the pointer to the C string wrapped by shader_src.
   // This is to comply with the signature of glShaderSource() function.
@@ -80,9 +85,16 @@ GLuint CompileShader(const std::string& shader_src,
   // Associates the vertex shader id with the vertex shader source pointed
   // by vertex_shader_src_ptr.
   glShaderSource(shader_id, 1, &shader_src_ptr, nullptr);
-  // Compile the shader.
+  // Compile the shader. Querying the status right away would make the driver
+  // wait until the compilation finishes, so we do it later.
   glCompileShader(shader_id);
-  // Verify if the compilation was successful.
+  return shader_id;
+}
+
+// Verifies if the compilation of the shader was successful. This function
+// retrieves the errors in case of compilation errors and stores it into
+// info_log. Returns true if successful, and false otherwise.
+bool CheckShaderCompileStatus(const GLuint shader_id, std::string* info_log) {
   GLint success = 0;
   // Retrieve if the compilation was successful. The function returns a non-zero
   // value in success if successful. Otherwise, it does not modify success.
@@ -90,63 +102,111 @@ GLuint CompileShader(const std::string& shader_src,
   // If it is successful, success becomes a non-zero number. Also, if the user
   // provided a valid C++ string to store the error log info then we extract
   // the error log info from OpenGL.
-  if (!success) {
-    if (info_log) {
-      // Allocate the number of chars in the string.
-      info_log->resize(kNumCharsInfoLog);
-      // Retrieve the error ingo log.
-      glGetShaderInfoLog(shader_id, kNumCharsInfoLog, nullptr,
-                         &info_log->front());
-    }
-    return 0;
+  if (!success && info_log) {
+    // Allocate the number of chars in the string.
+    info_log->resize(kNumCharsInfoLog);
+    // Retrieve the error ingo log.
+    glGetShaderInfoLog(shader_id, kNumCharsInfoLog, nullptr,
+                       &info_log->front());
   }
-  return shader_id;
+  return success != 0;
 }
 
-// Creates a shader program. This function requires the ids of the vertex and
-// fragment shaders which were successfully compiled. The function can return
-// the error info log string in case of a failure. The function returns the
-// shader program id if successfull, and returns zero otherwise.
+// Submits the creation of a shader program. This function requires the ids of
+// the shaders which were submitted for compilation: the vertex and fragment
+// shaders, or the compute shader. The shaders that are 0 are skipped. When
+// retrievable_binary is true, the binary of the program can be retrieved after
+// linking. This function does not wait for the linkage to finish; use
+// CheckProgramLinkStatus() to retrieve the result. The function returns the
+// shader program id.
 GLuint CreateShaderProgram(const GLuint vertex_shader,
                            const GLuint fragment_shader,
-                           std::string* info_log) {
-    if(info_log == nullptr){
-        std::cout << "Null pointer passed.  Could not create shader program.";
-        return -1;
-    }
+                           const GLuint compute_shader,
+                           const bool retrievable_binary) {
   // Create a program id.
   const GLuint shader_program = glCreateProgram();
   // Attach to the program the vertex shader.
-  glAttachShader(shader_program, vertex_shader);
+  if (vertex_shader != 0) {
+    glAttachShader(shader_program, vertex_shader);
+  }
   // Attach to the program the fragment shader.
-  glAttachShader(shader_program, fragment_shader);
+  if (fragment_shader != 0) {
+    glAttachShader(shader_program, fragment_shader);
+  }
+  // Attach to the program the compute shader.
+  if (compute_shader != 0) {
+    glAttachShader(shader_program, compute_shader);
+  }
+  // Let the driver know that we will retrieve the binary of the program.
+  if (retrievable_binary) {
+    glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+  }
   // Link the both shaders to get a shader program.
   glLinkProgram(shader_program);
-  // Check if the operation was successful.
+  return shader_program;
+}
+
+// Verifies if the linkage of the shader program was successful. The function
+// can return the error info log string in case of a failure. Returns true if
+// successful, and false otherwise.
+bool CheckProgramLinkStatus(const GLuint shader_program,
+                            std::string* info_log) {
   GLint success = 0;
   // Get the status of the linkage procedure. The function returns a non-zero
   // value in success if successful. Otherwise, it does not modify success.
   glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-  if (!success) {
-    if (info_log) {
-      // Allocate the number of chars in the string.
-      info_log->resize(kNumCharsInfoLog);
-      // Retrieve the error ingo log.
-      glGetProgramInfoLog(shader_program, kNumCharsInfoLog, nullptr,
-                          &info_log->front());
+  if (!success && info_log) {
+    // Allocate the number of chars in the string.
+    info_log->resize(kNumCharsInfoLog);
+    // Retrieve the error ingo log.
+    glGetProgramInfoLog(shader_program, kNumCharsInfoLog, nullptr,
+                        &info_log->front());
+  }
+  return success != 0;
+}
+
+// Returns true if the driver compiles and links shaders in the background and
+// lets us poll for completion (GL_KHR_parallel_shader_compile). The first call
+// also asks the driver to use as many compiler threads as it wants.
+bool IsParallelShaderCompileSupported() {
+  static int supported = -1;
+  if (supported < 0) {
+    supported = 0;
+#ifdef GL_KHR_parallel_shader_compile
+    if (GLEW_KHR_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+      supported = 1;
     }
-    return 0;
+#endif
   }
-  return shader_program;
+  return supported == 1;
+}
+
+// Returns true if the driver finished compiling and linking the program. This
+// function never blocks when parallel shader compilation is supported.
+// Otherwise, it reports that the build is complete; querying the link status
+// afterwards blocks until it is.
+bool IsProgramBuildComplete(const GLuint shader_program) {
+#ifdef GL_KHR_parallel_shader_compile
+  if (IsParallelShaderCompileSupported()) {
+    GLint completed = GL_FALSE;
+    glGetProgramiv(shader_program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed != GL_FALSE;
+  }
+#endif
+  return true;
 }
 
 // Releases the resources allocated for compilation of shaders.
 // Clear the shader sources strings.
 void ReleaseShaderResources(const GLuint vertex_shader,
-                            const GLuint fragment_shader) {
-  // Delete shaders and set them to 0.
+                            const GLuint fragment_shader,
+                            const GLuint compute_shader) {
+  // Delete shaders and set them to 0. Deleting 0 is ignored.
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
+  glDeleteShader(compute_shader);
 }
 
 // Loads a shader source from a file. The function receives the filepath
@@ -175,6 +235,50 @@ bool LoadShaderFromFile(const std::string& filepath,
   return true;
 }
 
+// Inserts the define directives right after the #version directive of the
+// shader source. The #version directive must be the first one in a shader.
+std::string InsertDefineDirectives(const std::string& shader_src,
+                                   const std::string& define_directives) {
+  if (define_directives.empty()) return shader_src;
+  const std::string::size_type version = shader_src.find("#version");
+  if (version == std::string::npos) return define_directives + shader_src;
+  const std::string::size_type end_of_line = shader_src.find('\n', version);
+  if (end_of_line == std::string::npos) {
+    return shader_src + "\n" + define_directives;
+  }
+  return shader_src.substr(0, end_of_line + 1) + define_directives +
+      shader_src.substr(end_of_line + 1);
+}
+
+// Removes the "[0]" suffix that OpenGL appends to the names of arrays.
+std::string RemoveArraySuffix(const std::string& name) {
+  const std::string::size_type bracket = name.find('[');
+  return bracket == std::string::npos ? name : name.substr(0, bracket);
+}
+
+// Returns true if a uniform of the given type is set with glUniform1i().
+bool IsIntUniformType(const GLenum type) {
+  switch (type) {
+    case GL_INT:
+    case GL_BOOL:
+    case GL_SAMPLER_1D:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_2D_SHADOW:
+    case GL_SAMPLER_1D_ARRAY:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_BUFFER:
+    case GL_INT_SAMPLER_2D:
+    case GL_UNSIGNED_INT_SAMPLER_2D:
+    case GL_INT_SAMPLER_2D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+      return true;
+    default:
+      return false;
+  }
+}
+
 }  // namespace
 
 bool ShaderProgram::LoadVertexShaderFromString(
@@ -189,6 +293,12 @@ bool ShaderProgram::LoadFragmentShaderFromString(
   return true;
 }
 
+bool ShaderProgram::LoadComputeShaderFromString(
+    const std::string& compute_shader_source) {
+  compute_shader_src_ = compute_shader_source;
+  return true;
+}
+
 bool ShaderProgram::LoadVertexShaderFromFile(
     const std::string& vertex_shader_path) {
   return LoadShaderFromFile(vertex_shader_path, &vertex_shader_src_);
@@ -199,6 +309,29 @@ bool ShaderProgram::LoadFragmentShaderFromFile(
   return LoadShaderFromFile(fragment_shader_path, &fragment_shader_src_);
 }
 
+void ShaderProgram::AddDefine(const std::string& name,
+                              const std::string& value) {
+  defines_.push_back(std::make_pair(name, value));
+}
+
+std::string ShaderProgram::GetDefineDirectives() const {
+  std::string define_directives;
+  for (const std::pair<std::string, std::string>& define : defines_) {
+    define_directives += "#define " + define.first + " " + define.second + "\n";
+  }
+  return define_directives;
+}
+
+bool ShaderProgram::LoadProgramFromBinaryCache(const std::string& key) {
+  const GLuint shader_program = glCreateProgram();
+  if (!binary_cache_->Load(key, shader_program)) {
+    glDeleteProgram(shader_program);
+    return false;
+  }
+  shader_program_id_ = shader_program;
+  return true;
+}
+
 bool ShaderProgram::Create(std::string* error_info_log) {
   // If an instance of this class already created a shader program, the Create()
   // method will report true. No need to build again. If different shader
@@ -208,53 +341,269 @@ bool ShaderProgram::Create(std::string* error_info_log) {
         return false;
     }
     if (created_) return true;
-  std::string info_log;
-  if (!BuildVertexShader(&info_log)) {
-    if (error_info_log) {
-      *error_info_log = info_log;
-    }
+  if (!BeginCreate()) {
+    *error_info_log = "The shader program failed to build.";
     return false;
   }
-  if (!BuildFragmentShader(&info_log)) {
-    if (error_info_log) {
-      *error_info_log = info_log;
+  // Wait for the driver to finish the build.
+  return FinishBuild(error_info_log);
+}
+
+bool ShaderProgram::BeginCreate() {
+  if (created_ || build_pending_) return true;
+  if (build_failed_) return false;
+  // Try the binary cache first. Loading a binary does not need to be
+  // compiled, so the program is ready right away.
+  binary_cache_key_.clear();
+  if (binary_cache_ != nullptr && binary_cache_->IsSupported()) {
+    binary_cache_key_ = binary_cache_->ComputeKey(vertex_shader_src_,
+                                                  fragment_shader_src_ +
+                                                  compute_shader_src_,
+                                                  GetDefineDirectives());
+    if (LoadProgramFromBinaryCache(binary_cache_key_)) {
+      ReflectActiveVariables();
+      BindSharedUniformBlocks();
+      created_ = true;
+      return true;
     }
-    return false;
   }
-  if (!LinkProgram(&info_log)) {
-    if (error_info_log) {
-      *error_info_log = info_log;
+  IsParallelShaderCompileSupported();
+  build_start_ = std::chrono::steady_clock::now();
+  if (compute_shader_src_.empty()) {
+    BuildVertexShader();
+    BuildFragmentShader();
+  } else {
+    BuildComputeShader();
+  }
+  LinkProgram();
+  build_pending_ = true;
+  return true;
+}
+
+ShaderProgram::BuildStatus ShaderProgram::PollCreate(
+    std::string* error_info_log) {
+  if (created_) return BuildStatus::kReady;
+  if (!build_pending_ && !BeginCreate()) return BuildStatus::kFailed;
+  if (created_) return BuildStatus::kReady;
+  if (!IsProgramBuildComplete(shader_program_id_)) {
+    return BuildStatus::kPending;
+  }
+  return FinishBuild(error_info_log) ?
+      BuildStatus::kReady : BuildStatus::kFailed;
+}
+
+bool ShaderProgram::FinishBuild(std::string* info_log) {
+  if (created_) return true;
+  if (!build_pending_) return false;
+  build_pending_ = false;
+  // Query the link status first. If the link failed, find out whether one of
+  // the shaders failed to compile to report the most useful error.
+  std::string link_info_log;
+  const bool linked =
+      CheckProgramLinkStatus(shader_program_id_, &link_info_log);
+  if (!linked) {
+    std::string compile_info_log;
+    for (const GLuint shader :
+             { vertex_shader_, fragment_shader_, compute_shader_ }) {
+      if (shader != 0 &&
+          !CheckShaderCompileStatus(shader, &compile_info_log)) {
+        link_info_log = compile_info_log;
+        break;
+      }
+    }
+  }
+  ReleaseShaderResources(vertex_shader_, fragment_shader_, compute_shader_);
+  vertex_shader_ = 0;
+  fragment_shader_ = 0;
+  compute_shader_ = 0;
+  if (!linked) {
+    if (info_log) {
+      *info_log = link_info_log;
     }
+    glDeleteProgram(shader_program_id_);
+    shader_program_id_ = 0;
+    build_failed_ = true;
     return false;
   }
+  if (!binary_cache_key_.empty()) {
+    const double build_time_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - build_start_).count();
+    binary_cache_->Store(binary_cache_key_, shader_program_id_, build_time_ms);
+  }
+  ReflectActiveVariables();
+  BindSharedUniformBlocks();
   created_ = true;
   return true;
 }
 
-bool ShaderProgram::BuildVertexShader(std::string* info_log) {
-    if(info_log == nullptr){
-        std::cout << "Null pointer passed.  Could not build vertex shader.";
-        return false;
-    }
-  vertex_shader_ = CompileShader(vertex_shader_src_, VERTEX, info_log);
-  return vertex_shader_ != 0;
+void ShaderProgram::BuildVertexShader() {
+  vertex_shader_ = CompileShader(
+      InsertDefineDirectives(vertex_shader_src_, GetDefineDirectives()),
+      VERTEX);
 }
 
-bool ShaderProgram::BuildFragmentShader(std::string* info_log) {
-    if(info_log == nullptr){
-        std::cout << "Null pointer passed.  Could not build fragment shader.";
-        return false;
-    }
-  fragment_shader_ = CompileShader(fragment_shader_src_, FRAGMENT, info_log);
-  return fragment_shader_ != 0;
+void ShaderProgram::BuildFragmentShader() {
+  fragment_shader_ = CompileShader(
+      InsertDefineDirectives(fragment_shader_src_, GetDefineDirectives()),
+      FRAGMENT);
+}
+
+void ShaderProgram::BuildComputeShader() {
+  compute_shader_ = CompileShader(
+      InsertDefineDirectives(compute_shader_src_, GetDefineDirectives()),
+      COMPUTE);
 }
 
-bool ShaderProgram::LinkProgram(std::string* info_log) {
+void ShaderProgram::LinkProgram() {
   shader_program_id_ = CreateShaderProgram(vertex_shader_,
                                            fragment_shader_,
-                                           info_log);
-  ReleaseShaderResources(vertex_shader_, fragment_shader_);
-  return shader_program_id_ != 0;
+                                           compute_shader_,
+                                           binary_cache_ != nullptr &&
+                                           binary_cache_->IsSupported());
+}
+
+void ShaderProgram::ReflectActiveVariables() {
+  uniforms_.clear();
+  uniform_handles_.clear();
+  attributes_.clear();
+  // Reflect the active uniforms.
+  GLint num_uniforms = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_UNIFORMS, &num_uniforms);
+  GLint max_name_length = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_UNIFORM_MAX_LENGTH,
+                 &max_name_length);
+  std::vector<GLchar> name_buffer(max_name_length + 1);
+  for (GLint i = 0; i < num_uniforms; ++i) {
+    ShaderVariable uniform;
+    GLsizei name_length = 0;
+    glGetActiveUniform(shader_program_id_, i, name_buffer.size(), &name_length,
+                       &uniform.size, &uniform.type, name_buffer.data());
+    const std::string full_name(name_buffer.data(), name_length);
+    uniform.name = RemoveArraySuffix(full_name);
+    uniform.location =
+        glGetUniformLocation(shader_program_id_, full_name.c_str());
+    uniform_handles_[uniform.name] = uniforms_.size();
+    uniforms_.push_back(uniform);
+  }
+  uniform_values_.assign(uniforms_.size(), std::vector<unsigned char>());
+  // Reflect the active attributes.
+  GLint num_attributes = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_ATTRIBUTES, &num_attributes);
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH,
+                 &max_name_length);
+  name_buffer.resize(max_name_length + 1);
+  for (GLint i = 0; i < num_attributes; ++i) {
+    ShaderVariable attribute;
+    GLsizei name_length = 0;
+    glGetActiveAttrib(shader_program_id_, i, name_buffer.size(), &name_length,
+                      &attribute.size, &attribute.type, name_buffer.data());
+    const std::string full_name(name_buffer.data(), name_length);
+    attribute.name = RemoveArraySuffix(full_name);
+    attribute.location =
+        glGetAttribLocation(shader_program_id_, full_name.c_str());
+    attributes_.push_back(attribute);
+  }
+}
+
+void ShaderProgram::BindSharedUniformBlocks() {
+  const GLuint camera_block_index =
+      glGetUniformBlockIndex(shader_program_id_, "Camera");
+  if (camera_block_index != GL_INVALID_INDEX) {
+    glUniformBlockBinding(shader_program_id_, camera_block_index,
+                          kCameraUniformBlockBinding);
+  }
+}
+
+UniformHandle ShaderProgram::uniform_handle(const std::string& name) const {
+  const std::unordered_map<std::string, UniformHandle>::const_iterator it =
+      uniform_handles_.find(name);
+  return it == uniform_handles_.end() ? kInvalidUniformHandle : it->second;
+}
+
+GLint ShaderProgram::attribute_location(const std::string& name) const {
+  for (const ShaderVariable& attribute : attributes_) {
+    if (attribute.name == name) return attribute.location;
+  }
+  return -1;
+}
+
+bool ShaderProgram::UpdateCachedUniformValue(
+    const UniformHandle handle,
+    const void* value,
+    const size_t value_size_in_bytes) const {
+  std::vector<unsigned char>& cached_value = uniform_values_[handle];
+  if (cached_value.size() == value_size_in_bytes &&
+      std::memcmp(cached_value.data(), value, value_size_in_bytes) == 0) {
+    ++num_skipped_uniform_uploads_;
+    return false;
+  }
+  const unsigned char* value_bytes = static_cast<const unsigned char*>(value);
+  cached_value.assign(value_bytes, value_bytes + value_size_in_bytes);
+  ++num_uniform_uploads_;
+  return true;
+}
+
+bool ShaderProgram::SetUniformInt(const UniformHandle handle,
+                                  const GLint value) const {
+  if (handle < 0 || handle >= static_cast<int>(uniforms_.size()) ||
+      !IsIntUniformType(uniforms_[handle].type)) {
+    return false;
+  }
+  if (UpdateCachedUniformValue(handle, &value, sizeof(value))) {
+    glUniform1i(uniforms_[handle].location, value);
+  }
+  return true;
+}
+
+bool ShaderProgram::SetUniformFloat(const UniformHandle handle,
+                                    const GLfloat value) const {
+  if (handle < 0 || handle >= static_cast<int>(uniforms_.size()) ||
+      uniforms_[handle].type != GL_FLOAT) {
+    return false;
+  }
+  if (UpdateCachedUniformValue(handle, &value, sizeof(value))) {
+    glUniform1f(uniforms_[handle].location, value);
+  }
+  return true;
+}
+
+bool ShaderProgram::SetUniformVector3(const UniformHandle handle,
+                                      const GLfloat* values) const {
+  if (handle < 0 || handle >= static_cast<int>(uniforms_.size()) ||
+      uniforms_[handle].type != GL_FLOAT_VEC3 || values == nullptr) {
+    return false;
+  }
+  if (UpdateCachedUniformValue(handle, values,
+                               3 * sizeof(values[0]))) {
+    glUniform3fv(uniforms_[handle].location, 1, values);
+  }
+  return true;
+}
+
+bool ShaderProgram::SetUniformVector4(const UniformHandle handle,
+                                      const GLfloat* values) const {
+  if (handle < 0 || handle >= static_cast<int>(uniforms_.size()) ||
+      uniforms_[handle].type != GL_FLOAT_VEC4 || values == nullptr) {
+    return false;
+  }
+  if (UpdateCachedUniformValue(handle, values,
+                               4 * sizeof(values[0]))) {
+    glUniform4fv(uniforms_[handle].location, 1, values);
+  }
+  return true;
+}
+
+bool ShaderProgram::SetUniformMatrix4(const UniformHandle handle,
+                                      const GLfloat* values) const {
+  if (handle < 0 || handle >= static_cast<int>(uniforms_.size()) ||
+      uniforms_[handle].type != GL_FLOAT_MAT4 || values == nullptr) {
+    return false;
+  }
+  if (UpdateCachedUniformValue(handle, values,
+                               16 * sizeof(values[0]))) {
+    glUniformMatrix4fv(uniforms_[handle].location, 1, GL_FALSE, values);
+  }
+  return true;
 }
 
 }  // namespace wvu
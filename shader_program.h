@@ -37,16 +37,50 @@
 #ifndef GLUTILS_SHADER_PROGRAM_H_
 #define GLUTILS_SHADER_PROGRAM_H_
 
+#include <chrono>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <GL/glew.h>
 
 namespace wvu {
-// This class helps with the compilation of vertex and fragment shaders. The
-// class compiles the shaders and creates a shader program. The class keeps
-// the id of such a compiled and linked program. The class also provides a way
-// to use the shader by calling the Use() member function.
-// The class can load shaders from file or accept C++ strings holding the
-// contents of the shader.
+class ProgramBinaryCache;
+
+// Handle to an active uniform variable of a shader program. A handle is the
+// index of the uniform in the table that ShaderProgram::Create() fills by
+// reflecting the linked program, so setting a uniform through a handle needs no
+// string lookup and no round-trip to the driver.
+typedef int UniformHandle;
+// Handle returned when the shader program has no active uniform with the
+// requested name. Setting a uniform through this handle does nothing.
+constexpr UniformHandle kInvalidUniformHandle = -1;
+
+// Uniform buffer binding point of the "Camera" uniform block (see
+// camera_uniform_buffer.h). Create() binds the block of every program that
+// declares it to this binding point.
+constexpr GLuint kCameraUniformBlockBinding = 0;
+
+// Active uniform or attribute of a linked shader program.
+struct ShaderVariable {
+  // Name of the variable. For arrays, the name does not include the "[0]"
+  // suffix that OpenGL reports.
+  std::string name;
+  // Type of the variable (e.g., GL_FLOAT_MAT4, GL_SAMPLER_2D).
+  GLenum type;
+  // Number of elements. Larger than one only for arrays.
+  GLint size;
+  // Location of the variable. Uniforms that live in a uniform block have no
+  // location (-1).
+  GLint location;
+};
+
+// This class helps with the compilation of vertex and fragment shaders, or of
+// a compute shader. The class compiles the shaders and creates a shader
+// program. The class keeps the id of such a compiled and linked program. The
+// class also provides a way to use the shader by calling the Use() member
+// function. The class can load shaders from file or accept C++ strings holding
+// the contents of the shader.
 // To use the class simply create an instance, load shaders from string or files
 // and then call the Create() function.
 // When the user desires to use the shader, the member function Use() should be
@@ -83,31 +117,57 @@ namespace wvu {
 // }
 //
 // 4) Passing uniform variables to shader example:
-// When passing values to uniform variables in the shader program, the shader
-// program id is necessary. This class provides access to this id by calling the
-// accessor method shader_program_id().
+// Create() reflects the active uniforms of the program once. Look up the handle
+// of a uniform outside the rendering loop and set its value through the handle
+// while the shader program is in use. Uploads of values equal to the last
+// uploaded ones are skipped.
 //
+//  const wvu::UniformHandle model_handle =
+//     shader_program.uniform_handle("model");
 //  ...
-//  const GLint uniform_variable_location =
-//     glGetUniformLocation(shader_program_.shader_program_id(),
-//                          "uniform_variable_name");
-//  ...
+//  while (...) {  // Rendering loop.
+//    shader_program.Use();
+//    shader_program.SetUniformMatrix4(model_handle, model.data());
+//    ...
+//  }
+//
+// The shader program id is also available through the accessor method
+// shader_program_id() to call OpenGL functions directly. Note that values set
+// directly with glUniform*() bypass the cache of last uploaded values.
 class ShaderProgram {
  public:
   // Default constructor.
   ShaderProgram() :
       // Initializing member attributes.
       vertex_shader_src_(""), fragment_shader_src_(""),
-      vertex_shader_(0), fragment_shader_(0), shader_program_id_(0),
-      created_(false) {}
+      compute_shader_src_(""), vertex_shader_(0), fragment_shader_(0),
+      compute_shader_(0), shader_program_id_(0),
+      created_(false), build_pending_(false), build_failed_(false),
+      binary_cache_(nullptr), num_uniform_uploads_(0),
+      num_skipped_uniform_uploads_(0) {}
   // Destructor. Invoked automatically once the instance goes out of scope.
   virtual ~ShaderProgram() {
-    if (created_) {
+    if (build_pending_) {
+      glDeleteShader(vertex_shader_);
+      glDeleteShader(fragment_shader_);
+      glDeleteShader(compute_shader_);
+    }
+    if (created_ || build_pending_) {
       // Once the shader program is not needed, we tell OpenGL to delete it.
       glDeleteProgram(shader_program_id_);
     }
   }
 
+  // State of a shader program built with BeginCreate() and PollCreate().
+  enum class BuildStatus {
+    // The driver is still compiling or linking the program.
+    kPending,
+    // The program is created and can be used.
+    kReady,
+    // The program failed to compile or link.
+    kFailed
+  };
+
   // The accessor member returns the shader program id that OpenGL generates
   // when creating the shader program. When the shader program has not been
   // created, the shader_program_id() returns 0.
@@ -140,14 +200,40 @@ class ShaderProgram {
   //   fragment_shader_path  The filepath for the fragment shader.
   bool LoadFragmentShaderFromFile(const std::string& fragment_shader_path);
 
+  // Loads a compute shader source code from a string. A program with a
+  // compute shader has no vertex or fragment shader; it is dispatched with
+  // glDispatchCompute() while in use. Requires OpenGL 4.3. Returns true if
+  // successful, and false otherwise.
+  // Parameters:
+  //   compute_shader_source  The C++ string containing the compute shader
+  //     source.
+  bool LoadComputeShaderFromString(const std::string& compute_shader_source);
+
+  // Adds a preprocessor define to both shaders. The defines are inserted right
+  // after the #version directive, so the same sources can build several
+  // program variants. Must be called before Create().
+  // Parameters:
+  //   name  The name of the macro.
+  //   value  The value of the macro. It can be empty.
+  void AddDefine(const std::string& name, const std::string& value);
+
+  // Sets the cache of program binaries used by Create(). When the cache holds
+  // a binary for the sources and defines of this program, Create() loads it
+  // instead of compiling and linking. Otherwise, Create() builds the program
+  // and stores its binary in the cache. The cache is not owned by this class.
+  void set_binary_cache(ProgramBinaryCache* binary_cache) {
+    binary_cache_ = binary_cache;
+  }
+
   // This function executes the following steps:
-  // 1. Compiles the vertex shader. If an error occurrs, the error information
-  //    log is copied into error_info_log pointer.
-  // 2. Compiles the fragment shader. If an error occurrs, the error information
-  //    log is copied into error_info_log pointer.
-  // 3. Links the shaders to form a shader program. If an error occurrs, the
+  // 1. Compiles the vertex shader.
+  // 2. Compiles the fragment shader.
+  // 3. Links the shaders to form a shader program.
+  // 4. Waits for the driver and checks for errors. If an error occurrs, the
   //    error information log is copied into error_info_log pointer.
-  // 4. Cleans up temporary variables.
+  // 5. Cleans up temporary variables.
+  // If a binary cache is set, the steps above are replaced by loading the
+  // cached binary when possible.
   // The function returns false when the creation of the program fails, and
   // returns true otherwise.
   //
@@ -155,6 +241,34 @@ class ShaderProgram {
   //  error_info_log  A pointer to a string that holds the error log.
   bool Create(std::string* error_info_log);
 
+  // Non-blocking version of Create(). BeginCreate() submits the compilation of
+  // the shaders and the linkage of the program to the driver without waiting
+  // for them, and PollCreate() reports whether the program is ready. Submit
+  // every program first and then poll them, so that drivers supporting
+  // GL_KHR_parallel_shader_compile build them in parallel while the renderer
+  // keeps drawing with a fallback program. On drivers without the extension,
+  // PollCreate() waits for the build to finish.
+  //
+  // Example:
+  //
+  // shader_program.BeginCreate();
+  // other_shader_program.BeginCreate();
+  // while (...) {  // Rendering loop.
+  //   if (shader_program.PollCreate(&error_info_log) ==
+  //       wvu::ShaderProgram::BuildStatus::kReady) {
+  //     ...  // Draw with shader_program.
+  //   } else {
+  //     ...  // Draw with the fallback program.
+  //   }
+  // }
+  //
+  // BeginCreate() returns false if a previous build of this program failed.
+  bool BeginCreate();
+  // Returns the state of the build started with BeginCreate(), which is
+  // started if needed. If the build failed, the error information log is
+  // copied into error_info_log (when not null).
+  BuildStatus PollCreate(std::string* error_info_log);
+
   // This function activates the shader as the current one in OpenGL.
   // Returns true if the function successfully activates the shader program.
   bool Use() const {
@@ -166,28 +280,128 @@ class ShaderProgram {
     return false;
   }
 
+  // Returns the handle of the active uniform with the given name, or
+  // kInvalidUniformHandle if the program has no such active uniform. This
+  // function does a string lookup, so call it once and keep the handle.
+  UniformHandle uniform_handle(const std::string& name) const;
+
+  // Returns the location of the active attribute with the given name, or -1 if
+  // the program has no such active attribute.
+  GLint attribute_location(const std::string& name) const;
+
+  // Returns the active uniforms, indexed by their handles.
+  const std::vector<ShaderVariable>& uniforms() const {
+    return uniforms_;
+  }
+
+  // Returns the active attributes.
+  const std::vector<ShaderVariable>& attributes() const {
+    return attributes_;
+  }
+
+  // The functions below set the value of a uniform variable of this shader
+  // program, which must be the one in use. The value is uploaded only if it
+  // differs from the last value uploaded through the same handle. The functions
+  // return false if the handle is invalid or if the type of the value does not
+  // match the type of the uniform.
+  // Sets an int, bool or sampler uniform.
+  bool SetUniformInt(const UniformHandle handle, const GLint value) const;
+  // Sets a float uniform.
+  bool SetUniformFloat(const UniformHandle handle, const GLfloat value) const;
+  // Sets a vec3 uniform from 3 floats.
+  bool SetUniformVector3(const UniformHandle handle,
+                         const GLfloat* values) const;
+  // Sets a vec4 uniform from 4 floats.
+  bool SetUniformVector4(const UniformHandle handle,
+                         const GLfloat* values) const;
+  // Sets a mat4 uniform from 16 floats in column-major order.
+  bool SetUniformMatrix4(const UniformHandle handle,
+                         const GLfloat* values) const;
+
+  // Number of uniform values uploaded to OpenGL through the setters above.
+  int num_uniform_uploads() const {
+    return num_uniform_uploads_;
+  }
+
+  // Number of uniform uploads skipped because the value did not change.
+  int num_skipped_uniform_uploads() const {
+    return num_skipped_uniform_uploads_;
+  }
+
+  // Resets the upload counters, e.g., at the beginning of a frame.
+  void ResetUniformUploadCounters() {
+    num_uniform_uploads_ = 0;
+    num_skipped_uniform_uploads_ = 0;
+  }
+
  protected:
-  // Compiles the vertex shader.
-  bool BuildVertexShader(std::string* info_log);
-  // Compiles the fragment shader.
-  bool BuildFragmentShader(std::string* info_log);
-  // Links the shaders to form a shader program.
-  bool LinkProgram(std::string* info_log);
+  // Loads the program from the binary cache. Returns true if successful.
+  bool LoadProgramFromBinaryCache(const std::string& key);
+  // Returns the defines of this program as preprocessor directives.
+  std::string GetDefineDirectives() const;
+  // Submits the compilation of the vertex shader.
+  void BuildVertexShader();
+  // Submits the compilation of the fragment shader.
+  void BuildFragmentShader();
+  // Submits the compilation of the compute shader.
+  void BuildComputeShader();
+  // Submits the linkage of the shaders to form a shader program.
+  void LinkProgram();
+  // Waits for the submitted build to finish, checks for errors and releases
+  // the shaders. Returns true if the program was created.
+  bool FinishBuild(std::string* info_log);
+  // Fills the tables of active uniforms and attributes of the linked program.
+  void ReflectActiveVariables();
+  // Binds the uniform blocks shared by all programs to their fixed binding
+  // points.
+  void BindSharedUniformBlocks();
+  // Compares the value with the last one uploaded through the handle and
+  // updates the cached value. Returns true if the value has to be uploaded.
+  bool UpdateCachedUniformValue(const UniformHandle handle,
+                                const void* value,
+                                const size_t value_size_in_bytes) const;
 
  private:
   // Vertex shader program source.
   std::string vertex_shader_src_;
   // Fragment shader program source.
   std::string fragment_shader_src_;
+  // Compute shader program source. Empty for vertex and fragment programs.
+  std::string compute_shader_src_;
   // Vertex shader id.
   GLuint vertex_shader_;
   // Fragment shader id.
   GLuint fragment_shader_;
+  // Compute shader id.
+  GLuint compute_shader_;
   // Program shader id.
   GLuint shader_program_id_;
   // Created state variable. True when this shader program is created, and false
   // otherwise.
   bool created_;
+  // True while the driver builds the program submitted by BeginCreate().
+  bool build_pending_;
+  // True when the build of the program failed.
+  bool build_failed_;
+  // Time when the build started.
+  std::chrono::steady_clock::time_point build_start_;
+  // Key of this program in the binary cache. Empty without a binary cache.
+  std::string binary_cache_key_;
+  // Preprocessor defines as (name, value) pairs.
+  std::vector<std::pair<std::string, std::string> > defines_;
+  // Cache of program binaries. Not owned.
+  ProgramBinaryCache* binary_cache_;
+  // Active uniforms indexed by their handles.
+  std::vector<ShaderVariable> uniforms_;
+  // Maps the name of an active uniform to its handle.
+  std::unordered_map<std::string, UniformHandle> uniform_handles_;
+  // Active attributes.
+  std::vector<ShaderVariable> attributes_;
+  // Last value uploaded through each handle. Empty until the first upload.
+  mutable std::vector<std::vector<unsigned char> > uniform_values_;
+  // Upload counters.
+  mutable int num_uniform_uploads_;
+  mutable int num_skipped_uniform_uploads_;
 };
 
 }  // namespace wvu
@@ -0,0 +1,328 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "texture_array.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "image_decoder.h"
+#include "mipmap_generator.h"
+
+namespace wvu {
+namespace {
+// Largest side of the layers of the atlas arrays.
+constexpr int kMaxAtlasPageSize = 2048;
+// Number of texels repeated around the images packed in the atlas.
+constexpr int kAtlasBorder = 4;
+// Last mipmap level of the atlas arrays. At this level the border of the images
+// is one texel wide, so the lower levels would mix neighbouring images. The
+// levels of the atlas are always box filtered for the same reason: the wider
+// filters would reach past the border.
+constexpr int kAtlasMaxLevel = 2;
+// Number of bytes per RGBA pixel.
+constexpr int kBytesPerPixel = 4;
+
+// Returns the last mipmap level of an image.
+int ComputeMaxLevel(const int width, const int height) {
+  return static_cast<int>(std::floor(std::log2(std::max(width, height))));
+}
+
+// Copies an image into a page of the atlas at (x, y), and repeats its edges
+// kAtlasBorder texels around it. (x, y) is the top-left corner of the border.
+void CopyImageWithBorder(const RgbaImage& image,
+                         const int x,
+                         const int y,
+                         const int page_size,
+                         unsigned char* page) {
+  const int row_size = image.width * kBytesPerPixel;
+  for (int row = -kAtlasBorder; row < image.height + kAtlasBorder; ++row) {
+    const int source_row = std::min(std::max(row, 0), image.height - 1);
+    const unsigned char* source =
+        image.pixels.data() + source_row * row_size;
+    unsigned char* destination = page + ((y + kAtlasBorder + row) * page_size +
+                                         x) * kBytesPerPixel;
+    for (int i = 0; i < kAtlasBorder; ++i) {
+      std::memcpy(destination + i * kBytesPerPixel, source, kBytesPerPixel);
+    }
+    destination += kAtlasBorder * kBytesPerPixel;
+    std::memcpy(destination, source, row_size);
+    destination += row_size;
+    for (int i = 0; i < kAtlasBorder; ++i) {
+      std::memcpy(destination + i * kBytesPerPixel,
+                  source + row_size - kBytesPerPixel, kBytesPerPixel);
+    }
+  }
+}
+
+}  // namespace
+
+TextureAtlasPacker::TextureAtlasPacker(const int page_width,
+                                       const int page_height) :
+    page_width_(page_width), page_height_(page_height), num_pages_(0),
+    last_page_height_used_(0) {}
+
+bool TextureAtlasPacker::Insert(const int width,
+                                const int height,
+                                int* page,
+                                int* x,
+                                int* y) {
+  if (page == nullptr || x == nullptr || y == nullptr) {
+    std::cout << "Null pointer passed.  Could not insert the rectangle.";
+    return false;
+  }
+  if (width > page_width_ || height > page_height_) return false;
+  // Find the shortest shelf where the rectangle fits. Only the shelves of the
+  // last page can still have space left.
+  Shelf* best_shelf = nullptr;
+  for (Shelf& shelf : shelves_) {
+    if (shelf.height >= height && page_width_ - shelf.width_used >= width &&
+        (best_shelf == nullptr || shelf.height < best_shelf->height)) {
+      best_shelf = &shelf;
+    }
+  }
+  if (best_shelf == nullptr) {
+    // Open a new shelf, in a new page if the last one is full.
+    if (num_pages_ == 0 || last_page_height_used_ + height > page_height_) {
+      shelves_.clear();
+      ++num_pages_;
+      last_page_height_used_ = 0;
+    }
+    Shelf shelf;
+    shelf.page = num_pages_ - 1;
+    shelf.y = last_page_height_used_;
+    shelf.height = height;
+    shelf.width_used = 0;
+    shelves_.push_back(shelf);
+    last_page_height_used_ += height;
+    best_shelf = &shelves_.back();
+  }
+  *page = best_shelf->page;
+  *x = best_shelf->width_used;
+  *y = best_shelf->y;
+  best_shelf->width_used += width;
+  return true;
+}
+
+TextureArrayManager::TextureArrayManager() :
+    mipmap_filter_(MipmapFilter::kBox), num_layers_(0) {}
+
+TextureArrayManager::~TextureArrayManager() {
+  if (!texture_ids_.empty()) {
+    glDeleteTextures(texture_ids_.size(), texture_ids_.data());
+  }
+}
+
+int TextureArrayManager::Add(const RgbaImage* image) {
+  images_.push_back(image);
+  return images_.size() - 1;
+}
+
+bool TextureArrayManager::Build() {
+  for (const RgbaImage* image : images_) {
+    if (image == nullptr || image->pixels.empty()) {
+      std::cout << "Empty image passed.  Could not build the texture arrays.";
+      return false;
+    }
+  }
+  regions_.resize(images_.size());
+  GLint max_layers = 0;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  // Group the images by size.
+  std::map<std::pair<int, int>, std::vector<int> > images_by_size;
+  for (int i = 0; i < images_.size(); ++i) {
+    images_by_size[std::make_pair(images_[i]->width, images_[i]->height)]
+        .push_back(i);
+  }
+  std::vector<int> atlas_image_indices;
+  for (const auto& size_and_indices : images_by_size) {
+    const int width = size_and_indices.first.first;
+    const int height = size_and_indices.first.second;
+    const std::vector<int>& image_indices = size_and_indices.second;
+    // A small image alone in its size would waste a layer; pack it instead.
+    if (image_indices.size() == 1 &&
+        width + 2 * kAtlasBorder <= kMaxAtlasPageSize / 2 &&
+        height + 2 * kAtlasBorder <= kMaxAtlasPageSize / 2) {
+      atlas_image_indices.push_back(image_indices[0]);
+      continue;
+    }
+    for (int first = 0; first < image_indices.size(); first += max_layers) {
+      const int last = std::min<int>(first + max_layers, image_indices.size());
+      std::vector<const RgbaImage*> layers;
+      for (int i = first; i < last; ++i) {
+        layers.push_back(images_[image_indices[i]]);
+      }
+      const GLuint texture_id =
+          CreateTextureArray(layers, GL_REPEAT, mipmap_filter_,
+                             ComputeMaxLevel(width, height));
+      for (int i = first; i < last; ++i) {
+        TextureRegion& region = regions_[image_indices[i]];
+        region.texture_id = texture_id;
+        region.layer = i - first;
+      }
+    }
+  }
+  BuildAtlas(atlas_image_indices);
+  return true;
+}
+
+void TextureArrayManager::BuildAtlas(const std::vector<int>& image_indices) {
+  if (image_indices.empty()) return;
+  // Insert the images from the tallest to the shortest.
+  std::vector<int> sorted_indices = image_indices;
+  std::sort(sorted_indices.begin(), sorted_indices.end(),
+            [this](const int a, const int b) {
+              return images_[a]->height > images_[b]->height;
+            });
+  // Use the smallest power of two page that could hold all the images.
+  int largest_side = 0;
+  long long area = 0;
+  for (const int index : sorted_indices) {
+    const int width = images_[index]->width + 2 * kAtlasBorder;
+    const int height = images_[index]->height + 2 * kAtlasBorder;
+    largest_side = std::max(largest_side, std::max(width, height));
+    area += static_cast<long long>(width) * height;
+  }
+  int page_size = 1;
+  while (page_size < kMaxAtlasPageSize &&
+         (page_size < largest_side ||
+          static_cast<long long>(page_size) * page_size < area)) {
+    page_size *= 2;
+  }
+  TextureAtlasPacker packer(page_size, page_size);
+  std::vector<RgbaImage> pages;
+  std::vector<int> image_pages(images_.size());
+  for (const int index : sorted_indices) {
+    const RgbaImage& image = *images_[index];
+    int page, x, y;
+    packer.Insert(image.width + 2 * kAtlasBorder,
+                  image.height + 2 * kAtlasBorder, &page, &x, &y);
+    if (page == pages.size()) {
+      pages.emplace_back();
+      pages.back().width = page_size;
+      pages.back().height = page_size;
+      pages.back().pixels.resize(page_size * page_size * kBytesPerPixel, 0);
+    }
+    CopyImageWithBorder(image, x, y, page_size, pages[page].pixels.data());
+    image_pages[index] = page;
+    TextureRegion& region = regions_[index];
+    region.uv_transform[0] = static_cast<GLfloat>(image.width) / page_size;
+    region.uv_transform[1] = static_cast<GLfloat>(image.height) / page_size;
+    region.uv_transform[2] =
+        static_cast<GLfloat>(x + kAtlasBorder) / page_size;
+    region.uv_transform[3] =
+        static_cast<GLfloat>(y + kAtlasBorder) / page_size;
+  }
+  GLint max_layers = 0;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  for (int first = 0; first < pages.size(); first += max_layers) {
+    const int last = std::min<int>(first + max_layers, pages.size());
+    std::vector<const RgbaImage*> layers;
+    for (int i = first; i < last; ++i) {
+      layers.push_back(&pages[i]);
+    }
+    const GLuint texture_id =
+        CreateTextureArray(layers, GL_CLAMP_TO_EDGE, MipmapFilter::kBox,
+                           std::min(kAtlasMaxLevel,
+                                    ComputeMaxLevel(page_size, page_size)));
+    for (const int index : sorted_indices) {
+      if (image_pages[index] >= first && image_pages[index] < last) {
+        regions_[index].texture_id = texture_id;
+        regions_[index].layer = image_pages[index] - first;
+      }
+    }
+  }
+}
+
+// The mipmaps are built on the CPU (see GenerateMipmaps()) so that the OpenGL
+// thread does not wait for glGenerateMipmap().
+GLuint TextureArrayManager::CreateTextureArray(
+    const std::vector<const RgbaImage*>& layers,
+    const GLint wrap,
+    const MipmapFilter filter,
+    const int max_level) {
+  const int width = layers[0]->width;
+  const int height = layers[0]->height;
+  const int num_levels = max_level + 1;
+  GLuint texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, max_level);
+  // The rows of the images are tightly packed.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, num_levels, GL_RGBA8, width, height,
+                   layers.size());
+  } else {
+    for (int level = 0; level < num_levels; ++level) {
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8,
+                   std::max(1, width >> level), std::max(1, height >> level),
+                   layers.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+  }
+  std::vector<RgbaImage> mipmaps;
+  for (int layer = 0; layer < layers.size(); ++layer) {
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE, layers[layer]->pixels.data());
+    if (num_levels == 1) continue;
+    GenerateMipmaps(*layers[layer], filter, 0, &mipmaps);
+    for (int level = 1; level < num_levels && level <= mipmaps.size();
+         ++level) {
+      const RgbaImage& mipmap = mipmaps[level - 1];
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mipmap.width,
+                      mipmap.height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                      mipmap.pixels.data());
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  texture_ids_.push_back(texture_id);
+  num_layers_ += layers.size();
+  return texture_id;
+}
+
+}  // namespace wvu
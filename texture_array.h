@@ -0,0 +1,185 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef TEXTURE_ARRAY_H_
+#define TEXTURE_ARRAY_H_
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "image_decoder.h"
+#include "mipmap_generator.h"
+
+namespace wvu {
+// Place of an image inside a texture array.
+struct TextureRegion {
+  TextureRegion() : texture_id(0), layer(0),
+                    uv_transform{1.0f, 1.0f, 0.0f, 0.0f} {}
+  // Id of the GL_TEXTURE_2D_ARRAY texture. Zero if the region is not set.
+  GLuint texture_id;
+  // Layer of the array holding the image.
+  int layer;
+  // Maps the texture coordinates of the image to the coordinates of the layer:
+  // uv_layer = uv * (uv_transform[0], uv_transform[1]) +
+  //            (uv_transform[2], uv_transform[3]).
+  GLfloat uv_transform[4];
+};
+
+// Packs rectangles into pages of fixed size with the shelf algorithm: the page
+// is split into horizontal shelves, and each rectangle goes to the shortest
+// shelf that fits it. A new shelf (or page) is opened when none fits. Inserting
+// the rectangles sorted by decreasing height gives the best results.
+class TextureAtlasPacker {
+ public:
+  // Params:
+  //   page_width  Width of the pages.
+  //   page_height  Height of the pages.
+  TextureAtlasPacker(const int page_width, const int page_height);
+
+  // Finds a place for a rectangle. Returns false if the rectangle is larger
+  // than a page.
+  // Params:
+  //   width  The width of the rectangle.
+  //   height  The height of the rectangle.
+  //   page  The page where the rectangle was placed.
+  //   x  The column of the top-left corner of the rectangle.
+  //   y  The row of the top-left corner of the rectangle.
+  bool Insert(const int width, const int height, int* page, int* x, int* y);
+
+  // Returns the number of pages used.
+  int num_pages() const {
+    return num_pages_;
+  }
+
+ private:
+  // Horizontal band of a page.
+  struct Shelf {
+    int page;
+    // Row of the top of the shelf.
+    int y;
+    int height;
+    // Width used by the rectangles of the shelf.
+    int width_used;
+  };
+
+  const int page_width_;
+  const int page_height_;
+  std::vector<Shelf> shelves_;
+  int num_pages_;
+  // Height used by the shelves of the last page.
+  int last_page_height_used_;
+};
+
+// Packs images into a few GL_TEXTURE_2D_ARRAY textures, so that models with
+// different textures can be drawn without binding a texture per model. Images
+// with the same size get a layer each in an array of that size. Small images
+// with a unique size are packed into the layers of an atlas array; their
+// texture coordinates are remapped with TextureRegion::uv_transform, and they
+// are surrounded by a border that repeats their edges to avoid bleeding when
+// filtering. The texture coordinates of the images packed in the atlas must be
+// in [0, 1] because wrapping is not possible inside a layer.
+//
+// Example:
+//
+// wvu::TextureArrayManager texture_arrays;
+// const int region_index = texture_arrays.Add(&image);
+// ...  // Add more images.
+// texture_arrays.Build();
+// model->set_texture_region(texture_arrays.region(region_index));
+//
+// The manager owns the texture arrays.
+class TextureArrayManager {
+ public:
+  TextureArrayManager();
+  // Deletes the texture arrays.
+  ~TextureArrayManager();
+
+  // Adds an image to pack and returns the index of its region. The image must
+  // outlive the call to Build(). Images cannot be added after Build().
+  int Add(const RgbaImage* image);
+
+  // Packs the images, creates the texture arrays and uploads the images into
+  // them. Must be called from the OpenGL thread. Returns true if successful.
+  bool Build();
+
+  // Sets the filter that builds the mipmaps of the arrays of same-size images.
+  // The atlas arrays are always box filtered. The default is
+  // MipmapFilter::kBox.
+  void set_mipmap_filter(const MipmapFilter filter) {
+    mipmap_filter_ = filter;
+  }
+
+  // Returns the region of the image with the given index. Valid after Build().
+  const TextureRegion& region(const int index) const {
+    return regions_[index];
+  }
+
+  // Returns the ids of the texture arrays.
+  const std::vector<GLuint>& texture_ids() const {
+    return texture_ids_;
+  }
+
+  // Returns the number of layers of all the texture arrays.
+  int num_layers() const {
+    return num_layers_;
+  }
+
+ private:
+  // Creates a texture array with levels 0 to max_level, and uploads the layers
+  // and their mipmaps, which are built on the CPU.
+  // Params:
+  //   layers  The images of the layers. They all have the same size.
+  //   wrap  The wrapping mode of the texture coordinates.
+  //   filter  The filter that builds the mipmaps.
+  //   max_level  The last mipmap level that can be sampled.
+  GLuint CreateTextureArray(
+      const std::vector<const RgbaImage*>& layers,
+      const GLint wrap,
+      const MipmapFilter filter,
+      const int max_level);
+  // Packs the images with the given indices into atlas layers.
+  void BuildAtlas(const std::vector<int>& image_indices);
+
+  std::vector<const RgbaImage*> images_;
+  std::vector<TextureRegion> regions_;
+  std::vector<GLuint> texture_ids_;
+  MipmapFilter mipmap_filter_;
+  int num_layers_;
+};
+
+}  // namespace wvu
+
+#endif  // TEXTURE_ARRAY_H_
@@ -0,0 +1,143 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+// Bakes image files into texture containers (.wvtx, see texture_container.h)
+// holding every mipmap level, optionally block compressed, so that
+// draw_scene loads them without decoding or filtering anything. Outputs with
+// the .wvvt extension are written as virtual textures instead (see
+// virtual_texture_file.h), cut into pages; they are not compressed.
+//
+// Usage: ./bin/texture_baker [-compression bc7] [-mipmap_filter kaiser]
+//            input.jpg output.wvtx [input2.png output2.wvvt ...]
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define GLUTILS_GFLAGS_NAMESPACE google
+#else
+#define GLUTILS_GFLAGS_NAMESPACE gflags
+#endif
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+
+#include "image_decoder.h"
+#include "mipmap_generator.h"
+#include "texture_compression.h"
+#include "texture_container.h"
+#include "virtual_texture_file.h"
+
+DEFINE_string(compression, "none",
+              "Block compression of the textures: none, bc1, bc3 or bc7.");
+DEFINE_string(mipmap_filter, "kaiser",
+              "Filter building the mipmaps: box or kaiser.");
+DEFINE_int32(threads, 0,
+             "Number of threads filtering and compressing each texture. When "
+             "zero, one thread per hardware thread is used.");
+
+namespace {
+
+// Bakes one image file into a container. Returns true if successful.
+bool BakeTexture(const std::string& input_filepath,
+                 const std::string& output_filepath,
+                 const wvu::TextureCompressionFormat format,
+                 const wvu::MipmapFilter filter) {
+  wvu::RgbaImage image;
+  if (!wvu::DecodeImageFile(input_filepath, &image)) {
+    std::cerr << "ERROR: Could not decode " << input_filepath << ".\n";
+    return false;
+  }
+  if (wvu::IsVirtualTexturePath(output_filepath)) {
+    if (!wvu::WriteVirtualTexture(output_filepath, image, filter,
+                                  FLAGS_threads)) {
+      std::cerr << "ERROR: Could not write " << output_filepath << ".\n";
+      return false;
+    }
+    std::cout << input_filepath << " (" << image.width << "x" << image.height
+              << ") -> " << output_filepath << "\n";
+    return true;
+  }
+  std::vector<wvu::RgbaImage> mipmaps;
+  wvu::GenerateMipmaps(image, filter, FLAGS_threads, &mipmaps);
+  bool written = false;
+  if (format == wvu::TextureCompressionFormat::kNone) {
+    written = wvu::WriteTextureContainer(output_filepath, image, mipmaps);
+  } else {
+    wvu::CompressedImage compressed_image;
+    wvu::CompressImage(image, mipmaps, format, FLAGS_threads,
+                       &compressed_image);
+    written = wvu::WriteTextureContainer(output_filepath, compressed_image);
+  }
+  if (!written) {
+    std::cerr << "ERROR: Could not write " << output_filepath << ".\n";
+    return false;
+  }
+  std::cout << input_filepath << " (" << image.width << "x" << image.height
+            << ", " << mipmaps.size() + 1 << " levels) -> " << output_filepath
+            << "\n";
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  GLUTILS_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc < 3 || argc % 2 == 0) {
+    std::cerr << "Usage: " << argv[0]
+              << " [flags] input output.wvtx [input output.wvtx ...]\n";
+    return -1;
+  }
+  wvu::TextureCompressionFormat format;
+  if (!wvu::ParseTextureCompressionFormat(FLAGS_compression, &format)) {
+    std::cerr << "ERROR: Unknown texture compression " << FLAGS_compression
+              << ".\n";
+    return -1;
+  }
+  wvu::MipmapFilter filter;
+  if (!wvu::ParseMipmapFilter(FLAGS_mipmap_filter, &filter)) {
+    std::cerr << "ERROR: Unknown mipmap filter " << FLAGS_mipmap_filter
+              << ".\n";
+    return -1;
+  }
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!BakeTexture(argv[i], argv[i + 1], format, filter)) {
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,445 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+
+#include <GL/glew.h>
+
+#include "texture_loader.h"
+
+namespace wvu {
+namespace {
+// 64-bit FNV-1a hash.
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+// Size of the chunks read when hashing a file.
+constexpr int kHashChunkSize = 1 << 16;
+// Largest number of mipmap levels of a texture.
+constexpr int kMaxNumLevels = 32;
+// Evictions keep the levels up to this size, so that the texture can still be
+// drawn.
+constexpr int kMinEvictedSide = 16;
+
+// Hashes the content of a file. Returns false if the file cannot be read.
+bool HashFile(const std::string& filepath, uint64_t* hash) {
+  std::ifstream file(filepath, std::ios::binary);
+  if (!file.is_open()) return false;
+  std::vector<char> chunk(kHashChunkSize);
+  *hash = kFnvOffsetBasis;
+  while (file) {
+    file.read(chunk.data(), chunk.size());
+    const std::streamsize num_read = file.gcount();
+    for (std::streamsize i = 0; i < num_read; ++i) {
+      *hash ^= static_cast<unsigned char>(chunk[i]);
+      *hash *= kFnvPrime;
+    }
+  }
+  return !file.bad();
+}
+
+// Returns the bytes of video memory of a texture, with all its levels.
+size_t ComputeTextureSize(const GLuint texture_id) {
+  GLint previous_texture_id = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous_texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  size_t size = 0;
+  for (int level = 0; level < kMaxNumLevels; ++level) {
+    GLint width = 0;
+    GLint height = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+    if (width == 0 || height == 0) break;
+    GLint compressed = GL_FALSE;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED,
+                             &compressed);
+    if (compressed) {
+      GLint level_size = 0;
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, level,
+                               GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &level_size);
+      size += level_size;
+      continue;
+    }
+    GLint num_bits = 0;
+    for (const GLenum channel : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE,
+                                  GL_TEXTURE_BLUE_SIZE,
+                                  GL_TEXTURE_ALPHA_SIZE }) {
+      GLint channel_bits = 0;
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, level, channel, &channel_bits);
+      num_bits += channel_bits;
+    }
+    size += static_cast<size_t>(width) * height * num_bits / 8;
+  }
+  glBindTexture(GL_TEXTURE_2D, previous_texture_id);
+  return size;
+}
+
+// Copies a level of a texture into a level of another one. The destination
+// level must be allocated if the driver supports texture storage.
+void CopyTextureLevel(const GLuint source_texture_id,
+                      const int source_level,
+                      const GLuint destination_texture_id,
+                      const int destination_level,
+                      const GLenum internal_format,
+                      const bool compressed,
+                      const bool use_texture_storage) {
+  GLint width = 0;
+  GLint height = 0;
+  glBindTexture(GL_TEXTURE_2D, source_texture_id);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, source_level, GL_TEXTURE_WIDTH,
+                           &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, source_level, GL_TEXTURE_HEIGHT,
+                           &height);
+  if (use_texture_storage && (GLEW_VERSION_4_3 || GLEW_ARB_copy_image)) {
+    // Copy within video memory.
+    glCopyImageSubData(source_texture_id, GL_TEXTURE_2D, source_level, 0, 0,
+                       0, destination_texture_id, GL_TEXTURE_2D,
+                       destination_level, 0, 0, 0, width, height, 1);
+    return;
+  }
+  // Read the level back and upload it again.
+  std::vector<unsigned char> data;
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (compressed) {
+    GLint size = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, source_level,
+                             GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+    data.resize(size);
+    glGetCompressedTexImage(GL_TEXTURE_2D, source_level, data.data());
+    glBindTexture(GL_TEXTURE_2D, destination_texture_id);
+    if (use_texture_storage) {
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, destination_level, 0, 0, width,
+                                height, internal_format, size, data.data());
+    } else {
+      glCompressedTexImage2D(GL_TEXTURE_2D, destination_level,
+                             internal_format, width, height, 0, size,
+                             data.data());
+    }
+    return;
+  }
+  data.resize(4 * static_cast<size_t>(width) * height);
+  glGetTexImage(GL_TEXTURE_2D, source_level, GL_RGBA, GL_UNSIGNED_BYTE,
+                data.data());
+  glBindTexture(GL_TEXTURE_2D, destination_texture_id);
+  if (use_texture_storage) {
+    glTexSubImage2D(GL_TEXTURE_2D, destination_level, 0, 0, width, height,
+                    GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, destination_level, internal_format, width,
+                 height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+  }
+}
+
+}  // namespace
+
+size_t TextureHandle::Entry::resident_bytes() const {
+  return texture_bytes;
+}
+
+size_t TextureHandle::Entry::full_bytes() const {
+  return loaded_texture_bytes;
+}
+
+bool TextureHandle::Entry::Evict() {
+  return cache->DropLargestLevel(this);
+}
+
+bool TextureHandle::Entry::Restore() {
+  return cache->Reload(this);
+}
+
+TextureHandle::TextureHandle() : entry_(nullptr) {}
+
+TextureHandle::TextureHandle(Entry* entry) : entry_(entry) {
+  if (entry_ != nullptr) ++entry_->num_references;
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other) :
+    TextureHandle(other.entry_) {}
+
+TextureHandle& TextureHandle::operator=(const TextureHandle& other) {
+  if (entry_ == other.entry_) return *this;
+  Release();
+  entry_ = other.entry_;
+  if (entry_ != nullptr) ++entry_->num_references;
+  return *this;
+}
+
+TextureHandle::~TextureHandle() {
+  Release();
+}
+
+GLuint TextureHandle::texture_id() const {
+  return entry_ == nullptr ? 0 : entry_->texture_id;
+}
+
+void TextureHandle::MarkUsed() const {
+  if (entry_ == nullptr || entry_->cache->residency_manager_ == nullptr) {
+    return;
+  }
+  entry_->cache->residency_manager_->MarkUsed(entry_);
+}
+
+void TextureHandle::Release() {
+  if (entry_ == nullptr) return;
+  if (--entry_->num_references == 0) {
+    entry_->cache->Release(entry_);
+  }
+  entry_ = nullptr;
+}
+
+TextureCache::TextureCache(TextureLoader* texture_loader) :
+    texture_loader_(texture_loader), residency_manager_(nullptr), num_hits_(0),
+    num_misses_(0) {}
+
+TextureCache::~TextureCache() {
+  if (!entries_.empty()) {
+    std::cerr << "ERROR: " << entries_.size()
+              << " textures are still referenced by handles.\n";
+  }
+}
+
+TextureHandle TextureCache::Acquire(const std::string& filepath) {
+  if (texture_loader_ == nullptr) {
+    std::cout << "Null pointer passed.  Could not acquire the texture.";
+    return TextureHandle();
+  }
+  std::string key;
+  if (!ComputeContentKey(filepath, &key)) {
+    // The loader keeps the placeholder image for files it cannot read.
+    key = "unreadable:" + filepath;
+  }
+  const auto entry_iterator = entries_.find(key);
+  if (entry_iterator != entries_.end()) {
+    ++num_hits_;
+    return TextureHandle(entry_iterator->second);
+  }
+  ++num_misses_;
+  TextureHandle::Entry* entry = new TextureHandle::Entry;
+  entry->key = key;
+  entry->filepath = filepath;
+  entry->texture_id = texture_loader_->Load(filepath);
+  entry->reload_texture_id = 0;
+  entry->texture_bytes = 0;
+  entry->loaded_texture_bytes = 0;
+  entry->num_dropped_levels = 0;
+  entry->num_references = 0;
+  entry->cache = this;
+  entries_[key] = entry;
+  if (residency_manager_ != nullptr) {
+    residency_manager_->Register(entry, ResourceType::kTexture);
+  }
+  return TextureHandle(entry);
+}
+
+void TextureCache::set_residency_manager(
+    ResidencyManager* residency_manager) {
+  for (const auto& key_and_entry : entries_) {
+    if (residency_manager_ != nullptr) {
+      residency_manager_->Unregister(key_and_entry.second);
+    }
+    if (residency_manager != nullptr) {
+      residency_manager->Register(key_and_entry.second,
+                                  ResourceType::kTexture);
+    }
+  }
+  residency_manager_ = residency_manager;
+}
+
+void TextureCache::Update() {
+  for (const auto& key_and_entry : entries_) {
+    TextureHandle::Entry* entry = key_and_entry.second;
+    if (entry->texture_bytes == 0 &&
+        !texture_loader_->IsLoading(entry->texture_id)) {
+      entry->texture_bytes = ComputeTextureSize(entry->texture_id);
+      entry->loaded_texture_bytes = entry->texture_bytes;
+    }
+    if (entry->reload_texture_id != 0 &&
+        !texture_loader_->IsLoading(entry->reload_texture_id)) {
+      // The reloaded texture has all its levels; drop the reduced one.
+      glDeleteTextures(1, &entry->texture_id);
+      entry->texture_id = entry->reload_texture_id;
+      entry->reload_texture_id = 0;
+      entry->num_dropped_levels = 0;
+      entry->texture_bytes = ComputeTextureSize(entry->texture_id);
+      entry->loaded_texture_bytes = entry->texture_bytes;
+    }
+  }
+}
+
+TextureCache::Stats TextureCache::stats() const {
+  Stats stats;
+  stats.hits = num_hits_;
+  stats.misses = num_misses_;
+  stats.num_textures = entries_.size();
+  stats.resident_bytes = 0;
+  for (const auto& key_and_entry : entries_) {
+    stats.resident_bytes += ComputeTextureSize(key_and_entry.second->texture_id);
+  }
+  return stats;
+}
+
+bool TextureCache::ComputeContentKey(const std::string& filepath,
+                                     std::string* key) {
+  char* canonical_path_buffer = realpath(filepath.c_str(), nullptr);
+  if (canonical_path_buffer == nullptr) return false;
+  const std::string canonical_path(canonical_path_buffer);
+  free(canonical_path_buffer);
+  struct stat file_status;
+  if (stat(canonical_path.c_str(), &file_status) != 0) return false;
+  FileHash& file_hash = file_hashes_[canonical_path];
+  if (file_hash.size != file_status.st_size ||
+      file_hash.modification_time != file_status.st_mtime ||
+      file_hash.hash == 0) {
+    if (!HashFile(canonical_path, &file_hash.hash)) {
+      file_hashes_.erase(canonical_path);
+      return false;
+    }
+    file_hash.size = file_status.st_size;
+    file_hash.modification_time = file_status.st_mtime;
+  }
+  // The size guards against collisions between files of different sizes.
+  char key_buffer[64];
+  snprintf(key_buffer, sizeof(key_buffer), "%016llx-%lld",
+           static_cast<unsigned long long>(file_hash.hash),
+           static_cast<long long>(file_hash.size));
+  *key = key_buffer;
+  return true;
+}
+
+void TextureCache::Release(TextureHandle::Entry* entry) {
+  if (residency_manager_ != nullptr) {
+    residency_manager_->Unregister(entry);
+  }
+  texture_loader_->Cancel(entry->texture_id);
+  glDeleteTextures(1, &entry->texture_id);
+  if (entry->reload_texture_id != 0) {
+    texture_loader_->Cancel(entry->reload_texture_id);
+    glDeleteTextures(1, &entry->reload_texture_id);
+  }
+  entries_.erase(entry->key);
+  delete entry;
+}
+
+bool TextureCache::DropLargestLevel(TextureHandle::Entry* entry) {
+  // Textures are measured once loaded; until then they can not be evicted.
+  if (entry->texture_bytes == 0) return false;
+  GLint previous_texture_id = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous_texture_id);
+  glBindTexture(GL_TEXTURE_2D, entry->texture_id);
+  GLint width = 0;
+  GLint height = 0;
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  int num_levels = 1;
+  while (num_levels < kMaxNumLevels) {
+    GLint level_width = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, num_levels, GL_TEXTURE_WIDTH,
+                             &level_width);
+    if (level_width == 0) break;
+    ++num_levels;
+  }
+  if (num_levels == 1 ||
+      (width <= kMinEvictedSide && height <= kMinEvictedSide)) {
+    glBindTexture(GL_TEXTURE_2D, previous_texture_id);
+    return false;
+  }
+  GLint internal_format = 0;
+  GLint compressed = GL_FALSE;
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT,
+                           &internal_format);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED,
+                           &compressed);
+  if (entry->reload_texture_id != 0) {
+    // The texture is not used enough to finish reloading it.
+    texture_loader_->Cancel(entry->reload_texture_id);
+    glDeleteTextures(1, &entry->reload_texture_id);
+    entry->reload_texture_id = 0;
+  }
+  // Copy the other levels into a new texture, since the storage of the
+  // loaded textures can not be resized.
+  GLuint texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 2);
+  const bool use_texture_storage =
+      GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+  if (use_texture_storage) {
+    glTexStorage2D(GL_TEXTURE_2D, num_levels - 1, internal_format,
+                   std::max(1, width / 2), std::max(1, height / 2));
+  }
+  for (int level = 1; level < num_levels; ++level) {
+    CopyTextureLevel(entry->texture_id, level, texture_id, level - 1,
+                     internal_format, compressed, use_texture_storage);
+  }
+  // The old texture can not be bound again once deleted.
+  if (previous_texture_id == static_cast<GLint>(entry->texture_id)) {
+    previous_texture_id = texture_id;
+  }
+  glDeleteTextures(1, &entry->texture_id);
+  entry->texture_id = texture_id;
+  ++entry->num_dropped_levels;
+  entry->texture_bytes = ComputeTextureSize(texture_id);
+  glBindTexture(GL_TEXTURE_2D, previous_texture_id);
+  return true;
+}
+
+bool TextureCache::Reload(TextureHandle::Entry* entry) {
+  if (entry->num_dropped_levels == 0 || entry->reload_texture_id != 0) {
+    return false;
+  }
+  entry->reload_texture_id = texture_loader_->Load(entry->filepath);
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,202 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef TEXTURE_CACHE_H_
+#define TEXTURE_CACHE_H_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <sys/types.h>
+#include <GL/glew.h>
+
+#include "residency_manager.h"
+
+namespace wvu {
+class TextureCache;
+class TextureLoader;
+
+// Reference to a texture of a TextureCache. Copies of a handle share the
+// texture; the texture is deleted when the last handle is destroyed. Handles
+// must be used from the OpenGL thread and must not outlive their cache.
+class TextureHandle {
+ public:
+  // Creates an empty handle.
+  TextureHandle();
+  TextureHandle(const TextureHandle& other);
+  TextureHandle& operator=(const TextureHandle& other);
+  ~TextureHandle();
+
+  // Returns the texture id, or zero if the handle is empty.
+  GLuint texture_id() const;
+
+  // Returns true if the handle references a texture.
+  bool valid() const {
+    return entry_ != nullptr;
+  }
+
+  // Records the use of the texture in the residency manager of its cache, if
+  // any. Does nothing if the handle is empty.
+  void MarkUsed() const;
+
+ private:
+  friend class TextureCache;
+
+  // Texture shared by the handles. It is a texture resource of the residency
+  // manager of the cache, if any.
+  struct Entry : public ResidentResource {
+    size_t resident_bytes() const override;
+    size_t full_bytes() const override;
+    bool Evict() override;
+    bool Restore() override;
+
+    // Key of the entry in the cache.
+    std::string key;
+    // File the texture was loaded from, to reload it after an eviction.
+    std::string filepath;
+    GLuint texture_id;
+    // Texture reloading the file at full resolution, or zero.
+    GLuint reload_texture_id;
+    // Video memory of the texture and of the texture when it has all its
+    // levels. Zero while the texture is loading.
+    size_t texture_bytes;
+    size_t loaded_texture_bytes;
+    // Number of largest levels dropped by evictions.
+    int num_dropped_levels;
+    // Number of handles referencing the entry.
+    int num_references;
+    TextureCache* cache;
+  };
+
+  explicit TextureHandle(Entry* entry);
+  // Drops the reference to the entry.
+  void Release();
+
+  Entry* entry_;
+};
+
+// Shares the textures loaded from the same image among all their users. The
+// textures are addressed by content: files are identified by a hash of their
+// bytes, so the same image reached through different paths (copies, symbolic
+// links, relative paths) is decoded and uploaded once. The hash of a file is
+// remembered by canonical path, size and modification time, so acquiring an
+// unchanged file again does not read it.
+//
+// Example:
+//
+// wvu::TextureCache texture_cache(&texture_loader);
+// model->set_texture(texture_cache.Acquire("/path/to/texture.jpg"));
+//
+// The textures are loaded asynchronously with the texture loader, which must
+// outlive the cache. With a residency manager, the least recently used
+// textures drop their largest levels under memory pressure, and are reloaded
+// from their files when they are used again.
+class TextureCache {
+ public:
+  // Statistics of the cache.
+  struct Stats {
+    // Number of Acquire() calls that found the texture in the cache.
+    int hits;
+    // Number of Acquire() calls that loaded the texture.
+    int misses;
+    // Number of textures in the cache.
+    int num_textures;
+    // Bytes of video memory taken by the textures of the cache.
+    size_t resident_bytes;
+  };
+
+  // Params:
+  //   texture_loader  The loader used to load the textures.
+  explicit TextureCache(TextureLoader* texture_loader);
+  // The handles of the cache must be destroyed before the cache.
+  ~TextureCache();
+
+  // Returns a handle to the texture of the image file, loading it if no other
+  // handle references the same image. Files that cannot be read get the
+  // placeholder texture of the loader, shared by path. Must be called from the
+  // OpenGL thread.
+  TextureHandle Acquire(const std::string& filepath);
+
+  // Registers the textures of the cache in a residency manager, which must
+  // outlive the cache. Null unregisters them.
+  void set_residency_manager(ResidencyManager* residency_manager);
+
+  // Measures the textures that finished loading, and replaces the evicted
+  // textures whose reload finished. Must be called from the OpenGL thread,
+  // after TextureLoader::Update() (e.g., once per frame).
+  void Update();
+
+  // Returns the statistics of the cache. The resident bytes are queried from
+  // OpenGL, so this must be called from the OpenGL thread.
+  Stats stats() const;
+
+ private:
+  friend class TextureHandle;
+
+  // Hash of a file, valid while the size and modification time of the file do
+  // not change.
+  struct FileHash {
+    off_t size;
+    time_t modification_time;
+    uint64_t hash;
+  };
+
+  // Computes the key of the file addressed by its content. Returns false if
+  // the file cannot be read.
+  bool ComputeContentKey(const std::string& filepath, std::string* key);
+  // Deletes the texture of an entry without handles.
+  void Release(TextureHandle::Entry* entry);
+  // Replaces the texture of an entry with a copy without its largest level.
+  // Returns false if the texture is loading or already small.
+  bool DropLargestLevel(TextureHandle::Entry* entry);
+  // Starts reloading the texture of an entry at full resolution. Returns false
+  // if the texture has all its levels or is already reloading.
+  bool Reload(TextureHandle::Entry* entry);
+
+  TextureLoader* texture_loader_;
+  ResidencyManager* residency_manager_;
+  // Textures by content key.
+  std::unordered_map<std::string, TextureHandle::Entry*> entries_;
+  // Hashes of the files by canonical path.
+  std::unordered_map<std::string, FileHash> file_hashes_;
+  int num_hits_;
+  int num_misses_;
+};
+
+}  // namespace wvu
+
+#endif  // TEXTURE_CACHE_H_
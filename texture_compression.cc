@@ -0,0 +1,526 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "texture_compression.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "image_decoder.h"
+
+namespace wvu {
+namespace {
+// Side of the blocks in pixels.
+constexpr int kBlockSide = 4;
+// Number of pixels of a block.
+constexpr int kPixelsPerBlock = kBlockSide * kBlockSide;
+// Number of iterations of the power method that finds the principal axis of
+// the colors of a block.
+constexpr int kNumPowerIterations = 8;
+// Interpolation weights of the 4-bit indices of BC7, out of 64.
+constexpr int kBc7Weights[16] = {
+  0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+
+// Copies the 4x4 block whose top-left pixel is (x, y) into block. Pixels
+// outside the image repeat the last row or column.
+void GatherBlock(const RgbaImage& image,
+                 const int x,
+                 const int y,
+                 unsigned char* block) {
+  for (int row = 0; row < kBlockSide; ++row) {
+    const int source_row = std::min(y + row, image.height - 1);
+    for (int column = 0; column < kBlockSide; ++column) {
+      const int source_column = std::min(x + column, image.width - 1);
+      const unsigned char* pixel = image.pixels.data() +
+          4 * (source_row * image.width + source_column);
+      std::copy(pixel, pixel + 4, block + 4 * (row * kBlockSide + column));
+    }
+  }
+}
+
+// Fits a line to the colors of a block (principal component analysis) and
+// returns the extremes of the colors projected on it. Only the first
+// num_channels channels are considered.
+void ComputeEndpoints(const unsigned char* block,
+                      const int num_channels,
+                      float* endpoint0,
+                      float* endpoint1) {
+  float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  for (int i = 0; i < kPixelsPerBlock; ++i) {
+    for (int c = 0; c < num_channels; ++c) mean[c] += block[4 * i + c];
+  }
+  for (int c = 0; c < num_channels; ++c) mean[c] /= kPixelsPerBlock;
+  float covariance[4][4] = {};
+  for (int i = 0; i < kPixelsPerBlock; ++i) {
+    for (int c0 = 0; c0 < num_channels; ++c0) {
+      const float d0 = block[4 * i + c0] - mean[c0];
+      for (int c1 = 0; c1 < num_channels; ++c1) {
+        covariance[c0][c1] += d0 * (block[4 * i + c1] - mean[c1]);
+      }
+    }
+  }
+  // Start the power method from the column of the channel with the largest
+  // variance, which is never orthogonal to the principal axis.
+  int largest_channel = 0;
+  for (int c = 1; c < num_channels; ++c) {
+    if (covariance[c][c] > covariance[largest_channel][largest_channel]) {
+      largest_channel = c;
+    }
+  }
+  float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  for (int c = 0; c < num_channels; ++c) {
+    axis[c] = covariance[c][largest_channel];
+  }
+  for (int iteration = 0; iteration < kNumPowerIterations; ++iteration) {
+    float next_axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float largest = 0.0f;
+    for (int c0 = 0; c0 < num_channels; ++c0) {
+      for (int c1 = 0; c1 < num_channels; ++c1) {
+        next_axis[c0] += covariance[c0][c1] * axis[c1];
+      }
+      largest = std::max(largest, std::abs(next_axis[c0]));
+    }
+    if (largest == 0.0f) break;
+    for (int c = 0; c < num_channels; ++c) axis[c] = next_axis[c] / largest;
+  }
+  float squared_norm = 0.0f;
+  for (int c = 0; c < num_channels; ++c) squared_norm += axis[c] * axis[c];
+  float min_projection = 0.0f;
+  float max_projection = 0.0f;
+  if (squared_norm > 0.0f) {
+    for (int i = 0; i < kPixelsPerBlock; ++i) {
+      float projection = 0.0f;
+      for (int c = 0; c < num_channels; ++c) {
+        projection += (block[4 * i + c] - mean[c]) * axis[c];
+      }
+      projection /= squared_norm;
+      min_projection = std::min(min_projection, projection);
+      max_projection = std::max(max_projection, projection);
+    }
+  }
+  for (int c = 0; c < num_channels; ++c) {
+    endpoint0[c] = std::min(std::max(mean[c] + min_projection * axis[c], 0.0f),
+                            255.0f);
+    endpoint1[c] = std::min(std::max(mean[c] + max_projection * axis[c], 0.0f),
+                            255.0f);
+  }
+}
+
+// Returns the index of the palette entry closest to the pixel.
+int FindClosestEntry(const unsigned char* pixel,
+                     const int (*palette)[4],
+                     const int num_entries,
+                     const int num_channels) {
+  int best_index = 0;
+  int best_distance = -1;
+  for (int i = 0; i < num_entries; ++i) {
+    int distance = 0;
+    for (int c = 0; c < num_channels; ++c) {
+      const int difference = pixel[c] - palette[i][c];
+      distance += difference * difference;
+    }
+    if (best_distance < 0 || distance < best_distance) {
+      best_distance = distance;
+      best_index = i;
+    }
+  }
+  return best_index;
+}
+
+// Rounds an RGB color to 5:6:5 bits.
+uint16_t PackRgb565(const float* color) {
+  const int red = static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f);
+  const int green = static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f);
+  const int blue = static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f);
+  return (red << 11) | (green << 5) | blue;
+}
+
+// Expands a 5:6:5 color to 8 bits per channel.
+void UnpackRgb565(const uint16_t packed, int* color) {
+  const int red = (packed >> 11) & 31;
+  const int green = (packed >> 5) & 63;
+  const int blue = packed & 31;
+  color[0] = (red << 3) | (red >> 2);
+  color[1] = (green << 2) | (green >> 4);
+  color[2] = (blue << 3) | (blue >> 2);
+  color[3] = 255;
+}
+
+// Encodes the colors of a block in the 8 bytes of a BC1 block. The block uses
+// the four color mode, so it can also be the color part of a BC3 block.
+void EncodeBc1Block(const unsigned char* block, unsigned char* output) {
+  float endpoint0[4];
+  float endpoint1[4];
+  ComputeEndpoints(block, 3, endpoint0, endpoint1);
+  uint16_t color0 = PackRgb565(endpoint1);
+  uint16_t color1 = PackRgb565(endpoint0);
+  // The four color mode requires color0 > color1.
+  if (color0 < color1) std::swap(color0, color1);
+  output[0] = color0 & 0xFF;
+  output[1] = color0 >> 8;
+  output[2] = color1 & 0xFF;
+  output[3] = color1 >> 8;
+  uint32_t indices = 0;
+  if (color0 != color1) {
+    int palette[4][4];
+    UnpackRgb565(color0, palette[0]);
+    UnpackRgb565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (int i = 0; i < kPixelsPerBlock; ++i) {
+      const uint32_t index = FindClosestEntry(block + 4 * i, palette, 4, 3);
+      indices |= index << (2 * i);
+    }
+  }
+  for (int i = 0; i < 4; ++i) output[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// Encodes the alpha of a block in the first 8 bytes of a BC3 block.
+void EncodeBc3AlphaBlock(const unsigned char* block, unsigned char* output) {
+  int alpha0 = 0;
+  int alpha1 = 255;
+  for (int i = 0; i < kPixelsPerBlock; ++i) {
+    alpha0 = std::max<int>(alpha0, block[4 * i + 3]);
+    alpha1 = std::min<int>(alpha1, block[4 * i + 3]);
+  }
+  output[0] = alpha0;
+  output[1] = alpha1;
+  uint64_t indices = 0;
+  if (alpha0 != alpha1) {
+    // Eight alpha values interpolated between alpha0 and alpha1.
+    int palette[8][4];
+    palette[0][0] = alpha0;
+    palette[1][0] = alpha1;
+    for (int i = 2; i < 8; ++i) {
+      palette[i][0] = ((8 - i) * alpha0 + (i - 1) * alpha1) / 7;
+    }
+    for (int i = 0; i < kPixelsPerBlock; ++i) {
+      const uint64_t index =
+          FindClosestEntry(block + 4 * i + 3, palette, 8, 1);
+      indices |= index << (3 * i);
+    }
+  }
+  for (int i = 0; i < 6; ++i) output[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// Writes bit fields into a block starting from the least significant bit.
+class BlockBitWriter {
+ public:
+  explicit BlockBitWriter(unsigned char* output) : output_(output), bit_(0) {}
+
+  void Write(const int value, const int num_bits) {
+    for (int i = 0; i < num_bits; ++i, ++bit_) {
+      if ((value >> i) & 1) output_[bit_ / 8] |= 1 << (bit_ % 8);
+    }
+  }
+
+ private:
+  unsigned char* output_;
+  int bit_;
+};
+
+// Encodes a block in the 16 bytes of a BC7 block using mode 6: one subset with
+// RGBA endpoints of 7 bits plus a shared least significant bit (p-bit) per
+// endpoint, and 4-bit indices.
+void EncodeBc7Block(const unsigned char* block, unsigned char* output) {
+  float endpoints[2][4];
+  ComputeEndpoints(block, 4, endpoints[0], endpoints[1]);
+  // Quantize the endpoints choosing the p-bit with the smallest error. Opaque
+  // blocks need the p-bit set to encode an alpha of 255 exactly.
+  bool opaque = true;
+  for (int i = 0; i < kPixelsPerBlock; ++i) {
+    opaque = opaque && block[4 * i + 3] == 255;
+  }
+  int quantized[2][4];
+  int p_bits[2];
+  for (int e = 0; e < 2; ++e) {
+    float best_error = -1.0f;
+    for (int p_bit = opaque ? 1 : 0; p_bit < 2; ++p_bit) {
+      int candidate[4];
+      float error = 0.0f;
+      for (int c = 0; c < 4; ++c) {
+        candidate[c] = std::min(std::max(static_cast<int>(
+            std::floor((endpoints[e][c] - p_bit) / 2.0f + 0.5f)), 0), 127);
+        const float difference =
+            ((candidate[c] << 1) | p_bit) - endpoints[e][c];
+        error += difference * difference;
+      }
+      if (best_error < 0.0f || error < best_error) {
+        best_error = error;
+        p_bits[e] = p_bit;
+        std::copy(candidate, candidate + 4, quantized[e]);
+      }
+    }
+  }
+  int palette[16][4];
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      const int value0 = (quantized[0][c] << 1) | p_bits[0];
+      const int value1 = (quantized[1][c] << 1) | p_bits[1];
+      palette[i][c] = ((64 - kBc7Weights[i]) * value0 +
+                       kBc7Weights[i] * value1 + 32) >> 6;
+    }
+  }
+  int indices[kPixelsPerBlock];
+  for (int i = 0; i < kPixelsPerBlock; ++i) {
+    indices[i] = FindClosestEntry(block + 4 * i, palette, 16, 4);
+  }
+  // The most significant bit of the first index is implicitly zero. Swap the
+  // endpoints when it is set.
+  if (indices[0] & 8) {
+    for (int c = 0; c < 4; ++c) std::swap(quantized[0][c], quantized[1][c]);
+    std::swap(p_bits[0], p_bits[1]);
+    for (int i = 0; i < kPixelsPerBlock; ++i) indices[i] = 15 - indices[i];
+  }
+  std::fill(output, output + 16, 0);
+  BlockBitWriter writer(output);
+  // Mode 6 is encoded as six zeros followed by a one.
+  writer.Write(1 << 6, 7);
+  for (int c = 0; c < 4; ++c) {
+    writer.Write(quantized[0][c], 7);
+    writer.Write(quantized[1][c], 7);
+  }
+  writer.Write(p_bits[0], 1);
+  writer.Write(p_bits[1], 1);
+  writer.Write(indices[0], 3);
+  for (int i = 1; i < kPixelsPerBlock; ++i) writer.Write(indices[i], 4);
+}
+
+// Encodes a row of blocks of the image.
+void EncodeBlockRow(const RgbaImage& image,
+                    const TextureCompressionFormat format,
+                    const int block_row,
+                    unsigned char* output) {
+  const int block_size = GetCompressedBlockSize(format);
+  const int num_block_columns = (image.width + kBlockSide - 1) / kBlockSide;
+  unsigned char block[4 * kPixelsPerBlock];
+  for (int block_column = 0; block_column < num_block_columns;
+       ++block_column) {
+    GatherBlock(image, block_column * kBlockSide, block_row * kBlockSide,
+                block);
+    unsigned char* block_output = output + block_column * block_size;
+    switch (format) {
+      case TextureCompressionFormat::kBc1:
+        EncodeBc1Block(block, block_output);
+        break;
+      case TextureCompressionFormat::kBc3:
+        EncodeBc3AlphaBlock(block, block_output);
+        EncodeBc1Block(block, block_output + 8);
+        break;
+      case TextureCompressionFormat::kBc7:
+        EncodeBc7Block(block, block_output);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+}  // namespace
+
+bool ParseTextureCompressionFormat(const std::string& name,
+                                   TextureCompressionFormat* format) {
+  if (format == nullptr) {
+    std::cout << "Null pointer passed.  Could not parse the format.";
+    return false;
+  }
+  if (name == "none") {
+    *format = TextureCompressionFormat::kNone;
+  } else if (name == "bc1") {
+    *format = TextureCompressionFormat::kBc1;
+  } else if (name == "bc3") {
+    *format = TextureCompressionFormat::kBc3;
+  } else if (name == "bc7") {
+    *format = TextureCompressionFormat::kBc7;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool IsTextureCompressionSupported(const TextureCompressionFormat format) {
+  switch (format) {
+    case TextureCompressionFormat::kNone:
+      return true;
+    case TextureCompressionFormat::kBc1:
+    case TextureCompressionFormat::kBc3:
+      return GLEW_EXT_texture_compression_s3tc;
+    case TextureCompressionFormat::kBc7:
+      return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+  }
+  return false;
+}
+
+GLenum GetCompressedInternalFormat(const TextureCompressionFormat format) {
+  switch (format) {
+    case TextureCompressionFormat::kBc1:
+      return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TextureCompressionFormat::kBc3:
+      return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TextureCompressionFormat::kBc7:
+      return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default:
+      return GL_RGBA8;
+  }
+}
+
+int GetCompressedBlockSize(const TextureCompressionFormat format) {
+  switch (format) {
+    case TextureCompressionFormat::kBc1:
+      return 8;
+    case TextureCompressionFormat::kBc3:
+    case TextureCompressionFormat::kBc7:
+      return 16;
+    default:
+      return 4 * kPixelsPerBlock;
+  }
+}
+
+bool CompressImage(const RgbaImage& image,
+                   const std::vector<RgbaImage>& mipmaps,
+                   const TextureCompressionFormat format,
+                   const int num_threads,
+                   CompressedImage* compressed_image) {
+  if (compressed_image == nullptr) {
+    std::cout << "Null pointer passed.  Could not compress the image.";
+    return false;
+  }
+  if (format == TextureCompressionFormat::kNone || image.pixels.empty()) {
+    return false;
+  }
+  const int num_levels = mipmaps.size() + 1;
+  // Every row of blocks of every level is a task for the threads.
+  struct BlockRowTask {
+    const RgbaImage* level_image;
+    int block_row;
+    unsigned char* output;
+  };
+  const int block_size = GetCompressedBlockSize(format);
+  compressed_image->format = format;
+  compressed_image->levels.resize(num_levels);
+  std::vector<BlockRowTask> tasks;
+  for (int level = 0; level < num_levels; ++level) {
+    const RgbaImage& level_image = level == 0 ? image : mipmaps[level - 1];
+    CompressedLevel& compressed_level = compressed_image->levels[level];
+    compressed_level.width = level_image.width;
+    compressed_level.height = level_image.height;
+    const int num_block_columns =
+        (level_image.width + kBlockSide - 1) / kBlockSide;
+    const int num_block_rows =
+        (level_image.height + kBlockSide - 1) / kBlockSide;
+    const int row_size = num_block_columns * block_size;
+    compressed_level.data.resize(num_block_rows * row_size);
+    for (int block_row = 0; block_row < num_block_rows; ++block_row) {
+      BlockRowTask task;
+      task.level_image = &level_image;
+      task.block_row = block_row;
+      task.output = compressed_level.data.data() + block_row * row_size;
+      tasks.push_back(task);
+    }
+  }
+  std::atomic<int> next_task(0);
+  auto encode_tasks = [&]() {
+    for (int i = next_task++; i < tasks.size(); i = next_task++) {
+      EncodeBlockRow(*tasks[i].level_image, format, tasks[i].block_row,
+                     tasks[i].output);
+    }
+  };
+  int num_workers = num_threads;
+  if (num_workers <= 0) {
+    num_workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::vector<std::thread> workers;
+  for (int i = 1; i < num_workers; ++i) {
+    workers.push_back(std::thread(encode_tasks));
+  }
+  encode_tasks();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  return true;
+}
+
+void UploadCompressedImage(const CompressedImage& compressed_image) {
+  const GLenum internal_format =
+      GetCompressedInternalFormat(compressed_image.format);
+  const int num_levels = compressed_image.levels.size();
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+  const bool use_texture_storage =
+      GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+  if (use_texture_storage) {
+    glTexStorage2D(GL_TEXTURE_2D, num_levels, internal_format,
+                   compressed_image.levels[0].width,
+                   compressed_image.levels[0].height);
+  }
+  for (int level = 0; level < num_levels; ++level) {
+    const CompressedLevel& compressed_level = compressed_image.levels[level];
+    if (use_texture_storage) {
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0,
+                                compressed_level.width,
+                                compressed_level.height, internal_format,
+                                compressed_level.data.size(),
+                                compressed_level.data.data());
+    } else {
+      glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format,
+                             compressed_level.width, compressed_level.height,
+                             0, compressed_level.data.size(),
+                             compressed_level.data.data());
+    }
+  }
+}
+
+size_t ComputeCompressedImageSize(const CompressedImage& compressed_image) {
+  size_t size = 0;
+  for (const CompressedLevel& compressed_level : compressed_image.levels) {
+    size += compressed_level.data.size();
+  }
+  return size;
+}
+
+}  // namespace wvu
@@ -0,0 +1,118 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef TEXTURE_COMPRESSION_H_
+#define TEXTURE_COMPRESSION_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "image_decoder.h"
+
+namespace wvu {
+// Block compression formats. Every format encodes blocks of 4x4 pixels.
+enum class TextureCompressionFormat {
+  // Uncompressed RGBA, 4 bytes per pixel.
+  kNone,
+  // BC1 (DXT1): opaque RGB, 8 bytes per block (0.5 bytes per pixel).
+  kBc1,
+  // BC3 (DXT5): RGBA, 16 bytes per block (1 byte per pixel).
+  kBc3,
+  // BC7 (BPTC) encoded with mode 6: RGBA, 16 bytes per block (1 byte per
+  // pixel) with a better quality than BC3.
+  kBc7
+};
+
+// Mipmap level of a compressed image.
+struct CompressedLevel {
+  int width;
+  int height;
+  // Blocks of the level, row by row.
+  std::vector<unsigned char> data;
+};
+
+// Image compressed with its complete mipmap chain.
+struct CompressedImage {
+  CompressedImage() : format(TextureCompressionFormat::kNone) {}
+  TextureCompressionFormat format;
+  // Level 0 is the full resolution image.
+  std::vector<CompressedLevel> levels;
+};
+
+// Parses the name of a format: "none", "bc1", "bc3" or "bc7". Returns true if
+// successful.
+bool ParseTextureCompressionFormat(const std::string& name,
+                                   TextureCompressionFormat* format);
+
+// Returns true if the OpenGL driver can sample textures in the format. Must be
+// called from the OpenGL thread.
+bool IsTextureCompressionSupported(const TextureCompressionFormat format);
+
+// Returns the OpenGL internal format of the format.
+GLenum GetCompressedInternalFormat(const TextureCompressionFormat format);
+
+// Returns the number of bytes of a block of the format.
+int GetCompressedBlockSize(const TextureCompressionFormat format);
+
+// Compresses every level of the image. The blocks are split among several
+// threads.
+// Params:
+//   image  The image to compress.
+//   mipmaps  The mipmaps of the image (see GenerateMipmaps()).
+//   format  The compression format. It must not be kNone.
+//   num_threads  Number of threads encoding the blocks. When zero, one thread
+//     per hardware thread is used.
+//   compressed_image  The compressed image.
+// Returns true if successful.
+bool CompressImage(const RgbaImage& image,
+                   const std::vector<RgbaImage>& mipmaps,
+                   const TextureCompressionFormat format,
+                   const int num_threads,
+                   CompressedImage* compressed_image);
+
+// Uploads every level of the compressed image into the texture bound to
+// GL_TEXTURE_2D. The levels are allocated at once with glTexStorage2D when the
+// driver supports it, so the texture can not be resized afterwards. The format
+// must be supported (see IsTextureCompressionSupported()).
+void UploadCompressedImage(const CompressedImage& compressed_image);
+
+// Returns the number of bytes of the compressed image, with all its levels.
+size_t ComputeCompressedImageSize(const CompressedImage& compressed_image);
+
+}  // namespace wvu
+
+#endif  // TEXTURE_COMPRESSION_H_
@@ -0,0 +1,284 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "texture_container.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "mipmap_generator.h"
+
+namespace wvu {
+namespace {
+constexpr char kMagic[4] = { 'W', 'V', 'T', 'X' };
+constexpr char kExtension[] = ".wvtx";
+constexpr size_t kHeaderSize = 32;
+// Bytes of an entry of the level table.
+constexpr size_t kLevelEntrySize = 16;
+// Alignment of the data of each level.
+constexpr size_t kLevelAlignment = 16;
+
+// Level to write: its pixels or blocks.
+struct LevelData {
+  const unsigned char* data;
+  size_t size;
+};
+
+void AppendUint32(const uint32_t value, std::vector<unsigned char>* bytes) {
+  for (int i = 0; i < 4; ++i) {
+    bytes->push_back((value >> (8 * i)) & 0xFF);
+  }
+}
+
+void AppendUint64(const uint64_t value, std::vector<unsigned char>* bytes) {
+  for (int i = 0; i < 8; ++i) {
+    bytes->push_back((value >> (8 * i)) & 0xFF);
+  }
+}
+
+uint32_t ReadUint32(const unsigned char* bytes) {
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+uint64_t ReadUint64(const unsigned char* bytes) {
+  return ReadUint32(bytes) |
+      (static_cast<uint64_t>(ReadUint32(bytes + 4)) << 32);
+}
+
+size_t AlignLevelOffset(const size_t offset) {
+  return (offset + kLevelAlignment - 1) / kLevelAlignment * kLevelAlignment;
+}
+
+// Returns the bytes of a level of the given size.
+size_t ComputeLevelSize(const TextureCompressionFormat format,
+                        const int width,
+                        const int height) {
+  if (format == TextureCompressionFormat::kNone) {
+    return 4 * static_cast<size_t>(width) * height;
+  }
+  return static_cast<size_t>(GetCompressedBlockSize(format)) *
+      ((width + 3) / 4) * ((height + 3) / 4);
+}
+
+bool WriteLevels(const std::string& filepath,
+                 const TextureCompressionFormat format,
+                 const int width,
+                 const int height,
+                 const std::vector<LevelData>& levels) {
+  std::vector<unsigned char> header(kMagic, kMagic + 4);
+  AppendUint32(kTextureContainerVersion, &header);
+  AppendUint32(static_cast<uint32_t>(format), &header);
+  AppendUint32(width, &header);
+  AppendUint32(height, &header);
+  AppendUint32(levels.size(), &header);
+  AppendUint32(0, &header);
+  AppendUint32(0, &header);
+  size_t offset = kHeaderSize + levels.size() * kLevelEntrySize;
+  std::vector<size_t> offsets;
+  for (const LevelData& level : levels) {
+    offset = AlignLevelOffset(offset);
+    offsets.push_back(offset);
+    AppendUint64(offset, &header);
+    AppendUint64(level.size, &header);
+    offset += level.size;
+  }
+  std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  const char padding[kLevelAlignment] = { 0 };
+  offset = header.size();
+  for (int i = 0; i < levels.size(); ++i) {
+    file.write(padding, offsets[i] - offset);
+    file.write(reinterpret_cast<const char*>(levels[i].data), levels[i].size);
+    offset = offsets[i] + levels[i].size;
+  }
+  return file.good();
+}
+
+}  // namespace
+
+bool IsTextureContainerPath(const std::string& filepath) {
+  const size_t extension_length = sizeof(kExtension) - 1;
+  return filepath.size() >= extension_length &&
+      filepath.compare(filepath.size() - extension_length, extension_length,
+                       kExtension) == 0;
+}
+
+bool WriteTextureContainer(const std::string& filepath,
+                           const RgbaImage& image,
+                           const std::vector<RgbaImage>& mipmaps) {
+  if (image.pixels.empty()) return false;
+  std::vector<LevelData> levels;
+  levels.push_back({ image.pixels.data(), image.pixels.size() });
+  for (const RgbaImage& mipmap : mipmaps) {
+    levels.push_back({ mipmap.pixels.data(), mipmap.pixels.size() });
+  }
+  return WriteLevels(filepath, TextureCompressionFormat::kNone, image.width,
+                     image.height, levels);
+}
+
+bool WriteTextureContainer(const std::string& filepath,
+                           const CompressedImage& compressed_image) {
+  if (compressed_image.levels.empty()) return false;
+  std::vector<LevelData> levels;
+  for (const CompressedLevel& level : compressed_image.levels) {
+    levels.push_back({ level.data.data(), level.data.size() });
+  }
+  return WriteLevels(filepath, compressed_image.format,
+                     compressed_image.levels[0].width,
+                     compressed_image.levels[0].height, levels);
+}
+
+TextureContainer::TextureContainer() :
+    format_(TextureCompressionFormat::kNone), width_(0), height_(0) {}
+
+bool TextureContainer::Open(const std::string& filepath) {
+  Close();
+  if (!file_.Open(filepath)) return false;
+  const unsigned char* data = file_.data();
+  if (file_.size() < kHeaderSize || std::memcmp(data, kMagic, 4) != 0 ||
+      ReadUint32(data + 4) != kTextureContainerVersion) {
+    Close();
+    return false;
+  }
+  const uint32_t format = ReadUint32(data + 8);
+  const uint32_t width = ReadUint32(data + 12);
+  const uint32_t height = ReadUint32(data + 16);
+  const uint32_t num_levels = ReadUint32(data + 20);
+  if (format > static_cast<uint32_t>(TextureCompressionFormat::kBc7) ||
+      width == 0 || height == 0 || width > (1 << 16) || height > (1 << 16) ||
+      num_levels == 0 || num_levels > ComputeNumMipmapLevels(width, height) ||
+      file_.size() < kHeaderSize + num_levels * kLevelEntrySize) {
+    Close();
+    return false;
+  }
+  format_ = static_cast<TextureCompressionFormat>(format);
+  width_ = width;
+  height_ = height;
+  for (int i = 0; i < num_levels; ++i) {
+    const unsigned char* entry = data + kHeaderSize + i * kLevelEntrySize;
+    const uint64_t offset = ReadUint64(entry);
+    Level level;
+    level.width = std::max(1, width_ >> i);
+    level.height = std::max(1, height_ >> i);
+    level.size = ReadUint64(entry + 8);
+    // The level must have the size of its format and lie within the file.
+    if (level.size != ComputeLevelSize(format_, level.width, level.height) ||
+        offset > file_.size() || level.size > file_.size() - offset) {
+      Close();
+      return false;
+    }
+    level.data = data + offset;
+    levels_.push_back(level);
+  }
+  return true;
+}
+
+void TextureContainer::Close() {
+  file_.Close();
+  format_ = TextureCompressionFormat::kNone;
+  width_ = 0;
+  height_ = 0;
+  levels_.clear();
+}
+
+bool TextureContainer::Upload() const {
+  if (levels_.empty() || !IsTextureCompressionSupported(format_)) {
+    return false;
+  }
+  const bool compressed = format_ != TextureCompressionFormat::kNone;
+  const GLenum internal_format =
+      compressed ? GetCompressedInternalFormat(format_) : GL_RGBA8;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels_.size() - 1);
+  // The rows of the levels are tightly packed.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  const bool use_texture_storage =
+      GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+  if (use_texture_storage) {
+    glTexStorage2D(GL_TEXTURE_2D, levels_.size(), internal_format, width_,
+                   height_);
+  }
+  // The levels are read straight from the mapping.
+  for (int i = 0; i < levels_.size(); ++i) {
+    const Level& level = levels_[i];
+    if (compressed && use_texture_storage) {
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width,
+                                level.height, internal_format, level.size,
+                                level.data);
+    } else if (compressed) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, internal_format, level.width,
+                             level.height, 0, level.size, level.data);
+    } else if (use_texture_storage) {
+      glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height,
+                      GL_RGBA, GL_UNSIGNED_BYTE, level.data);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, i, internal_format, level.width,
+                   level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.data);
+    }
+  }
+  return true;
+}
+
+bool TextureContainer::CopyImage(RgbaImage* image) const {
+  if (image == nullptr) {
+    std::cout << "Null pointer passed.  Could not copy the image.";
+    return false;
+  }
+  if (levels_.empty() || format_ != TextureCompressionFormat::kNone) {
+    return false;
+  }
+  image->width = width_;
+  image->height = height_;
+  image->pixels.assign(levels_[0].data, levels_[0].data + levels_[0].size);
+  return true;
+}
+
+size_t TextureContainer::data_size() const {
+  size_t size = 0;
+  for (const Level& level : levels_) {
+    size += level.size;
+  }
+  return size;
+}
+
+}  // namespace wvu
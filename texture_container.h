@@ -0,0 +1,185 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef TEXTURE_CONTAINER_H_
+#define TEXTURE_CONTAINER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image_decoder.h"
+#include "mapped_file.h"
+#include "texture_compression.h"
+
+namespace wvu {
+// Texture container (.wvtx) holding a texture ready to upload: every mipmap
+// level, either as RGBA pixels or as compressed blocks. The containers are
+// written offline (see texture_baker.cc), so loading a texture only maps the
+// file and uploads the levels straight from the mapping, without decoding,
+// filtering or copying them.
+//
+// File layout, little endian:
+//   Header (32 bytes):
+//     char magic[4]  "WVTX".
+//     uint32 version  kTextureContainerVersion.
+//     uint32 format  TextureCompressionFormat of the levels (kNone is RGBA).
+//     uint32 width, height  Size of level 0.
+//     uint32 num_levels  Level i is max(1, width >> i) x max(1, height >> i).
+//     uint32 reserved[2]  Zero.
+//   Level table: num_levels entries of
+//     uint64 offset  Offset of the level from the beginning of the file.
+//     uint64 size  Bytes of the level.
+//   Level data, each level starting at a multiple of 16 bytes.
+//
+// Example:
+//
+// wvu::TextureContainer container;
+// if (container.Open("texture.wvtx")) {
+//   glBindTexture(GL_TEXTURE_2D, texture_id);
+//   container.Upload();
+// }
+
+// Version of the layout written by WriteTextureContainer().
+constexpr uint32_t kTextureContainerVersion = 1;
+
+// Returns true if the filepath has the .wvtx extension of the containers.
+bool IsTextureContainerPath(const std::string& filepath);
+
+// Writes an uncompressed image and its mipmaps into a container. Returns true
+// if successful.
+// Params:
+//   filepath  The path of the container.
+//   image  Level 0 of the texture.
+//   mipmaps  The remaining levels (see GenerateMipmaps()).
+bool WriteTextureContainer(const std::string& filepath,
+                           const RgbaImage& image,
+                           const std::vector<RgbaImage>& mipmaps);
+
+// Writes a compressed image into a container. Returns true if successful.
+// Params:
+//   filepath  The path of the container.
+//   compressed_image  The compressed levels (see CompressImage()).
+bool WriteTextureContainer(const std::string& filepath,
+                           const CompressedImage& compressed_image);
+
+// Memory-mapped container.
+class TextureContainer {
+ public:
+  TextureContainer();
+
+  // Maps the container and checks its header and level table. Returns true if
+  // the file is a valid container.
+  // Params:
+  //   filepath  The path of the container.
+  bool Open(const std::string& filepath);
+
+  // Unmaps the container.
+  void Close();
+
+  // Asks the operating system to read the container in the background.
+  void ReadAhead() const {
+    file_.ReadAhead();
+  }
+
+  // Uploads every level into the texture bound to GL_TEXTURE_2D, allocated
+  // with glTexStorage2D when the driver supports it. Returns false if the
+  // driver does not support the compression format of the container. Must be
+  // called from the OpenGL thread.
+  bool Upload() const;
+
+  // Copies level 0 of an uncompressed container into an image. Returns false
+  // if the container is compressed.
+  bool CopyImage(RgbaImage* image) const;
+
+  TextureCompressionFormat format() const {
+    return format_;
+  }
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  int num_levels() const {
+    return levels_.size();
+  }
+
+  // Returns the bytes of all the levels.
+  size_t data_size() const;
+
+  // Returns the size of a level.
+  int level_width(const int level) const {
+    return levels_[level].width;
+  }
+
+  int level_height(const int level) const {
+    return levels_[level].height;
+  }
+
+  // Returns the pixels or blocks of a level, within the mapping.
+  const unsigned char* level_data(const int level) const {
+    return levels_[level].data;
+  }
+
+  // Returns the bytes of a level.
+  size_t level_size(const int level) const {
+    return levels_[level].size;
+  }
+
+ private:
+  // Level of the texture within the mapping.
+  struct Level {
+    int width;
+    int height;
+    const unsigned char* data;
+    size_t size;
+  };
+
+  MappedFile file_;
+  TextureCompressionFormat format_;
+  int width_;
+  int height_;
+  std::vector<Level> levels_;
+};
+
+}  // namespace wvu
+
+#endif  // TEXTURE_CONTAINER_H_
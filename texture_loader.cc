@@ -0,0 +1,556 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "texture_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "image_decoder.h"
+#include "texture_compression.h"
+
+namespace wvu {
+namespace {
+// Side of the placeholder image.
+constexpr int kPlaceholderSize = 2;
+// Levels up to this size are uploaded as soon as the image of a texture is
+// ready, regardless of the upload budget.
+constexpr int kStreamingTailSize = 16;
+
+// Checkerboard shown until the image of a texture is uploaded.
+constexpr unsigned char kPlaceholderPixels[kPlaceholderSize *
+                                           kPlaceholderSize * 3] = {
+  255, 255, 255,  128, 128, 128,
+  128, 128, 128,  255, 255, 255
+};
+
+// Sets the sampling parameters of the bound texture.
+void SetTextureParameters() {
+  // We are configuring texture wrapper, each per dimension,s:x, t:y.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  // Define the interpolation behavior for this texture: trilinear, so that the
+  // mipmaps are sampled.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// Returns the bytes of an uncompressed RGBA texture with its mipmaps.
+size_t ComputeUncompressedSize(const int width, const int height) {
+  size_t size = 0;
+  int level_width = width;
+  int level_height = height;
+  while (true) {
+    size += 4 * static_cast<size_t>(level_width) * level_height;
+    if (level_width == 1 && level_height == 1) break;
+    level_width = std::max(1, level_width / 2);
+    level_height = std::max(1, level_height / 2);
+  }
+  return size;
+}
+
+}  // namespace
+
+TextureLoader::TextureLoader(const int num_threads) :
+    compression_format_(TextureCompressionFormat::kNone),
+    mipmap_filter_(MipmapFilter::kBox), preview_scale_denominator_(1),
+    upload_budget_(0), stop_(false), decoded_images_(nullptr),
+    num_pending_(0) {
+  stats_.num_loaded = 0;
+  stats_.num_failed = 0;
+  stats_.uploaded_bytes = 0;
+  stats_.uncompressed_bytes = 0;
+  stats_.upload_time_ms = 0.0;
+  stats_.num_previews = 0;
+  stats_.num_streamed_levels = 0;
+  int num_workers = num_threads;
+  if (num_workers <= 0) {
+    num_workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Split the hardware threads among the workers filtering and compressing
+  // images.
+  num_threads_per_image_ =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()) /
+                      num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.push_back(std::thread(&TextureLoader::WorkerLoop, this));
+  }
+}
+
+TextureLoader::~TextureLoader() {
+  {
+    std::lock_guard<std::mutex> lock(requests_mutex_);
+    stop_ = true;
+  }
+  requests_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+  DecodedImage* decoded_image = decoded_images_.exchange(nullptr);
+  while (decoded_image != nullptr) {
+    DecodedImage* next = decoded_image->next;
+    delete decoded_image;
+    decoded_image = next;
+  }
+}
+
+GLuint TextureLoader::Load(const std::string& filepath) {
+  GLuint texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  // The placeholder is mutable storage without mipmaps; the image replaces it.
+  SetTextureParameters();
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, kPlaceholderSize, kPlaceholderSize,
+               0, GL_RGB, GL_UNSIGNED_BYTE, kPlaceholderPixels);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  if (IsTextureContainerPath(filepath)) {
+    // Containers need no decoding: stream the levels from the mapping.
+    std::unique_ptr<DecodedImage> decoded_image(new DecodedImage);
+    decoded_image->texture_id = texture_id;
+    decoded_image->destination = nullptr;
+    decoded_image->preview = false;
+    decoded_image->next = nullptr;
+    decoded_image->container.reset(new TextureContainer);
+    const TextureContainer& container = *decoded_image->container;
+    if (!decoded_image->container->Open(filepath) ||
+        !IsTextureCompressionSupported(container.format())) {
+      ++stats_.num_failed;
+      return texture_id;
+    }
+    container.ReadAhead();
+    decoded_image->image.width = container.width();
+    decoded_image->image.height = container.height();
+    StartStreaming(std::move(decoded_image));
+    ++stats_.num_loaded;
+    return texture_id;
+  }
+  LoadRequest request;
+  request.filepath = filepath;
+  request.texture_id = texture_id;
+  request.destination = nullptr;
+  request.compression_format = compression_format_;
+  request.mipmap_filter = mipmap_filter_;
+  request.preview_scale_denominator = preview_scale_denominator_;
+  QueueRequest(request);
+  pending_texture_ids_.insert(texture_id);
+  return texture_id;
+}
+
+void TextureLoader::Cancel(const GLuint texture_id) {
+  // Drop the levels that are not uploaded yet.
+  for (auto streaming_texture = streaming_textures_.begin();
+       streaming_texture != streaming_textures_.end(); ++streaming_texture) {
+    if ((*streaming_texture)->texture_id == texture_id) {
+      streaming_textures_.erase(streaming_texture);
+      return;
+    }
+  }
+  if (pending_texture_ids_.count(texture_id) == 0) return;
+  {
+    std::lock_guard<std::mutex> lock(requests_mutex_);
+    for (auto request = requests_.begin(); request != requests_.end();
+         ++request) {
+      if (request->texture_id == texture_id) {
+        // No worker took the request yet.
+        requests_.erase(request);
+        pending_texture_ids_.erase(pending_texture_ids_.find(texture_id));
+        --num_pending_;
+        return;
+      }
+    }
+  }
+  // A worker is decoding the image; drop it when it arrives.
+  cancelled_texture_ids_.insert(texture_id);
+}
+
+bool TextureLoader::IsLoading(const GLuint texture_id) const {
+  if (pending_texture_ids_.count(texture_id) > 0) return true;
+  for (const auto& streaming_texture : streaming_textures_) {
+    if (streaming_texture->texture_id == texture_id) return true;
+  }
+  return false;
+}
+
+void TextureLoader::LoadImage(const std::string& filepath, RgbaImage* image) {
+  LoadRequest request;
+  request.filepath = filepath;
+  request.texture_id = 0;
+  request.destination = image;
+  request.compression_format = TextureCompressionFormat::kNone;
+  request.mipmap_filter = mipmap_filter_;
+  request.preview_scale_denominator = 1;
+  QueueRequest(request);
+}
+
+bool TextureLoader::set_compression_format(
+    const TextureCompressionFormat format) {
+  if (!IsTextureCompressionSupported(format)) return false;
+  compression_format_ = format;
+  return true;
+}
+
+void TextureLoader::QueueRequest(const LoadRequest& request) {
+  {
+    std::lock_guard<std::mutex> lock(requests_mutex_);
+    requests_.push_back(request);
+  }
+  requests_condition_.notify_one();
+  ++num_pending_;
+}
+
+int TextureLoader::Update() {
+  // Take all the decoded images at once. The stack holds the most recent image
+  // on top, so reverse it to upload the images in completion order.
+  DecodedImage* decoded_image =
+      decoded_images_.exchange(nullptr, std::memory_order_acquire);
+  DecodedImage* reversed = nullptr;
+  while (decoded_image != nullptr) {
+    DecodedImage* next = decoded_image->next;
+    decoded_image->next = reversed;
+    reversed = decoded_image;
+    decoded_image = next;
+  }
+  int num_updated = 0;
+  bool texture_bound = false;
+  while (reversed != nullptr) {
+    std::unique_ptr<DecodedImage> decoded_image(reversed);
+    reversed = reversed->next;
+    const bool preview = decoded_image->preview;
+    bool cancelled = false;
+    if (decoded_image->destination == nullptr) {
+      const auto cancelled_id =
+          cancelled_texture_ids_.find(decoded_image->texture_id);
+      cancelled = cancelled_id != cancelled_texture_ids_.end();
+      // A preview is followed by the full image, which is still pending
+      // unless it was cancelled before a worker took it.
+      if (preview) {
+        cancelled = cancelled ||
+            pending_texture_ids_.count(decoded_image->texture_id) == 0;
+      } else {
+        pending_texture_ids_.erase(
+            pending_texture_ids_.find(decoded_image->texture_id));
+        if (cancelled) cancelled_texture_ids_.erase(cancelled_id);
+      }
+    }
+    if (!preview) --num_pending_;
+    if (cancelled) {
+      // The texture may have been deleted and its id reused; drop the image.
+    } else if (preview) {
+      // The full image is uploaded into immutable storage later, so the
+      // preview can not use it.
+      glBindTexture(GL_TEXTURE_2D, decoded_image->texture_id);
+      UploadMipmappedImage(decoded_image->image, decoded_image->mipmaps,
+                           false);
+      texture_bound = true;
+      ++stats_.num_previews;
+    } else if (decoded_image->success &&
+               decoded_image->destination != nullptr) {
+      std::swap(*decoded_image->destination, decoded_image->image);
+      ++stats_.num_loaded;
+      ++num_updated;
+    } else if (decoded_image->success) {
+      StartStreaming(std::move(decoded_image));
+      ++stats_.num_loaded;
+      ++num_updated;
+    } else {
+      ++stats_.num_failed;
+    }
+  }
+  if (texture_bound) {
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  StreamLevels();
+  return num_updated;
+}
+
+void TextureLoader::WaitForAll() {
+  while (num_pending_ > 0 || !streaming_textures_.empty()) {
+    if (Update() == 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void TextureLoader::WorkerLoop() {
+  while (true) {
+    LoadRequest request;
+    {
+      std::unique_lock<std::mutex> lock(requests_mutex_);
+      requests_condition_.wait(lock, [this]() {
+        return stop_ || !requests_.empty();
+      });
+      if (stop_) return;
+      request = requests_.front();
+      requests_.pop_front();
+    }
+    DecodedImage* preview = nullptr;
+    if (request.preview_scale_denominator > 1) {
+      preview = DecodePreview(request);
+    }
+    PushDecodedImage(preview != nullptr ? preview : Decode(request));
+  }
+}
+
+TextureLoader::DecodedImage* TextureLoader::DecodePreview(
+    const LoadRequest& request) {
+  DecodedImage* preview = new DecodedImage;
+  preview->texture_id = request.texture_id;
+  preview->destination = nullptr;
+  preview->next = nullptr;
+  preview->preview = true;
+  preview->success = DecodeReducedImageFile(
+      request.filepath, request.preview_scale_denominator, &preview->image);
+  if (!preview->success) {
+    delete preview;
+    return nullptr;
+  }
+  GenerateMipmaps(preview->image, request.mipmap_filter,
+                  num_threads_per_image_, &preview->mipmaps);
+  // Decode the full image after the previews queued so far.
+  LoadRequest full_request = request;
+  full_request.preview_scale_denominator = 1;
+  {
+    std::lock_guard<std::mutex> lock(requests_mutex_);
+    requests_.push_back(full_request);
+  }
+  requests_condition_.notify_one();
+  return preview;
+}
+
+void TextureLoader::StartStreaming(
+    std::unique_ptr<DecodedImage> decoded_image) {
+  const auto start_time = std::chrono::steady_clock::now();
+  std::unique_ptr<StreamingTexture> streaming_texture(new StreamingTexture);
+  streaming_texture->texture_id = decoded_image->texture_id;
+  // Gather the levels, wherever they are.
+  const TextureContainer* container = decoded_image->container.get();
+  const CompressedImage& compressed_image = decoded_image->compressed_image;
+  TextureCompressionFormat format = TextureCompressionFormat::kNone;
+  if (container != nullptr) {
+    format = container->format();
+    for (int level = 0; level < container->num_levels(); ++level) {
+      streaming_texture->levels.push_back({
+          container->level_width(level), container->level_height(level),
+          container->level_data(level), container->level_size(level) });
+    }
+  } else if (!compressed_image.levels.empty()) {
+    format = compressed_image.format;
+    for (const CompressedLevel& level : compressed_image.levels) {
+      streaming_texture->levels.push_back({
+          level.width, level.height, level.data.data(), level.data.size() });
+    }
+  } else {
+    const RgbaImage& image = decoded_image->image;
+    streaming_texture->levels.push_back({
+        image.width, image.height, image.pixels.data(), image.pixels.size() });
+    for (const RgbaImage& mipmap : decoded_image->mipmaps) {
+      streaming_texture->levels.push_back({
+          mipmap.width, mipmap.height, mipmap.pixels.data(),
+          mipmap.pixels.size() });
+    }
+  }
+  streaming_texture->compressed = format != TextureCompressionFormat::kNone;
+  streaming_texture->internal_format = streaming_texture->compressed ?
+      GetCompressedInternalFormat(format) : GL_RGBA8;
+  const int num_levels = streaming_texture->levels.size();
+  streaming_texture->base_level = num_levels;
+  streaming_texture->decoded_image = std::move(decoded_image);
+
+  glBindTexture(GL_TEXTURE_2D, streaming_texture->texture_id);
+  SetTextureParameters();
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+  if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+    glTexStorage2D(GL_TEXTURE_2D, num_levels,
+                   streaming_texture->internal_format,
+                   streaming_texture->levels[0].width,
+                   streaming_texture->levels[0].height);
+  }
+  for (const TextureLevel& level : streaming_texture->levels) {
+    stats_.uploaded_bytes += level.size;
+  }
+  stats_.uncompressed_bytes += ComputeUncompressedSize(
+      streaming_texture->levels[0].width, streaming_texture->levels[0].height);
+  // Upload the small levels right away so the texture can be drawn, and the
+  // rest too if there is no budget.
+  while (streaming_texture->base_level > 0) {
+    const TextureLevel& level =
+        streaming_texture->levels[streaming_texture->base_level - 1];
+    if (upload_budget_ > 0 && (level.width > kStreamingTailSize ||
+                               level.height > kStreamingTailSize)) {
+      break;
+    }
+    UploadLevel(streaming_texture->base_level - 1, streaming_texture.get());
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  stats_.upload_time_ms += std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start_time).count();
+  if (streaming_texture->base_level > 0) {
+    streaming_textures_.push_back(std::move(streaming_texture));
+  }
+}
+
+void TextureLoader::StreamLevels() {
+  if (streaming_textures_.empty()) return;
+  const auto start_time = std::chrono::steady_clock::now();
+  size_t uploaded_size = 0;
+  while (!streaming_textures_.empty()) {
+    // Every texture gets its smaller levels before any texture gets a larger
+    // one.
+    auto next_texture = streaming_textures_.begin();
+    for (auto streaming_texture = streaming_textures_.begin();
+         streaming_texture != streaming_textures_.end(); ++streaming_texture) {
+      const StreamingTexture& texture = **streaming_texture;
+      if (texture.levels[texture.base_level - 1].size <
+          (*next_texture)->levels[(*next_texture)->base_level - 1].size) {
+        next_texture = streaming_texture;
+      }
+    }
+    StreamingTexture* texture = next_texture->get();
+    const size_t level_size = texture->levels[texture->base_level - 1].size;
+    // Upload at least one level per call, however large.
+    if (uploaded_size > 0 && upload_budget_ > 0 &&
+        uploaded_size + level_size > upload_budget_) {
+      break;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+    UploadLevel(texture->base_level - 1, texture);
+    uploaded_size += level_size;
+    ++stats_.num_streamed_levels;
+    if (texture->base_level == 0) {
+      streaming_textures_.erase(next_texture);
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  stats_.upload_time_ms += std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start_time).count();
+}
+
+void TextureLoader::UploadLevel(const int level,
+                                StreamingTexture* streaming_texture) {
+  const TextureLevel& texture_level = streaming_texture->levels[level];
+  const bool use_texture_storage =
+      GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+  // The rows of the levels are tightly packed.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (streaming_texture->compressed && use_texture_storage) {
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, texture_level.width,
+                              texture_level.height,
+                              streaming_texture->internal_format,
+                              texture_level.size, texture_level.data);
+  } else if (streaming_texture->compressed) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, level,
+                           streaming_texture->internal_format,
+                           texture_level.width, texture_level.height, 0,
+                           texture_level.size, texture_level.data);
+  } else if (use_texture_storage) {
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, texture_level.width,
+                    texture_level.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                    texture_level.data);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, texture_level.width,
+                 texture_level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 texture_level.data);
+  }
+  // Sample only the uploaded levels; the finer ones hold no image yet.
+  streaming_texture->base_level = level;
+  if (use_texture_storage) {
+    // The immutable storage keeps the texture complete with the finer levels
+    // undefined, so the base level stays at 0 and the minimum LOD clamps the
+    // sampling to the uploaded levels. The minimum LOD is relative to the
+    // base level, so moving both would skip the uploaded levels as well. The
+    // shaders sample with texture(), which honors the minimum LOD.
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD,
+                    static_cast<GLfloat>(level));
+  } else {
+    // Mutable storage is only complete from the base level on.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+  }
+}
+
+void TextureLoader::PushDecodedImage(DecodedImage* decoded_image) {
+  decoded_image->next = decoded_images_.load(std::memory_order_relaxed);
+  while (!decoded_images_.compare_exchange_weak(decoded_image->next,
+                                                decoded_image,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+  }
+}
+
+TextureLoader::DecodedImage* TextureLoader::Decode(
+    const LoadRequest& request) const {
+  DecodedImage* decoded_image = new DecodedImage;
+  decoded_image->texture_id = request.texture_id;
+  decoded_image->destination = request.destination;
+  decoded_image->next = nullptr;
+  decoded_image->preview = false;
+  if (IsTextureContainerPath(request.filepath)) {
+    // Only images come here; Load() streams the containers itself.
+    TextureContainer container;
+    decoded_image->success = container.Open(request.filepath) &&
+        container.CopyImage(&decoded_image->image);
+    return decoded_image;
+  }
+  decoded_image->success = DecodeImageFile(request.filepath,
+                                           &decoded_image->image);
+  if (!decoded_image->success || request.destination != nullptr) {
+    return decoded_image;
+  }
+  GenerateMipmaps(decoded_image->image, request.mipmap_filter,
+                  num_threads_per_image_, &decoded_image->mipmaps);
+  if (request.compression_format != TextureCompressionFormat::kNone) {
+    CompressImage(decoded_image->image, decoded_image->mipmaps,
+                  request.compression_format, num_threads_per_image_,
+                  &decoded_image->compressed_image);
+    // Only the size of the image is needed after compressing it.
+    std::vector<unsigned char>().swap(decoded_image->image.pixels);
+    std::vector<RgbaImage>().swap(decoded_image->mipmaps);
+  }
+  return decoded_image;
+}
+
+}  // namespace wvu
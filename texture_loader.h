@@ -0,0 +1,295 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef TEXTURE_LOADER_H_
+#define TEXTURE_LOADER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <GL/glew.h>
+
+#include "image_decoder.h"
+#include "mipmap_generator.h"
+#include "texture_compression.h"
+#include "texture_container.h"
+
+namespace wvu {
+// Loads textures asynchronously. Load() creates the OpenGL texture right away
+// with a small placeholder image and queues the decoding of the file into a
+// pool of worker threads. The workers decode the images and build their
+// mipmaps in parallel, and hand the finished pixel buffers to the OpenGL
+// thread through a lock-free queue. Update(), called from the OpenGL thread
+// (e.g., once per frame), allocates immutable storage for the finished images
+// and streams their levels in: the levels up to 16x16 are uploaded at once,
+// and the larger ones over the following calls, from the smallest to the
+// largest, within a per-call upload budget. The base level of each texture is
+// clamped to its finest uploaded level, so the textures can be drawn while
+// they stream. Optionally, JPEG textures first get a preview decoded at a
+// reduced resolution. Texture containers (.wvtx, see texture_container.h)
+// need no decoding: Load() maps them and starts streaming them right away.
+//
+// Example:
+//
+// wvu::TextureLoader texture_loader(0);  // One worker per hardware thread.
+// model->set_texture(texture_loader.Load("/path/to/texture.jpg"));
+// while (...) {  // Rendering loop.
+//   texture_loader.Update();
+//   ...  // Draw the models.
+// }
+//
+// The loader does not own the textures; the caller deletes them.
+class TextureLoader {
+ public:
+  // Statistics of the loader.
+  struct Stats {
+    // Number of textures and images whose file was decoded.
+    int num_loaded;
+    // Number of textures whose image could not be decoded. They keep the
+    // placeholder image.
+    int num_failed;
+    // Bytes of video memory taken by the uploaded textures, with mipmaps.
+    size_t uploaded_bytes;
+    // Bytes the uploaded textures would take without compression.
+    size_t uncompressed_bytes;
+    // Time spent uploading the textures.
+    double upload_time_ms;
+    // Number of previews uploaded.
+    int num_previews;
+    // Number of levels uploaded after the first call to Update() that saw
+    // their texture.
+    int num_streamed_levels;
+  };
+
+  // Params:
+  //   num_threads  Number of worker threads. When zero, one worker per
+  //     hardware thread is created.
+  explicit TextureLoader(const int num_threads);
+  // Stops the workers. Decoded images that were not uploaded are discarded.
+  ~TextureLoader();
+
+  // Creates a texture with a placeholder image and queues the decoding of the
+  // image file. Returns the texture id. Must be called from the OpenGL thread.
+  GLuint Load(const std::string& filepath);
+
+  // Queues the decoding of the image file into the given image, without
+  // creating a texture (e.g., to pack it into a texture array). The image is
+  // filled by Update(); it stays empty if the file could not be decoded. The
+  // image must outlive the request.
+  void LoadImage(const std::string& filepath, RgbaImage* image);
+
+  // Cancels the loading of the image of a texture, so that the texture can be
+  // deleted. Does nothing if the image was already uploaded. Must be called
+  // from the OpenGL thread.
+  void Cancel(const GLuint texture_id);
+
+  // Starts streaming the images decoded since the last call, and uploads the
+  // next levels of the streaming textures within the upload budget. Must be
+  // called from the OpenGL thread. Returns the number of textures updated.
+  int Update();
+
+  // Blocks until every queued image is decoded and all its levels uploaded.
+  // Must be called from the OpenGL thread.
+  void WaitForAll();
+
+  // Sets the bytes of texture levels uploaded per call to Update(). At least
+  // one level is uploaded per call, however large. Zero uploads every level
+  // right away.
+  void set_upload_budget(const size_t upload_budget) {
+    upload_budget_ = upload_budget;
+  }
+
+  // Sets the block compression of the textures loaded afterwards. The workers
+  // compress the decoded images, and Update() uploads the compressed mipmaps.
+  // Returns false, keeping the current format, if the driver does not support
+  // the format. Must be called from the OpenGL thread.
+  bool set_compression_format(const TextureCompressionFormat format);
+
+  // Sets the filter building the mipmaps of the textures loaded afterwards.
+  void set_mipmap_filter(const MipmapFilter filter) {
+    mipmap_filter_ = filter;
+  }
+
+  // Sets the reduction of the previews of the textures loaded afterwards: 2,
+  // 4 or 8 decode JPEG files at 1/2, 1/4 or 1/8 of their resolution before
+  // decoding them fully. The previews of all the queued textures are decoded
+  // before the full images. 1 disables the previews.
+  void set_preview_scale_denominator(const int scale_denominator) {
+    preview_scale_denominator_ = scale_denominator;
+  }
+
+  // Returns the number of textures and images waiting to be decoded.
+  int num_pending() const {
+    return num_pending_;
+  }
+
+  // Returns true if the image of the texture is being decoded or some of its
+  // levels are not uploaded yet.
+  bool IsLoading(const GLuint texture_id) const;
+
+  // Returns the number of textures with levels waiting to be uploaded.
+  int num_streaming() const {
+    return streaming_textures_.size();
+  }
+
+  // Returns the statistics of the loader.
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  // Image file to decode into a texture.
+  struct LoadRequest {
+    std::string filepath;
+    // Texture receiving the image, or zero if the image goes to destination.
+    GLuint texture_id;
+    RgbaImage* destination;
+    TextureCompressionFormat compression_format;
+    MipmapFilter mipmap_filter;
+    // Reduction of the preview to decode, or 1 to decode the full image.
+    int preview_scale_denominator;
+  };
+
+  // Decoded image waiting to be uploaded. The workers link the decoded images
+  // in a lock-free stack.
+  struct DecodedImage {
+    GLuint texture_id;
+    RgbaImage* destination;
+    // True if the file was decoded.
+    bool success;
+    // True if the image is a preview; the full image comes later.
+    bool preview;
+    RgbaImage image;
+    // Mipmaps of the image. Empty for the images going to a destination.
+    std::vector<RgbaImage> mipmaps;
+    // Compressed mipmaps of the image. Empty if the texture is not compressed.
+    CompressedImage compressed_image;
+    // Container of the texture, for .wvtx files. The image only holds its
+    // size then.
+    std::unique_ptr<TextureContainer> container;
+    // Next decoded image in the stack.
+    DecodedImage* next;
+  };
+
+  // Level of a streaming texture.
+  struct TextureLevel {
+    int width;
+    int height;
+    const unsigned char* data;
+    size_t size;
+  };
+
+  // Texture whose levels are uploaded from the smallest to the largest.
+  struct StreamingTexture {
+    GLuint texture_id;
+    // Owner of the levels.
+    std::unique_ptr<DecodedImage> decoded_image;
+    // Internal format of the texture, compressed or GL_RGBA8.
+    GLenum internal_format;
+    bool compressed;
+    std::vector<TextureLevel> levels;
+    // Finest level uploaded so far, which is the base level of the texture.
+    int base_level;
+  };
+
+  // Body of the worker threads.
+  void WorkerLoop();
+  // Decodes the preview of the request. If the file has a preview, queues the
+  // decoding of the full image and returns the preview; otherwise returns
+  // null.
+  DecodedImage* DecodePreview(const LoadRequest& request);
+  // Queues a request for the workers.
+  void QueueRequest(const LoadRequest& request);
+  // Decodes the image of the request and builds its mipmaps, and compresses
+  // it if requested.
+  DecodedImage* Decode(const LoadRequest& request) const;
+  // Pushes a decoded image into the lock-free stack.
+  void PushDecodedImage(DecodedImage* decoded_image);
+  // Allocates the storage of the texture of a decoded image and uploads its
+  // smallest levels. The remaining levels are streamed by StreamLevels().
+  void StartStreaming(std::unique_ptr<DecodedImage> decoded_image);
+  // Uploads the next level of the streaming textures, smallest first, until
+  // the upload budget is spent.
+  void StreamLevels();
+  // Uploads a level of a streaming texture into the bound texture, and makes
+  // it the base level.
+  void UploadLevel(const int level, StreamingTexture* streaming_texture);
+
+  // Worker threads.
+  std::vector<std::thread> workers_;
+  // Requests waiting for a worker, protected by requests_mutex_.
+  std::deque<LoadRequest> requests_;
+  std::mutex requests_mutex_;
+  std::condition_variable requests_condition_;
+  // Block compression of the textures.
+  TextureCompressionFormat compression_format_;
+  // Filter building the mipmaps of the textures.
+  MipmapFilter mipmap_filter_;
+  // Reduction of the previews, or 1 if disabled.
+  int preview_scale_denominator_;
+  // Bytes of texture levels uploaded per call to Update(), or zero.
+  size_t upload_budget_;
+  // Number of threads building the mipmaps of each image and compressing it.
+  int num_threads_per_image_;
+  // True when the workers have to exit.
+  bool stop_;
+  // Top of the lock-free stack of decoded images. Workers push and the OpenGL
+  // thread takes the whole stack at once.
+  std::atomic<DecodedImage*> decoded_images_;
+  // Number of textures and images waiting to be decoded. Only used by the
+  // OpenGL thread.
+  int num_pending_;
+  // Textures waiting for their image, and the ones among them whose loading
+  // was cancelled while being decoded. An id can appear more than once when a
+  // deleted texture id is reused before its image arrives. Only used by the
+  // OpenGL thread.
+  std::unordered_multiset<GLuint> pending_texture_ids_;
+  std::unordered_multiset<GLuint> cancelled_texture_ids_;
+  // Textures with levels waiting to be uploaded. Only used by the OpenGL
+  // thread.
+  std::vector<std::unique_ptr<StreamingTexture>> streaming_textures_;
+  Stats stats_;
+};
+
+}  // namespace wvu
+
+#endif  // TEXTURE_LOADER_H_
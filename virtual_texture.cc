@@ -0,0 +1,557 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Largest number of textures. The index of the texture plus one is written
+// into an 8-bit channel of the feedback; zero marks the texels without
+// texture.
+constexpr int kMaxNumTextures = 255;
+// Largest number of pages waiting for the streaming thread. The feedback of the
+// following frames requests the pages again if they are still missing.
+constexpr int kMaxNumPendingPages = 256;
+// Texture unit of the cache of physical pages.
+constexpr int kPhysicalPagesTextureUnit = 1;
+// Color of the page shown while the coarsest level of a texture loads.
+constexpr unsigned char kLoadingPageColor = 128;
+}  // namespace
+
+const char kVirtualTextureShaderSource[] =
+    "uniform sampler2D physical_pages;\n"
+    // Side of the pages, border, side of the pages with their border and
+    // pages per side of the cache.
+    "uniform vec4 virtual_texture_layout;\n"
+    // The feedback pass draws at a reduced resolution, which increases the
+    // level of detail it computes.
+    "uniform float virtual_texture_lod_bias;\n"
+    "float ComputeVirtualTextureLod(sampler2D page_table, vec2 uv) {\n"
+    "vec2 texels = uv * vec2(textureSize(page_table, 0)) *\n"
+    "    virtual_texture_layout.x;\n"
+    "vec2 dx = dFdx(texels);\n"
+    "vec2 dy = dFdy(texels);\n"
+    "return max(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) +\n"
+    "    virtual_texture_lod_bias, 0.0);\n"
+    "}\n"
+    "vec4 ReadPageTable(sampler2D page_table, vec2 uv, float lod) {\n"
+    "return floor(textureLod(page_table, uv, lod) * 255.0 + 0.5);\n"
+    "}\n"
+    "vec4 SampleVirtualTexture(sampler2D page_table, vec2 uv) {\n"
+    "vec4 entry = ReadPageTable(page_table, uv,\n"
+    "    ComputeVirtualTextureLod(page_table, uv));\n"
+    // The entry points at the finest page in the cache covering the texel,
+    // which may be of a coarser level.
+    "int level = int(mod(entry.b, 16.0));\n"
+    "vec2 page = fract(uv) * vec2(textureSize(page_table, level));\n"
+    "vec2 texel = entry.rg * virtual_texture_layout.z +\n"
+    "    virtual_texture_layout.y + fract(page) * virtual_texture_layout.x;\n"
+    "return textureLod(physical_pages, texel /\n"
+    "    (virtual_texture_layout.z * virtual_texture_layout.w), 0.0);\n"
+    "}\n"
+    "vec4 ComputeVirtualTextureFeedback(sampler2D page_table, vec2 uv) {\n"
+    "vec4 entry = ReadPageTable(page_table, uv, 0.0);\n"
+    "float level = min(floor(ComputeVirtualTextureLod(page_table, uv) + 0.5),\n"
+    "    floor(entry.b / 16.0));\n"
+    "vec2 page = floor(fract(uv) * vec2(textureSize(page_table, int(level))));\n"
+    "return vec4(page, level, entry.a + 1.0) / 255.0;\n"
+    "}\n";
+
+VirtualTextureManager::VirtualTextureManager() :
+    cache_pages_per_side_(0), physical_pages_id_(0),
+    feedback_framebuffer_id_(0), feedback_renderbuffer_ids_{ 0, 0 },
+    feedback_width_(0), feedback_height_(0), feedback_scale_(1),
+    framebuffer_width_(0), framebuffer_height_(0),
+    feedback_pixel_buffer_id_(0), feedback_fence_(nullptr), stop_(false),
+    max_page_uploads_(32), frame_(0) {
+  std::memset(&stats_, 0, sizeof(stats_));
+}
+
+VirtualTextureManager::~VirtualTextureManager() {
+  if (streaming_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(streaming_mutex_);
+      stop_ = true;
+    }
+    streaming_condition_.notify_all();
+    streaming_thread_.join();
+  }
+  for (const std::unique_ptr<VirtualTexture>& texture : textures_) {
+    glDeleteTextures(1, &texture->page_table_id);
+  }
+  if (feedback_fence_ != nullptr) {
+    glDeleteSync(feedback_fence_);
+  }
+  if (feedback_pixel_buffer_id_ != 0) {
+    glDeleteBuffers(1, &feedback_pixel_buffer_id_);
+  }
+  if (feedback_framebuffer_id_ != 0) {
+    glDeleteFramebuffers(1, &feedback_framebuffer_id_);
+    glDeleteRenderbuffers(2, feedback_renderbuffer_ids_);
+  }
+  if (physical_pages_id_ != 0) {
+    glDeleteTextures(1, &physical_pages_id_);
+  }
+}
+
+bool VirtualTextureManager::Create(const int cache_pages_per_side,
+                                   const int framebuffer_width,
+                                   const int framebuffer_height,
+                                   const int feedback_scale) {
+  if (physical_pages_id_ != 0 || cache_pages_per_side < 2 ||
+      cache_pages_per_side > 256 || feedback_scale < 1) {
+    return false;
+  }
+  // Cache of physical pages. Page 0 shows the textures whose coarsest level
+  // is loading.
+  const int cache_size = cache_pages_per_side * kVirtualTextureTileSize;
+  GLint max_texture_size = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+  if (cache_size > max_texture_size) return false;
+  cache_pages_per_side_ = cache_pages_per_side;
+  glGenTextures(1, &physical_pages_id_);
+  glBindTexture(GL_TEXTURE_2D, physical_pages_id_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, cache_size, cache_size);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cache_size, cache_size, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  }
+  std::vector<unsigned char> loading_page(kVirtualTextureTileBytes, kLoadingPageColor);
+  for (int i = 3; i < loading_page.size(); i += 4) {
+    loading_page[i] = 255;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kVirtualTextureTileSize, kVirtualTextureTileSize, GL_RGBA,
+                  GL_UNSIGNED_BYTE, loading_page.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  cache_pages_.assign(cache_pages_per_side * cache_pages_per_side,
+                      CachePage{ 0, false, false, 0 });
+  cache_pages_[0].occupied = true;
+  cache_pages_[0].pinned = true;
+
+  // Feedback framebuffer, with a depth buffer so that only the visible
+  // fragments request pages.
+  framebuffer_width_ = framebuffer_width;
+  framebuffer_height_ = framebuffer_height;
+  feedback_scale_ = feedback_scale;
+  feedback_width_ = std::max(1, framebuffer_width / feedback_scale);
+  feedback_height_ = std::max(1, framebuffer_height / feedback_scale);
+  glGenRenderbuffers(2, feedback_renderbuffer_ids_);
+  glBindRenderbuffer(GL_RENDERBUFFER, feedback_renderbuffer_ids_[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, feedback_width_,
+                        feedback_height_);
+  glBindRenderbuffer(GL_RENDERBUFFER, feedback_renderbuffer_ids_[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedback_width_,
+                        feedback_height_);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glGenFramebuffers(1, &feedback_framebuffer_id_);
+  glBindFramebuffer(GL_FRAMEBUFFER, feedback_framebuffer_id_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, feedback_renderbuffer_ids_[0]);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, feedback_renderbuffer_ids_[1]);
+  const bool complete =
+      glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (!complete) return false;
+  glGenBuffers(1, &feedback_pixel_buffer_id_);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, feedback_pixel_buffer_id_);
+  glBufferData(GL_PIXEL_PACK_BUFFER, 4 * feedback_width_ * feedback_height_,
+               nullptr, GL_STREAM_READ);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  stats_.num_cache_pages = cache_pages_.size();
+  stats_.cache_bytes = kVirtualTextureTileBytes * cache_pages_.size();
+  streaming_thread_ = std::thread(&VirtualTextureManager::StreamingLoop, this);
+  return true;
+}
+
+GLuint VirtualTextureManager::Add(const std::string& filepath) {
+  if (physical_pages_id_ == 0 || textures_.size() >= kMaxNumTextures) {
+    return 0;
+  }
+  std::unique_ptr<VirtualTexture> texture(new VirtualTexture);
+  if (!texture->file.Open(filepath)) return 0;
+  VirtualTextureHeader header;
+  if (!ReadVirtualTextureHeader(texture->file.data(), texture->file.size(),
+                                &header)) {
+    return 0;
+  }
+  texture->num_levels = header.num_levels;
+  texture->num_pages_x = header.width / kVirtualTexturePageSize;
+  texture->num_pages_y = header.height / kVirtualTexturePageSize;
+  int num_pages = 0;
+  for (int level = 0; level < texture->num_levels; ++level) {
+    texture->level_first_pages.push_back(num_pages);
+    num_pages +=
+        (texture->num_pages_x >> level) * (texture->num_pages_y >> level);
+  }
+  texture->page_table_dirty = false;
+
+  // Page table, sampled with the level of detail of the virtual texture.
+  glGenTextures(1, &texture->page_table_id);
+  glBindTexture(GL_TEXTURE_2D, texture->page_table_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  texture->num_levels - 1);
+  for (int level = 0; level < texture->num_levels; ++level) {
+    const int level_width = texture->num_pages_x >> level;
+    const int level_height = texture->num_pages_y >> level;
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, level_width, level_height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    texture->page_table.emplace_back(4 * level_width * level_height);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  const GLuint page_table_id = texture->page_table_id;
+  const int texture_index = textures_.size();
+  const int coarsest_level = texture->num_levels - 1;
+  const int num_coarsest_pages_x = texture->num_pages_x >> coarsest_level;
+  const int num_coarsest_pages_y = texture->num_pages_y >> coarsest_level;
+  {
+    std::lock_guard<std::mutex> lock(streaming_mutex_);
+    textures_.push_back(std::move(texture));
+  }
+  UpdatePageTable(texture_index);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  // The coarsest level stays in the cache.
+  for (int y = 0; y < num_coarsest_pages_y; ++y) {
+    for (int x = 0; x < num_coarsest_pages_x; ++x) {
+      RequestPage(PackPageKey({ texture_index, coarsest_level, x, y }));
+    }
+  }
+  return page_table_id;
+}
+
+void VirtualTextureManager::SetUniforms(const ShaderProgram& shader_program,
+                                        const bool feedback) const {
+  shader_program.Use();
+  shader_program.SetUniformInt(shader_program.uniform_handle("physical_pages"),
+                               kPhysicalPagesTextureUnit);
+  const GLfloat layout[4] = {
+    static_cast<GLfloat>(kVirtualTexturePageSize),
+    static_cast<GLfloat>(kVirtualTextureBorder),
+    static_cast<GLfloat>(kVirtualTextureTileSize),
+    static_cast<GLfloat>(cache_pages_per_side_)
+  };
+  shader_program.SetUniformVector4(
+      shader_program.uniform_handle("virtual_texture_layout"), layout);
+  shader_program.SetUniformFloat(
+      shader_program.uniform_handle("virtual_texture_lod_bias"),
+      feedback ? -std::log2(static_cast<float>(feedback_scale_)) : 0.0f);
+}
+
+bool VirtualTextureManager::BeginFeedback() {
+  if (feedback_framebuffer_id_ == 0 || feedback_fence_ != nullptr) {
+    return false;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, feedback_framebuffer_id_);
+  glViewport(0, 0, feedback_width_, feedback_height_);
+  // Texels without texture stay zero.
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glEnable(GL_DEPTH_TEST);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  return true;
+}
+
+void VirtualTextureManager::EndFeedback() {
+  // The pixels are copied into the pixel buffer object by the GPU; Update()
+  // maps it once the fence says they are there.
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, feedback_pixel_buffer_id_);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, feedback_width_, feedback_height_, GL_RGBA,
+               GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  feedback_fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, framebuffer_width_, framebuffer_height_);
+}
+
+void VirtualTextureManager::BindPhysicalPages() const {
+  glActiveTexture(GL_TEXTURE0 + kPhysicalPagesTextureUnit);
+  glBindTexture(GL_TEXTURE_2D, physical_pages_id_);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void VirtualTextureManager::Update() {
+  ++frame_;
+  if (feedback_fence_ != nullptr) {
+    const GLenum status = glClientWaitSync(feedback_fence_, 0, 0);
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+      glDeleteSync(feedback_fence_);
+      feedback_fence_ = nullptr;
+      const int num_texels = feedback_width_ * feedback_height_;
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, feedback_pixel_buffer_id_);
+      const unsigned char* texels = static_cast<const unsigned char*>(
+          glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 4 * num_texels,
+                           GL_MAP_READ_BIT));
+      if (texels != nullptr) {
+        ProcessFeedback(texels, num_texels);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      ++stats_.num_feedback_readbacks;
+    }
+  }
+
+  std::vector<LoadedPage> loaded_pages;
+  {
+    std::lock_guard<std::mutex> lock(streaming_mutex_);
+    while (!loaded_pages_.empty() && loaded_pages.size() < max_page_uploads_) {
+      loaded_pages.push_back(std::move(loaded_pages_.front()));
+      loaded_pages_.pop_front();
+    }
+  }
+  if (!loaded_pages.empty()) {
+    glBindTexture(GL_TEXTURE_2D, physical_pages_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (const LoadedPage& page : loaded_pages) {
+      pending_pages_.erase(page.key);
+      // A page that does not fit is requested again by a later feedback.
+      UploadPage(page);
+    }
+  }
+  for (int i = 0; i < textures_.size(); ++i) {
+    if (textures_[i]->page_table_dirty) {
+      UpdatePageTable(i);
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+VirtualTextureManager::Stats VirtualTextureManager::stats() const {
+  Stats stats = stats_;
+  stats.num_textures = textures_.size();
+  stats.num_resident_pages = resident_pages_.size();
+  return stats;
+}
+
+uint32_t VirtualTextureManager::PackPageKey(const PageKey& page) {
+  return (static_cast<uint32_t>(page.texture) << 24) | (page.level << 16) |
+      (page.y << 8) | page.x;
+}
+
+VirtualTextureManager::PageKey VirtualTextureManager::UnpackPageKey(
+    const uint32_t key) {
+  return { static_cast<int>(key >> 24), static_cast<int>((key >> 16) & 0xFF),
+           static_cast<int>(key & 0xFF), static_cast<int>((key >> 8) & 0xFF) };
+}
+
+void VirtualTextureManager::StreamingLoop() {
+  std::vector<unsigned char> pixels;
+  while (true) {
+    uint32_t key;
+    const VirtualTexture* texture;
+    {
+      std::unique_lock<std::mutex> lock(streaming_mutex_);
+      streaming_condition_.wait(lock, [this] {
+        return stop_ || !page_requests_.empty();
+      });
+      if (stop_) return;
+      key = page_requests_.front();
+      page_requests_.pop_front();
+      texture = textures_[key >> 24].get();
+    }
+    // Reading the page from the mapping faults it in from the disk here, and
+    // not on the OpenGL thread.
+    const PageKey page = UnpackPageKey(key);
+    const int page_index = texture->level_first_pages[page.level] +
+        page.y * (texture->num_pages_x >> page.level) + page.x;
+    const unsigned char* data =
+        texture->file.data() + kVirtualTextureHeaderSize + page_index * kVirtualTextureTileBytes;
+    LoadedPage loaded_page;
+    loaded_page.key = key;
+    loaded_page.pixels.assign(data, data + kVirtualTextureTileBytes);
+    std::lock_guard<std::mutex> lock(streaming_mutex_);
+    loaded_pages_.push_back(std::move(loaded_page));
+  }
+}
+
+void VirtualTextureManager::RequestPage(const uint32_t key) {
+  const auto resident_page = resident_pages_.find(key);
+  if (resident_page != resident_pages_.end()) {
+    cache_pages_[resident_page->second].last_used_frame = frame_;
+    return;
+  }
+  if (pending_pages_.count(key) != 0 ||
+      pending_pages_.size() >= kMaxNumPendingPages) {
+    return;
+  }
+  pending_pages_.insert(key);
+  {
+    std::lock_guard<std::mutex> lock(streaming_mutex_);
+    page_requests_.push_back(key);
+  }
+  streaming_condition_.notify_one();
+  ++stats_.num_requested_pages;
+}
+
+void VirtualTextureManager::ProcessFeedback(const unsigned char* texels,
+                                            const int num_texels) {
+  // Neighboring texels mostly request the same pages.
+  std::unordered_set<uint32_t> keys;
+  for (int i = 0; i < num_texels; ++i) {
+    const unsigned char* texel = texels + 4 * i;
+    if (texel[3] == 0) continue;
+    PageKey page = { texel[3] - 1, texel[2], texel[0], texel[1] };
+    if (page.texture >= textures_.size()) continue;
+    const VirtualTexture& texture = *textures_[page.texture];
+    if (page.level >= texture.num_levels ||
+        page.x >= (texture.num_pages_x >> page.level) ||
+        page.y >= (texture.num_pages_y >> page.level)) {
+      continue;
+    }
+    // The ancestors are kept too, since they are shown while the page loads.
+    for (; page.level < texture.num_levels; ++page.level) {
+      if (!keys.insert(PackPageKey(page)).second) break;
+      page.x /= 2;
+      page.y /= 2;
+    }
+  }
+  // The coarser pages are requested first, so that something close to the
+  // requested page shows up soon.
+  std::vector<uint32_t> sorted_keys(keys.begin(), keys.end());
+  std::sort(sorted_keys.begin(), sorted_keys.end(),
+            [](const uint32_t a, const uint32_t b) {
+              return ((a >> 16) & 0xFF) > ((b >> 16) & 0xFF);
+            });
+  for (const uint32_t key : sorted_keys) {
+    RequestPage(key);
+  }
+}
+
+bool VirtualTextureManager::UploadPage(const LoadedPage& page) {
+  // Take a free page of the cache, or else the least recently used one that
+  // was not used in this frame.
+  int cache_page_index = -1;
+  for (int i = 0; i < cache_pages_.size(); ++i) {
+    const CachePage& cache_page = cache_pages_[i];
+    if (!cache_page.occupied) {
+      cache_page_index = i;
+      break;
+    }
+    if (cache_page.pinned || cache_page.last_used_frame >= frame_) continue;
+    if (cache_page_index == -1 || cache_page.last_used_frame <
+        cache_pages_[cache_page_index].last_used_frame) {
+      cache_page_index = i;
+    }
+  }
+  if (cache_page_index == -1) return false;
+  CachePage& cache_page = cache_pages_[cache_page_index];
+  if (cache_page.occupied) {
+    resident_pages_.erase(cache_page.key);
+    textures_[cache_page.key >> 24]->page_table_dirty = true;
+    ++stats_.num_evicted_pages;
+  }
+  const PageKey key = UnpackPageKey(page.key);
+  const VirtualTexture& texture = *textures_[key.texture];
+  glTexSubImage2D(GL_TEXTURE_2D, 0,
+                  (cache_page_index % cache_pages_per_side_) * kVirtualTextureTileSize,
+                  (cache_page_index / cache_pages_per_side_) * kVirtualTextureTileSize,
+                  kVirtualTextureTileSize, kVirtualTextureTileSize, GL_RGBA, GL_UNSIGNED_BYTE,
+                  page.pixels.data());
+  cache_page.key = page.key;
+  cache_page.occupied = true;
+  cache_page.pinned = key.level == texture.num_levels - 1;
+  cache_page.last_used_frame = frame_;
+  resident_pages_[page.key] = cache_page_index;
+  textures_[key.texture]->page_table_dirty = true;
+  ++stats_.num_uploaded_pages;
+  return true;
+}
+
+void VirtualTextureManager::UpdatePageTable(const int texture_index) {
+  VirtualTexture& texture = *textures_[texture_index];
+  const int coarsest_level = texture.num_levels - 1;
+  glBindTexture(GL_TEXTURE_2D, texture.page_table_id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  // Every level is filled from the next coarser one, which has the entries of
+  // the pages missing from the cache.
+  for (int level = coarsest_level; level >= 0; --level) {
+    const int width = texture.num_pages_x >> level;
+    const int height = texture.num_pages_y >> level;
+    std::vector<unsigned char>& entries = texture.page_table[level];
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        unsigned char* entry = &entries[4 * (y * width + x)];
+        const auto resident_page = resident_pages_.find(
+            PackPageKey({ texture_index, level, x, y }));
+        if (resident_page != resident_pages_.end()) {
+          entry[0] = resident_page->second % cache_pages_per_side_;
+          entry[1] = resident_page->second / cache_pages_per_side_;
+          entry[2] = level + 16 * coarsest_level;
+          entry[3] = texture_index;
+        } else if (level == coarsest_level) {
+          // Page 0 of the cache is the loading page.
+          entry[0] = 0;
+          entry[1] = 0;
+          entry[2] = level + 16 * coarsest_level;
+          entry[3] = texture_index;
+        } else {
+          const std::vector<unsigned char>& parent_entries =
+              texture.page_table[level + 1];
+          std::memcpy(entry,
+                      &parent_entries[4 * ((y / 2) * (width / 2) + x / 2)], 4);
+        }
+      }
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_RGBA,
+                    GL_UNSIGNED_BYTE, entries.data());
+  }
+  texture.page_table_dirty = false;
+}
+
+}  // namespace wvu
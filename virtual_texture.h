@@ -0,0 +1,271 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef VIRTUAL_TEXTURE_H_
+#define VIRTUAL_TEXTURE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <GL/glew.h>
+
+#include "mapped_file.h"
+#include "virtual_texture_file.h"
+
+namespace wvu {
+class ShaderProgram;
+
+// GLSL functions sampling a virtual texture through its page table (see
+// VirtualTextureManager). Fragment shaders that sample virtual textures
+// include this source, and call:
+//   vec4 SampleVirtualTexture(sampler2D page_table, vec2 uv) in place of
+//     texture(sampler, uv).
+//   vec4 ComputeVirtualTextureFeedback(sampler2D page_table, vec2 uv) in the
+//     feedback pass, which returns the page needed by the fragment.
+extern const char kVirtualTextureShaderSource[];
+
+// Streams the pages of virtual textures into a cache of physical pages of
+// fixed size, so the video memory taken by the textures does not depend on
+// their size. Each virtual texture has a page table texture, with a texel per
+// page and a level per mipmap level, pointing at the page of the cache to
+// sample; pages that are not in the cache point at their finest ancestor in
+// it. The coarsest level of every texture stays in the cache.
+//
+// The pages to load are found by a feedback pass: the scene is drawn at a
+// reduced resolution into a framebuffer that receives the texture, level and
+// page of each fragment (see ComputeVirtualTextureFeedback()). The framebuffer
+// is read back asynchronously into a pixel buffer object, and the missing pages
+// are read from the files by a streaming thread. Update() uploads the pages
+// read, replacing the least recently seen ones when the cache is full, and
+// updates the page tables.
+//
+// Example:
+//
+// wvu::VirtualTextureManager virtual_textures;
+// virtual_textures.Create(16, framebuffer_width, framebuffer_height, 8);
+// model->set_texture(virtual_textures.Add("texture.wvvt"));
+// virtual_textures.SetUniforms(shader_program, false);
+// virtual_textures.SetUniforms(feedback_shader_program, true);
+// while (...) {  // Rendering loop.
+//   virtual_textures.Update();
+//   if (virtual_textures.BeginFeedback()) {
+//     ...  // Draw the models with feedback_shader_program.
+//     virtual_textures.EndFeedback();
+//   }
+//   virtual_textures.BindPhysicalPages();
+//   ...  // Draw the models with shader_program.
+// }
+class VirtualTextureManager {
+ public:
+  // Statistics of the manager.
+  struct Stats {
+    int num_textures;
+    // Pages in the cache, and pages the cache can hold.
+    int num_resident_pages;
+    int num_cache_pages;
+    // Bytes of the cache texture.
+    size_t cache_bytes;
+    // Feedback buffers read back, and missing pages they requested.
+    int num_feedback_readbacks;
+    int num_requested_pages;
+    // Pages uploaded into the cache, and pages replaced by them.
+    int num_uploaded_pages;
+    int num_evicted_pages;
+  };
+
+  VirtualTextureManager();
+  // Stops the streaming thread and deletes the textures and buffers.
+  ~VirtualTextureManager();
+
+  // Creates the cache of physical pages, the feedback framebuffer and the
+  // streaming thread. Returns true if successful. Must be called from the
+  // OpenGL thread.
+  // Params:
+  //   cache_pages_per_side  The cache holds cache_pages_per_side^2 pages (at
+  //     most 256^2). The first one is a grey page shown while the coarsest
+  //     level of a texture loads.
+  //   framebuffer_width, framebuffer_height  Size of the framebuffer the
+  //     scene is drawn into.
+  //   feedback_scale  The feedback pass draws at 1/feedback_scale of the
+  //     framebuffer size.
+  bool Create(const int cache_pages_per_side,
+              const int framebuffer_width,
+              const int framebuffer_height,
+              const int feedback_scale);
+
+  // Opens a virtual texture file and creates its page table. Returns the id of
+  // the page table texture, to bind in place of the texture, or zero if the
+  // file could not be opened. The manager owns the page table.
+  GLuint Add(const std::string& filepath);
+
+  // Sets the uniforms read by kVirtualTextureShaderSource in a shader program:
+  // the unit of the cache and the layout of its pages. Uses the program.
+  // Params:
+  //   shader_program  The program.
+  //   feedback  True if the program draws the feedback pass.
+  void SetUniforms(const ShaderProgram& shader_program,
+                   const bool feedback) const;
+
+  // Binds the feedback framebuffer and its viewport and clears it. Returns
+  // false, binding nothing, if the previous feedback is still being read back.
+  bool BeginFeedback();
+
+  // Starts reading back the feedback framebuffer, and binds the default
+  // framebuffer and its viewport again.
+  void EndFeedback();
+
+  // Binds the cache of physical pages to the texture unit of the cache.
+  void BindPhysicalPages() const;
+
+  // Requests the missing pages of the feedback read back, uploads the pages
+  // read by the streaming thread and updates the page tables. Must be called
+  // from the OpenGL thread once per frame.
+  void Update();
+
+  // Sets the largest number of pages uploaded per call to Update().
+  void set_max_page_uploads(const int max_page_uploads) {
+    max_page_uploads_ = max_page_uploads;
+  }
+
+  Stats stats() const;
+
+ private:
+  // Virtual texture file opened.
+  struct VirtualTexture {
+    MappedFile file;
+    int num_levels;
+    // Pages per side of level 0.
+    int num_pages_x;
+    int num_pages_y;
+    // Index of the first page of each level in the file.
+    std::vector<int> level_first_pages;
+    GLuint page_table_id;
+    // Texels of each level of the page table, RGBA: the cache page (x, y),
+    // the level of the page plus 16 times the coarsest level, and the index of
+    // the texture.
+    std::vector<std::vector<unsigned char>> page_table;
+    // True when the pages in the cache changed since the page table was
+    // uploaded.
+    bool page_table_dirty;
+  };
+
+  // Page of a virtual texture. Packed into a key as texture << 24 |
+  // level << 16 | y << 8 | x.
+  struct PageKey {
+    int texture;
+    int level;
+    int x;
+    int y;
+  };
+
+  // Page read by the streaming thread.
+  struct LoadedPage {
+    uint32_t key;
+    std::vector<unsigned char> pixels;
+  };
+
+  // Page of the cache.
+  struct CachePage {
+    // Key of the page it holds, valid if occupied.
+    uint32_t key;
+    bool occupied;
+    // Pages of the coarsest levels are never replaced.
+    bool pinned;
+    int last_used_frame;
+  };
+
+  static uint32_t PackPageKey(const PageKey& page);
+  static PageKey UnpackPageKey(const uint32_t key);
+
+  // Body of the streaming thread.
+  void StreamingLoop();
+  // Queues the page for the streaming thread if it is not in the cache;
+  // otherwise marks it used.
+  void RequestPage(const uint32_t key);
+  // Requests the page of every texel of the feedback read back, and their
+  // ancestors.
+  void ProcessFeedback(const unsigned char* texels, const int num_texels);
+  // Uploads a page read into the cache. Returns false if every page of the
+  // cache was used this frame.
+  bool UploadPage(const LoadedPage& page);
+  // Fills the page table of a texture from the pages in the cache and uploads
+  // it.
+  void UpdatePageTable(const int texture_index);
+
+  int cache_pages_per_side_;
+  // Texture holding the cache of physical pages.
+  GLuint physical_pages_id_;
+  std::vector<CachePage> cache_pages_;
+  // Page of the cache holding each page.
+  std::unordered_map<uint32_t, int> resident_pages_;
+  std::vector<std::unique_ptr<VirtualTexture>> textures_;
+  // Feedback framebuffer and its color and depth renderbuffers.
+  GLuint feedback_framebuffer_id_;
+  GLuint feedback_renderbuffer_ids_[2];
+  int feedback_width_;
+  int feedback_height_;
+  int feedback_scale_;
+  int framebuffer_width_;
+  int framebuffer_height_;
+  // Pixel buffer object receiving the feedback, and the fence signaled when
+  // it is written, or null when no feedback is being read back.
+  GLuint feedback_pixel_buffer_id_;
+  GLsync feedback_fence_;
+  // Pages requested and not uploaded yet. Only used by the OpenGL thread.
+  std::unordered_set<uint32_t> pending_pages_;
+  // Pages waiting for the streaming thread, and pages it read. The textures
+  // are also added under streaming_mutex_, since the thread reads their files.
+  std::deque<uint32_t> page_requests_;
+  std::deque<LoadedPage> loaded_pages_;
+  std::mutex streaming_mutex_;
+  std::condition_variable streaming_condition_;
+  std::thread streaming_thread_;
+  bool stop_;
+  int max_page_uploads_;
+  int frame_;
+  Stats stats_;
+};
+
+}  // namespace wvu
+
+#endif  // VIRTUAL_TEXTURE_H_
@@ -0,0 +1,237 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#include "virtual_texture_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace wvu {
+namespace {
+constexpr char kMagic[4] = { 'W', 'V', 'V', 'T' };
+constexpr char kExtension[] = ".wvvt";
+// Largest number of pages per side of level 0. The page coordinates are
+// written into 8-bit channels.
+constexpr int kMaxNumPagesPerSide = 256;
+// Largest number of levels. The level is written into 4 bits of the page
+// table.
+constexpr int kMaxNumLevels = 16;
+
+void AppendUint32(const uint32_t value, std::vector<unsigned char>* bytes) {
+  for (int i = 0; i < 4; ++i) {
+    bytes->push_back((value >> (8 * i)) & 0xFF);
+  }
+}
+
+uint32_t ReadUint32(const unsigned char* bytes) {
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+bool IsPowerOfTwo(const int value) {
+  return value > 0 && (value & (value - 1)) == 0;
+}
+
+int RoundUpToPowerOfTwo(const int value) {
+  int power = 1;
+  while (power < value) power *= 2;
+  return power;
+}
+
+// Returns the number of levels of a virtual texture: the levels stop when the
+// smaller side is one page.
+int ComputeNumVirtualTextureLevels(const int width, const int height) {
+  int num_levels = 1;
+  while ((std::min(width, height) >> num_levels) >= kVirtualTexturePageSize) {
+    ++num_levels;
+  }
+  return num_levels;
+}
+
+// Resizes an image with bilinear interpolation.
+void ResizeImage(const RgbaImage& image,
+                 const int width,
+                 const int height,
+                 RgbaImage* resized_image) {
+  resized_image->width = width;
+  resized_image->height = height;
+  resized_image->pixels.resize(4 * static_cast<size_t>(width) * height);
+  const float scale_x = static_cast<float>(image.width) / width;
+  const float scale_y = static_cast<float>(image.height) / height;
+  for (int y = 0; y < height; ++y) {
+    const float source_y =
+        std::max(0.0f, std::min((y + 0.5f) * scale_y - 0.5f,
+                                image.height - 1.0f));
+    const int y0 = static_cast<int>(source_y);
+    const int y1 = std::min(y0 + 1, image.height - 1);
+    const float weight_y = source_y - y0;
+    for (int x = 0; x < width; ++x) {
+      const float source_x =
+          std::max(0.0f, std::min((x + 0.5f) * scale_x - 0.5f,
+                                  image.width - 1.0f));
+      const int x0 = static_cast<int>(source_x);
+      const int x1 = std::min(x0 + 1, image.width - 1);
+      const float weight_x = source_x - x0;
+      const unsigned char* p00 = &image.pixels[4 * (y0 * image.width + x0)];
+      const unsigned char* p01 = &image.pixels[4 * (y0 * image.width + x1)];
+      const unsigned char* p10 = &image.pixels[4 * (y1 * image.width + x0)];
+      const unsigned char* p11 = &image.pixels[4 * (y1 * image.width + x1)];
+      unsigned char* destination =
+          &resized_image->pixels[4 * (static_cast<size_t>(y) * width + x)];
+      for (int c = 0; c < 4; ++c) {
+        const float top = p00[c] + weight_x * (p01[c] - p00[c]);
+        const float bottom = p10[c] + weight_x * (p11[c] - p10[c]);
+        destination[c] =
+            static_cast<unsigned char>(top + weight_y * (bottom - top) + 0.5f);
+      }
+    }
+  }
+}
+
+// Copies a page of a level and its border into a tile. The border wraps
+// around the edges of the level, like GL_REPEAT.
+void CopyTile(const RgbaImage& level,
+              const int page_x,
+              const int page_y,
+              unsigned char* tile) {
+  const int origin_x = page_x * kVirtualTexturePageSize - kVirtualTextureBorder;
+  const int origin_y = page_y * kVirtualTexturePageSize - kVirtualTextureBorder;
+  for (int y = 0; y < kVirtualTextureTileSize; ++y) {
+    const int source_y = (origin_y + y + level.height) % level.height;
+    for (int x = 0; x < kVirtualTextureTileSize; ++x) {
+      const int source_x = (origin_x + x + level.width) % level.width;
+      std::memcpy(
+          tile + 4 * (y * kVirtualTextureTileSize + x),
+          &level.pixels[4 * (static_cast<size_t>(source_y) * level.width +
+                             source_x)],
+          4);
+    }
+  }
+}
+
+}  // namespace
+
+bool IsVirtualTexturePath(const std::string& filepath) {
+  const size_t extension_length = sizeof(kExtension) - 1;
+  return filepath.size() >= extension_length &&
+      filepath.compare(filepath.size() - extension_length, extension_length,
+                       kExtension) == 0;
+}
+
+bool WriteVirtualTexture(const std::string& filepath,
+                         const RgbaImage& image,
+                         const MipmapFilter filter,
+                         const int num_threads) {
+  if (image.pixels.empty()) return false;
+  constexpr int kMaxSize = kMaxNumPagesPerSide * kVirtualTexturePageSize;
+  const int width = std::min(
+      RoundUpToPowerOfTwo(std::max(image.width, kVirtualTexturePageSize)),
+      kMaxSize);
+  const int height = std::min(
+      RoundUpToPowerOfTwo(std::max(image.height, kVirtualTexturePageSize)),
+      kMaxSize);
+  RgbaImage resized_image;
+  const RgbaImage* level0 = &image;
+  if (width != image.width || height != image.height) {
+    ResizeImage(image, width, height, &resized_image);
+    level0 = &resized_image;
+  }
+  std::vector<RgbaImage> mipmaps;
+  if (!GenerateMipmaps(*level0, filter, num_threads, &mipmaps)) return false;
+  const int num_levels =
+      std::min(ComputeNumVirtualTextureLevels(width, height), kMaxNumLevels);
+
+  std::vector<unsigned char> header(kMagic, kMagic + 4);
+  AppendUint32(kVirtualTextureVersion, &header);
+  AppendUint32(width, &header);
+  AppendUint32(height, &header);
+  AppendUint32(kVirtualTexturePageSize, &header);
+  AppendUint32(kVirtualTextureBorder, &header);
+  AppendUint32(num_levels, &header);
+  AppendUint32(0, &header);
+  std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  std::vector<unsigned char> tile(kVirtualTextureTileBytes);
+  for (int level = 0; level < num_levels; ++level) {
+    const RgbaImage& level_image = level == 0 ? *level0 : mipmaps[level - 1];
+    const int num_pages_x = level_image.width / kVirtualTexturePageSize;
+    const int num_pages_y = level_image.height / kVirtualTexturePageSize;
+    for (int y = 0; y < num_pages_y; ++y) {
+      for (int x = 0; x < num_pages_x; ++x) {
+        CopyTile(level_image, x, y, tile.data());
+        file.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+      }
+    }
+  }
+  return file.good();
+}
+
+bool ReadVirtualTextureHeader(const unsigned char* data,
+                              const size_t size,
+                              VirtualTextureHeader* header) {
+  if (size < kVirtualTextureHeaderSize || std::memcmp(data, kMagic, 4) != 0 ||
+      ReadUint32(data + 4) != kVirtualTextureVersion) {
+    return false;
+  }
+  header->width = ReadUint32(data + 8);
+  header->height = ReadUint32(data + 12);
+  const int page_size = ReadUint32(data + 16);
+  const int border = ReadUint32(data + 20);
+  header->num_levels = ReadUint32(data + 24);
+  const int num_pages_x = header->width / kVirtualTexturePageSize;
+  const int num_pages_y = header->height / kVirtualTexturePageSize;
+  if (page_size != kVirtualTexturePageSize ||
+      border != kVirtualTextureBorder || !IsPowerOfTwo(num_pages_x) ||
+      !IsPowerOfTwo(num_pages_y) || num_pages_x > kMaxNumPagesPerSide ||
+      num_pages_y > kMaxNumPagesPerSide ||
+      header->num_levels != std::min(
+          ComputeNumVirtualTextureLevels(header->width, header->height),
+          kMaxNumLevels)) {
+    return false;
+  }
+  size_t num_pages = 0;
+  for (int level = 0; level < header->num_levels; ++level) {
+    num_pages += (num_pages_x >> level) * (num_pages_y >> level);
+  }
+  return size >= kVirtualTextureHeaderSize +
+      num_pages * kVirtualTextureTileBytes;
+}
+
+}  // namespace wvu
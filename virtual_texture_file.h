@@ -0,0 +1,118 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+// Author: Dustin Teel (dlteel@mix.wvu.edu)
+// Author: Brandon Horn (bhorn1@mix.wvu.edu)
+
+#ifndef VIRTUAL_TEXTURE_FILE_H_
+#define VIRTUAL_TEXTURE_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "image_decoder.h"
+#include "mipmap_generator.h"
+
+namespace wvu {
+// Virtual texture file (.wvvt): the mipmap levels of a texture cut into square
+// pages, so that a single page can be read without reading its level. Each
+// page is stored with a border of texels copied from its neighbors (wrapping
+// around the edges), which lets the hardware filter bilinearly within a page.
+// The size of the texture is a power of two, and the levels stop when the
+// smaller side is one page: the coarsest level is never smaller than a page.
+//
+// File layout, little endian:
+//   Header (32 bytes):
+//     char magic[4]  "WVVT".
+//     uint32 version  kVirtualTextureVersion.
+//     uint32 width, height  Size of level 0.
+//     uint32 page_size  Side of the pages, without the border.
+//     uint32 border  Texels of border on each side of a page.
+//     uint32 num_levels  Number of levels.
+//     uint32 reserved  Zero.
+//   Pages, RGBA, level by level and row by row within a level. A page takes
+//   4 * (page_size + 2 * border)^2 bytes.
+
+// Version of the layout written by WriteVirtualTexture().
+constexpr uint32_t kVirtualTextureVersion = 1;
+// Side of the pages, without the border.
+constexpr int kVirtualTexturePageSize = 128;
+// Texels of border on each side of a page.
+constexpr int kVirtualTextureBorder = 4;
+// Side of a page with its border, and bytes of a page in the file.
+constexpr int kVirtualTextureTileSize =
+    kVirtualTexturePageSize + 2 * kVirtualTextureBorder;
+constexpr size_t kVirtualTextureTileBytes =
+    4 * kVirtualTextureTileSize * kVirtualTextureTileSize;
+// Bytes of the header; the pages follow it.
+constexpr size_t kVirtualTextureHeaderSize = 32;
+
+// Size and levels of a virtual texture file.
+struct VirtualTextureHeader {
+  // Size of level 0.
+  int width;
+  int height;
+  int num_levels;
+};
+
+// Returns true if the filepath has the .wvvt extension of virtual textures.
+bool IsVirtualTexturePath(const std::string& filepath);
+
+// Writes an image into a virtual texture file. The image is resized to the
+// nearest power of two sizes, at least one page, and its mipmaps are built with
+// the given filter. Returns true if successful.
+// Params:
+//   filepath  The path of the file.
+//   image  The texture.
+//   filter  Filter building the mipmaps.
+//   num_threads  Threads building the mipmaps, or zero for one per hardware
+//     thread.
+bool WriteVirtualTexture(const std::string& filepath,
+                         const RgbaImage& image,
+                         const MipmapFilter filter,
+                         const int num_threads);
+
+// Reads and validates the header of a virtual texture file, and checks that the
+// file holds every page. Returns true if the file is valid.
+// Params:
+//   data  The contents of the file.
+//   size  Bytes of the file.
+//   header  The header read.
+bool ReadVirtualTextureHeader(const unsigned char* data,
+                              const size_t size,
+                              VirtualTextureHeader* header);
+
+}  // namespace wvu
+
+#endif  // VIRTUAL_TEXTURE_FILE_H_